@@ -61,7 +61,7 @@
 
 #include <stdint.h>
 
-#ifdef __cplusplus__
+#ifdef __cplusplus
 extern "C" {
 #endif
 
@@ -105,6 +105,36 @@ struct OpiEventAutomation
     uint32_t    smoothFrames;   // frames to interpolate over (0 = snap)
 };
 
+// Packed event buffer, used instead of the pointer arrays in OpiProcessInfo
+// when both sides agree on opiConfigPackedEvents (see below).
+//
+// The events are stored back to back as records: a uint32_t holding the size
+// of the whole record in bytes (a multiple of 4, at least 4 + sizeof(OpiEvent))
+// followed directly by the event itself. The data pointer is at least 4-byte
+// aligned. Events of unknown type can be skipped by their size.
+//
+// For input the host fills data, size and count (capacity is unused).
+//
+// For output the host provides data and capacity (in bytes) and sets size and
+// count to zero before each process call; the plugin appends records (sorted
+// by delta like input events) and updates size and count. If there is no room
+// left the plugin must drop the event. The contents belong to the host again
+// once opiPlugProcess returns.
+//
+// RATIONALE: Arrays of pointers to separately allocated events cost a pointer
+// chase (and likely a cache miss) per event and leave plugins to manage the
+// storage for outbound events with no clear lifetime. A single contiguous
+// buffer in each direction is cheap to walk and to fill, and having the host
+// own both means nobody allocates anything during processing.
+//
+struct OpiEventBuffer
+{
+    void *      data;       // packed records
+    uint32_t    size;       // bytes used
+    uint32_t    capacity;   // bytes available (output only)
+    uint32_t    count;      // number of events
+};
+
 // OpiTimeInfo flags: bitwise OR together
 static const uint32_t   opiTimeTransportPlaying = 1<<0;
 static const uint32_t   opiTimeSamplePosValid   = 1<<1;
@@ -149,19 +179,127 @@ enum OpiHostOps
 {
     opiHostParamState,  // set parameter automation state, 1 = editing (uint32_t *)
     opiHostParamValue,  // send parameter automation, normalized [0,1] (float *)
+                        // not from opiPlugProcess: queue and send on opiPlugIdle
 
     opiHostPatchChange, // notify the host that all past state should be flushed
     opiHostResizeEdit,  // resize editor, call once at init (struct OpiEditSize *)
 
     opiHostSetLatency,  // request that host refresh opiPlugGetLatency
+
+    opiHostNumWorkers,  // return max number of tasks that may run concurrently
+    opiHostRunTasks,    // [RT] run tasks and wait for them (struct OpiTaskList *)
+
+    opiHostGetProfiler, // [ANY] return pointer to struct OpiProfiler (or 0)
+
+    opiHostGetArena,    // [RT] return pointer to struct OpiArena (or 0)
+    opiHostGetScratch,  // [UI] get host memory for a string result (struct OpiString *)
 };
 
+// opiHostSetLatency may be called from any thread, including from within
+// opiPlugProcess. The host queries opiPlugGetLatency again later, outside
+// [RT], and adjusts its delay compensation, so a change of latency takes
+// effect some blocks after the plugin has signalled it.
+
 struct OpiEditSize
 {
     uint32_t    w;  // width in pixels (logical pixels for Retina, etc)
     uint32_t    h;  // height in pixels (logical pixels for Retina, etc)
 };
 
+// opiHostRunTasks lets a plugin split work across the host's own (realtime)
+// worker threads. The host calls run(ctx, i) exactly once for each i in
+// [0, nTasks), in any order and possibly concurrently, and only returns once
+// all of them have finished. It may only be called from within opiPlugProcess.
+//
+// If the host returns 0 (not supported) then none of the tasks were run and
+// the plugin must run them itself. opiHostNumWorkers returns 0 in that case,
+// otherwise the number of threads that may run tasks (including the caller)
+// which is a reasonable guide for how finely to split the work.
+//
+// Tasks must be real-time safe and must not call back into the host.
+//
+// RATIONALE: If every plugin spins up its own threads they end up fighting
+// with each other and with the host's audio threads over the same cores;
+// borrowing the host's workers keeps the total number of threads in check
+// and lets the host schedule plugin work alongside everything else.
+//
+typedef void (*OpiTaskCallback)(void * ctx, uint32_t task);
+
+struct OpiTaskList
+{
+    uint32_t        taskListSize;   // = sizeof(OpiTaskList) for future extensions
+    uint32_t        nTasks;
+
+    OpiTaskCallback run;
+    void *          ctx;
+};
+
+// opiHostGetProfiler lets a plugin mark named zones of its own processing,
+// which the host records along with its timing of every opiPlugProcess call
+// (eg. to show a trace or attribute DSP load to instances and their parts).
+// The profiler stays valid for the lifetime of the plugin; plugins typically
+// ask for it once in opiPlugConfig.
+//
+// Zones may only be used on the thread running opiPlugProcess, during the
+// call, and must nest: every begin() is matched by an end() before the call
+// returns. The name must stay valid for the lifetime of the plugin (ie. use
+// string constants) since the host only keeps the pointer. Both functions
+// are real-time safe and cheap, especially while the host isn't recording.
+//
+// RATIONALE: Only the host knows when each instance runs and on which thread
+// and only the plugin knows where its time goes; putting both in the same
+// record makes it possible to find what blows the deadline in a big session.
+//
+struct OpiProfiler
+{
+    uint32_t    profilerSize;   // = sizeof(OpiProfiler) for future extensions
+
+    void        (*begin)(struct OpiProfiler *, const char * name);
+    void        (*end)(struct OpiProfiler *);
+};
+
+// opiHostGetArena returns memory the host has set aside for this instance, or
+// 0 if there is none. The plugin asks for it by setting OpiConfig::arenaSize
+// in opiPlugConfig; the arena is there from opiPlugEnable on and holds at
+// least that many bytes until the next opiPlugConfig.
+//
+// It is a plain bump allocator: alloc() hands out the next size bytes at the
+// given alignment (a power of two, at most 4096) or returns 0 once it's full.
+// Nothing is ever freed; instead the host empties the whole arena right before
+// each opiPlugEnable and opiPlugReset, so plugins carve it up in those (the
+// same sizes in the same order give the same pointers) or as they go along in
+// opiPlugProcess. Contents are undefined after emptying. alloc() is real-time
+// safe, but only for the [RT] context itself (not from opiHostRunTasks tasks).
+//
+// The host hands out memory that is already faulted in, on huge pages where
+// it can and on the NUMA node the instance runs on if it knows which.
+//
+// RATIONALE: A plugin that must not allocate in opiPlugProcess has to guess
+// at opiPlugConfig everything it might need and get it from the general heap,
+// which scatters its state and leaves the first touch of every page to the
+// audio thread. The host knows where the instance is going to run and can
+// give it one contiguous prefaulted block instead, and emptying it on reset
+// gives plugins that build up state as they go (eg. voices) a free restart.
+//
+struct OpiArena
+{
+    uint32_t    arenaSize;  // = sizeof(OpiArena) for future extensions
+
+    uint64_t    capacity;   // bytes
+    uint64_t    used;       // bytes handed out so far, including padding
+
+    void *      (*alloc)(struct OpiArena *, uint64_t size, uint32_t align);
+};
+
+// opiHostGetScratch lends the plugin host memory to return a string in (eg.
+// for opiPlugGetParamName or opiPlugValueToString): the plugin sets size to
+// the bytes it needs and the host sets data, or returns 0 and the plugin uses
+// a buffer of its own. The memory stays valid as long as the string returned
+// in it has to, but only the most recent scratch is valid.
+//
+// RATIONALE: Otherwise every instance keeps a buffer around just for passing
+// strings out, which the host copies from straight away anyway.
+
 // opcodes for dispatchToPlugin (parameters in parenthesis)
 //
 // The plugin should always return 0 for unknown or unimplemented opcodes
@@ -177,6 +315,10 @@ struct OpiEditSize
 // Operations marked [ANY] can be called concurrently with everything else
 // (eg. two opiSetParam calls to the same parameter concurrently are valid)
 //
+// Values set with opiPlugSetParam need not be applied immediately, but should
+// take effect no later than the start of the next opiPlugProcess call (before
+// any automation events for that block).
+//
 // Finally opiPlugDestroy must never be called while any other call active.
 //
 // opiPlugConfig is only valid while a plugin is in disable state (the default)
@@ -222,8 +364,59 @@ enum OpiPlugOps
 
     opiPlugGetPatchName,    // [UI] get current patch name (struct OpiString *)
     opiPlugSetPatchName,    // [UI] set current patch (struct OpiString *)
+
+    opiPlugIdle,        // [UI] periodic call, eg. to send queued opiHostParamValue
+
+    opiPlugGetTailFrames,   // [ANY] get tail length in frames (uint32_t *)
+
+    opiPlugSaveSections,    // [UI] save state in sections (struct OpiSectionWriter *)
+    opiPlugLoadSections,    // [UI] load state from sections (struct OpiSectionReader *)
+
+    opiPlugGetParams,       // [ANY] get a range of parameter values (struct OpiParamRange *)
+    opiPlugSetParams,       // [ANY] set a range of parameter values (struct OpiParamRange *)
+    opiPlugGetParamChanges, // [ANY] find parameters that changed (struct OpiParamChanges *)
+
+    opiPlugFlushEvents,     // [RT] handle events without audio (struct OpiProcessInfo *)
+    opiPlugGetFuncs,        // [ANY] return pointer to struct OpiPluginFuncs (or 0)
+
+    opiPlugMaxBatch,        // [ANY] return max instances per batch (0 = not supported)
+    opiPlugProcessBatch,    // [RT] process several instances (struct OpiBatchInfo *)
+
+    opiPlugAcceptsParamBuffer,  // [ANY] return 1 if parameter idx takes OpiParamBuffers
+
+    opiPlugValuesToStrings, // [UI] convert many values to strings (struct OpiParamStrings *)
+    opiPlugStringsToValues, // [UI] convert many strings to values (struct OpiParamStrings *)
+    opiPlugGetParamFormat,  // [ANY] return pointer to struct OpiParamFormat (or 0)
 };
 
+// opiPlugFlushEvents takes the events of an OpiProcessInfo (in either event
+// transport) and applies them as if processing a block, but without any
+// audio: nFrames is 0 and inputs and outputs are 0. This lets the host pass
+// on parameter changes and automation while it isn't running audio (eg. the
+// transport is stopped) without faking a process call. Only valid while the
+// plugin is enabled.
+
+// opiPlugGetTailFrames: the number of frames the outputs can stay non-silent
+// once all inputs have gone silent and no more events arrive (eg. the decay
+// time of a reverb; 0 for a plain gain), or opiTailInfinite if the plugin
+// produces output on its own. The value may change with parameters, so the
+// host should query it again whenever the inputs go silent.
+//
+// Once the inputs have been silent (and there were no events) for at least
+// this long, the host may stop calling opiPlugProcess and treat the outputs
+// as silent, until there is non-silent input or an event again. It then just
+// carries on calling opiPlugProcess (without a reset); the plugin must cope
+// with the skipped time (eg. a jump in OpiTimeInfo::samplePos).
+//
+// If a plugin does not implement this op (returns 0) the host must assume
+// opiTailInfinite and keep calling opiPlugProcess.
+//
+// RATIONALE: In a large session most plugins are idle most of the time and
+// silenceMask alone still costs a process call per plugin per block; only
+// the plugin can know how long it keeps ringing after its inputs stop.
+//
+static const uint32_t   opiTailInfinite         = 0xffffffff;
+
 // each logical bus is a collection of channels
 // the number of channels must be set by calling opiPlugConfig (see below)
 //
@@ -245,6 +438,17 @@ enum OpiPlugOps
 // the additional complexity is very minor (eg. the plugin can just always set
 // silenceMask to zero for all the outputs if it doesn't care about any of this).
 //
+// silenceMask covers channels 0 to 63. With opiConfigWideSilence, buses with
+// more channels carry the bits for the rest in more words straight after
+// channels[nChannels - 1] (rounded up to a multiple of 8 bytes): the bit for
+// channel c is bit c % 64 of word c / 64, silenceMask being word 0. They work
+// exactly like silenceMask, for inputs and outputs. Without the flag there are
+// no such words and channels from 64 up are never flagged.
+//
+// RATIONALE: A wider mask in place would change every bus for the sake of a
+// few very wide ones (eg. higher-order ambisonics), while words after the
+// pointers cost nothing below 65 channels and leave the layout alone.
+//
 struct OpiBusChannels
 {
     uint64_t    silenceMask;    // bitmask of fully silent channels (1 = silent)
@@ -262,6 +466,17 @@ struct OpiBusChannels
 // If plugin wants to send outbound events, it should set the outEvents pointer
 // and the number of events to non-zero values.
 //
+// With opiConfigPackedEvents the host passes the input events in inEventBuffer
+// instead (with inEvents = 0 and nInEvents = 0) and the plugin must only write
+// outbound events into outEventBuffer. These fields are only present if
+// processInfoSize covers them.
+//
+// Parameters that the plugin accepts per-frame values for can be modulated
+// with paramBuffers instead of events (see OpiParamBuffer); also only present
+// if processInfoSize covers them.
+//
+struct OpiParamBuffer;
+
 struct OpiProcessInfo
 {
     uint32_t    processInfoSize; // = sizeof(OpiProcessInfo) for future extensions
@@ -277,11 +492,58 @@ struct OpiProcessInfo
     
     uint32_t        nInEvents;      // number of input events
     uint32_t        nOutEvents;     // number of output events
+
+    OpiEventBuffer  inEventBuffer;  // packed input events (opiConfigPackedEvents)
+    OpiEventBuffer  outEventBuffer; // host arena for output (opiConfigPackedEvents)
+
+    struct OpiParamBuffer * paramBuffers;   // per-frame parameter values (or 0)
+    uint32_t        nParamBuffers;  // number of paramBuffers
 };
 
+// Audio-rate parameter values: values[i] is the (normalized) value of the
+// parameter paramIndex at frame i of the block, for all nFrames frames. The
+// host may only pass buffers for parameters where opiPlugAcceptsParamBuffer
+// returned 1, sorted by paramIndex and at most one per parameter.
+//
+// A buffer replaces any automation for that parameter in the block: the host
+// should not send OpiEventAutomation for it as well (and if it does, the
+// buffer wins). The parameter then keeps the last value of the buffer (eg. as
+// seen by opiPlugGetParam) until something else changes it.
+//
+// RATIONALE: Modulation (LFOs, envelopes, dense automation curves) sent as
+// events splits the block at every breakpoint, so the plugin pays for the
+// spans and the per-event bookkeeping over and over. A host that renders the
+// curve once into a buffer lets the plugin treat the parameter like another
+// input signal and keep its inner loops whole. Only some parameters make
+// sense at audio rate, so the plugin opts in per parameter.
+//
+struct OpiParamBuffer
+{
+    uint32_t        paramIndex;
+    const float *   values;         // nFrames values
+};
+
+// With opiConfigInterleaved the host may ask for a bus to be laid out in
+// groups of interleave channels (0 or 1 = planar, the default): frame i of
+// every channel in a group is stored together, so channels[c] points at the
+// first sample of channel c and sample i is at channels[c][i * interleave].
+// Groups start at multiples of interleave channels and the last one is padded
+// to the full width, so the plugin can always process whole groups (the
+// padding channels hold nothing in particular). Silence and in-place still go
+// per channel. A plugin that can't take the interleave asked for may set it
+// back to 1 and still return 1, the host must then pass that bus planar.
+// interleave is only there if busConfigSize covers it, and opiPlugProcessBatch
+// only ever batches planar buses.
+//
+// RATIONALE: With hundreds of channels each planar loop does the same thing
+// over and over on short buffers. Interleaving a vector's worth of channels
+// lets the plugin run across channels with full SIMD vectors, while groups
+// keep the buffers small enough to stay in cache.
+//
 struct OpiBusConfig
 {
     uint32_t    nChannels;      // number of channels (0 = disconnected)
+    uint32_t    interleave;     // channels per group (opiConfigInterleaved)
 };
 
 // the plugin must be in disabled (initial) state when opiPlugConfig is called
@@ -297,19 +559,76 @@ struct OpiBusConfig
 // relevant in any given situation) it seems to make the most sense to just let
 // the host try the applicable configurations one by one in order of preference.
 //
+// The same applies to the flags: the plugin must return 0 if any flag is set
+// that it does not understand (or support) and the host can retry without.
+//
+// The blocksize is the maximum nFrames the host will pass to opiPlugProcess.
+// If the plugin can't handle blocks that large it may lower blocksize to what
+// it can handle and still return 1; the host must then respect the lower
+// value (and may configure again, eg. so that every plugin in a graph agrees
+// on the same size). The plugin must never raise it, and must only lower it if
+// configSize covers flags (older hosts won't look).
+//
+// The host sets arenaSize to 0; a plugin that wants an arena (see
+// opiHostGetArena) sets it to the bytes it needs, if configSize covers it.
+//
 struct OpiConfig
 {
     uint32_t    configSize; // = sizeof(OpiConfig) for future extensions
     
-    uint32_t    blocksize;
+    uint32_t    blocksize;  // maximum nFrames, the plugin may lower it (see above)
     float       samplerate;
 
     uint32_t    busConfigSize;  // = sizeof(OpiBusConfig) for future extensions
 
     OpiBusConfig *inBusChannels;    // array of bus configurations
     OpiBusConfig *outBusChannels;   // array of bus configurations
+
+    uint32_t    flags;          // OpiConfig flags (only if configSize covers it)
+
+    uint64_t    arenaSize;      // set by the plugin, see opiHostGetArena (same rule)
 };
 
+// OpiConfig flags: bitwise OR together
+//
+// opiConfigInPlace: the host may pass the same buffer for inputs[b].channels[c]
+// and outputs[b].channels[c] (for any bus and channel present on both sides),
+// so the plugin must not rely on the input still being there after it writes
+// the output. Buffers never overlap partially.
+//
+// RATIONALE: With in-place processing a chain of plugins can run through a
+// single buffer per channel, rather than touching a new one for every plugin,
+// which keeps the working set small when there are lots of short blocks.
+//
+static const uint32_t   opiConfigInPlace        = 1<<0;
+
+// opiConfigPackedEvents: events are passed in OpiProcessInfo::inEventBuffer
+// and outEventBuffer rather than the pointer arrays (see OpiEventBuffer).
+//
+static const uint32_t   opiConfigPackedEvents   = 1<<1;
+
+// opiConfigOffline: the host is rendering offline (eg. a bounce) rather than
+// playing back live, so opiPlugProcess does not need to be real-time safe: the
+// plugin may allocate, wait for disk, block on opiHostRunTasks tasks that take
+// locks, or switch to slower but higher quality algorithms. Block sizes are
+// likely to be large. All the threading rules for [RT] still apply.
+//
+// RATIONALE: Without knowing, a plugin has to take its real-time path even
+// when nobody is listening, and the host has to bounce with the small blocks
+// of live playback even though large ones would be much faster.
+//
+static const uint32_t   opiConfigOffline        = 1<<2;
+
+// opiConfigWideSilence: buses with more than 64 channels carry silence words
+// past silenceMask (see OpiBusChannels).
+//
+static const uint32_t   opiConfigWideSilence    = 1<<3;
+
+// opiConfigInterleaved: OpiBusConfig::interleave may ask for interleaved
+// channel groups (see OpiBusConfig).
+//
+static const uint32_t   opiConfigInterleaved    = 1<<4;
+
 // This is passed by host to both opiPlugSaveChunk and opiPlugLoadChunk
 // but for opiPlugSaveChunk the plugin sets the pointer and the data size and
 // the buffer remains valid until next [UI] context call to dispatcher.
@@ -319,6 +638,71 @@ struct OpiChunk
     uint32_t    size;
 };
 
+// Sectioned state, as an alternative to OpiChunk for plugins with large state
+// (eg. samplers). The state is a set of sections, each with a plugin-chosen
+// id (unique within the state) and any amount of data. The plugin pushes the
+// data to the host in pieces as it goes, so it never has to build the whole
+// state in one buffer, and sizes are 64-bit.
+//
+// Saving: for each section the plugin calls begin() and then write() as many
+// times as it likes. If any call returns 0 the plugin must stop and return 0.
+//
+// With opiSaveDirtyOnly set, the host still has the state from the previous
+// successful save or load through this interface, and the plugin may call
+// keep() instead for sections that have not changed since then; sections
+// that are neither written nor kept are dropped. After a failed save the
+// host must not ask for dirty-only until it has done a full save.
+//
+// Loading: the host provides the sections in the order they were saved. The
+// plugin can read() any part of any section, or map() a section to get a
+// pointer to all of it. map() may return 0 (eg. if the host does not keep
+// the state in memory or a file it can map) in which case the plugin must
+// fall back to read(). Mapped memory is read-only and remains valid until
+// the plugin is destroyed or opiPlugLoadSections is called again, so the
+// plugin can keep using it instead of copying it (and the host can back it
+// with a memory mapped file that is only paged in as the plugin touches it).
+//
+// Plugins that implement these must still implement opiPlugSaveChunk and
+// opiPlugLoadChunk (eg. for copy & paste of presets), but if both are
+// available the host should prefer sections for projects.
+//
+// RATIONALE: A single contiguous chunk means a plugin with hundreds of MB of
+// state has to copy all of it into one buffer (doubling peak memory) and the
+// host has to write all of it on every save, even if a single knob changed.
+//
+struct OpiSectionWriter
+{
+    uint32_t    writerSize; // = sizeof(OpiSectionWriter) for future extensions
+    uint32_t    flags;      // OpiSectionWriter flags
+    void *      ctx;        // for the host
+
+    // start a new section
+    int32_t     (*begin)(struct OpiSectionWriter *, uint32_t id);
+    // append data to the current section
+    int32_t     (*write)(struct OpiSectionWriter *, const void * data, uint64_t size);
+    // reuse a section unchanged from the previous save (opiSaveDirtyOnly only)
+    int32_t     (*keep)(struct OpiSectionWriter *, uint32_t id);
+};
+
+// OpiSectionWriter flags: bitwise OR together
+static const uint32_t   opiSaveDirtyOnly        = 1<<0;
+
+struct OpiSectionReader
+{
+    uint32_t    readerSize; // = sizeof(OpiSectionReader) for future extensions
+    uint32_t    nSections;
+    void *      ctx;        // for the host
+
+    // get the id and size of a section (by index)
+    int32_t     (*info)(struct OpiSectionReader *, uint32_t index,
+                    uint32_t * id, uint64_t * size);
+    // read part of a section, returns the number of bytes read
+    uint64_t    (*read)(struct OpiSectionReader *, uint32_t index,
+                    uint64_t offset, void * data, uint64_t size);
+    // pointer to the whole section, or 0 if not supported
+    const void* (*map)(struct OpiSectionReader *, uint32_t index);
+};
+
 // This is used for operations that get or set strings. The pointer and size
 // are always filled by the party that provides the contents and must remain
 // valid until the next [UI) context dispatcher call.
@@ -344,6 +728,168 @@ struct OpiParamString
     float       value;
 };
 
+// opiPlugValuesToStrings and opiPlugStringsToValues work like opiPlugValueToString
+// and opiPlugStringToValue for parameter idx, but on count values at once, with
+// the strings packed in memory the host provides: string i starts at
+// data + offsets[i] and is offsets[i + 1] - offsets[i] - 1 bytes long, followed
+// by a NUL (so offsets has count + 1 entries).
+//
+// For opiPlugValuesToStrings the host sets values, data, dataSize and offsets[0]
+// (usually 0) and the plugin writes the strings one after another, setting the
+// offsets as it goes. If dataSize runs out it stops after the last string that
+// fits whole; it returns the number of strings written (0 if it can't convert
+// in bulk at all, in which case the host converts one value at a time). The
+// host may then call again with the rest.
+//
+// For opiPlugStringsToValues the host sets data, offsets and count and the
+// plugin sets values; strings it can't make sense of leave their value alone.
+//
+// RATIONALE: Drawing an automation lane or a long list of parameters converts
+// thousands of values, each a [UI] call whose result the host has to copy out
+// before the next one. Packing them into the host's memory needs one call and
+// no copies, and the host can keep the strings as long as it likes.
+//
+struct OpiParamStrings
+{
+    uint32_t    paramStringsSize;   // = sizeof(OpiParamStrings) for future extensions
+    uint32_t    count;
+
+    float *     values;     // count values
+    char *      data;       // the strings, packed
+    uint32_t    dataSize;   // bytes available at data
+    uint32_t *  offsets;    // count + 1 entries
+};
+
+// opiPlugGetParamFormat returns how parameter idx turns into a string, for
+// hosts that would rather do it themselves than ask the plugin, or 0 if the
+// parameter isn't simple enough to describe this way. The pointer must stay
+// valid (and unchanged) for the lifetime of the plugin.
+//
+// The string for a value is value * scale (in single precision) printed like
+// printf's "%.*f" with precision digits, then a space and the unit if unit is
+// neither 0 nor empty. Parsing takes a number (as strtod reads it), optionally
+// followed by spaces and the unit, and divides it by scale. A plugin that
+// returns a format must give exactly these strings from opiPlugValueToString(s).
+//
+// RATIONALE: Most parameters are a number with a unit, and a host that knows
+// that can format them for display without calling into the plugin at all,
+// which also works when the plugin is busy, remote or not loaded (eg. from a
+// saved session). Anything fancier still goes through the plugin.
+//
+struct OpiParamFormat
+{
+    uint32_t        formatSize; // = sizeof(OpiParamFormat) for future extensions
+
+    float           scale;      // displayed number = value * scale
+    uint32_t        precision;  // digits after the decimal point
+    const char *    unit;       // UTF-8, eg. "dB" or "Hz" (0 or "" for none)
+};
+
+// opiPlugGetParams and opiPlugSetParams work exactly like opiPlugGetParam and
+// opiPlugSetParam for each of the parameters first to first+count-1, but in a
+// single call. If the range goes past opiPlugNumParam the plugin returns 0
+// (and must not touch any parameters).
+struct OpiParamRange
+{
+    uint32_t    first;      // index of the first parameter
+    uint32_t    count;      // number of parameters
+    float *     values;     // array of count values
+};
+
+// opiPlugGetParamChanges reports which parameters changed value (through
+// opiPlugSetParam(s) or by the plugin itself, eg. automation) since an earlier
+// call: bit i of the bitset is set if parameter first+i may have changed.
+//
+// The generation is a token: pass 0 on the first call (all bits are set) and
+// then whatever the plugin returned in it on the previous call. Any number of
+// callers can each keep their own generation. Bits may be set for parameters
+// that didn't actually change (eg. when set to the same value), but no change
+// is ever missed.
+//
+// RATIONALE: Host UIs and automation recorders otherwise have to poll every
+// parameter to find the handful that moved, which gets expensive for plugins
+// with thousands of them.
+//
+struct OpiParamChanges
+{
+    uint32_t    generation; // in: from the previous call (0 = first), out: for the next
+    uint32_t    first;      // first parameter to report, a multiple of 64
+    uint32_t    count;      // number of parameters to report
+    uint64_t *  bits;       // (count + 63) / 64 words, cleared by the plugin first
+};
+
+// opiPlugProcessBatch processes several instances of the same plugin (ie.
+// created by the same entrypoint, configured identically and all enabled) in
+// a single call, which the host makes on any one of them. For each instance
+// in the batch it counts as its opiPlugProcess call. opiPlugMaxBatch returns
+// the largest nInstances the plugin accepts, or 0 if it can't batch.
+//
+// The audio is laid out across instances: the batch has the usual buses and
+// channels, but each channel holds nFrames * nInstances samples, with frame i
+// of instance k at index i * nInstances + k. The same frame of every instance
+// is thus adjacent and the plugin can process the instances in SIMD lanes. A
+// silenceMask bit means the channel is silent for every instance.
+//
+// Everything else (time info, input and output events) is per instance in
+// procInfos[k], whose nFrames matches the batch; its inputs and outputs must
+// be ignored.
+//
+// RATIONALE: Running the same plugin on lots of tracks (eg. a channel strip)
+// costs a call per instance, each too short to amortise its setup, and the
+// inner loops only ever see one instance. Handing the plugin all of them at
+// once lets it vectorise across instances instead.
+//
+struct OpiBatchInfo
+{
+    uint32_t    batchInfoSize;  // = sizeof(OpiBatchInfo) for future extensions
+    uint32_t    nInstances;
+    uint32_t    nFrames;
+
+    struct OpiPlugin **         plugins;    // the instances, in lane order
+    struct OpiProcessInfo **    procInfos;  // per instance, same order
+
+    OpiBusChannels  *inputs;        // pointer to array of OpiBusChannels
+    OpiBusChannels  *outputs;       // pointer to array of OpiBusChannels
+};
+
+// Direct entry points for the hot operations, returned by opiPlugGetFuncs.
+// Each one behaves exactly like dispatchToPlugin with the corresponding op
+// (same return values and same threading rules) so a host can call them
+// without going through the opcode switch; the dispatcher must still handle
+// every op as well.
+//
+// The table must stay valid (and unchanged) for the lifetime of the plugin;
+// typically it is a static constant shared by all instances. Any pointer may
+// be 0 if the plugin doesn't implement the op. The host must only look at
+// fields covered by funcsSize and should fall back to the dispatcher for
+// anything missing.
+//
+// RATIONALE: With small blocks the fixed cost of every call adds up and the
+// opcode switch (another indirect branch) is part of it. A plain table keeps
+// the dispatcher as the one extensible interface while letting hosts go
+// straight to the few functions that are called all the time.
+//
+struct OpiPluginFuncs
+{
+    uint32_t    funcsSize;  // = sizeof(OpiPluginFuncs) for future extensions
+
+    // opiPlugProcess
+    void        (*process)(struct OpiPlugin *, struct OpiProcessInfo *);
+    // opiPlugFlushEvents
+    void        (*flushEvents)(struct OpiPlugin *, struct OpiProcessInfo *);
+
+    // opiPlugGetParam and opiPlugSetParam
+    int32_t     (*getParam)(struct OpiPlugin *, uint32_t idx, float * value);
+    int32_t     (*setParam)(struct OpiPlugin *, uint32_t idx, float value);
+
+    // opiPlugGetParams and opiPlugSetParams
+    int32_t     (*getParams)(struct OpiPlugin *, struct OpiParamRange *);
+    int32_t     (*setParams)(struct OpiPlugin *, struct OpiParamRange *);
+
+    // opiPlugProcessBatch
+    void        (*processBatch)(struct OpiPlugin *, struct OpiBatchInfo *);
+};
+
 // Plugin entry point
 #ifndef DLLEXPORT
 # ifdef _WIN32
@@ -353,12 +899,54 @@ struct OpiParamString
 # endif
 #endif
 
-DLLEXPORT OpiPlugin * OpiPluginEntrypoint(OpiCallback hostCallback)
+// The plugin returns a new instance (or 0 on failure) with dispatchToHost set to
+// hostCallback and ptrHost set to hostPtr. Hosts that load plugins dynamically
+// should look up the "OpiPluginEntrypoint" symbol and cast it to OpiEntrypoint.
+typedef struct OpiPlugin * (*OpiEntrypoint)(OpiCallback hostCallback, void * hostPtr);
+
+DLLEXPORT struct OpiPlugin * OpiPluginEntrypoint(OpiCallback hostCallback, void * hostPtr);
+
+// Static description of a plugin, for scanning without creating an instance.
+// Plugins may export "OpiPluginDescriptor" (of type OpiDescriptorFunc) next to
+// the entrypoint; it must not allocate or have any other side effects and the
+// result must stay valid (and unchanged) while the library is loaded.
+//
+// Each field is what the corresponding op returns on a new instance (before
+// opiPlugConfig). Anything not covered here still needs an instance, and the
+// host must fall back to one if the symbol is missing or descriptorSize
+// doesn't cover a field.
+//
+// RATIONALE: Creating an instance just to ask what it is can be expensive
+// (plugins tend to allocate, build tables or check licenses in there) and a
+// large library is scanned often. Plain data is cheap to read, and since it
+// only depends on the binary the host can cache it and skip even loading the
+// library as long as the file hasn't changed.
+//
+struct OpiParamDescriptor
 {
-    return 0;
-}
+    const char *    name;           // UTF-8, as from opiPlugGetParamName
+    float           defaultValue;   // as from opiPlugGetParam
+};
+
+struct OpiDescriptor
+{
+    uint32_t    descriptorSize; // = sizeof(OpiDescriptor) for future extensions
+
+    uint32_t    nInputs;        // opiPlugNumInputs
+    uint32_t    nOutputs;       // opiPlugNumOutputs
+    uint32_t    maxChannels;    // opiPlugMaxChannels
+    uint32_t    inEventMask;    // opiPlugInEventMask
+    uint32_t    outEventMask;   // opiPlugOutEventMask
+
+    uint32_t    nParams;        // opiPlugNumParam
+    const struct OpiParamDescriptor * params;   // nParams entries
+};
+
+typedef const struct OpiDescriptor * (*OpiDescriptorFunc)(void);
+
+DLLEXPORT const struct OpiDescriptor * OpiPluginDescriptor(void);
 
-#ifdef __cplusplus__
+#ifdef __cplusplus
 } // extern "C"
 #endif
 
@@ -0,0 +1,1281 @@
+/*
+/// # Community Plugin Format Process Bridge
+///
+/// ## About
+/// Runs a plugin in a process of its own (eg. to sandbox it) behind a proxy
+/// OpiPlugin that forwards the dispatcher calls, and the callbacks the plugin
+/// makes to the host, across the process boundary. Audio, events and call
+/// arguments all go through one shared memory region and calls are handed
+/// over with futexes: a process call copies nothing if the host keeps its
+/// buffers in the region (see inputBus and outputBus) and makes no system
+/// call as long as the other side is still spinning.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiBridgeHost bridge;
+///    bridge.start("plugin.so");                   // fork, load it in the child
+///    bridge.start("plugin.so", "./opi_bridge");   // or run the stub (OpiBridgeStub.cpp)
+///
+///    OpiHostInstance inst;
+///    inst.adopt(bridge.instantiate(&OpiHostInstance::hostDispatcher, &inst));
+///    ... configure and enable as usual, then per block ...
+///    info.inputs = bridge.inputBus();     // optional, saves copying the audio
+///    info.outputs = bridge.outputBus();
+///    inst.process(&info);
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// ## Details
+/// - One stub process per instance. It serves the [RT] calls on one thread
+///   and the rest on another, so the plugin sees the same concurrency as it
+///   would in-process; on the host side the non-[RT] calls take a lock.
+/// - Waiting for a reply spins for callSpin iterations before sleeping on the
+///   futex, and the stub spins for idleSpin between calls. A call only costs a
+///   wake-up if the other side has gone to sleep; spinning through the whole
+///   block (idleSpin) saves that too, but keeps a core busy per plugin. With a
+///   single core spinning only gets in the way, so it's off by default there.
+/// - Host buffers that are already in the shared region (audio, packed input
+///   events, parameter buffers) are passed as they are, anything else is
+///   copied. Pointer-array events are packed for the trip.
+/// - Only one bus per direction carries channels (see the FIXME on
+///   OpiHostBus); configurations with more are refused, as are
+///   opiConfigWideSilence and opiConfigInterleaved (the shared buses are
+///   planar and only have silenceMask).
+/// - Host ops that only make sense in the plugin's own process are answered
+///   by the stub: opiHostGetArena and opiHostGetScratch from its own memory,
+///   opiHostRunTasks, opiHostNumWorkers and opiHostGetProfiler as not
+///   supported. opiHostSetLatency works from any plugin thread, the other
+///   callbacks only from within a call.
+/// - Not forwarded (return 0, hosts fall back as usual): editors, sectioned
+///   state, the function table and batching. Chunks, strings and parameter
+///   ranges must fit the payload (uiPayload bytes).
+/// - If the stub dies the host notices while waiting for it (within 20ms);
+///   from then on every call returns 0 and process outputs silence. The host
+///   never follows pointers or trusts sizes coming back from the stub.
+/// - Linux only (memfd and futex). Whatever sandbox the stub process gets
+///   (seccomp, namespaces, ...) is up to the host.
+*/
+
+#pragma once
+
+#include "CommunityHost.h"
+#include "CommunityEvents.h"
+
+#ifdef __linux__
+# define OPI_BRIDGE_SUPPORTED 1
+#endif
+
+#ifdef OPI_BRIDGE_SUPPORTED
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * ==============================================================
+ *
+ *                          SHARED
+ *
+ * ===============================================================
+ */
+
+static const uint32_t   opiBridgeMagic = 0x4f504942;
+static const uint32_t   opiBridgeVersion = 1;
+static const uint32_t   opiBridgeMaxBuses = 8;
+static const uint32_t   opiBridgeMaxParamBuffers = 16;
+static const uint32_t   opiBridgeEventRoom = 64 << 10;  // bytes each way
+static const uint64_t   opiBridgeNone = ~(uint64_t) 0;  // offset: not in the region
+
+enum OpiBridgeState
+{
+    opiBridgeIdle,
+    opiBridgeCall,          // host to stub: op, idx and payload are ready
+    opiBridgeCallback,      // stub to host: the plugin called dispatchToHost
+    opiBridgeCallbackDone,  // host to stub: callback answered
+    opiBridgeDone,          // stub to host: result and payload are ready
+    opiBridgeQuit,          // host to stub: exit
+};
+
+// one calling context ([RT] or the rest); state is the futex word
+struct OpiBridgeChannel
+{
+    std::atomic<uint32_t>   state;
+    std::atomic<uint32_t>   hostSleeping;
+    std::atomic<uint32_t>   stubSleeping;
+
+    int32_t     op;
+    int32_t     idx;
+    int64_t     result;
+
+    int32_t     cbOp;
+    int32_t     cbIdx;
+    int64_t     cbResult;
+    uint32_t    cbSize;
+    uint8_t     cbData[16];
+
+    uint64_t    payload;        // offset and size of this channel's payload
+    uint64_t    payloadSize;
+};
+
+// at the start of the region
+struct OpiBridgeShared
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    size;           // of the whole region
+
+    uint32_t    maxChannels;    // audio slots per direction
+    uint32_t    maxFrames;      // per slot
+    uint64_t    audio;          // offset: input slots, then output slots
+
+    std::atomic<uint32_t>   callSpin;   // see OpiBridgeHost
+    std::atomic<uint32_t>   idleSpin;
+
+    std::atomic<uint32_t>   ready;          // 1 = instance created, 2 = failed
+    std::atomic<uint32_t>   latencyChanged; // opiHostSetLatency from another thread
+    std::atomic<uint32_t>   nWaits;         // futex waits and wakes, both sides
+    std::atomic<uint32_t>   nWakes;
+
+    uint32_t    nInputs;        // buses, as the plugin reported them
+    uint32_t    nOutputs;
+
+    OpiBridgeChannel    rt;
+    OpiBridgeChannel    ui;
+};
+
+// [RT] payload for opiPlugConfig
+struct OpiBridgeConfig
+{
+    OpiConfig   config;         // pointers unused
+    uint32_t    inChannels[opiBridgeMaxBuses];
+    uint32_t    outChannels[opiBridgeMaxBuses];
+};
+
+// [RT] payload for opiPlugProcess and opiPlugFlushEvents, followed by the
+// offsets of each channel's buffer (maxChannels inputs, then outputs) and
+// room for whatever has to be copied
+struct OpiBridgeProcess
+{
+    uint32_t    processInfoSize;    // as much of OpiProcessInfo as the host had
+    uint32_t    nFrames;
+    uint32_t    hasTime;
+    OpiTimeInfo time;
+
+    uint64_t    inSilence;
+    uint64_t    outSilence;
+
+    uint64_t    inEvents;           // offset of packed records
+    uint32_t    inEventsSize;
+    uint32_t    nInEvents;
+
+    uint64_t    outEvents;          // offset of room for packed records
+    uint32_t    outCapacity;
+    uint32_t    outSize;
+    uint32_t    nOutEvents;
+
+    uint32_t    nParamBuffers;
+    uint32_t    paramIndex[opiBridgeMaxParamBuffers];
+    uint64_t    paramValues[opiBridgeMaxParamBuffers];
+};
+
+// true if state is one of those in mask; state comes from the shared page,
+// so the other side may have left anything in there
+static inline bool opiBridgeInMask(uint32_t mask, uint32_t state)
+{
+    return state < 32 && (mask & (1u << state));
+}
+
+// returns the state once it is one of those in mask (bits of OpiBridgeState)
+// spinning first and then sleeping on the futex, or ~0u if gone() says the
+// other side has died (checked whenever a 20ms sleep runs out)
+template <class Gone>
+static inline uint32_t opiBridgeWait(OpiBridgeShared & shared, OpiBridgeChannel & ch,
+    uint32_t mask, uint32_t spin, std::atomic<uint32_t> & sleeping, Gone gone)
+{
+    for(uint32_t i = 0;; ++i)
+    {
+        uint32_t state = ch.state.load(std::memory_order_acquire);
+        if(opiBridgeInMask(mask, state)) return state;
+        if(i < spin) { OPI_POOL_PAUSE(); continue; }
+
+        // seq_cst both ways, so either we see the new state or they see us
+        sleeping.store(1);
+        state = ch.state.load();
+        long r = 0;
+        if(!opiBridgeInMask(mask, state))
+        {
+            timespec slice = { 0, 20 * 1000 * 1000 };
+            shared.nWaits.fetch_add(1, std::memory_order_relaxed);
+            r = syscall(SYS_futex, &ch.state, FUTEX_WAIT, state, &slice, 0, 0);
+        }
+        sleeping.store(0, std::memory_order_relaxed);
+        if(r == -1 && errno == ETIMEDOUT && gone()) return ~0u;
+    }
+}
+
+static inline void opiBridgePost(OpiBridgeShared & shared, OpiBridgeChannel & ch,
+    uint32_t state, std::atomic<uint32_t> & sleeping)
+{
+    ch.state.store(state);
+    if(sleeping.load())
+    {
+        shared.nWakes.fetch_add(1, std::memory_order_relaxed);
+        syscall(SYS_futex, &ch.state, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+    }
+}
+
+// payload strings and blobs: a uint32_t size, then the bytes
+static inline bool opiBridgePutBytes(char * at, uint64_t room, const void * data, uint32_t size)
+{
+    if(room < sizeof(uint32_t) || size > room - sizeof(uint32_t) || (size && !data)) return false;
+    memcpy(at, &size, sizeof(uint32_t));
+    if(size) memcpy(at + sizeof(uint32_t), data, size);
+    return true;
+}
+
+// the size, if it fits the room (sizes from the stub aren't trusted)
+static inline bool opiBridgeBytesSize(const char * at, uint64_t room, uint32_t & size)
+{
+    if(room < sizeof(uint32_t)) return false;
+    memcpy(&size, at, sizeof(uint32_t));
+    return size <= room - sizeof(uint32_t);
+}
+
+/*
+ * ==============================================================
+ *
+ *                          STUB
+ *
+ * ===============================================================
+ */
+
+// The child side: creates the plugin instance and serves both channels.
+struct OpiBridgeStub
+{
+    OpiBridgeShared *   shared = 0;
+    char *              base = 0;
+    pid_t               parent = 0;
+
+    OpiHostLibrary      lib;
+    OpiPlugin *         plug = 0;
+
+    OpiHostArena        arena;      // for opiHostGetArena
+    std::vector<char>   scratch;    // for opiHostGetScratch
+
+    // set up by opiPlugConfig
+    bool                packedEvents = false;
+    std::vector<char>   inStorage, outStorage;
+    std::vector<OpiEvent*>  inList;
+    OpiParamBuffer      params[opiBridgeMaxParamBuffers];
+    OpiTimeInfo         time;
+    OpiProcessInfo      info;
+
+    static OpiBridgeChannel *& current()
+    {
+        static thread_local OpiBridgeChannel * channel = 0;
+        return channel;
+    }
+
+    OpiBusChannels * inBus() { return (OpiBusChannels*) inStorage.data(); }
+    OpiBusChannels * outBus() { return (OpiBusChannels*) outStorage.data(); }
+
+    intptr_t dispatch(int32_t op, int32_t idx = 0, void * data = 0)
+    {
+        return plug->dispatchToPlugin(plug, op, idx, data);
+    }
+
+    // Maps the region behind fd and serves it until told to quit (or the
+    // host goes away); the plugin comes from path, or entrypoint if that's
+    // given (only after a plain fork, where it still points at the code).
+    static int run(int fd, const char * path, OpiEntrypoint entrypoint)
+    {
+        OpiBridgeShared header;
+        if(pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+            || header.magic != opiBridgeMagic || header.version != opiBridgeVersion) return 2;
+
+        void * ptr = mmap(0, header.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(ptr == MAP_FAILED) return 2;
+
+        OpiBridgeStub stub;
+        stub.base = (char*) ptr;
+        stub.shared = (OpiBridgeShared*) ptr;
+        stub.parent = getppid();
+
+        if(!entrypoint && path && stub.lib.open(path)) entrypoint = stub.lib.entrypoint;
+        if(entrypoint) stub.plug = entrypoint(&stubDispatcher, &stub);
+        if(stub.plug)
+        {
+            stub.shared->nInputs = (uint32_t) stub.dispatch(opiPlugNumInputs);
+            stub.shared->nOutputs = (uint32_t) stub.dispatch(opiPlugNumOutputs);
+        }
+        stub.shared->ready = stub.plug ? 1 : 2;
+        if(!stub.plug) return 1;
+
+        std::thread rt([&stub]()
+        {
+            opiSetThreadRealtime();
+            stub.serve(stub.shared->rt);
+        });
+        stub.serve(stub.shared->ui);
+        rt.join();
+
+        if(stub.plug) stub.dispatch(opiPlugDestroy);
+        stub.plug = 0;
+        return 0;
+    }
+
+    void serve(OpiBridgeChannel & ch)
+    {
+        current() = &ch;
+        pid_t host = parent;
+        auto gone = [host]() { return getppid() != host; };
+
+        for(;;)
+        {
+            uint32_t state = opiBridgeWait(*shared, ch,
+                (1u << opiBridgeCall) | (1u << opiBridgeQuit),
+                shared->idleSpin, ch.stubSleeping, gone);
+            if(state != opiBridgeCall) break;
+
+            ch.result = plug ? handle(ch) : 0;
+            opiBridgePost(*shared, ch, opiBridgeDone, ch.hostSleeping);
+        }
+        current() = 0;
+    }
+
+    int64_t handle(OpiBridgeChannel & ch)
+    {
+        char * payload = base + ch.payload;
+        uint64_t room = ch.payloadSize;
+        int32_t op = ch.op, idx = ch.idx;
+
+        switch(op)
+        {
+        case opiPlugProcess:
+        case opiPlugFlushEvents:
+            return process(op, (OpiBridgeProcess*) payload);
+
+        case opiPlugConfig: return configure((OpiBridgeConfig*) payload);
+
+        case opiPlugEnable:
+        case opiPlugReset:
+            arena.reset();
+            return dispatch(op, idx);
+
+        case opiPlugDestroy:
+            dispatch(op);
+            plug = 0;
+            return 1;
+
+        case opiPlugGetParam:
+        case opiPlugSetParam:
+        case opiPlugGetTailFrames:
+            return dispatch(op, idx, payload);
+
+        case opiPlugGetParamName:
+        case opiPlugGetPatchName:
+            {
+                OpiString str = { 0, 0 };
+                if(!dispatch(op, idx, &str)) return 0;
+                return opiBridgePutBytes(payload, room, str.data, str.size);
+            }
+        case opiPlugSetPatchName:
+            {
+                OpiString str = { payload + sizeof(uint32_t), 0 };
+                if(!opiBridgeBytesSize(payload, room, str.size)) return 0;
+                return dispatch(op, idx, &str);
+            }
+        case opiPlugValueToString:
+            {
+                // value, then the string
+                OpiParamString str = { 0, 0, 0 };
+                memcpy(&str.value, payload, sizeof(float));
+                if(!dispatch(op, idx, &str)) return 0;
+                return opiBridgePutBytes(payload + 8, room - 8, str.data, str.size);
+            }
+        case opiPlugStringToValue:
+            {
+                OpiParamString str = { payload + 8 + sizeof(uint32_t), 0, 0 };
+                if(!opiBridgeBytesSize(payload + 8, room - 8, str.size)) return 0;
+                int64_t r = dispatch(op, idx, &str);
+                memcpy(payload, &str.value, sizeof(float));
+                return r;
+            }
+        case opiPlugSaveChunk:
+            {
+                OpiChunk chunk = { 0, 0 };
+                if(!dispatch(op, idx, &chunk)) return 0;
+                return opiBridgePutBytes(payload, room, chunk.data, chunk.size);
+            }
+        case opiPlugLoadChunk:
+            {
+                OpiChunk chunk = { payload + sizeof(uint32_t), 0 };
+                if(!opiBridgeBytesSize(payload, room, chunk.size)) return 0;
+                return dispatch(op, idx, &chunk);
+            }
+        case opiPlugGetParams:
+        case opiPlugSetParams:
+            {
+                // first, count, then the values
+                OpiParamRange range;
+                memcpy(&range.first, payload, sizeof(uint32_t));
+                memcpy(&range.count, payload + 4, sizeof(uint32_t));
+                if(range.count > (room - 8) / sizeof(float)) return 0;
+                range.values = (float*) (payload + 8);
+                return dispatch(op, idx, &range);
+            }
+        case opiPlugGetParamChanges:
+            {
+                // generation, first, count, then the bits
+                OpiParamChanges changes;
+                memcpy(&changes.generation, payload, sizeof(uint32_t));
+                memcpy(&changes.first, payload + 4, sizeof(uint32_t));
+                memcpy(&changes.count, payload + 8, sizeof(uint32_t));
+                if((changes.count + 63) / 64 > (room - 16) / sizeof(uint64_t)) return 0;
+                changes.bits = (uint64_t*) (payload + 16);
+                int64_t r = dispatch(op, idx, &changes);
+                memcpy(payload, &changes.generation, sizeof(uint32_t));
+                return r;
+            }
+
+        // the host only sends these without data
+        case opiPlugNumInputs:
+        case opiPlugNumOutputs:
+        case opiPlugMaxChannels:
+        case opiPlugInEventMask:
+        case opiPlugOutEventMask:
+        case opiPlugGetLatency:
+        case opiPlugDisable:
+        case opiPlugNumParam:
+        case opiPlugIdle:
+        case opiPlugAcceptsParamBuffer:
+            return dispatch(op, idx);
+
+        default: return 0;
+        }
+    }
+
+    int64_t configure(OpiBridgeConfig * bc)
+    {
+        uint32_t nIn = std::min(shared->nInputs, opiBridgeMaxBuses);
+        uint32_t nOut = std::min(shared->nOutputs, opiBridgeMaxBuses);
+
+        OpiBusConfig inBuses[opiBridgeMaxBuses] = {}, outBuses[opiBridgeMaxBuses] = {};
+        for(uint32_t b = 0; b < nIn; ++b) inBuses[b].nChannels = bc->inChannels[b];
+        for(uint32_t b = 0; b < nOut; ++b) outBuses[b].nChannels = bc->outChannels[b];
+
+        OpiConfig config = bc->config;
+        if(config.configSize > sizeof(OpiConfig)) config.configSize = sizeof(OpiConfig);
+        config.busConfigSize = sizeof(OpiBusConfig);
+        config.inBusChannels = inBuses;
+        config.outBusChannels = outBuses;
+        if(config.configSize > offsetof(OpiConfig, arenaSize)) config.arenaSize = 0;
+
+        if(!dispatch(opiPlugConfig, 0, &config)) return 0;
+
+        bc->config.blocksize = config.blocksize;
+        bc->config.arenaSize = config.arenaSize;
+        if(!arena.allocate(config.configSize > offsetof(OpiConfig, arenaSize)
+            ? config.arenaSize : 0)) arena.release();
+
+        packedEvents = config.configSize > offsetof(OpiConfig, flags)
+            && (config.flags & opiConfigPackedEvents);
+
+        uint32_t maxChannels = shared->maxChannels;
+        inStorage.assign(sizeof(OpiBusChannels) + maxChannels * sizeof(float*), 0);
+        outStorage.assign(sizeof(OpiBusChannels) + maxChannels * sizeof(float*), 0);
+        inList.assign(opiBridgeEventRoom / (sizeof(uint32_t) + sizeof(OpiEvent)), 0);
+        return 1;
+    }
+
+    int64_t process(int32_t op, OpiBridgeProcess * p)
+    {
+        uint32_t maxChannels = shared->maxChannels;
+        const uint64_t * channels = (const uint64_t*) (p + 1);
+
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = p->processInfoSize;
+        info.nFrames = p->nFrames;
+        if(p->hasTime)
+        {
+            time = p->time;
+            info.timeInfo = &time;
+        }
+
+        if(op == opiPlugProcess)
+        {
+            inBus()->silenceMask = p->inSilence;
+            outBus()->silenceMask = p->outSilence;
+            for(uint32_t c = 0; c < maxChannels; ++c)
+            {
+                inBus()->channels[c] = (float*) (base + channels[c]);
+                outBus()->channels[c] = (float*) (base + channels[maxChannels + c]);
+            }
+            info.inputs = inBus();
+            info.outputs = outBus();
+        }
+
+        if(packedEvents)
+        {
+            info.inEventBuffer.data = base + p->inEvents;
+            info.inEventBuffer.size = p->inEventsSize;
+            info.inEventBuffer.count = p->nInEvents;
+            info.outEventBuffer.data = base + p->outEvents;
+            info.outEventBuffer.capacity = p->outCapacity;
+        }
+        else
+        {
+            // point the list at the records
+            uint32_t pos = 0, n = 0;
+            const char * records = base + p->inEvents;
+            while(pos < p->inEventsSize && n < inList.size())
+            {
+                uint32_t recordSize;
+                memcpy(&recordSize, records + pos, sizeof(uint32_t));
+                inList[n++] = (OpiEvent*) (records + pos + sizeof(uint32_t));
+                pos += recordSize;
+            }
+            info.inEvents = inList.data();
+            info.nInEvents = n;
+        }
+
+        for(uint32_t i = 0; i < p->nParamBuffers && i < opiBridgeMaxParamBuffers; ++i)
+        {
+            params[i].paramIndex = p->paramIndex[i];
+            params[i].values = (const float*) (base + p->paramValues[i]);
+        }
+        if(p->nParamBuffers)
+        {
+            info.paramBuffers = params;
+            info.nParamBuffers = p->nParamBuffers;
+        }
+
+        dispatch(op, 0, &info);
+
+        if(op == opiPlugProcess) p->outSilence = outBus()->silenceMask;
+        if(packedEvents)
+        {
+            p->outSize = info.outEventBuffer.size;
+            p->nOutEvents = info.outEventBuffer.count;
+        }
+        else
+        {
+            OpiEventBuffer room = { base + p->outEvents, 0, p->outCapacity, 0 };
+            for(uint32_t e = 0; info.outEvents && e < info.nOutEvents; ++e)
+                opiEventAppend(&room, info.outEvents[e], opiEventSize(info.outEvents[e]));
+            p->outSize = room.size;
+            p->nOutEvents = room.count;
+        }
+        return 1;
+    }
+
+    // the plugin's dispatchToHost
+    static intptr_t stubDispatcher(OpiPlugin * plug, int32_t op, int32_t idx, void * data)
+    {
+        OpiBridgeStub * stub = (OpiBridgeStub*) plug->ptrHost;
+
+        // the ones answered here
+        switch(op)
+        {
+        case opiHostGetArena:
+            if(!stub->arena.capacity) return 0;
+            return (intptr_t) static_cast<OpiArena*>(&stub->arena);
+
+        case opiHostGetScratch:
+            {
+                OpiString * str = (OpiString*) data;
+                stub->scratch.resize(str->size ? str->size : 1);
+                str->data = stub->scratch.data();
+                return 1;
+            }
+        case opiHostNumWorkers: return 0;
+        case opiHostRunTasks: return 0;
+        case opiHostGetProfiler: return 0;
+        }
+
+        OpiBridgeChannel * ch = current();
+        if(!ch)
+        {
+            // from one of the plugin's own threads
+            if(op != opiHostSetLatency) return 0;
+            stub->shared->latencyChanged = 1;
+            return 1;
+        }
+
+        uint32_t size = 0;
+        switch(op)
+        {
+        case opiHostParamState: size = sizeof(uint32_t); break;
+        case opiHostParamValue: size = sizeof(float); break;
+        case opiHostPatchChange: break;
+        case opiHostResizeEdit: size = sizeof(OpiEditSize); break;
+        case opiHostSetLatency: break;
+        default: return 0;
+        }
+
+        ch->cbOp = op;
+        ch->cbIdx = idx;
+        ch->cbSize = size;
+        if(size) memcpy(ch->cbData, data, size);
+
+        pid_t host = stub->parent;
+        opiBridgePost(*stub->shared, *ch, opiBridgeCallback, ch->hostSleeping);
+        uint32_t state = opiBridgeWait(*stub->shared, *ch, 1u << opiBridgeCallbackDone,
+            stub->shared->callSpin, ch->stubSleeping,
+            [host]() { return getppid() != host; });
+        if(state != opiBridgeCallbackDone) return 0;
+
+        if(size) memcpy(data, ch->cbData, size);
+        return (intptr_t) ch->cbResult;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          HOST
+ *
+ * ===============================================================
+ */
+
+// The host side, which is also the proxy plugin: after start(), instantiate()
+// returns this as the OpiPlugin to drive. opiPlugDestroy on it stops the stub
+// (but the object itself stays the host's to delete).
+struct OpiBridgeHost : public OpiPlugin
+{
+    uint32_t    callSpin = 0;   // set before start(), see Details above
+    uint32_t    idleSpin = 0;
+    uint64_t    uiPayload = 1 << 20;    // bytes for chunks, strings and ranges
+
+    OpiBridgeShared *   shared = 0;
+    char *              base = 0;
+    uint64_t            size = 0;
+    pid_t               pid = 0;
+    std::atomic<bool>   dead { false };
+
+    std::mutex          uiLock;     // for the non-[RT] channel
+
+    // set up by opiPlugConfig
+    uint32_t            nInChannels = 0;
+    uint32_t            nOutChannels = 0;
+    bool                packedEvents = false;
+    std::vector<char>   inStorage, outStorage;  // inputBus() and outputBus()
+    std::vector<OpiEvent*>  outList;            // outEvents handed to the host
+
+    std::vector<char>   uiResult;   // strings and chunks handed to the host
+
+    OpiBridgeHost()
+    {
+        callSpin = std::thread::hardware_concurrency() > 1 ? 100000 : 0;
+        dispatchToHost = 0;
+        dispatchToPlugin = &proxyDispatcher;
+        ptrHost = 0;
+    }
+    OpiBridgeHost(const OpiBridgeHost &) = delete;
+    OpiBridgeHost & operator=(const OpiBridgeHost &) = delete;
+
+    ~OpiBridgeHost() { stop(); }
+
+    // Loads the plugin in a new process: the stub executable if given,
+    // otherwise a fork of this one. Waits until the instance is created.
+    bool start(const char * pluginPath, const char * stubPath = 0,
+        uint32_t maxChannels = 16, uint32_t maxFrames = 4096)
+    {
+        return launch(pluginPath, 0, stubPath, maxChannels, maxFrames);
+    }
+
+    // same with an entrypoint linked into the host (fork only)
+    bool start(OpiEntrypoint entrypoint, uint32_t maxChannels = 16, uint32_t maxFrames = 4096)
+    {
+        return launch(0, entrypoint, 0, maxChannels, maxFrames);
+    }
+
+    OpiPlugin * instantiate(OpiCallback hostCallback, void * hostPtr)
+    {
+        if(!shared || dead) return 0;
+        dispatchToHost = hostCallback;
+        ptrHost = hostPtr;
+        return this;
+    }
+
+    bool alive() const { return shared && !dead; }
+
+    // the shared buffers, as of the last opiPlugConfig
+    OpiBusChannels * inputBus() { return (OpiBusChannels*) inStorage.data(); }
+    OpiBusChannels * outputBus() { return (OpiBusChannels*) outStorage.data(); }
+
+    // futex system calls so far, from both sides
+    uint32_t numSyscalls() const
+    {
+        return shared ? shared->nWaits.load() + shared->nWakes.load() : 0;
+    }
+
+    void stop()
+    {
+        if(pid > 0)
+        {
+            if(!dead)
+            {
+                opiBridgePost(*shared, shared->rt, opiBridgeQuit, shared->rt.stubSleeping);
+                opiBridgePost(*shared, shared->ui, opiBridgeQuit, shared->ui.stubSleeping);
+            }
+            // give it a second, then make sure
+            bool exited = false;
+            for(int i = 0; i < 1000 && !exited; ++i)
+            {
+                exited = waitpid(pid, 0, WNOHANG) == pid;
+                if(!exited) usleep(1000);
+            }
+            if(!exited)
+            {
+                kill(pid, SIGKILL);
+                waitpid(pid, 0, 0);
+            }
+        }
+        if(base) munmap(base, size);
+
+        pid = 0;
+        base = 0;
+        shared = 0;
+        size = 0;
+        dead = false;
+    }
+
+    bool launch(const char * pluginPath, OpiEntrypoint entrypoint, const char * stubPath,
+        uint32_t maxChannels, uint32_t maxFrames)
+    {
+        stop();
+
+        uint64_t header = (sizeof(OpiBridgeShared) + 4095) & ~(uint64_t) 4095;
+        uint64_t audio = 2 * (uint64_t) maxChannels * maxFrames * sizeof(float);
+        uint64_t rtPayload = sizeof(OpiBridgeProcess)
+            + 2 * (uint64_t) maxChannels * sizeof(uint64_t) + 2 * opiBridgeEventRoom
+            + (uint64_t) opiBridgeMaxParamBuffers * maxFrames * sizeof(float);
+        rtPayload = std::max<uint64_t>(rtPayload, sizeof(OpiBridgeConfig));
+        rtPayload = (rtPayload + 4095) & ~(uint64_t) 4095;
+        uint64_t total = header + audio + rtPayload + ((uiPayload + 4095) & ~(uint64_t) 4095);
+
+        int fd = memfd_create("opi-bridge", 0);
+        if(fd < 0) return false;
+        void * ptr = MAP_FAILED;
+        if(ftruncate(fd, total) == 0)
+            ptr = mmap(0, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(ptr == MAP_FAILED) { close(fd); return false; }
+
+        base = (char*) ptr;
+        size = total;
+        shared = (OpiBridgeShared*) ptr;     // zeroed by ftruncate
+
+        shared->magic = opiBridgeMagic;
+        shared->version = opiBridgeVersion;
+        shared->size = total;
+        shared->maxChannels = maxChannels;
+        shared->maxFrames = maxFrames;
+        shared->audio = header;
+        shared->callSpin = callSpin;
+        shared->idleSpin = idleSpin;
+        shared->rt.payload = header + audio;
+        shared->rt.payloadSize = rtPayload;
+        shared->ui.payload = header + audio + rtPayload;
+        shared->ui.payloadSize = total - shared->ui.payload;
+
+        fflush(0);  // or the child flushes our buffered output too
+        pid = fork();
+        if(pid == 0)
+        {
+            if(stubPath)
+            {
+                char fdArg[16];
+                snprintf(fdArg, sizeof(fdArg), "%d", fd);
+                execl(stubPath, stubPath, fdArg, pluginPath, (char*) 0);
+                _exit(127);
+            }
+            _exit(OpiBridgeStub::run(fd, pluginPath, entrypoint));
+        }
+        close(fd);
+        if(pid < 0) { pid = 0; stop(); return false; }
+
+        // not [RT], so polling is fine
+        while(!shared->ready)
+        {
+            if(waitpid(pid, 0, WNOHANG) == pid) { pid = 0; stop(); return false; }
+            usleep(200);
+        }
+        if(shared->ready != 1) { stop(); return false; }
+        return true;
+    }
+
+    bool stubGone()
+    {
+        if(waitpid(pid, 0, WNOHANG) != pid) return false;
+        pid = 0;    // reaped
+        dead = true;
+        return true;
+    }
+
+    // offset of [ptr, ptr + bytes) if it's in the region, else opiBridgeNone
+    uint64_t offsetOf(const void * ptr, uint64_t bytes) const
+    {
+        uintptr_t p = (uintptr_t) ptr, b = (uintptr_t) base;
+        if(p < b || p - b > size || bytes > size - (p - b)) return opiBridgeNone;
+        return p - b;
+    }
+
+    float * slot(bool output, uint32_t c)
+    {
+        return (float*) (base + shared->audio) + ((output ? shared->maxChannels : 0) + c)
+            * (size_t) shared->maxFrames;
+    }
+
+    // hands op to the stub and waits for it, answering callbacks meanwhile
+    int64_t call(OpiBridgeChannel & ch, int32_t op, int32_t idx)
+    {
+        if(dead || !shared) return 0;
+
+        ch.op = op;
+        ch.idx = idx;
+        opiBridgePost(*shared, ch, opiBridgeCall, ch.stubSleeping);
+
+        for(;;)
+        {
+            uint32_t state = opiBridgeWait(*shared, ch,
+                (1u << opiBridgeCallback) | (1u << opiBridgeDone),
+                shared->callSpin, ch.hostSleeping, [this]() { return stubGone(); });
+            if(state == opiBridgeDone) break;
+            if(state != opiBridgeCallback) return 0;
+
+            answerCallback(ch);
+            opiBridgePost(*shared, ch, opiBridgeCallbackDone, ch.stubSleeping);
+        }
+
+        int64_t result = ch.result;
+        ch.state.store(opiBridgeIdle, std::memory_order_relaxed);
+
+        if(shared->latencyChanged.load(std::memory_order_relaxed)
+            && shared->latencyChanged.exchange(0) && dispatchToHost)
+            dispatchToHost(this, opiHostSetLatency, 0, 0);
+        return result;
+    }
+
+    // only the callbacks the stub forwards, never trusting what it says
+    void answerCallback(OpiBridgeChannel & ch)
+    {
+        uint8_t data[sizeof(ch.cbData)];
+        memcpy(data, ch.cbData, sizeof(data));
+
+        intptr_t result = 0;
+        switch(ch.cbOp)
+        {
+        case opiHostParamState:
+        case opiHostParamValue:
+        case opiHostResizeEdit:
+            if(dispatchToHost) result = dispatchToHost(this, ch.cbOp, ch.cbIdx, data);
+            break;
+        case opiHostPatchChange:
+        case opiHostSetLatency:
+            if(dispatchToHost) result = dispatchToHost(this, ch.cbOp, ch.cbIdx, 0);
+            break;
+        }
+        memcpy(ch.cbData, data, sizeof(data));
+        ch.cbResult = result;
+    }
+
+    intptr_t configure(OpiConfig * config)
+    {
+        OpiBridgeConfig * bc = (OpiBridgeConfig*) (base + shared->rt.payload);
+        memset(bc, 0, sizeof(OpiBridgeConfig));
+
+        uint32_t configSize = std::min<uint32_t>(config->configSize, sizeof(OpiConfig));
+        memcpy(&bc->config, config, configSize);
+        bc->config.configSize = configSize;
+        bool hasFlags = configSize > offsetof(OpiConfig, flags);
+
+        // the shared buses are planar and only have silenceMask
+        if(hasFlags && (config->flags & (opiConfigWideSilence | opiConfigInterleaved))) return 0;
+
+        // only bus 0 may have channels, and no more than there are slots for
+        uint32_t nIn = shared->nInputs, nOut = shared->nOutputs;
+        if(nIn > opiBridgeMaxBuses || nOut > opiBridgeMaxBuses) return 0;
+        for(uint32_t b = 0; b < nIn + nOut; ++b)
+        {
+            const char * buses = (const char*) (b < nIn ? config->inBusChannels : config->outBusChannels);
+            uint32_t n = ((const OpiBusConfig*) (buses + (b < nIn ? b : b - nIn)
+                * (size_t) config->busConfigSize))->nChannels;
+            if(n && (b != 0 && b != nIn)) return 0;
+            if(n > shared->maxChannels) return 0;
+            if(b < nIn) bc->inChannels[b] = n;
+            else bc->outChannels[b - nIn] = n;
+        }
+
+        if(bc->config.blocksize > shared->maxFrames)
+        {
+            if(!hasFlags) return 0;
+            bc->config.blocksize = shared->maxFrames;
+        }
+
+        if(!call(shared->rt, opiPlugConfig, 0)) return 0;
+
+        // it may only lower it
+        uint32_t blocksize = std::min(bc->config.blocksize,
+            std::min(config->blocksize, shared->maxFrames));
+        if(!blocksize) return 0;
+        config->blocksize = blocksize;
+        // the stub has the arena, not us
+        if(configSize > offsetof(OpiConfig, arenaSize)) config->arenaSize = 0;
+
+        nInChannels = nIn ? bc->inChannels[0] : 0;
+        nOutChannels = nOut ? bc->outChannels[0] : 0;
+        packedEvents = hasFlags && (config->flags & opiConfigPackedEvents);
+
+        uint32_t maxChannels = shared->maxChannels;
+        inStorage.assign(sizeof(OpiBusChannels) + maxChannels * sizeof(float*), 0);
+        outStorage.assign(sizeof(OpiBusChannels) + maxChannels * sizeof(float*), 0);
+        for(uint32_t c = 0; c < maxChannels; ++c)
+        {
+            inputBus()->channels[c] = slot(false, c);
+            outputBus()->channels[c] = slot(true, c);
+        }
+        outList.assign(opiBridgeEventRoom / (sizeof(uint32_t) + sizeof(OpiEvent)), 0);
+        return 1;
+    }
+
+    intptr_t process(int32_t op, OpiProcessInfo * info)
+    {
+        bool audio = op == opiPlugProcess;
+        uint32_t nFrames = audio ? std::min(info->nFrames, shared->maxFrames) : 0;
+        uint64_t frameBytes = nFrames * sizeof(float);
+
+        if(dead)
+        {
+            for(uint32_t c = 0; audio && c < nOutChannels; ++c)
+                memset(info->outputs[0].channels[c], 0, frameBytes);
+            if(audio && nOutChannels)
+                info->outputs[0].silenceMask = nOutChannels < 64
+                    ? (uint64_t(1) << nOutChannels) - 1 : ~uint64_t(0);
+            return 0;
+        }
+
+        uint32_t maxChannels = shared->maxChannels;
+        OpiBridgeChannel & ch = shared->rt;
+        OpiBridgeProcess * p = (OpiBridgeProcess*) (base + ch.payload);
+        uint64_t * channels = (uint64_t*) (p + 1);
+        uint64_t room = ch.payload + sizeof(OpiBridgeProcess) + 2 * maxChannels * sizeof(uint64_t);
+        uint64_t roomEnd = ch.payload + ch.payloadSize;
+
+        p->processInfoSize = std::min<uint32_t>(info->processInfoSize, sizeof(OpiProcessInfo));
+        p->nFrames = nFrames;
+        p->hasTime = info->timeInfo != 0;
+        if(p->hasTime)
+        {
+            memset(&p->time, 0, sizeof(OpiTimeInfo));
+            memcpy(&p->time, info->timeInfo,
+                std::min<uint32_t>(info->timeInfo->infoSize, sizeof(OpiTimeInfo)));
+        }
+
+        // audio in place if it's ours already, else through the slots
+        if(audio)
+        {
+            p->inSilence = nInChannels ? info->inputs[0].silenceMask : 0;
+            p->outSilence = nOutChannels ? info->outputs[0].silenceMask : 0;
+            for(uint32_t c = 0; c < maxChannels; ++c)
+            {
+                channels[c] = (char*) slot(false, c) - base;
+                channels[maxChannels + c] = (char*) slot(true, c) - base;
+            }
+            for(uint32_t c = 0; c < nInChannels; ++c)
+            {
+                const float * src = info->inputs[0].channels[c];
+                uint64_t at = offsetOf(src, frameBytes);
+                if(at == opiBridgeNone) memcpy(slot(false, c), src, frameBytes);
+                else channels[c] = at;
+            }
+            for(uint32_t c = 0; c < nOutChannels; ++c)
+            {
+                uint64_t at = offsetOf(info->outputs[0].channels[c], frameBytes);
+                if(at != opiBridgeNone) channels[maxChannels + c] = at;
+            }
+        }
+
+        // input events, packed for the trip unless they already are (and here)
+        bool hasBuffers = opiHasEventBuffers(info);
+        const OpiEventBuffer * inBuffer = hasBuffers && info->inEventBuffer.data
+            ? &info->inEventBuffer : 0;
+        p->inEvents = inBuffer ? offsetOf(inBuffer->data, inBuffer->size) : opiBridgeNone;
+        if(p->inEvents != opiBridgeNone)
+        {
+            p->inEventsSize = inBuffer->size;
+            p->nInEvents = inBuffer->count;
+        }
+        else
+        {
+            OpiEventBuffer packed = { base + room, 0, opiBridgeEventRoom, 0 };
+            if(inBuffer)
+            {
+                packed.size = std::min(inBuffer->size, opiBridgeEventRoom);
+                memcpy(packed.data, inBuffer->data, packed.size);
+                packed.count = inBuffer->count;
+            }
+            else
+            {
+                for(uint32_t e = 0; e < info->nInEvents; ++e)
+                    opiEventAppend(&packed, info->inEvents[e], opiEventSize(info->inEvents[e]));
+            }
+            p->inEvents = room;
+            p->inEventsSize = packed.size;
+            p->nInEvents = packed.count;
+        }
+        room += opiBridgeEventRoom;
+
+        // room for the output events
+        OpiEventBuffer * outBuffer = hasBuffers && info->outEventBuffer.data
+            ? &info->outEventBuffer : 0;
+        p->outEvents = room;
+        p->outCapacity = opiBridgeEventRoom;
+        if(outBuffer) p->outCapacity = std::min(outBuffer->capacity - outBuffer->size, p->outCapacity);
+        p->outSize = 0;
+        p->nOutEvents = 0;
+        room += opiBridgeEventRoom;
+
+        // parameter buffers, copied unless they're here
+        bool hasParams = info->processInfoSize >=
+            offsetof(OpiProcessInfo, nParamBuffers) + sizeof(uint32_t);
+        p->nParamBuffers = 0;
+        for(uint32_t i = 0; audio && hasParams && info->paramBuffers
+            && i < info->nParamBuffers && i < opiBridgeMaxParamBuffers; ++i)
+        {
+            const OpiParamBuffer & pb = info->paramBuffers[i];
+            uint64_t at = offsetOf(pb.values, frameBytes);
+            if(at == opiBridgeNone)
+            {
+                if(roomEnd - room < frameBytes) break;
+                memcpy(base + room, pb.values, frameBytes);
+                at = room;
+                room += frameBytes;
+            }
+            p->paramIndex[i] = pb.paramIndex;
+            p->paramValues[i] = at;
+            p->nParamBuffers = i + 1;
+        }
+
+        call(ch, op, 0);
+        if(dead) return process(op, info);
+
+        if(audio)
+        {
+            for(uint32_t c = 0; c < nOutChannels; ++c)
+            {
+                float * dst = info->outputs[0].channels[c];
+                if(offsetOf(dst, frameBytes) == opiBridgeNone)
+                    memcpy(dst, slot(true, c), frameBytes);
+            }
+            if(nOutChannels) info->outputs[0].silenceMask = p->outSilence;
+        }
+
+        // output events: check every record, the stub wrote them
+        uint32_t outSize = std::min(p->outSize, p->outCapacity);
+        const char * records = base + p->outEvents;
+        uint32_t nOut = 0;
+        for(uint32_t pos = 0; pos + sizeof(uint32_t) <= outSize;)
+        {
+            uint32_t recordSize;
+            memcpy(&recordSize, records + pos, sizeof(uint32_t));
+            if(recordSize < sizeof(uint32_t) + sizeof(OpiEvent)
+                || recordSize > outSize - pos || (recordSize & 3)) break;
+
+            const OpiEvent * ev = (const OpiEvent*) (records + pos + sizeof(uint32_t));
+            if(packedEvents && outBuffer)
+            {
+                uint32_t evSize = recordSize - sizeof(uint32_t);
+                if(!opiEventAppend(outBuffer, ev, evSize)) break;
+            }
+            else if(!packedEvents && nOut < outList.size())
+            {
+                // opiEventSize() of what the plugin sent, which has to fit
+                if(opiEventSize(ev) > recordSize - sizeof(uint32_t)) break;
+                outList[nOut++] = (OpiEvent*) ev;
+            }
+            pos += recordSize;
+        }
+        if(!packedEvents && audio)
+        {
+            info->outEvents = nOut ? outList.data() : 0;
+            info->nOutEvents = nOut;
+        }
+        return 1;
+    }
+
+    intptr_t uiCall(int32_t op, int32_t idx, void * data)
+    {
+        std::lock_guard<std::mutex> guard(uiLock);
+        if(dead || !shared) return 0;
+
+        OpiBridgeChannel & ch = shared->ui;
+        char * payload = base + ch.payload;
+        uint64_t room = ch.payloadSize;
+
+        switch(op)
+        {
+        case opiPlugGetParam:
+        case opiPlugGetTailFrames:
+            if(!call(ch, op, idx)) return 0;
+            memcpy(data, payload, 4);
+            return 1;
+
+        case opiPlugSetParam:
+            memcpy(payload, data, 4);
+            return call(ch, op, idx);
+
+        case opiPlugGetParamName:
+        case opiPlugGetPatchName:
+            {
+                OpiString * str = (OpiString*) data;
+                if(!call(ch, op, idx)) return 0;
+                return takeBytes(payload, room, str->data, str->size);
+            }
+        case opiPlugSetPatchName:
+            {
+                OpiString * str = (OpiString*) data;
+                if(!opiBridgePutBytes(payload, room, str->data, str->size)) return 0;
+                return call(ch, op, idx);
+            }
+        case opiPlugValueToString:
+            {
+                OpiParamString * str = (OpiParamString*) data;
+                memcpy(payload, &str->value, sizeof(float));
+                if(!call(ch, op, idx)) return 0;
+                return takeBytes(payload + 8, room - 8, str->data, str->size);
+            }
+        case opiPlugStringToValue:
+            {
+                OpiParamString * str = (OpiParamString*) data;
+                if(!opiBridgePutBytes(payload + 8, room - 8, str->data, str->size)) return 0;
+                intptr_t r = call(ch, op, idx);
+                memcpy(&str->value, payload, sizeof(float));
+                return r;
+            }
+        case opiPlugSaveChunk:
+            {
+                OpiChunk * chunk = (OpiChunk*) data;
+                char * bytes = 0;
+                if(!call(ch, op, idx) || !takeBytes(payload, room, bytes, chunk->size)) return 0;
+                chunk->data = bytes;
+                return 1;
+            }
+        case opiPlugLoadChunk:
+            {
+                OpiChunk * chunk = (OpiChunk*) data;
+                if(!opiBridgePutBytes(payload, room, chunk->data, chunk->size)) return 0;
+                return call(ch, op, idx);
+            }
+        case opiPlugGetParams:
+        case opiPlugSetParams:
+            {
+                OpiParamRange * range = (OpiParamRange*) data;
+                if(range->count > (room - 8) / sizeof(float)) return 0;
+                memcpy(payload, &range->first, sizeof(uint32_t));
+                memcpy(payload + 4, &range->count, sizeof(uint32_t));
+                if(op == opiPlugSetParams)
+                    memcpy(payload + 8, range->values, range->count * sizeof(float));
+                if(!call(ch, op, idx)) return 0;
+                if(op == opiPlugGetParams)
+                    memcpy(range->values, payload + 8, range->count * sizeof(float));
+                return 1;
+            }
+        case opiPlugGetParamChanges:
+            {
+                OpiParamChanges * changes = (OpiParamChanges*) data;
+                uint32_t nWords = (changes->count + 63) / 64;
+                if(nWords > (room - 16) / sizeof(uint64_t)) return 0;
+                memcpy(payload, &changes->generation, sizeof(uint32_t));
+                memcpy(payload + 4, &changes->first, sizeof(uint32_t));
+                memcpy(payload + 8, &changes->count, sizeof(uint32_t));
+                if(!call(ch, op, idx)) return 0;
+                memcpy(&changes->generation, payload, sizeof(uint32_t));
+                memcpy(changes->bits, payload + 16, nWords * sizeof(uint64_t));
+                return 1;
+            }
+
+        default: return call(ch, op, idx);
+        }
+    }
+
+    // copy a blob from the payload into uiResult (NUL terminated, for strings)
+    bool takeBytes(const char * at, uint64_t room, char *& data, uint32_t & n)
+    {
+        if(!opiBridgeBytesSize(at, room, n)) return false;
+        uiResult.resize(n + 1);
+        memcpy(uiResult.data(), at + sizeof(uint32_t), n);
+        uiResult[n] = 0;
+        data = uiResult.data();
+        return true;
+    }
+
+    static intptr_t proxyDispatcher(OpiPlugin * ptr, int32_t op, int32_t idx, void * data)
+    {
+        OpiBridgeHost * bridge = (OpiBridgeHost*) ptr;
+
+        switch(op)
+        {
+        case opiPlugProcess:
+        case opiPlugFlushEvents:
+            return bridge->process(op, (OpiProcessInfo*) data);
+
+        case opiPlugConfig: return bridge->configure((OpiConfig*) data);
+
+        case opiPlugReset:
+        case opiPlugEnable:
+        case opiPlugDisable:
+            return bridge->call(bridge->shared->rt, op, idx);
+
+        case opiPlugDestroy:
+            bridge->uiCall(op, 0, 0);
+            bridge->stop();
+            return 1;
+
+        case opiPlugNumInputs:
+        case opiPlugNumOutputs:
+        case opiPlugMaxChannels:
+        case opiPlugInEventMask:
+        case opiPlugOutEventMask:
+        case opiPlugGetLatency:
+        case opiPlugNumParam:
+        case opiPlugIdle:
+        case opiPlugAcceptsParamBuffer:
+            return bridge->uiCall(op, idx, 0);
+
+        case opiPlugGetParam:
+        case opiPlugSetParam:
+        case opiPlugGetTailFrames:
+        case opiPlugGetParamName:
+        case opiPlugGetPatchName:
+        case opiPlugSetPatchName:
+        case opiPlugValueToString:
+        case opiPlugStringToValue:
+        case opiPlugSaveChunk:
+        case opiPlugLoadChunk:
+        case opiPlugGetParams:
+        case opiPlugSetParams:
+        case opiPlugGetParamChanges:
+            return bridge->uiCall(op, idx, data);
+
+        // editors, sections, the function table, batching and bulk strings
+        // stay behind (the host falls back to one string at a time)
+        default: return 0;
+        }
+    }
+};
+
+#endif // OPI_BRIDGE_SUPPORTED
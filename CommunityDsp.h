@@ -0,0 +1,1038 @@
+/*
+/// # Community Plugin Format DSP Kernels
+///
+/// ## About
+/// Small header-only set of the buffer loops that almost every plugin (and
+/// host) ends up writing:
+/// - Clear, copy, scale and mix-accumulate, peak detection
+/// - Scale with a linear gain ramp, and rendering linear ramps (eg. for
+///   OpiParamBuffer)
+/// - Scaling buffers that hold several instances side by side (see
+///   opiPlugProcessBatch)
+/// - Scaling channels interleaved in groups (see OpiBusConfig::interleave)
+/// - Dot products (eg. for the filters in CommunityResample.h)
+/// - Silence bits of buses with more than 64 channels
+///
+/// ## Details
+/// - Scalar, SSE2, AVX2 and AVX-512 variants
+/// - Variant is picked at runtime from what the CPU supports
+/// - Portable scalar fallback for everything else
+///
+/// ## Usage
+/// Call the opiDsp* functions directly, or fetch the kernel table once with
+/// opiDsp() and call through that. Buffers need not be aligned. Unless noted
+/// otherwise dst may be equal to src, but the two must not partially overlap.
+///
+/// ### Flags
+/// - OPI_DSP_NO_SIMD: only build the portable scalar kernels
+*/
+
+#pragma once
+
+#include "Community.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(OPI_DSP_NO_SIMD) \
+    && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+# define OPI_DSP_X86 1
+# include <immintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+#  define OPI_DSP_TARGET(isa)
+# else
+#  define OPI_DSP_TARGET(isa) __attribute__((target(isa)))
+# endif
+#endif
+
+/*
+ * ==============================================================
+ *
+ *                          KERNEL TABLE
+ *
+ * ===============================================================
+ */
+
+enum OpiDspIsa
+{
+    opiDspIsaScalar,
+    opiDspIsaSse2,
+    opiDspIsaAvx2,
+    opiDspIsaAvx512,
+
+    opiDspIsaCount
+};
+
+struct OpiDspKernels
+{
+    const char *    name;
+
+    // dst[i] = 0
+    void    (*clear)(float * dst, uint32_t n);
+    // dst[i] = src[i]
+    void    (*copy)(float * dst, const float * src, uint32_t n);
+    // dst[i] = gain * src[i]
+    void    (*scale)(float * dst, const float * src, float gain, uint32_t n);
+    // dst[i] = (g0 + (g1 - g0) * i / n) * src[i], ie. g1 is reached at dst[n]
+    void    (*scaleRamp)(float * dst, const float * src, float g0, float g1, uint32_t n);
+    // dst[i] += gain * src[i]
+    void    (*mix)(float * dst, const float * src, float gain, uint32_t n);
+    // max(|src[i]|)
+    float   (*peak)(const float * src, uint32_t n);
+    // dst[i] = gains[i % lanes] * src[i], n a multiple of lanes; fastest when
+    // lanes is a multiple of the vector width (16 suits every variant)
+    void    (*scaleLanes)(float * dst, const float * src, const float * gains,
+                uint32_t lanes, uint32_t n);
+    // dst[i] = g0 + (g1 - g0) * i / n, exactly the gains scaleRamp applies
+    void    (*ramp)(float * dst, float g0, float g1, uint32_t n);
+    // dst[i] = gains[i / lanes] * src[i], n a multiple of lanes, ie. one gain
+    // per frame of interleaved channels; fastest when lanes is a multiple of
+    // the vector width
+    void    (*scaleFrames)(float * dst, const float * src, const float * gains,
+                uint32_t lanes, uint32_t n);
+    // sum(a[i] * b[i]); the order of summation differs between the variants
+    float   (*dot)(const float * a, const float * b, uint32_t n);
+};
+
+/*
+ * ==============================================================
+ *
+ *                          SCALAR
+ *
+ * ===============================================================
+ */
+
+// clear and copy are shared by all the variants, libc already picks the best
+static inline void opiDspClearScalar(float * dst, uint32_t n)
+{
+    memset(dst, 0, n * sizeof(float));
+}
+
+static inline void opiDspCopyScalar(float * dst, const float * src, uint32_t n)
+{
+    if(dst != src) memmove(dst, src, n * sizeof(float));
+}
+
+static inline void opiDspScaleScalar(float * dst, const float * src, float gain, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i) dst[i] = gain * src[i];
+}
+
+static inline void opiDspScaleRampScalar(
+    float * dst, const float * src, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    for(uint32_t i = 0; i < n; ++i) dst[i] = (g0 + step * (float) i) * src[i];
+}
+
+static inline void opiDspMixScalar(float * dst, const float * src, float gain, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i) dst[i] += gain * src[i];
+}
+
+static inline float opiDspPeakScalar(const float * src, uint32_t n)
+{
+    float peak = 0;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        float a = src[i] < 0 ? -src[i] : src[i];
+        if(a > peak) peak = a;
+    }
+    return peak;
+}
+
+static inline void opiDspScaleLanesScalar(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; i += lanes)
+    for(uint32_t k = 0; k < lanes; ++k) dst[i + k] = gains[k] * src[i + k];
+}
+
+static inline void opiDspRampScalar(float * dst, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    for(uint32_t i = 0; i < n; ++i) dst[i] = g0 + step * (float) i;
+}
+
+static inline void opiDspScaleFramesScalar(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    for(uint32_t i = 0, f = 0; i < n; i += lanes, ++f)
+    for(uint32_t k = 0; k < lanes; ++k) dst[i + k] = gains[f] * src[i + k];
+}
+
+static inline float opiDspDotScalar(const float * a, const float * b, uint32_t n)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for(; i < n; ++i) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static const OpiDspKernels opiDspKernelsScalar =
+{
+    "scalar",
+    opiDspClearScalar, opiDspCopyScalar, opiDspScaleScalar,
+    opiDspScaleRampScalar, opiDspMixScalar, opiDspPeakScalar,
+    opiDspScaleLanesScalar, opiDspRampScalar, opiDspScaleFramesScalar,
+    opiDspDotScalar
+};
+
+#ifdef OPI_DSP_X86
+
+/*
+ * ==============================================================
+ *
+ *                          SSE2
+ *
+ * ===============================================================
+ */
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspScaleSse2(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+    for(; i < n; ++i) dst[i] = gain * src[i];
+}
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspScaleRampSse2(
+    float * dst, const float * src, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m128 vg0 = _mm_set1_ps(g0);
+    __m128 vstep = _mm_set1_ps(step);
+    __m128 idx = _mm_setr_ps(0, 1, 2, 3);
+    __m128 four = _mm_set1_ps(4);
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128 g = _mm_add_ps(vg0, _mm_mul_ps(vstep, idx));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+        idx = _mm_add_ps(idx, four);
+    }
+    for(; i < n; ++i) dst[i] = (g0 + step * (float) i) * src[i];
+}
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspMixSse2(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+            _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+    for(; i < n; ++i) dst[i] += gain * src[i];
+}
+
+OPI_DSP_TARGET("sse2")
+static inline float opiDspPeakSse2(const float * src, uint32_t n)
+{
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        peak = _mm_max_ps(peak, _mm_and_ps(absMask, _mm_loadu_ps(src + i)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+    float result = _mm_cvtss_f32(peak);
+    float tail = opiDspPeakScalar(src + i, n - i);
+    return tail > result ? tail : result;
+}
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspScaleLanesSse2(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // rows that divide the vector: the gains repeat every vector
+    if(4 % lanes == 0)
+    {
+        float pattern[4];
+        for(uint32_t k = 0; k < 4; ++k) pattern[k] = gains[k % lanes];
+        __m128 g = _mm_loadu_ps(pattern);
+        uint32_t i = 0;
+        for(; i + 4 <= n; i += 4) _mm_storeu_ps(dst + i, _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+        for(; i < n; ++i) dst[i] = gains[i % lanes] * src[i];
+        return;
+    }
+
+    for(uint32_t i = 0; i < n; i += lanes)
+    {
+        uint32_t k = 0;
+        for(; k + 4 <= lanes; k += 4)
+            _mm_storeu_ps(dst + i + k, _mm_mul_ps(_mm_loadu_ps(gains + k),
+                _mm_loadu_ps(src + i + k)));
+        for(; k < lanes; ++k) dst[i + k] = gains[k] * src[i + k];
+    }
+}
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspRampSse2(float * dst, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m128 vg0 = _mm_set1_ps(g0);
+    __m128 vstep = _mm_set1_ps(step);
+    __m128 idx = _mm_setr_ps(0, 1, 2, 3);
+    __m128 four = _mm_set1_ps(4);
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(dst + i, _mm_add_ps(vg0, _mm_mul_ps(vstep, idx)));
+        idx = _mm_add_ps(idx, four);
+    }
+    for(; i < n; ++i) dst[i] = g0 + step * (float) i;
+}
+
+OPI_DSP_TARGET("sse2")
+static inline void opiDspScaleFramesSse2(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // groups that divide the vector: 4 / lanes frames per vector
+    if(lanes <= 2)
+    {
+        uint32_t i = 0, f = 0;
+        for(; i + 4 <= n; i += 4, f += 4 / lanes)
+        {
+            __m128 g;
+            if(lanes == 1) g = _mm_loadu_ps(gains + f);
+            else
+            {
+                g = _mm_castpd_ps(_mm_load_sd((const double*) (gains + f)));
+                g = _mm_unpacklo_ps(g, g);
+            }
+            _mm_storeu_ps(dst + i, _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+        }
+        for(; i < n; ++i) dst[i] = gains[i / lanes] * src[i];
+        return;
+    }
+
+    for(uint32_t i = 0, f = 0; i < n; i += lanes, ++f)
+    {
+        __m128 g = _mm_set1_ps(gains[f]);
+        uint32_t k = 0;
+        for(; k + 4 <= lanes; k += 4)
+            _mm_storeu_ps(dst + i + k, _mm_mul_ps(g, _mm_loadu_ps(src + i + k)));
+        for(; k < lanes; ++k) dst[i + k] = gains[f] * src[i + k];
+    }
+}
+
+OPI_DSP_TARGET("sse2")
+static inline float opiDspDotSse2(const float * a, const float * b, uint32_t n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 s = _mm_add_ps(s0, s1);
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(s) + opiDspDotScalar(a + i, b + i, n - i);
+}
+
+static const OpiDspKernels opiDspKernelsSse2 =
+{
+    "sse2",
+    opiDspClearScalar, opiDspCopyScalar, opiDspScaleSse2,
+    opiDspScaleRampSse2, opiDspMixSse2, opiDspPeakSse2,
+    opiDspScaleLanesSse2, opiDspRampSse2, opiDspScaleFramesSse2,
+    opiDspDotSse2
+};
+
+/*
+ * ==============================================================
+ *
+ *                          AVX2
+ *
+ * ===============================================================
+ */
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspScaleAvx2(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m256 a = _mm256_loadu_ps(src + i);
+        __m256 b = _mm256_loadu_ps(src + i + 8);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(g, a));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(g, b));
+    }
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(g, _mm256_loadu_ps(src + i)));
+    for(; i < n; ++i) dst[i] = gain * src[i];
+}
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspScaleRampAvx2(
+    float * dst, const float * src, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m256 vg0 = _mm256_set1_ps(g0);
+    __m256 vstep = _mm256_set1_ps(step);
+    __m256 idx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 eight = _mm256_set1_ps(8);
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256 g = _mm256_add_ps(vg0, _mm256_mul_ps(vstep, idx));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(g, _mm256_loadu_ps(src + i)));
+        idx = _mm256_add_ps(idx, eight);
+    }
+    for(; i < n; ++i) dst[i] = (g0 + step * (float) i) * src[i];
+}
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspMixAvx2(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i),
+            _mm256_mul_ps(g, _mm256_loadu_ps(src + i))));
+    for(; i < n; ++i) dst[i] += gain * src[i];
+}
+
+OPI_DSP_TARGET("avx2")
+static inline float opiDspPeakAvx2(const float * src, uint32_t n)
+{
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        peak = _mm256_max_ps(peak, _mm256_and_ps(absMask, _mm256_loadu_ps(src + i)));
+    __m128 p = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    p = _mm_max_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 0, 3, 2)));
+    p = _mm_max_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1)));
+    float result = _mm_cvtss_f32(p);
+    float tail = opiDspPeakScalar(src + i, n - i);
+    return tail > result ? tail : result;
+}
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspScaleLanesAvx2(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // rows that divide the vector: the gains repeat every vector
+    if(8 % lanes == 0)
+    {
+        float pattern[8];
+        for(uint32_t k = 0; k < 8; ++k) pattern[k] = gains[k % lanes];
+        __m256 g = _mm256_loadu_ps(pattern);
+        uint32_t i = 0;
+        for(; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(g, _mm256_loadu_ps(src + i)));
+        for(; i < n; ++i) dst[i] = gains[i % lanes] * src[i];
+        return;
+    }
+
+    for(uint32_t i = 0; i < n; i += lanes)
+    {
+        uint32_t k = 0;
+        for(; k + 8 <= lanes; k += 8)
+            _mm256_storeu_ps(dst + i + k, _mm256_mul_ps(_mm256_loadu_ps(gains + k),
+                _mm256_loadu_ps(src + i + k)));
+        for(; k < lanes; ++k) dst[i + k] = gains[k] * src[i + k];
+    }
+}
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspRampAvx2(float * dst, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m256 vg0 = _mm256_set1_ps(g0);
+    __m256 vstep = _mm256_set1_ps(step);
+    __m256 idx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 eight = _mm256_set1_ps(8);
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(vg0, _mm256_mul_ps(vstep, idx)));
+        idx = _mm256_add_ps(idx, eight);
+    }
+    for(; i < n; ++i) dst[i] = g0 + step * (float) i;
+}
+
+// the gains of the 8 / lanes frames starting at gains, each repeated for
+// the lanes of its frame
+OPI_DSP_TARGET("avx2")
+static inline __m256 opiDspFrameGainsAvx2(const float * gains, uint32_t lanes)
+{
+    switch(lanes)
+    {
+    case 1: return _mm256_loadu_ps(gains);
+    case 2:
+        {
+            __m128 g = _mm_loadu_ps(gains);
+            return _mm256_set_m128(_mm_unpackhi_ps(g, g), _mm_unpacklo_ps(g, g));
+        }
+    case 4: return _mm256_set_m128(_mm_set1_ps(gains[1]), _mm_set1_ps(gains[0]));
+    default: return _mm256_set1_ps(gains[0]);
+    }
+}
+
+OPI_DSP_TARGET("avx2")
+static inline void opiDspScaleFramesAvx2(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // groups that divide the vector: 8 / lanes frames per vector
+    if(8 % lanes == 0)
+    {
+        uint32_t i = 0, f = 0;
+        for(; i + 8 <= n; i += 8, f += 8 / lanes)
+        {
+            __m256 g = opiDspFrameGainsAvx2(gains + f, lanes);
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(g, _mm256_loadu_ps(src + i)));
+        }
+        for(; i < n; ++i) dst[i] = gains[i / lanes] * src[i];
+        return;
+    }
+
+    for(uint32_t i = 0, f = 0; i < n; i += lanes, ++f)
+    {
+        __m256 g = _mm256_set1_ps(gains[f]);
+        uint32_t k = 0;
+        for(; k + 8 <= lanes; k += 8)
+            _mm256_storeu_ps(dst + i + k, _mm256_mul_ps(g, _mm256_loadu_ps(src + i + k)));
+        for(; k < lanes; ++k) dst[i + k] = gains[f] * src[i + k];
+    }
+}
+
+// horizontal sum, shared with the AVX-512 variant
+OPI_DSP_TARGET("avx2")
+static inline float opiDspSumAvx2(__m256 s)
+{
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_add_ss(h, _mm_shuffle_ps(h, h, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(h);
+}
+
+OPI_DSP_TARGET("avx2")
+static inline float opiDspDotAvx2(const float * a, const float * b, uint32_t n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1,
+            _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    if(i + 8 <= n)
+    {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        i += 8;
+    }
+    return opiDspSumAvx2(_mm256_add_ps(s0, s1)) + opiDspDotScalar(a + i, b + i, n - i);
+}
+
+static const OpiDspKernels opiDspKernelsAvx2 =
+{
+    "avx2",
+    opiDspClearScalar, opiDspCopyScalar, opiDspScaleAvx2,
+    opiDspScaleRampAvx2, opiDspMixAvx2, opiDspPeakAvx2,
+    opiDspScaleLanesAvx2, opiDspRampAvx2, opiDspScaleFramesAvx2,
+    opiDspDotAvx2
+};
+
+/*
+ * ==============================================================
+ *
+ *                          AVX-512
+ *
+ * ===============================================================
+ */
+
+// the tails use masked loads/stores, so there are no scalar loops here
+
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspScaleAvx512(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m512 g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(g, _mm512_loadu_ps(src + i)));
+    if(i < n)
+    {
+        __mmask16 m = (__mmask16) ((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(dst + i, m,
+            _mm512_mul_ps(g, _mm512_maskz_loadu_ps(m, src + i)));
+    }
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspScaleRampAvx512(
+    float * dst, const float * src, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m512 vg0 = _mm512_set1_ps(g0);
+    __m512 vstep = _mm512_set1_ps(step);
+    __m512 idx = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 sixteen = _mm512_set1_ps(16);
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m512 g = _mm512_add_ps(vg0, _mm512_mul_ps(vstep, idx));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(g, _mm512_loadu_ps(src + i)));
+        idx = _mm512_add_ps(idx, sixteen);
+    }
+    if(i < n)
+    {
+        __mmask16 m = (__mmask16) ((1u << (n - i)) - 1);
+        __m512 g = _mm512_add_ps(vg0, _mm512_mul_ps(vstep, idx));
+        _mm512_mask_storeu_ps(dst + i, m,
+            _mm512_mul_ps(g, _mm512_maskz_loadu_ps(m, src + i)));
+    }
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspMixAvx512(float * dst, const float * src, float gain, uint32_t n)
+{
+    __m512 g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i),
+            _mm512_mul_ps(g, _mm512_loadu_ps(src + i))));
+    if(i < n)
+    {
+        __mmask16 m = (__mmask16) ((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(dst + i, m,
+            _mm512_add_ps(_mm512_maskz_loadu_ps(m, dst + i),
+                _mm512_mul_ps(g, _mm512_maskz_loadu_ps(m, src + i))));
+    }
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline float opiDspPeakAvx512(const float * src, uint32_t n)
+{
+    // absolute values as integers: the ordering is the same for non-NaN floats
+    //
+    // NOTE: the explicit mask forms are used, because the plain max/reduce
+    // intrinsics trigger bogus -Wuninitialized warnings with GCC 12
+    __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+    __m512i peak = _mm512_setzero_si512();
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+        peak = _mm512_mask_max_epi32(peak, (__mmask16) 0xffff, peak,
+            _mm512_and_si512(absMask, _mm512_loadu_si512((const void*) (src + i))));
+    if(i < n)
+    {
+        __mmask16 m = (__mmask16) ((1u << (n - i)) - 1);
+        peak = _mm512_mask_max_epi32(peak, m, peak,
+            _mm512_and_si512(absMask, _mm512_maskz_loadu_epi32(m, src + i)));
+    }
+    int32_t lanes[16];
+    _mm512_storeu_si512((void*) lanes, peak);
+    int32_t bits = 0;
+    for(int l = 0; l < 16; ++l) if(lanes[l] > bits) bits = lanes[l];
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// NOTE: no masked tails here: in place, each row's masked store would feed
+// the next row's masked load, which can't be forwarded and stalls every row
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspScaleLanesAvx512(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // rows that divide the vector: the gains repeat every vector
+    if(16 % lanes == 0)
+    {
+        float pattern[16];
+        for(uint32_t k = 0; k < 16; ++k) pattern[k] = gains[k % lanes];
+        __m512 g = _mm512_loadu_ps(pattern);
+        uint32_t i = 0;
+        for(; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(dst + i, _mm512_mul_ps(g, _mm512_loadu_ps(src + i)));
+        if(i + 8 <= n)
+        {
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(pattern),
+                _mm256_loadu_ps(src + i)));
+            i += 8;
+        }
+        for(; i < n; ++i) dst[i] = gains[i % lanes] * src[i];
+        return;
+    }
+
+    for(uint32_t i = 0; i < n; i += lanes)
+    {
+        uint32_t k = 0;
+        for(; k + 16 <= lanes; k += 16)
+            _mm512_storeu_ps(dst + i + k, _mm512_mul_ps(_mm512_loadu_ps(gains + k),
+                _mm512_loadu_ps(src + i + k)));
+        if(k + 8 <= lanes)
+        {
+            _mm256_storeu_ps(dst + i + k, _mm256_mul_ps(_mm256_loadu_ps(gains + k),
+                _mm256_loadu_ps(src + i + k)));
+            k += 8;
+        }
+        for(; k < lanes; ++k) dst[i + k] = gains[k] * src[i + k];
+    }
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspRampAvx512(float * dst, float g0, float g1, uint32_t n)
+{
+    float step = n ? (g1 - g0) / n : 0;
+    __m512 vg0 = _mm512_set1_ps(g0);
+    __m512 vstep = _mm512_set1_ps(step);
+    __m512 idx = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 sixteen = _mm512_set1_ps(16);
+    uint32_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(vg0, _mm512_mul_ps(vstep, idx)));
+        idx = _mm512_add_ps(idx, sixteen);
+    }
+    if(i < n)
+    {
+        __mmask16 m = (__mmask16) ((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(dst + i, m, _mm512_add_ps(vg0, _mm512_mul_ps(vstep, idx)));
+    }
+}
+
+// the gains of the 16 / lanes frames starting at gains, each repeated for
+// the lanes of its frame; only those gains are read
+OPI_DSP_TARGET("avx512f")
+static inline __m512 opiDspFrameGainsAvx512(const float * gains, uint32_t lanes)
+{
+    static const int32_t spread[3][16] =
+    {
+        { 0, 0, 1, 1, 2, 2, 3, 3, 8, 8, 9, 9, 10, 10, 11, 11 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 },
+    };
+
+    // (maskz forms with a full mask: the plain ones trip -Wmaybe-uninitialized
+    // in some GCC versions)
+    __m512 g;
+    const int32_t * idx;
+    switch(lanes)
+    {
+    case 1: return _mm512_loadu_ps(gains);
+    case 2:
+        // gains 0-3 in the low half, 4-7 in the high half
+        g = _mm512_maskz_broadcast_f32x4(0xffff, _mm_loadu_ps(gains));
+        g = _mm512_mask_broadcast_f32x4(g, 0xff00, _mm_loadu_ps(gains + 4));
+        idx = spread[0];
+        break;
+    case 4:
+        g = _mm512_maskz_broadcast_f32x4(0xffff, _mm_loadu_ps(gains));
+        idx = spread[1];
+        break;
+    case 8:
+        g = _mm512_maskz_broadcast_f32x4(0xffff,
+            _mm_castpd_ps(_mm_load_sd((const double*) gains)));
+        idx = spread[2];
+        break;
+    default: return _mm512_set1_ps(gains[0]);
+    }
+    return _mm512_maskz_permutexvar_ps(0xffff, _mm512_loadu_si512((const void*) idx), g);
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline void opiDspScaleFramesAvx512(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    // groups that divide the vector: 16 / lanes frames per vector
+    if(16 % lanes == 0)
+    {
+        uint32_t i = 0, f = 0;
+        for(; i + 16 <= n; i += 16, f += 16 / lanes)
+        {
+            __m512 g = opiDspFrameGainsAvx512(gains + f, lanes);
+            _mm512_storeu_ps(dst + i, _mm512_mul_ps(g, _mm512_loadu_ps(src + i)));
+        }
+        for(; i < n; ++i) dst[i] = gains[i / lanes] * src[i];
+        return;
+    }
+
+    // no masked tail, same as opiDspScaleLanesAvx512
+    for(uint32_t i = 0, f = 0; i < n; i += lanes, ++f)
+    {
+        __m512 g = _mm512_set1_ps(gains[f]);
+        uint32_t k = 0;
+        for(; k + 16 <= lanes; k += 16)
+            _mm512_storeu_ps(dst + i + k, _mm512_mul_ps(g, _mm512_loadu_ps(src + i + k)));
+        if(k + 8 <= lanes)
+        {
+            _mm256_storeu_ps(dst + i + k, _mm256_mul_ps(_mm256_set1_ps(gains[f]),
+                _mm256_loadu_ps(src + i + k)));
+            k += 8;
+        }
+        for(; k < lanes; ++k) dst[i + k] = gains[f] * src[i + k];
+    }
+}
+
+OPI_DSP_TARGET("avx512f")
+static inline float opiDspDotAvx512(const float * a, const float * b, uint32_t n)
+{
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    uint32_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+        s1 = _mm512_add_ps(s1,
+            _mm512_mul_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)));
+    }
+    for(; i < n; i += 16)
+    {
+        __mmask16 m = n - i >= 16 ? (__mmask16) 0xffff : (__mmask16) ((1u << (n - i)) - 1);
+        s0 = _mm512_add_ps(s0,
+            _mm512_mul_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i)));
+    }
+    // through memory rather than _mm512_reduce_add_ps or extracting the
+    // halves, for the same GCC 12 warnings as in opiDspPeakAvx512
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(s0, s1));
+    return opiDspSumAvx2(_mm256_add_ps(_mm256_loadu_ps(lanes), _mm256_loadu_ps(lanes + 8)));
+}
+
+static const OpiDspKernels opiDspKernelsAvx512 =
+{
+    "avx512",
+    opiDspClearScalar, opiDspCopyScalar, opiDspScaleAvx512,
+    opiDspScaleRampAvx512, opiDspMixAvx512, opiDspPeakAvx512,
+    opiDspScaleLanesAvx512, opiDspRampAvx512, opiDspScaleFramesAvx512,
+    opiDspDotAvx512
+};
+
+/*
+ * ==============================================================
+ *
+ *                          CPU DETECTION
+ *
+ * ===============================================================
+ */
+
+static inline bool opiDspCpuSupports(int isa)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] >> 26) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    bool avx = (info[2] >> 28) & 1;
+    uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(info, 7, 0);
+    switch(isa)
+    {
+    case opiDspIsaSse2: return sse2;
+    case opiDspIsaAvx2: return avx && (xcr0 & 6) == 6 && ((info[1] >> 5) & 1);
+    case opiDspIsaAvx512: return (xcr0 & 0xe6) == 0xe6 && ((info[1] >> 16) & 1);
+    }
+    return isa == opiDspIsaScalar;
+#else
+    __builtin_cpu_init();
+    switch(isa)
+    {
+    case opiDspIsaSse2: return __builtin_cpu_supports("sse2");
+    case opiDspIsaAvx2: return __builtin_cpu_supports("avx2");
+    case opiDspIsaAvx512: return __builtin_cpu_supports("avx512f");
+    }
+    return isa == opiDspIsaScalar;
+#endif
+}
+
+#else // OPI_DSP_X86
+
+static inline bool opiDspCpuSupports(int isa) { return isa == opiDspIsaScalar; }
+
+#endif // OPI_DSP_X86
+
+/*
+ * ==============================================================
+ *
+ *                          API
+ *
+ * ===============================================================
+ */
+
+// returns the kernels for a given OpiDspIsa, or 0 if the CPU doesn't support it
+static inline const OpiDspKernels * opiDspKernelsFor(int isa)
+{
+    if(!opiDspCpuSupports(isa)) return 0;
+    switch(isa)
+    {
+    case opiDspIsaScalar: return &opiDspKernelsScalar;
+#ifdef OPI_DSP_X86
+    case opiDspIsaSse2: return &opiDspKernelsSse2;
+    case opiDspIsaAvx2: return &opiDspKernelsAvx2;
+    case opiDspIsaAvx512: return &opiDspKernelsAvx512;
+#endif
+    }
+    return 0;
+}
+
+// returns the best supported kernels; selected once on first use
+static inline const OpiDspKernels & opiDsp()
+{
+    struct Select
+    {
+        static const OpiDspKernels * best()
+        {
+            for(int isa = opiDspIsaCount - 1; isa > opiDspIsaScalar; --isa)
+            {
+                const OpiDspKernels * k = opiDspKernelsFor(isa);
+                if(k) return k;
+            }
+            return &opiDspKernelsScalar;
+        }
+    };
+    static const OpiDspKernels * kernels = Select::best();
+    return *kernels;
+}
+
+static inline void opiDspClear(float * dst, uint32_t n)
+{
+    opiDsp().clear(dst, n);
+}
+
+static inline void opiDspCopy(float * dst, const float * src, uint32_t n)
+{
+    opiDsp().copy(dst, src, n);
+}
+
+static inline void opiDspScale(float * dst, const float * src, float gain, uint32_t n)
+{
+    opiDsp().scale(dst, src, gain, n);
+}
+
+static inline void opiDspScaleRamp(
+    float * dst, const float * src, float g0, float g1, uint32_t n)
+{
+    opiDsp().scaleRamp(dst, src, g0, g1, n);
+}
+
+static inline void opiDspMix(float * dst, const float * src, float gain, uint32_t n)
+{
+    opiDsp().mix(dst, src, gain, n);
+}
+
+static inline float opiDspPeak(const float * src, uint32_t n)
+{
+    return opiDsp().peak(src, n);
+}
+
+static inline void opiDspScaleLanes(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    opiDsp().scaleLanes(dst, src, gains, lanes, n);
+}
+
+// dst[i] = gains[i] * src[i]
+static inline void opiDspMultiply(float * dst, const float * src, const float * gains, uint32_t n)
+{
+    if(n) opiDsp().scaleLanes(dst, src, gains, n, n);
+}
+
+static inline void opiDspRamp(float * dst, float g0, float g1, uint32_t n)
+{
+    opiDsp().ramp(dst, g0, g1, n);
+}
+
+// dst[i] = gains[i / lanes] * src[i], eg. a gain ramp (from opiDspRamp) or a
+// parameter buffer applied to a group of interleaved channels
+static inline void opiDspScaleFrames(float * dst, const float * src,
+    const float * gains, uint32_t lanes, uint32_t n)
+{
+    opiDsp().scaleFrames(dst, src, gains, lanes, n);
+}
+
+static inline float opiDspDot(const float * a, const float * b, uint32_t n)
+{
+    return opiDsp().dot(a, b, n);
+}
+
+// true if the buffer is all zeroes, ie. it can be flagged in silenceMask
+static inline bool opiDspIsSilent(const float * src, uint32_t n)
+{
+    return opiDsp().peak(src, n) == 0.f;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          SILENCE
+ *
+ * ===============================================================
+ */
+
+// Silence bits of a bus, see OpiBusChannels. nChannels is the number of
+// channels the bits cover: the bus's channels with opiConfigWideSilence, or
+// at most 64 without (there are no more words then).
+
+// words in the bitset, silenceMask included
+static inline uint32_t opiSilenceWords(uint32_t nChannels)
+{
+    return nChannels > 64 ? (nChannels + 63) / 64 : 1;
+}
+
+// bytes for an OpiBusChannels of nChannels channels, silence words included
+static inline size_t opiBusChannelsSize(uint32_t nChannels)
+{
+    size_t size = sizeof(OpiBusChannels) + nChannels * sizeof(float*);
+    if(nChannels <= 64) return size;
+    return ((size + 7) & ~(size_t) 7) + (opiSilenceWords(nChannels) - 1) * sizeof(uint64_t);
+}
+
+// word w of the bitset (w < opiSilenceWords), 0 being silenceMask
+static inline uint64_t * opiSilenceWord(OpiBusChannels * bus, uint32_t nChannels, uint32_t w)
+{
+    if(!w) return &bus->silenceMask;
+    uintptr_t words = ((uintptr_t) (bus->channels + nChannels) + 7) & ~(uintptr_t) 7;
+    return (uint64_t*) words + (w - 1);
+}
+
+static inline bool opiIsSilent(OpiBusChannels * bus, uint32_t nChannels, uint32_t c)
+{
+    if(c >= nChannels) return false;
+    return (*opiSilenceWord(bus, nChannels, c / 64) >> (c % 64)) & 1;
+}
+
+static inline void opiSetSilent(OpiBusChannels * bus, uint32_t nChannels, uint32_t c, bool silent)
+{
+    if(c >= nChannels) return;
+    uint64_t * word = opiSilenceWord(bus, nChannels, c / 64);
+    uint64_t bit = uint64_t(1) << (c % 64);
+    *word = silent ? *word | bit : *word & ~bit;
+}
+
+// flags all nChannels channels silent or not, eg. to preset the outputs
+static inline void opiSetAllSilent(OpiBusChannels * bus, uint32_t nChannels, bool silent)
+{
+    uint32_t nWords = opiSilenceWords(nChannels);
+    for(uint32_t w = 0; w < nWords; ++w)
+    {
+        uint32_t bits = nChannels - w * 64;
+        uint64_t all = bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+        *opiSilenceWord(bus, nChannels, w) = silent ? all : 0;
+    }
+}
+
+// true if channels [first, first + n) are all flagged, eg. a whole group of
+// interleaved channels
+static inline bool opiAllSilent(OpiBusChannels * bus, uint32_t nChannels,
+    uint32_t first, uint32_t n)
+{
+    for(uint32_t c = first; c < first + n; ++c)
+        if(!opiIsSilent(bus, nChannels, c)) return false;
+    return n != 0;
+}
@@ -0,0 +1,395 @@
+/*
+/// # Community Plugin Format Event Scheduling
+///
+/// ## About
+/// Helper for sample-accurate event handling in opiPlugProcess. The block is
+/// split at event positions and the plugin renders the contiguous spans in
+/// between, while OpiEventAutomation ramps (smoothFrames) are run for it,
+/// including ramps that continue over several blocks.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiEventScheduler sched;
+///    sched.init(nParams, defaults);                 // outside [RT]
+///
+///    sched.process(procInfo,
+///        [&](uint32_t offset, uint32_t n) { ... },  // render a span
+///        [&](const OpiEvent * ev) { ... });         // non-automation events
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// Within each span every parameter is linear: ramps[i].value at the first
+/// frame of the span, advancing by ramps[i].step per frame. Spans are also
+/// split where a ramp finishes, so the render callback never has to check
+/// per sample whether a ramp is still running.
+///
+/// OpiEventReader walks the input events of a block in either transport
+/// (pointer array or opiConfigPackedEvents) and OpiEventArena is a growable
+/// packed buffer for hosts (or plugins that buffer events themselves).
+///
+/// For audio-rate parameters opiFindParamBuffer looks up the OpiParamBuffer
+/// of a parameter, and on the host side OpiParamCurve renders automation into
+/// one with the same ramps the scheduler would run.
+*/
+
+#pragma once
+
+#include "Community.h"
+#include "CommunityDsp.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+
+/*
+ * ==============================================================
+ *
+ *                          PACKED EVENTS
+ *
+ * ===============================================================
+ */
+
+// size of the known event types, or just the common part for unknown ones
+static inline uint32_t opiEventSize(const OpiEvent * ev)
+{
+    switch(ev->type)
+    {
+    case opiEventMidi: return sizeof(OpiEventMidi);
+    case opiEventAutomation: return sizeof(OpiEventAutomation);
+    default: return sizeof(OpiEvent);
+    }
+}
+
+// true if the process call carries OpiEventBuffers at all
+static inline bool opiHasEventBuffers(const OpiProcessInfo * procInfo)
+{
+    return procInfo->processInfoSize >=
+        offsetof(OpiProcessInfo, outEventBuffer) + sizeof(OpiEventBuffer);
+}
+
+// append one event record, returns false (and drops it) if out of capacity
+static inline bool opiEventAppend(OpiEventBuffer * buf, const OpiEvent * ev, uint32_t evSize)
+{
+    uint32_t recordSize = (uint32_t) (sizeof(uint32_t) + evSize + 3) & ~3u;
+    if(buf->capacity - buf->size < recordSize) return false;
+
+    char * record = (char*) buf->data + buf->size;
+    *((uint32_t*) record) = recordSize;
+    memcpy(record + sizeof(uint32_t), ev, evSize);
+
+    buf->size += recordSize;
+    buf->count += 1;
+    return true;
+}
+
+// Walks the input events of a process call, whichever transport is in use.
+struct OpiEventReader
+{
+    OpiEvent **     list = 0;   // pointer array, or 0 for packed
+    const char *    data = 0;
+    uint32_t        pos = 0;    // index into list or byte offset into data
+    uint32_t        end = 0;    // count or size
+
+    explicit OpiEventReader(const OpiProcessInfo * procInfo)
+    {
+        if(opiHasEventBuffers(procInfo) && procInfo->inEventBuffer.data)
+        {
+            data = (const char*) procInfo->inEventBuffer.data;
+            end = procInfo->inEventBuffer.size;
+        }
+        else
+        {
+            list = procInfo->inEvents;
+            end = procInfo->nInEvents;
+        }
+    }
+
+    // the current event, or 0 when done
+    const OpiEvent * peek() const
+    {
+        if(pos >= end) return 0;
+        if(list) return list[pos];
+        return (const OpiEvent*) (data + pos + sizeof(uint32_t));
+    }
+
+    void next()
+    {
+        if(list) { ++pos; return; }
+
+        uint32_t recordSize = *((const uint32_t*) (data + pos));
+        // a broken record would loop forever or run off the end, so stop
+        if(recordSize < sizeof(uint32_t) + sizeof(OpiEvent)) pos = end;
+        else pos += recordSize;
+    }
+};
+
+// Growable packed event storage, eg. for a host building input buffers or
+// providing an output arena. Only allocate() and add() ever allocate.
+struct OpiEventArena
+{
+    std::vector<uint32_t>   storage;    // uint32_t for alignment
+    OpiEventBuffer          buffer;
+
+    OpiEventArena() { memset(&buffer, 0, sizeof(buffer)); }
+
+    // reserve capacity in bytes, keeping the contents
+    void allocate(uint32_t bytes)
+    {
+        storage.resize((bytes + 3) / 4);
+        buffer.data = storage.data();
+        buffer.capacity = (uint32_t) storage.size() * 4;
+    }
+
+    void clear() { buffer.size = 0; buffer.count = 0; }
+
+    // copy an event in, growing if needed (so not for [RT] use unless the
+    // capacity is known to be enough)
+    void add(const OpiEvent * ev)
+    {
+        if(!opiEventAppend(&buffer, ev, opiEventSize(ev)))
+        {
+            allocate(2 * buffer.capacity + 64);
+            opiEventAppend(&buffer, ev, opiEventSize(ev));
+        }
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          RAMP
+ *
+ * ===============================================================
+ */
+
+// Linear parameter ramp that can run across block boundaries.
+struct OpiParamRamp
+{
+    float       value = 0;      // value at the current position
+    float       target = 0;     // value once the ramp is done
+    float       step = 0;       // increment per frame (0 = not ramping)
+    uint32_t    remaining = 0;  // frames until target is reached
+
+    bool active() const { return remaining != 0; }
+
+    // value after n frames, valid as long as n <= remaining (or not active)
+    float at(uint32_t n) const { return value + step * (float) n; }
+
+    void set(float v)
+    {
+        value = target = v;
+        step = 0;
+        remaining = 0;
+    }
+
+    void start(float v, uint32_t frames)
+    {
+        if(!frames) { set(v); return; }
+        target = v;
+        step = (v - value) / (float) frames;
+        remaining = frames;
+    }
+
+    void advance(uint32_t n)
+    {
+        if(n >= remaining) { set(target); return; }
+        value += step * (float) n;
+        remaining -= n;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          SCHEDULER
+ *
+ * ===============================================================
+ */
+
+struct OpiEventScheduler
+{
+    std::vector<OpiParamRamp>   ramps;
+
+    // indices of ramps in flight, so spans only touch the ones that move;
+    // a ramp stays listed until the next advance even if it was snapped
+    std::vector<uint32_t>       active;
+    std::vector<uint8_t>        listed;
+    uint32_t                    nActive = 0;
+
+    // allocates storage for nParams ramps, must be called outside [RT]
+    void init(uint32_t nParams, const float * values = 0)
+    {
+        ramps.assign(nParams, OpiParamRamp());
+        active.assign(nParams, 0);
+        listed.assign(nParams, 0);
+        nActive = 0;
+        if(values) for(uint32_t i = 0; i < nParams; ++i) ramps[i].set(values[i]);
+    }
+
+    // snap a parameter, eg. when the host sets it outside of automation
+    void setParam(uint32_t idx, float value)
+    {
+        if(idx < ramps.size()) ramps[idx].set(value);
+    }
+
+    // cancel all ramps, eg. on opiPlugReset
+    void reset()
+    {
+        for(uint32_t i = 0; i < nActive; ++i)
+        {
+            ramps[active[i]].set(ramps[active[i]].target);
+            listed[active[i]] = 0;
+        }
+        nActive = 0;
+    }
+
+    template <class Render>
+    void process(OpiProcessInfo * procInfo, Render && render)
+    {
+        process(procInfo, render, [](const OpiEvent *) {});
+    }
+
+    template <class Render, class Event>
+    void process(OpiProcessInfo * procInfo, Render && render, Event && event)
+    {
+        uint32_t nFrames = procInfo->nFrames;
+        OpiEventReader events(procInfo);
+
+        uint32_t pos = 0;
+        for(;;)
+        {
+            // dispatch everything at the current position; deltas are sorted,
+            // but anything past the end of the block is still delivered at the end
+            const OpiEvent * ev;
+            while((ev = events.peek()) && (ev->delta <= pos || pos == nFrames))
+            {
+                dispatch(ev, event);
+                events.next();
+            }
+            if(pos == nFrames) break;
+
+            uint32_t end = nFrames;
+            if(ev && ev->delta < end) end = ev->delta;
+
+            // remaining can be anything up to UINT32_MAX, so compare lengths
+            for(uint32_t i = 0; i < nActive; ++i)
+            {
+                uint32_t remaining = ramps[active[i]].remaining;
+                if(remaining < end - pos) end = pos + remaining;
+            }
+
+            if(end > pos) render(pos, end - pos);
+            advance(end - pos);
+            pos = end;
+        }
+    }
+
+private:
+    template <class Event>
+    void dispatch(const OpiEvent * ev, Event & event)
+    {
+        if(ev->type != opiEventAutomation) { event(ev); return; }
+
+        const OpiEventAutomation * a = (const OpiEventAutomation*) ev;
+        if(a->paramIndex >= ramps.size()) return;
+
+        ramps[a->paramIndex].start(a->targetValue, a->smoothFrames);
+        if(a->smoothFrames && !listed[a->paramIndex])
+        {
+            listed[a->paramIndex] = 1;
+            active[nActive++] = a->paramIndex;
+        }
+    }
+
+    void advance(uint32_t n)
+    {
+        for(uint32_t i = 0; i < nActive;)
+        {
+            OpiParamRamp & r = ramps[active[i]];
+            r.advance(n);
+            if(r.active()) { ++i; continue; }
+            listed[active[i]] = 0;
+            active[i] = active[--nActive];
+        }
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          PARAMETER BUFFERS
+ *
+ * ===============================================================
+ */
+
+// the OpiParamBuffer for parameter idx, or 0 if it comes without one
+static inline const OpiParamBuffer * opiFindParamBuffer(
+    const OpiProcessInfo * procInfo, uint32_t idx)
+{
+    if(procInfo->processInfoSize < offsetof(OpiProcessInfo, nParamBuffers)
+        + sizeof(procInfo->nParamBuffers)) return 0;
+
+    // sorted by paramIndex
+    const OpiParamBuffer * buf = procInfo->paramBuffers;
+    uint32_t lo = 0, hi = procInfo->nParamBuffers;
+    while(lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if(buf[mid].paramIndex < idx) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < procInfo->nParamBuffers && buf[lo].paramIndex == idx ? buf + lo : 0;
+}
+
+// Host side: renders the automation of one parameter into an OpiParamBuffer,
+// block by block. The values are exactly what a plugin using the scheduler
+// would compute for the same events, ramps continue across blocks and events
+// at or past the end of the block take effect from the next one.
+struct OpiParamCurve
+{
+    OpiParamRamp        ramp;
+    std::vector<float>  values;
+
+    // must be called outside [RT]
+    void init(uint32_t maxFrames, float value)
+    {
+        values.assign(maxFrames, value);
+        ramp.set(value);
+    }
+
+    // snap, eg. when the parameter is set outside of automation
+    void set(float value) { ramp.set(value); }
+
+    // [RT] points must be sorted by delta and all for this parameter
+    void render(const OpiEventAutomation * points, uint32_t nPoints, uint32_t nFrames)
+    {
+        uint32_t pos = 0, next = 0;
+        for(;;)
+        {
+            while(next < nPoints && (points[next].delta <= pos || pos == nFrames))
+            {
+                ramp.start(points[next].targetValue, points[next].smoothFrames);
+                ++next;
+            }
+            if(pos == nFrames) break;
+
+            uint32_t end = nFrames;
+            if(next < nPoints && points[next].delta < end) end = points[next].delta;
+            if(ramp.active() && ramp.remaining < end - pos) end = pos + ramp.remaining;
+
+            uint32_t n = end - pos;
+            if(ramp.active()) opiDspRamp(values.data() + pos, ramp.value, ramp.at(n), n);
+            else std::fill(values.data() + pos, values.data() + end, ramp.value);
+
+            ramp.advance(n);
+            pos = end;
+        }
+    }
+
+    // the buffer for the block just rendered
+    OpiParamBuffer buffer(uint32_t paramIndex) const
+    {
+        OpiParamBuffer buf = { paramIndex, values.data() };
+        return buf;
+    }
+};
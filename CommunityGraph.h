@@ -0,0 +1,781 @@
+/*
+/// # Community Plugin Format Graph Executor
+///
+/// ## About
+/// Reference host graph: a DAG of plugin instances, each with one input and
+/// one output bus, processed in parallel on an OpiWorkerPool.
+///
+/// ## Details
+/// - A node runs as soon as all of its inputs have finished, on whichever
+///   worker got there first; independent nodes run concurrently, while each
+///   instance is still only ever called from one thread at a time as [RT]
+///   requires
+/// - A node with a single input reads its predecessor's output buffers
+///   directly; with several inputs they are summed into the node's own input
+/// - Nodes without inputs are sources, the host fills their input buses
+/// - Nodes whose inputs have been silent for longer than their tail (see
+///   opiPlugGetTailFrames) are put to sleep: their outputs are cleared once
+///   and flagged silent, and process is skipped until the next non-silent
+///   input or event. Since sleeping outputs are silent, whole idle chains
+///   downstream fall asleep as well. Nodes of more than 64 channels are
+///   configured with opiConfigWideSilence where the plugin takes it, and
+///   can only sleep if it does
+/// - With maxBatch set, nodes running the same plugin at the same depth of
+///   the graph (so they can't depend on each other) are processed together
+///   with opiPlugProcessBatch, as one work item: their inputs are gathered
+///   into the batch layout and the outputs scattered back afterwards. Where
+///   a batch only feeds the same lanes of the next one (eg. parallel chains
+///   of the same plugins) the audio stays in the batch layout in between,
+///   and output() of those nodes is not kept up to date
+/// - Plugin latency is compensated: where paths with different latency meet
+///   at a node, the earlier inputs go through delay lines so that everything
+///   arrives aligned. Delay lines of channels that have gone silent stop
+///   being touched once they have played out. When a plugin signals a change
+///   (opiHostSetLatency) updateLatency() builds new delay lines off the audio
+///   thread and process() switches over at the start of the next block; the
+///   new lines start out silent, so expect a glitch like with any change of
+///   latency
+/// - Nothing is allocated per block
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiGraph graph;
+///    uint32_t a = graph.addNode(instA, 2), b = graph.addNode(instB, 2);
+///    graph.connect(a, b);
+///    graph.maxBatch = 16;                       // optional, before compile
+///    graph.compile(blockSize, samplerate);      // configures and enables
+///    ... blocks of at most graph.maxFrames ...
+///    ... fill graph.input(a), set its silence bits ...
+///    graph.setEvents(a, events, nEvents);       // optional, for one block
+///    graph.process(pool, nFrames);
+///    ... read graph.output(b) ...
+///
+///    graph.idle();                              // periodically, not [RT]
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#pragma once
+
+#include "CommunityHost.h"
+#include "CommunityDsp.h"
+#include "CommunityPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+struct OpiGraph
+{
+    struct Node
+    {
+        OpiHostInstance *   inst = 0;
+        uint32_t            nChannels = 0;
+        uint32_t            flags = 0;      // config flags the plugin accepted
+
+        std::vector<uint32_t>   preds;
+        std::vector<uint32_t>   succs;
+        uint32_t                firstEdge = 0;  // index of the edge from preds[0]
+
+        OpiHostBus      input;
+        OpiHostBus      output;
+        bool            aliasInput = false;     // input is the predecessor's output
+        OpiProcessInfo  procInfo;
+
+        // sleep state, see opiPlugGetTailFrames
+        uint32_t        silenceChannels = 0;    // channels with silence bits, see compile()
+        uint32_t        tailFrames = opiTailInfinite;
+        uint32_t        silentFrames = 0;   // frames processed since input went silent
+        bool            sleeping = false;
+        uint64_t        processCalls = 0;
+
+        // batching: every member of a batch runs as part of its first node
+        int32_t         batch = -1;     // index into batches, -1 = not batched
+        uint32_t        leader = 0;     // node that runs this one
+        uint32_t        waitFor = 0;    // predecessors pending counts down from
+
+        // predecessors still running this block, reset by the node itself
+        std::atomic<uint32_t>   pending { 0 };
+    };
+
+    struct Batch
+    {
+        std::vector<uint32_t>           members;
+        std::vector<OpiPlugin*>         plugins;
+        std::vector<OpiProcessInfo*>    procInfos;
+        std::vector<uint8_t>            awake;
+
+        OpiHostBus      input;      // channels hold maxFrames * members
+        OpiHostBus      output;
+        OpiBatchInfo    info;
+
+        bool            fromBatch = false;  // input is the previous batch's output
+        bool            toBatch = false;    // output only feeds the next batch
+        bool            outputCleared = false;
+    };
+
+    // one input of a node delayed by delay frames; the ring holds delay +
+    // maxFrames frames per channel, a block is written at pos and read back
+    // from delay frames earlier
+    struct DelayLine
+    {
+        uint32_t                delay = 0;
+        uint32_t                length = 0;
+        uint32_t                pos = 0;
+        std::vector<float>      samples;    // length frames per channel
+        std::vector<uint32_t>   quiet;      // per channel, zero frames at the end
+    };
+
+    // delay lines for the current latencies, owned by process() once published
+    struct Compensation
+    {
+        std::vector<int32_t>    edgeLine;   // per edge index into lines, -1 = none
+        std::vector<DelayLine>  lines;
+    };
+
+    std::vector<std::unique_ptr<Node>>  nodes;
+    std::vector<std::unique_ptr<Batch>> batches;
+    std::vector<uint32_t>               roots;
+
+    // latency from the sources to each node's output, as of the last compile()
+    // or updateLatency(); not [RT]
+    std::vector<uint32_t>               latencies;
+
+    OpiTimeInfo     timeInfo;
+    uint32_t        nFrames = 0;
+    uint32_t        maxFrames = 0;      // block size agreed on by every node
+    bool            compiled = false;
+    bool            allowSleep = true;
+    uint32_t        maxBatch = 0;       // most nodes per batch, 0 or 1 = off
+    bool            compensateLatency = true;
+
+    OpiGraph() {}
+    OpiGraph(const OpiGraph &) = delete;
+    OpiGraph & operator=(const OpiGraph &) = delete;
+
+    ~OpiGraph()
+    {
+        delete compensation;
+        delete pendingCompensation.load();
+        delete retiredCompensation.load();
+    }
+
+    uint32_t addNode(OpiHostInstance * inst, uint32_t nChannels)
+    {
+        nodes.emplace_back(new Node);
+        nodes.back()->inst = inst;
+        nodes.back()->nChannels = nChannels;
+        compiled = false;
+        return (uint32_t) nodes.size() - 1;
+    }
+
+    void connect(uint32_t from, uint32_t to)
+    {
+        nodes[from]->succs.push_back(to);
+        nodes[to]->preds.push_back(from);
+        compiled = false;
+    }
+
+    // Configures and enables every instance and sets up buffers. Plugins that
+    // reject the flags are configured without them, and nodes of more than 64
+    // channels are offered opiConfigWideSilence as well; if a plugin lowers the
+    // block size, everything is configured again with the lower one (see
+    // maxFrames). Returns false if there is a cycle or a plugin rejects its
+    // configuration.
+    bool compile(uint32_t blockSize, float samplerate, uint32_t flags = 0)
+    {
+        compiled = false;
+        if(!isAcyclic()) return false;
+
+        for(;;)
+        {
+            uint32_t agreed = blockSize;
+            for(auto & n : nodes)
+            {
+                n->inst->dispatch(opiPlugDisable);
+                if(!configureNode(*n, blockSize, samplerate, flags)) return false;
+                if(n->inst->maxFrames < agreed) agreed = n->inst->maxFrames;
+            }
+            if(agreed == blockSize) break;
+            blockSize = agreed;
+        }
+
+        uint32_t nEdges = 0;
+        for(auto & n : nodes)
+        {
+            n->inst->dispatch(opiPlugEnable);
+            n->inst->refreshLatency(true);
+            n->output.allocate(n->nChannels, blockSize);
+            n->firstEdge = nEdges;
+            nEdges += (uint32_t) n->preds.size();
+        }
+
+        for(uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            Node & n = *nodes[i];
+
+            n.aliasInput = n.preds.size() == 1
+                && nodes[n.preds[0]]->nChannels == n.nChannels;
+            if(n.aliasInput) n.input.alias(nodes[n.preds[0]]->output);
+            else n.input.allocate(n.nChannels, blockSize);
+
+            // without wide silence the bits past 64 channels are never set,
+            // so such a node never sleeps
+            n.silenceChannels = (n.flags & opiConfigWideSilence)
+                ? n.nChannels : std::min(n.nChannels, 64u);
+            n.silentFrames = 0;
+            n.sleeping = false;
+
+            memset(&n.procInfo, 0, sizeof(n.procInfo));
+            n.procInfo.processInfoSize = sizeof(OpiProcessInfo);
+            n.procInfo.timeInfo = &timeInfo;
+            n.procInfo.inputs = n.input.bus();
+            n.procInfo.outputs = n.output.bus();
+        }
+
+        buildBatches(blockSize);
+
+        roots.clear();
+        for(uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            Node & n = *nodes[i];
+            if(n.leader != i) continue;
+            if(!n.waitFor) roots.push_back(i);
+            n.pending.store(n.waitFor, std::memory_order_relaxed);
+        }
+
+        memset(&timeInfo, 0, sizeof(timeInfo));
+        timeInfo.infoSize = sizeof(OpiTimeInfo);
+
+        maxFrames = blockSize;
+
+        delete pendingCompensation.exchange(0);
+        delete retiredCompensation.exchange(0);
+        delete compensation;
+        compensation = buildCompensation();
+
+        compiled = true;
+        return true;
+    }
+
+    // Not [RT]: picks up latency changes signalled with opiHostSetLatency and
+    // builds delay lines for them, which process() switches to at the start
+    // of its next block. Also frees the ones process() has let go of, so call
+    // this regularly (eg. from the UI thread) rather than only on demand.
+    // Returns true if new delay lines were built.
+    bool updateLatency()
+    {
+        delete retiredCompensation.exchange(0, std::memory_order_acquire);
+        if(!compiled) return false;
+
+        bool changed = false;
+        for(auto & n : nodes) changed = n->inst->refreshLatency() || changed;
+        if(!changed) return false;
+
+        // anything process() hasn't picked up yet is out of date anyway
+        delete pendingCompensation.exchange(buildCompensation(), std::memory_order_acq_rel);
+        return true;
+    }
+
+    // Not [RT]: opiPlugIdle on every node (see OpiHostInstance::idle), then
+    // updateLatency(); the one call to make regularly off the audio thread.
+    bool idle()
+    {
+        for(auto & n : nodes) n->inst->idle();
+        return updateLatency();
+    }
+
+    // total latency of the graph: the most of any node
+    uint32_t maxLatency() const
+    {
+        uint32_t most = 0;
+        for(uint32_t l : latencies) if(l > most) most = l;
+        return most;
+    }
+
+    OpiHostBus & input(uint32_t node) { return nodes[node]->input; }
+    OpiHostBus & output(uint32_t node) { return nodes[node]->output; }
+
+    // events for the node's next process call only; the array must stay
+    // valid until process() returns
+    void setEvents(uint32_t node, OpiEvent ** events, uint32_t nEvents)
+    {
+        nodes[node]->procInfo.inEvents = events;
+        nodes[node]->procInfo.nInEvents = nEvents;
+    }
+
+    // number of nodes that were asleep during the last block
+    uint32_t numSleeping() const
+    {
+        uint32_t n = 0;
+        for(auto & node : nodes) n += node->sleeping;
+        return n;
+    }
+
+    // [RT] process one block (of at most maxFrames) through the whole graph
+    void process(OpiWorkerPool & pool, uint32_t frames)
+    {
+        if(!compiled || nodes.empty() || frames > maxFrames) return;
+        nFrames = frames;
+
+        // switch to new delay lines, unless the last old ones are still to be freed
+        if(!retiredCompensation.load(std::memory_order_acquire)
+            && pendingCompensation.load(std::memory_order_relaxed))
+        {
+            Compensation * next = pendingCompensation.exchange(0, std::memory_order_acq_rel);
+            if(next)
+            {
+                retiredCompensation.store(compensation, std::memory_order_release);
+                compensation = next;
+            }
+        }
+
+        pool.run(&runNode, this, (uint32_t) nodes.size(),
+            roots.data(), (uint32_t) roots.size());
+        timeInfo.samplePos += frames;
+    }
+
+private:
+    Compensation *                  compensation = 0;   // [RT] in use
+    std::atomic<Compensation*>      pendingCompensation { nullptr };
+    std::atomic<Compensation*>      retiredCompensation { nullptr };
+
+    // Latency at each node's input is the most of any of its predecessors'
+    // outputs; inputs that arrive earlier get a delay line for the difference.
+    Compensation * buildCompensation()
+    {
+        Compensation * comp = new Compensation;
+        latencies.assign(nodes.size(), 0);
+
+        uint32_t nEdges = 0;
+        for(auto & n : nodes) nEdges += (uint32_t) n->preds.size();
+        comp->edgeLine.assign(nEdges, -1);
+
+        for(uint32_t i : topoOrder())
+        {
+            Node & n = *nodes[i];
+
+            uint32_t arrival = 0;
+            for(uint32_t p : n.preds) arrival = std::max(arrival, latencies[p]);
+            latencies[i] = arrival + n.inst->latency;
+
+            for(uint32_t j = 0; j < n.preds.size(); ++j)
+            {
+                uint32_t delay = arrival - latencies[n.preds[j]];
+                if(!delay || !compensateLatency) continue;
+
+                comp->edgeLine[n.firstEdge + j] = (int32_t) comp->lines.size();
+                comp->lines.emplace_back();
+                DelayLine & line = comp->lines.back();
+                uint32_t nChannels = std::min(n.nChannels, nodes[n.preds[j]]->nChannels);
+                line.delay = delay;
+                line.length = delay + maxFrames;
+                line.samples.assign((size_t) line.length * nChannels, 0.f);
+                line.quiet.assign(nChannels, line.length);
+            }
+        }
+        return comp;
+    }
+
+    // Pushes a block of channel c (0 = silent) through the line and copies or
+    // mixes the delayed block into dst. Returns false if that block is silent,
+    // in which case dst is left alone. Once a channel has been silent for the
+    // whole length of the ring, it isn't touched at all.
+    bool delayChannel(DelayLine & line, uint32_t c, const float * src, float * dst, bool first)
+    {
+        float * ring = line.samples.data() + (size_t) c * line.length;
+        uint32_t & quiet = line.quiet[c];
+
+        uint32_t head = std::min(nFrames, line.length - line.pos);
+        if(src)
+        {
+            opiDspCopy(ring + line.pos, src, head);
+            opiDspCopy(ring, src + head, nFrames - head);
+            quiet = 0;
+        }
+        else
+        {
+            if(quiet >= line.length) return false;
+            opiDspClear(ring + line.pos, head);
+            opiDspClear(ring, nFrames - head);
+            quiet = std::min(quiet + nFrames, line.length);
+        }
+        if(quiet >= line.delay + nFrames) return false;
+
+        uint32_t from = line.pos >= line.delay ? line.pos - line.delay
+            : line.pos + line.length - line.delay;
+        head = std::min(nFrames, line.length - from);
+        if(first)
+        {
+            opiDspCopy(dst, ring + from, head);
+            opiDspCopy(dst + head, ring, nFrames - head);
+        }
+        else
+        {
+            opiDspMix(dst, ring + from, 1.f, head);
+            opiDspMix(dst + head, ring, 1.f, nFrames - head);
+        }
+        return true;
+    }
+
+    bool configureNode(Node & n, uint32_t blockSize, float samplerate, uint32_t flags)
+    {
+        // all the flags are optional for the graph, so try with fewer: first
+        // without wide silence bits, then without any
+        uint32_t wide = n.nChannels > 64 ? opiConfigWideSilence : 0;
+        const uint32_t attempts[] = { flags | wide, flags, 0 };
+        for(uint32_t i = 0; i < 3; ++i)
+        {
+            if(i && attempts[i] == attempts[i - 1]) continue;
+            n.flags = attempts[i];
+            if(n.inst->configure(blockSize, samplerate, n.nChannels, n.nChannels, n.flags))
+                return true;
+        }
+        return false;
+    }
+
+    // Kahn's algorithm, leaves out the nodes that are part of a cycle
+    std::vector<uint32_t> topoOrder()
+    {
+        std::vector<uint32_t> indegree(nodes.size()), queue;
+        for(uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            indegree[i] = (uint32_t) nodes[i]->preds.size();
+            if(!indegree[i]) queue.push_back(i);
+        }
+        for(size_t q = 0; q < queue.size(); ++q)
+            for(uint32_t s : nodes[queue[q]]->succs)
+                if(!--indegree[s]) queue.push_back(s);
+        return queue;
+    }
+
+    bool isAcyclic() { return topoOrder().size() == nodes.size(); }
+
+    // Groups nodes by depth (longest path from a source), plugin and channel
+    // count, then splits the groups into batches of what both the graph and
+    // the plugin allow. Nodes of the same depth are never connected.
+    void buildBatches(uint32_t blockSize)
+    {
+        batches.clear();
+        for(uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            nodes[i]->batch = -1;
+            nodes[i]->leader = i;
+            nodes[i]->waitFor = (uint32_t) nodes[i]->preds.size();
+        }
+        if(maxBatch < 2) return;
+
+        std::vector<uint32_t> depth(nodes.size(), 0);
+        for(uint32_t i : topoOrder())
+            for(uint32_t s : nodes[i]->succs)
+                if(depth[s] < depth[i] + 1) depth[s] = depth[i] + 1;
+
+        typedef std::tuple<uint32_t, uintptr_t, uint32_t, uint32_t> Key;
+        std::map<Key, std::vector<uint32_t>> groups;
+        for(uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            Node & n = *nodes[i];
+            Key key(depth[i], (uintptr_t) n.inst->plug->dispatchToPlugin,
+                n.nChannels, n.flags);
+            groups[key].push_back(i);
+        }
+
+        for(auto & kv : groups)
+        {
+            std::vector<uint32_t> & group = kv.second;
+            uint32_t limit = (uint32_t) nodes[group[0]]->inst->dispatch(opiPlugMaxBatch);
+            if(limit > maxBatch) limit = maxBatch;
+            if(limit < 2) continue;
+
+            for(size_t first = 0; first + 1 < group.size(); first += limit)
+            {
+                size_t count = group.size() - first;
+                if(count > limit) count = limit;
+                if(count < 2) break;
+                addBatch(&group[first], (uint32_t) count, blockSize);
+            }
+        }
+    }
+
+    void addBatch(const uint32_t * members, uint32_t count, uint32_t blockSize)
+    {
+        batches.emplace_back(new Batch);
+        Batch & b = *batches.back();
+        Node & leader = *nodes[members[0]];
+
+        leader.waitFor = 0;
+        for(uint32_t k = 0; k < count; ++k)
+        {
+            Node & n = *nodes[members[k]];
+            n.batch = (int32_t) batches.size() - 1;
+            n.leader = members[0];
+            leader.waitFor += (uint32_t) n.preds.size();
+
+            b.members.push_back(members[k]);
+            b.plugins.push_back(n.inst->plug);
+            b.procInfos.push_back(&n.procInfo);
+        }
+        b.awake.assign(count, 0);
+
+        // a batch fed only by the same lanes of another one reads its output
+        // directly, so there is nothing to convert in between
+        Batch * prev = chainSource(b);
+        if(prev)
+        {
+            prev->toBatch = true;
+            b.fromBatch = true;
+            b.input.alias(prev->output);
+        }
+        else b.input.allocate(leader.nChannels, blockSize * count);
+        b.output.allocate(leader.nChannels, blockSize * count);
+
+        memset(&b.info, 0, sizeof(b.info));
+        b.info.batchInfoSize = sizeof(OpiBatchInfo);
+        b.info.nInstances = count;
+        b.info.plugins = b.plugins.data();
+        b.info.procInfos = b.procInfos.data();
+        b.info.inputs = b.input.bus();
+        b.info.outputs = b.output.bus();
+    }
+
+    Batch * chainSource(const Batch & b)
+    {
+        Node & first = *nodes[b.members[0]];
+        if(first.preds.size() != 1 || nodes[first.preds[0]]->batch < 0) return 0;
+
+        Batch & prev = *batches[nodes[first.preds[0]]->batch];
+        if(prev.toBatch || prev.members.size() != b.members.size()) return 0;
+
+        for(uint32_t k = 0; k < b.members.size(); ++k)
+        {
+            Node & n = *nodes[b.members[k]];
+            Node & p = *nodes[prev.members[k]];
+            if(!n.aliasInput || n.preds[0] != prev.members[k] || p.succs.size() != 1)
+                return 0;
+        }
+        return &prev;
+    }
+
+    // silence bits from a bus to another with the same channels, as far as
+    // dst has them; past srcChannels nothing counts as silent
+    static void copySilence(OpiBusChannels * dst, uint32_t dstChannels,
+        OpiBusChannels * src, uint32_t srcChannels)
+    {
+        if(dstChannels == srcChannels)
+        {
+            for(uint32_t w = 0; w < opiSilenceWords(dstChannels); ++w)
+                *opiSilenceWord(dst, dstChannels, w) = *opiSilenceWord(src, srcChannels, w);
+            return;
+        }
+        for(uint32_t c = 0; c < dstChannels; ++c)
+            opiSetSilent(dst, dstChannels, c, opiIsSilent(src, srcChannels, c));
+    }
+
+    // sum the outputs of all predecessors into the node's own input
+    void mixInputs(Node & n)
+    {
+        if(n.preds.empty()) return;
+
+        OpiBusChannels * in = n.input.bus();
+        if(n.aliasInput)
+        {
+            Node & pred = *nodes[n.preds[0]];
+            copySilence(in, n.silenceChannels, pred.output.bus(), pred.silenceChannels);
+            return;
+        }
+
+        const int32_t * edgeLine = compensation->edgeLine.data() + n.firstEdge;
+
+        for(uint32_t c = 0; c < n.nChannels; ++c)
+        {
+            bool first = true;
+            for(uint32_t j = 0; j < n.preds.size(); ++j)
+            {
+                Node & pred = *nodes[n.preds[j]];
+                if(c >= pred.nChannels) continue;
+
+                bool silentIn = opiIsSilent(pred.output.bus(), pred.silenceChannels, c);
+
+                if(edgeLine[j] >= 0)
+                {
+                    if(delayChannel(compensation->lines[edgeLine[j]], c,
+                        silentIn ? 0 : pred.output.channel(c), in->channels[c], first))
+                        first = false;
+                    continue;
+                }
+                if(silentIn) continue;
+
+                if(first) opiDspCopy(in->channels[c], pred.output.channel(c), nFrames);
+                else opiDspMix(in->channels[c], pred.output.channel(c), 1.f, nFrames);
+                first = false;
+            }
+            if(first) opiDspClear(in->channels[c], nFrames);
+            opiSetSilent(in, n.silenceChannels, c, first);
+        }
+
+        for(uint32_t j = 0; j < n.preds.size(); ++j)
+        {
+            if(edgeLine[j] < 0) continue;
+            DelayLine & line = compensation->lines[edgeLine[j]];
+            line.pos = (line.pos + nFrames) % line.length;
+        }
+    }
+
+    // decides whether the node needs processing this block, putting it to
+    // sleep or waking it up as needed
+    bool updateSleep(Node & n)
+    {
+        bool idle = allowSleep && !n.procInfo.nInEvents
+            && opiAllSilent(n.input.bus(), n.silenceChannels, 0, n.nChannels);
+
+        if(!idle)
+        {
+            n.silentFrames = 0;
+            n.sleeping = false;
+            return true;
+        }
+        if(n.sleeping) return false;
+
+        // the tail may depend on parameters, so ask every time we go silent
+        if(!n.silentFrames)
+        {
+            uint32_t tail;
+            if(!n.inst->dispatch(opiPlugGetTailFrames, 0, &tail)) tail = opiTailInfinite;
+            n.tailFrames = tail;
+        }
+
+        if(n.tailFrames != opiTailInfinite && n.silentFrames >= n.tailFrames)
+        {
+            // clear once, then the buffers stay untouched until we wake up
+            for(uint32_t c = 0; c < n.nChannels; ++c) n.output.clear(c, maxFrames);
+            opiSetAllSilent(n.output.bus(), n.silenceChannels, true);
+            n.sleeping = true;
+            return false;
+        }
+
+        if(n.silentFrames < opiTailInfinite - nFrames) n.silentFrames += nFrames;
+        return true;
+    }
+
+    // gathers the members' inputs, processes the batch on its first node and
+    // scatters the outputs back
+    void runBatch(Batch & b)
+    {
+        uint32_t count = (uint32_t) b.members.size();
+        uint32_t nChannels = nodes[b.members[0]]->nChannels;
+        uint32_t silenceChannels = nodes[b.members[0]]->silenceChannels;
+
+        bool any = false;
+        for(uint32_t k = 0; k < count; ++k)
+        {
+            Node & n = *nodes[b.members[k]];
+            mixInputs(n);
+            b.awake[k] = updateSleep(n);
+            any = any || b.awake[k];
+        }
+        if(!any)
+        {
+            // the next batch may still be awake and reads this directly
+            if(b.toBatch && !b.outputCleared)
+            {
+                for(uint32_t c = 0; c < nChannels; ++c) b.output.clear(c, maxFrames * count);
+                opiSetAllSilent(b.output.bus(), silenceChannels, true);
+                b.outputCleared = true;
+            }
+            return;
+        }
+        b.outputCleared = false;
+
+        // a channel of the batch is silent where it is for every member
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            bool silent = true;
+            for(uint32_t k = 0; k < count && silent; ++k)
+                silent = opiIsSilent(nodes[b.members[k]]->input.bus(), silenceChannels, c);
+            opiSetSilent(b.input.bus(), silenceChannels, c, silent);
+            if(b.fromBatch) continue;
+
+            float * dst = b.input.channel(c);
+            if(silent)
+            {
+                opiDspClear(dst, nFrames * count);
+                continue;
+            }
+            for(uint32_t k = 0; k < count; ++k)
+            {
+                const float * src = nodes[b.members[k]]->input.channel(c);
+                for(uint32_t i = 0; i < nFrames; ++i) dst[i * count + k] = src[i];
+            }
+        }
+        opiSetAllSilent(b.output.bus(), silenceChannels, false);
+
+        b.info.nFrames = nFrames;
+        for(uint32_t k = 0; k < count; ++k)
+        {
+            nodes[b.members[k]]->procInfo.nFrames = nFrames;
+            ++nodes[b.members[k]]->processCalls;
+        }
+        nodes[b.members[0]]->inst->processBatch(&b.info);
+
+        // sleeping members get written too, but only ever with silence
+        for(uint32_t c = 0; c < nChannels && !b.toBatch; ++c)
+        {
+            const float * src = b.output.channel(c);
+            for(uint32_t k = 0; k < count; ++k)
+            {
+                float * dst = nodes[b.members[k]]->output.channel(c);
+                for(uint32_t i = 0; i < nFrames; ++i) dst[i] = src[i * count + k];
+            }
+        }
+        for(uint32_t k = 0; k < count; ++k)
+        {
+            Node & n = *nodes[b.members[k]];
+            if(b.awake[k]) copySilence(n.output.bus(), silenceChannels, b.output.bus(), silenceChannels);
+            else opiSetAllSilent(n.output.bus(), silenceChannels, true);
+        }
+    }
+
+    // this block is done for the node: let its successors go
+    void finishNode(Node & n, OpiWorkerContext & wc)
+    {
+        n.procInfo.inEvents = 0;
+        n.procInfo.nInEvents = 0;
+
+        for(uint32_t s : n.succs)
+        {
+            uint32_t target = nodes[s]->leader;
+            if(nodes[target]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                wc.spawn(target);
+        }
+    }
+
+    static void runNode(void * ctx, uint32_t idx, OpiWorkerContext & wc)
+    {
+        OpiGraph * graph = (OpiGraph*) ctx;
+        Node & n = *graph->nodes[idx];
+
+        // nobody else touches this until our predecessors run next block
+        n.pending.store(n.waitFor, std::memory_order_relaxed);
+
+        if(n.batch >= 0)
+        {
+            Batch & b = *graph->batches[n.batch];
+            graph->runBatch(b);
+            for(uint32_t m : b.members) graph->finishNode(*graph->nodes[m], wc);
+            return;
+        }
+
+        graph->mixInputs(n);
+
+        if(graph->updateSleep(n))
+        {
+            opiSetAllSilent(n.output.bus(), n.silenceChannels, false);
+            n.procInfo.nFrames = graph->nFrames;
+            n.inst->process(&n.procInfo);
+            ++n.processCalls;
+        }
+        graph->finishNode(n, wc);
+    }
+};
@@ -0,0 +1,609 @@
+/*
+/// # Community Plugin Format Reference Host
+///
+/// ## About
+/// Minimal host-side support for loading and driving plugins through the
+/// Community.h API. This is what the benchmark harness (OpiBench.cpp) uses and
+/// is meant to double as an example for host authors.
+///
+/// ## Usage
+/// - OpiHostLibrary loads a plugin binary and resolves OpiPluginEntrypoint
+///   (and OpiPluginDescriptor, if the plugin has one)
+/// - OpiHostInstance owns one plugin instance and answers dispatchToHost;
+///   process() and friends use the plugin's OpiPluginFuncs when it has them
+/// - OpiHostBus owns the channel buffers for one bus
+/// - OpiHostStrings holds parameter strings packed like OpiParamStrings, as
+///   filled by OpiHostInstance::valuesToStrings
+///
+/// Instances given an OpiWorkerPool answer opiHostRunTasks on it, and those
+/// given an OpiProfileTrack (see CommunityProfile.h) time every process call
+/// and answer opiHostGetProfiler with it.
+///
+/// Every instance gets an OpiHostArena of the size the plugin asks for in
+/// opiPlugConfig, emptied by dispatch() before opiPlugEnable and opiPlugReset,
+/// and a scratch buffer for opiHostGetScratch.
+///
+/// The host is expected to call idle() regularly off the audio thread, which
+/// is where plugins send the opiHostParamValue notifications they queue in
+/// opiPlugProcess (OpiGraph::idle() does it for a whole graph).
+*/
+
+#pragma once
+
+#include "Community.h"
+#include "CommunityDsp.h"
+#include "CommunityParams.h"
+#include "CommunityPool.h"
+#include "CommunityProfile.h"
+
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <dlfcn.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+/*
+ * ==============================================================
+ *
+ *                          LIBRARY
+ *
+ * ===============================================================
+ */
+
+struct OpiHostLibrary
+{
+    void *          handle = 0;
+    OpiEntrypoint   entrypoint = 0;
+    OpiDescriptorFunc   descriptor = 0;     // optional
+
+    OpiHostLibrary() {}
+    OpiHostLibrary(const OpiHostLibrary &) = delete;
+    OpiHostLibrary & operator=(const OpiHostLibrary &) = delete;
+
+    ~OpiHostLibrary() { close(); }
+
+    bool open(const char * path)
+    {
+        close();
+#ifdef _WIN32
+        handle = (void*) LoadLibraryA(path);
+        if(!handle) return false;
+        entrypoint = (OpiEntrypoint)
+            GetProcAddress((HMODULE) handle, "OpiPluginEntrypoint");
+        descriptor = (OpiDescriptorFunc)
+            GetProcAddress((HMODULE) handle, "OpiPluginDescriptor");
+#else
+        handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        if(!handle) return false;
+        entrypoint = (OpiEntrypoint) dlsym(handle, "OpiPluginEntrypoint");
+        descriptor = (OpiDescriptorFunc) dlsym(handle, "OpiPluginDescriptor");
+#endif
+        if(!entrypoint) { close(); return false; }
+        return true;
+    }
+
+    void close()
+    {
+        if(!handle) return;
+#ifdef _WIN32
+        FreeLibrary((HMODULE) handle);
+#else
+        dlclose(handle);
+#endif
+        handle = 0;
+        entrypoint = 0;
+        descriptor = 0;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          ARENA
+ *
+ * ===============================================================
+ */
+
+// The memory behind opiHostGetArena for one instance. It is mapped straight
+// from the system (on huge pages if it's large enough and the system has them
+// reserved, otherwise asking for transparent ones) and faulted in when it is
+// allocated, so the plugin never takes a page fault on it. With a NUMA node
+// given the pages are bound there, otherwise they land wherever the thread
+// calling allocate() runs.
+struct OpiHostArena : public OpiArena
+{
+    static const uint64_t   hugePage = 2 << 20;
+
+    char *      base = 0;
+    uint64_t    mapped = 0;         // bytes, capacity rounded up to pages
+    bool        hugePages = false;  // mapped with MAP_HUGETLB
+
+    OpiHostArena()
+    {
+        arenaSize = sizeof(OpiArena);
+        capacity = 0;
+        used = 0;
+        alloc = &allocFunc;
+    }
+    OpiHostArena(const OpiHostArena &) = delete;
+    OpiHostArena & operator=(const OpiHostArena &) = delete;
+
+    ~OpiHostArena() { release(); }
+
+    // not [RT]: room for size bytes, reusing the current mapping if it's big
+    // enough; numaNode < 0 leaves the placement to first touch
+    bool allocate(uint64_t size, int32_t numaNode = -1)
+    {
+        used = 0;
+        if(base && size && size <= mapped) { capacity = size; return true; }
+        release();
+        if(!size) return true;
+
+#ifdef _WIN32
+        (void) numaNode;
+        uint64_t length = (size + 4095) & ~(uint64_t) 4095;
+        void * ptr = VirtualAlloc(0, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if(!ptr) return false;
+#else
+        uint64_t length = (size + 4095) & ~(uint64_t) 4095;
+        void * ptr = MAP_FAILED;
+# ifdef MAP_HUGETLB
+        if(size >= hugePage)
+        {
+            uint64_t hugeLength = (size + hugePage - 1) & ~(hugePage - 1);
+            ptr = mmap(0, hugeLength, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if(ptr != MAP_FAILED) { length = hugeLength; hugePages = true; }
+        }
+# endif
+        if(ptr == MAP_FAILED)
+        {
+            ptr = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(ptr == MAP_FAILED) return false;
+# ifdef MADV_HUGEPAGE
+            if(length >= hugePage) madvise(ptr, length, MADV_HUGEPAGE);
+# endif
+        }
+# if defined(__linux__) && defined(SYS_mbind)
+        // MPOL_PREFERRED, without needing libnuma; it's only a hint anyway
+        if(numaNode >= 0 && numaNode < 64)
+        {
+            unsigned long nodeMask = 1ul << numaNode;
+            syscall(SYS_mbind, ptr, length, 1, &nodeMask, 64, 0);
+        }
+# else
+        (void) numaNode;
+# endif
+#endif
+        // fault it all in now rather than in the audio thread
+        memset(ptr, 0, length);
+
+        base = (char*) ptr;
+        mapped = length;
+        capacity = size;
+        return true;
+    }
+
+    void release()
+    {
+        if(base)
+        {
+#ifdef _WIN32
+            VirtualFree(base, 0, MEM_RELEASE);
+#else
+            munmap(base, mapped);
+#endif
+        }
+        base = 0;
+        mapped = 0;
+        capacity = 0;
+        used = 0;
+        hugePages = false;
+    }
+
+    // [RT] forget everything handed out
+    void reset() { used = 0; }
+
+    static void * allocFunc(OpiArena * ptr, uint64_t size, uint32_t align)
+    {
+        OpiHostArena * arena = static_cast<OpiHostArena*>(ptr);
+        if(!align || (align & (align - 1)) || align > 4096) return 0;
+
+        uint64_t at = (arena->used + align - 1) & ~(uint64_t) (align - 1);
+        if(at > arena->capacity || size > arena->capacity - at) return 0;
+        arena->used = at + size;
+        return arena->base + at;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          INSTANCE
+ *
+ * ===============================================================
+ */
+
+// Strings for a run of parameter values, packed like OpiParamStrings: string
+// i is get(i), size(i) bytes plus a NUL. data is grown as needed and kept.
+struct OpiHostStrings
+{
+    std::vector<char>       data;
+    std::vector<uint32_t>   offsets = std::vector<uint32_t>(1, 0);
+
+    uint32_t count() const { return (uint32_t) offsets.size() - 1; }
+    const char * get(uint32_t i) const { return data.data() + offsets[i]; }
+    uint32_t size(uint32_t i) const { return offsets[i + 1] - offsets[i] - 1; }
+};
+
+// One plugin instance plus whatever state the host keeps for it.
+// The plugin receives a pointer to this struct as its ptrHost.
+struct OpiHostInstance
+{
+    OpiPlugin * plug = 0;
+
+    // state reported by the plugin through dispatchToHost
+    uint32_t    latency = 0;        // as of create() or refreshLatency()
+    std::atomic<bool>   latencyChanged { false };   // opiHostSetLatency, any thread
+    bool        patchChanged = false;
+    OpiEditSize editSize = { 0, 0 };
+    std::atomic<uint32_t>   paramValues { 0 };  // opiHostParamValue calls so far
+
+    OpiWorkerPool * pool = 0;   // for opiHostRunTasks, 0 = not supported
+    OpiProfileTrack * profile = 0;  // set before configure(), 0 = not profiled
+
+    OpiHostArena    arena;          // sized by configure()
+    bool        useArena = true;    // set before configure(), false = no opiHostGetArena
+    int32_t     numaNode = -1;      // for the arena, if the host pins the instance
+
+    std::vector<char>   scratch;    // for opiHostGetScratch
+
+    uint32_t    maxFrames = 0;  // blocksize accepted by the last configure()
+
+    // channels per group for each side, used with opiConfigInterleaved: set
+    // before configure(), which leaves what the plugin accepted (1 = planar)
+    uint32_t    inInterleave = 1;
+    uint32_t    outInterleave = 1;
+
+    // direct entry points, zero for anything the plugin doesn't provide
+    OpiPluginFuncs  funcs;
+
+    OpiHostInstance() { memset(&funcs, 0, sizeof(funcs)); }
+    OpiHostInstance(const OpiHostInstance &) = delete;
+    OpiHostInstance & operator=(const OpiHostInstance &) = delete;
+
+    ~OpiHostInstance() { destroy(); }
+
+    bool create(OpiEntrypoint entrypoint)
+    {
+        destroy();
+        return adopt(entrypoint(&hostDispatcher, this));
+    }
+
+    // takes over a plugin that was created some other way, but still with
+    // hostDispatcher and this (eg. OpiBridgeHost::instantiate)
+    bool adopt(OpiPlugin * plugin)
+    {
+        destroy();
+        plug = plugin;
+        if(!plug) return false;
+        latency = (uint32_t) dispatch(opiPlugGetLatency);
+        loadFuncs();
+        return true;
+    }
+
+    void destroy()
+    {
+        if(plug) dispatch(opiPlugDestroy);
+        plug = 0;
+        memset(&funcs, 0, sizeof(funcs));
+    }
+
+    intptr_t dispatch(int32_t op, int32_t idx = 0, void * data = 0)
+    {
+        if(op == opiPlugEnable || op == opiPlugReset) arena.reset();
+        return plug->dispatchToPlugin(plug, op, idx, data);
+    }
+
+    // not [RT]: opiPlugIdle, where the plugin sends what it queued on the
+    // audio thread (eg. opiHostParamValue); call it regularly while
+    // processing, from the UI thread or any other that isn't the audio one
+    void idle() { dispatch(opiPlugIdle); }
+
+    // not [RT]: query the latency again if the plugin asked for it (or if
+    // forced), returns true if it changed
+    bool refreshLatency(bool force = false)
+    {
+        if(!latencyChanged.exchange(false) && !force) return false;
+        uint32_t frames = (uint32_t) dispatch(opiPlugGetLatency);
+        if(frames == latency) return false;
+        latency = frames;
+        return true;
+    }
+
+    // copy whatever part of the table the plugin provides, the rest stays 0
+    void loadFuncs()
+    {
+        memset(&funcs, 0, sizeof(funcs));
+        const OpiPluginFuncs * table = (const OpiPluginFuncs*) dispatch(opiPlugGetFuncs);
+        if(!table || table->funcsSize <= sizeof(uint32_t)) return;
+
+        size_t size = table->funcsSize < sizeof(funcs) ? table->funcsSize : sizeof(funcs);
+        memcpy(&funcs, table, size);
+        funcs.funcsSize = sizeof(funcs);
+    }
+
+    void process(OpiProcessInfo * procInfo)
+    {
+        if(profile && profile->isRecording())
+        {
+            uint64_t t0 = opiProfileTicks();
+            processDirect(procInfo);
+            profile->record("process", t0, opiProfileTicks(), procInfo->nFrames, 0);
+        }
+        else processDirect(procInfo);
+    }
+
+    void processDirect(OpiProcessInfo * procInfo)
+    {
+        if(funcs.process) funcs.process(plug, procInfo);
+        else dispatch(opiPlugProcess, 0, procInfo);
+    }
+
+    // batch->plugins must include this instance, see opiPlugProcessBatch;
+    // the time of the whole batch is recorded on this instance's profile
+    void processBatch(OpiBatchInfo * batch)
+    {
+        uint64_t t0 = profile && profile->isRecording() ? opiProfileTicks() : 0;
+
+        if(funcs.processBatch) funcs.processBatch(plug, batch);
+        else dispatch(opiPlugProcessBatch, 0, batch);
+
+        if(t0) profile->record("processBatch", t0, opiProfileTicks(), batch->nFrames, 0);
+    }
+
+    bool getParam(uint32_t idx, float & value)
+    {
+        if(funcs.getParam) return funcs.getParam(plug, idx, &value) != 0;
+        return dispatch(opiPlugGetParam, (int32_t) idx, &value) != 0;
+    }
+
+    bool setParam(uint32_t idx, float value)
+    {
+        if(funcs.setParam) return funcs.setParam(plug, idx, value) != 0;
+        return dispatch(opiPlugSetParam, (int32_t) idx, &value) != 0;
+    }
+
+    // [UI] strings for count values of parameter idx into out: formatted here
+    // if the plugin has an OpiParamFormat for it, else with opiPlugValuesToStrings,
+    // else one opiPlugValueToString at a time
+    void valuesToStrings(uint32_t idx, const float * values, uint32_t count, OpiHostStrings & out)
+    {
+        const OpiParamFormat * format =
+            (const OpiParamFormat*) dispatch(opiPlugGetParamFormat, (int32_t) idx);
+        if(format && format->formatSize < sizeof(OpiParamFormat)) format = 0;
+
+        out.offsets.resize(count + 1);
+        out.offsets[0] = 0;
+        if(out.data.size() < 16 * (size_t) count) out.data.resize(16 * (size_t) count);
+
+        bool bulk = true;
+        uint32_t done = 0;
+        while(done < count)
+        {
+            OpiParamStrings strings;
+            strings.paramStringsSize = sizeof(OpiParamStrings);
+            strings.count = count - done;
+            strings.values = const_cast<float*>(values + done);
+            strings.data = out.data.data();
+            strings.dataSize = (uint32_t) out.data.size();
+            strings.offsets = out.offsets.data() + done;
+
+            uint32_t n = format ? opiFormatValues(*format, &strings)
+                : bulk ? (uint32_t) dispatch(opiPlugValuesToStrings, (int32_t) idx, &strings) : 0;
+            if(n)
+            {
+                done += n;
+                continue;
+            }
+
+            // nothing fit, unless the plugin can't do it in bulk at all
+            uint32_t at = out.offsets[done];
+            if(format || (bulk && out.data.size() - at < 256))
+            {
+                out.data.resize(2 * out.data.size() + 256);
+                continue;
+            }
+            bulk = false;
+
+            OpiParamString str = { 0, 0, values[done] };
+            if(!dispatch(opiPlugValueToString, (int32_t) idx, &str)) str.size = 0;
+            if(out.data.size() < (size_t) at + str.size + 1)
+                out.data.resize(2 * ((size_t) at + str.size + 1));
+            if(str.size) memcpy(out.data.data() + at, str.data, str.size);
+            out.data[at + str.size] = 0;
+            out.offsets[++done] = at + str.size + 1;
+        }
+    }
+
+    // opiPlugConfig for a single input and output bus (0 channels = no bus);
+    // the plugin may lower the block size, check maxFrames afterwards
+    bool configure(uint32_t blockSize, float samplerate,
+        uint32_t nIn, uint32_t nOut, uint32_t flags = 0)
+    {
+        bool interleaved = (flags & opiConfigInterleaved) != 0;
+        OpiBusConfig inBus = { nIn, interleaved ? inInterleave : 1 };
+        OpiBusConfig outBus = { nOut, interleaved ? outInterleave : 1 };
+
+        OpiConfig config;
+        memset(&config, 0, sizeof(config));
+        config.configSize = sizeof(OpiConfig);
+        config.blocksize = blockSize;
+        config.samplerate = samplerate;
+        config.busConfigSize = sizeof(OpiBusConfig);
+        config.inBusChannels = &inBus;
+        config.outBusChannels = &outBus;
+        config.flags = flags;
+
+        maxFrames = 0;
+        if(!dispatch(opiPlugConfig, 0, &config)) return false;
+        maxFrames = config.blocksize < blockSize ? config.blocksize : blockSize;
+
+        // it may only have gone back to planar
+        uint32_t inAccepted = inBus.interleave > 1 ? inBus.interleave : 1;
+        uint32_t outAccepted = outBus.interleave > 1 ? outBus.interleave : 1;
+        if((inAccepted > 1 && (!interleaved || inAccepted != inInterleave))
+            || (outAccepted > 1 && (!interleaved || outAccepted != outInterleave)))
+            maxFrames = 0;
+        inInterleave = inAccepted;
+        outInterleave = outAccepted;
+
+        // if this fails the plugin just doesn't get an arena
+        if(!useArena || !arena.allocate(config.arenaSize, numaNode)) arena.release();
+        return maxFrames != 0;
+    }
+
+    static intptr_t hostDispatcher(
+        struct OpiPlugin * plug, int32_t op, int32_t idx, void * data)
+    {
+        OpiHostInstance * host = (OpiHostInstance*) plug->ptrHost;
+
+        switch(op)
+        {
+        case opiHostParamState: return 1;   // nothing to record into
+        case opiHostParamValue:     // only counted
+            host->paramValues.fetch_add(1, std::memory_order_relaxed);
+            return 1;
+
+        case opiHostPatchChange: host->patchChanged = true; return 1;
+        case opiHostResizeEdit:
+            host->editSize = *((OpiEditSize*)data);
+            return 1;
+
+        case opiHostSetLatency:
+            // only flag it here, the plugin might call this from any thread
+            host->latencyChanged = true;
+            return 1;
+
+        case opiHostNumWorkers:
+            return host->pool ? host->pool->numThreads() : 0;
+
+        case opiHostRunTasks:
+            {
+                OpiTaskList * tasks = (OpiTaskList*) data;
+                if(!host->pool) return 0;
+                host->pool->run(&runTask, tasks, tasks->nTasks, 0, tasks->nTasks);
+                return 1;
+            }
+
+        case opiHostGetProfiler:
+            return (intptr_t) static_cast<OpiProfiler*>(host->profile);
+
+        case opiHostGetArena:
+            if(!host->arena.capacity) return 0;
+            return (intptr_t) static_cast<OpiArena*>(&host->arena);
+
+        case opiHostGetScratch:
+            {
+                OpiString * str = (OpiString*) data;
+                host->scratch.resize(str->size ? str->size : 1);
+                str->data = host->scratch.data();
+                return 1;
+            }
+
+        default: return 0;
+        }
+    }
+
+    static void runTask(void * ctx, uint32_t task, OpiWorkerContext &)
+    {
+        OpiTaskList * tasks = (OpiTaskList*) ctx;
+        tasks->run(tasks->ctx, task);
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          BUFFERS
+ *
+ * ===============================================================
+ */
+
+// Channel buffers for a single bus. OpiBusChannels ends in a flexible array so
+// the header and the channel pointers live in one allocation.
+//
+// FIXME: because of the flexible array, OpiProcessInfo::inputs can only really
+// point at a single bus; hosts can't build a proper array of several.
+//
+// Past 64 channels the storage always has the silence words of
+// opiConfigWideSilence, all clear, so the bus works either way.
+struct OpiHostBus
+{
+    std::vector<float>  samples;
+    std::vector<char>   storage;
+
+    uint32_t    nChannels = 0;
+    uint32_t    maxFrames = 0;
+    uint32_t    interleave = 1;     // channels per group, see OpiBusConfig
+
+    void allocate(uint32_t channels, uint32_t frames, uint32_t groupSize = 1)
+    {
+        nChannels = channels;
+        maxFrames = frames;
+        interleave = groupSize > 1 ? groupSize : 1;
+
+        // the last group is padded to the full width
+        uint32_t nGroups = (channels + interleave - 1) / interleave;
+        samples.assign((size_t) nGroups * interleave * frames, 0.f);
+        storage.assign(opiBusChannelsSize(channels), 0);
+
+        for(uint32_t c = 0; c < channels; ++c)
+        {
+            size_t group = (size_t) (c / interleave) * interleave * frames;
+            bus()->channels[c] = samples.data() + group + c % interleave;
+        }
+    }
+
+    // point this bus at the buffers of another one, for in-place processing
+    void alias(OpiHostBus & other)
+    {
+        nChannels = other.nChannels;
+        maxFrames = other.maxFrames;
+        interleave = other.interleave;
+
+        samples.clear();
+        storage.assign(opiBusChannelsSize(nChannels), 0);
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+            bus()->channels[c] = other.channel(c);
+    }
+
+    OpiBusChannels * bus() { return (OpiBusChannels*) storage.data(); }
+    float * channel(uint32_t c) { return bus()->channels[c]; }
+
+    // sample i of channel c, whatever the layout
+    float & sample(uint32_t c, uint32_t i) { return channel(c)[(size_t) i * interleave]; }
+
+    void clear(uint32_t c, uint32_t nFrames)
+    {
+        if(interleave == 1) memset(channel(c), 0, nFrames * sizeof(float));
+        else for(uint32_t i = 0; i < nFrames; ++i) sample(c, i) = 0;
+    }
+
+    // the channel's silence bit, including those past silenceMask
+    bool silent(uint32_t c) { return opiIsSilent(bus(), nChannels, c); }
+    void setSilent(uint32_t c, bool silent) { opiSetSilent(bus(), nChannels, c, silent); }
+    void setAllSilent(bool silent) { opiSetAllSilent(bus(), nChannels, silent); }
+};
@@ -0,0 +1,465 @@
+/*
+/// # Community Plugin Format Parameter Exchange
+///
+/// ## About
+/// Lock-free plumbing between the threads that touch parameters:
+/// - OpiParamStore: values set by [ANY]/[UI] calls and read by [RT], plus
+///   change tracking for opiPlugGetParamChanges
+/// - OpiSpscRing: bounded single-producer single-consumer queue
+/// - OpiParamNotifier: opiHostParamValue notifications queued from [RT]
+/// - opiFormatValue and friends: strings for an OpiParamFormat, which both
+///   plugins (for opiPlugValue(s)ToString) and hosts (instead of asking the
+///   plugin) use, so the two always agree
+///
+/// ## Details
+/// All operations are wait-free; nothing allocates after init().
+///
+/// opiPlugSetParam may be called concurrently from several threads, so the
+/// store does not queue individual writes: the latest value wins and a dirty
+/// bit per parameter tells the [RT] side what changed. The plugin calls
+/// consume() once at the start of opiPlugProcess, so changes become visible
+/// at block boundaries, before any of the block's automation events (which
+/// therefore take precedence within the block).
+///
+/// For opiPlugGetParamChanges every change is stamped with the current
+/// generation, per parameter and per group of 64, and each query starts a new
+/// generation; a query only scans the groups stamped since its token.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    opiPlugSetParam:    params.set(idx, value);
+///    opiPlugGetParam:    value = params.get(idx);
+///    opiPlugProcess:     params.consume([&](uint32_t idx, float v) { ... });
+///                        ... process ...
+///                        params.publish(idx, automatedValue);
+///    opiPlugIdle:        notifier.flush(plug);
+///    opiPlugGetParamChanges: params.changes((OpiParamChanges*) data);
+///    opiPlugValuesToStrings: return opiFormatValues(format, (OpiParamStrings*) data);
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#pragma once
+
+#include "Community.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+# include <intrin.h>
+#endif
+
+static inline uint32_t opiCountTrailingZeros(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (uint32_t) i;
+#else
+    return (uint32_t) __builtin_ctzll(x);
+#endif
+}
+
+/*
+ * ==============================================================
+ *
+ *                          STORE
+ *
+ * ===============================================================
+ */
+
+struct OpiParamStore
+{
+    std::unique_ptr<std::atomic<float>[]>       values;
+    std::unique_ptr<std::atomic<uint64_t>[]>    dirty;  // one bit per parameter
+
+    std::vector<float>  seen;   // [RT] only: value last consumed or published
+
+    // generation each parameter (and each group of 64) last changed in
+    std::unique_ptr<std::atomic<uint32_t>[]>    changedAt;
+    std::unique_ptr<std::atomic<uint32_t>[]>    wordChangedAt;
+    std::atomic<uint32_t>                       generation { 1 };
+
+    uint32_t    nParams = 0;
+    uint32_t    nWords = 0;
+
+    // must be called before any other thread can touch the store
+    void init(uint32_t n, const float * defaults = 0)
+    {
+        nParams = n;
+        nWords = (n + 63) / 64;
+
+        values.reset(new std::atomic<float>[n]);
+        dirty.reset(new std::atomic<uint64_t>[nWords]);
+        seen.assign(n, 0.f);
+        changedAt.reset(new std::atomic<uint32_t>[n]);
+        wordChangedAt.reset(new std::atomic<uint32_t>[nWords]);
+        generation.store(1, std::memory_order_relaxed);
+
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            seen[i] = defaults ? defaults[i] : 0.f;
+            values[i].store(seen[i], std::memory_order_relaxed);
+            changedAt[i].store(0, std::memory_order_relaxed);
+        }
+        for(uint32_t w = 0; w < nWords; ++w)
+        {
+            dirty[w].store(0, std::memory_order_relaxed);
+            wordChangedAt[w].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // [ANY]
+    void set(uint32_t idx, float value)
+    {
+        if(idx >= nParams) return;
+        values[idx].store(value, std::memory_order_relaxed);
+        dirty[idx >> 6].fetch_or(uint64_t(1) << (idx & 63), std::memory_order_release);
+        stamp(idx);
+    }
+
+    // [ANY] set count parameters starting at first (eg. for opiPlugSetParams),
+    // with one dirty and stamp update per group of 64 instead of per parameter
+    void set(uint32_t first, uint32_t count, const float * v)
+    {
+        if(first > nParams || count > nParams - first) return;
+
+        for(uint32_t i = 0; i < count;)
+        {
+            uint32_t idx = first + i, bit = idx & 63;
+            uint32_t n = count - i < 64 - bit ? count - i : 64 - bit;
+
+            for(uint32_t k = 0; k < n; ++k)
+                values[idx + k].store(v[i + k], std::memory_order_relaxed);
+
+            uint64_t mask = (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1) << bit;
+            dirty[idx >> 6].fetch_or(mask, std::memory_order_release);
+            stamp(idx, n);
+            i += n;
+        }
+    }
+
+    // [ANY]
+    float get(uint32_t idx) const
+    {
+        return idx < nParams ? values[idx].load(std::memory_order_relaxed) : 0.f;
+    }
+
+    // [ANY] get count parameters starting at first
+    void get(uint32_t first, uint32_t count, float * v) const
+    {
+        if(first > nParams || count > nParams - first) return;
+        for(uint32_t i = 0; i < count; ++i)
+            v[i] = values[first + i].load(std::memory_order_relaxed);
+    }
+
+    // [RT] calls f(idx, value) for every parameter set since the last call
+    template <class F>
+    void consume(F && f)
+    {
+        for(uint32_t w = 0; w < nWords; ++w)
+        {
+            if(!dirty[w].load(std::memory_order_relaxed)) continue;
+
+            uint64_t bits = dirty[w].exchange(0, std::memory_order_acquire);
+            while(bits)
+            {
+                uint32_t idx = w * 64 + opiCountTrailingZeros(bits);
+                bits &= bits - 1;
+
+                float value = values[idx].load(std::memory_order_relaxed);
+                seen[idx] = value;
+                f(idx, value);
+            }
+        }
+    }
+
+    // [RT] make a value changed by the plugin itself (eg. automation) visible
+    // to get(); if a set() raced with this the set() wins and is consumed
+    // on the next block
+    void publish(uint32_t idx, float value)
+    {
+        if(idx >= nParams || seen[idx] == value) return;
+
+        float expected = seen[idx];
+        if(values[idx].compare_exchange_strong(expected, value,
+            std::memory_order_relaxed))
+        {
+            seen[idx] = value;
+            stamp(idx);
+        }
+    }
+
+    // [ANY] fill in OpiParamChanges, returns false if the range is invalid
+    bool changes(OpiParamChanges * c)
+    {
+        if((c->first & 63) || c->first > nParams || c->count > nParams - c->first)
+            return false;
+
+        uint32_t since = c->generation;
+        c->generation = generation.fetch_add(1) + 1;
+
+        uint32_t nOut = (c->count + 63) / 64;
+        for(uint32_t w = 0; w < nOut; ++w)
+        {
+            uint32_t word = c->first / 64 + w;
+            uint64_t bits = 0;
+
+            if(!since) bits = ~uint64_t(0);
+            else if(newer(wordChangedAt[word].load(), since))
+            {
+                uint32_t n = nParams - word * 64;
+                if(n > 64) n = 64;
+                for(uint32_t i = 0; i < n; ++i)
+                    if(newer(changedAt[word * 64 + i].load(), since))
+                        bits |= uint64_t(1) << i;
+            }
+
+            uint32_t left = c->count - w * 64;
+            if(left < 64) bits &= (uint64_t(1) << left) - 1;
+            c->bits[w] = bits;
+        }
+        return true;
+    }
+
+private:
+    static bool newer(uint32_t stamp, uint32_t since)
+    {
+        return (int32_t) (stamp - since) >= 0;
+    }
+
+    static void raise(std::atomic<uint32_t> & stamp, uint32_t g)
+    {
+        uint32_t old = stamp.load();
+        while((int32_t) (g - old) > 0 && !stamp.compare_exchange_weak(old, g)) {}
+    }
+
+    // Stamps a change of n parameters (within one group of 64) with the current
+    // generation. If a query starts a new generation meanwhile, stamp again:
+    // either that query sees the stamp or it ends up at least as new as the
+    // token the query hands out.
+    void stamp(uint32_t idx, uint32_t n = 1)
+    {
+        uint32_t g = generation.load();
+        for(;;)
+        {
+            for(uint32_t k = 0; k < n; ++k) raise(changedAt[idx + k], g);
+            raise(wordChangedAt[idx >> 6], g);
+
+            uint32_t now = generation.load();
+            if(now == g) return;
+            g = now;
+        }
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          RING
+ *
+ * ===============================================================
+ */
+
+// Bounded queue for exactly one producer and one consumer thread.
+template <class T>
+struct OpiSpscRing
+{
+    std::vector<T>          slots;
+    uint32_t                mask = 0;
+
+    // head and tail on separate cache lines, so the two sides don't fight
+    alignas(64) std::atomic<uint32_t>   head { 0 };    // written by producer
+    alignas(64) std::atomic<uint32_t>   tail { 0 };    // written by consumer
+
+    // capacity is rounded up to a power of two; not thread-safe
+    void init(uint32_t capacity)
+    {
+        uint32_t size = 1;
+        while(size < capacity) size <<= 1;
+        slots.assign(size, T());
+        mask = size - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    // producer: returns false if the ring is full
+    bool push(const T & item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if(h - tail.load(std::memory_order_acquire) > mask) return false;
+        slots[h & mask] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer: returns false if the ring is empty
+    bool pop(T & item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire)) return false;
+        item = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          NOTIFIER
+ *
+ * ===============================================================
+ */
+
+// Parameter changes the plugin wants to report with opiHostParamValue, pushed
+// from [RT] and delivered to the host from the next opiPlugIdle call.
+struct OpiParamNotifier
+{
+    struct Change
+    {
+        uint32_t    idx;
+        float       value;
+    };
+
+    OpiSpscRing<Change>     ring;
+    std::atomic<uint32_t>   dropped { 0 };
+
+    void init(uint32_t capacity) { ring.init(capacity); }
+
+    // [RT] if the ring is full the change is dropped; the host will still
+    // see the current value through opiPlugGetParam
+    void push(uint32_t idx, float value)
+    {
+        Change c = { idx, value };
+        if(!ring.push(c)) dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // [UI] returns the number of notifications sent
+    uint32_t flush(OpiPlugin * plug)
+    {
+        uint32_t n = 0;
+        Change c;
+        while(ring.pop(c))
+        {
+            plug->dispatchToHost(plug, opiHostParamValue, c.idx, &c.value);
+            ++n;
+        }
+        return n;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          STRINGS
+ *
+ * ===============================================================
+ */
+
+// Writes the string for value into out (NUL terminated if size > 0) and
+// returns its length, which is size or more if it didn't fit (like snprintf).
+//
+// The digits are done by hand when the scaled number times 10^precision is
+// exact in a double (always, for a float and up to 9 digits) and fits in 64
+// bits; rounding that to an integer in the current mode is what printf does.
+// snprintf is left for the rest and would otherwise be most of the cost.
+static inline uint32_t opiFormatValue(
+    const OpiParamFormat & format, float value, char * out, uint32_t size)
+{
+    static const double powers[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    const char * unit = format.unit ? format.unit : "";
+    double x = (double) (value * format.scale);
+
+    if(format.precision > 9 || !(std::fabs(x) < 1e9))
+    {
+        int n = snprintf(out, size, "%.*f%s%s",
+            (int) format.precision, x, *unit ? " " : "", unit);
+        return n < 0 ? size : (uint32_t) n;
+    }
+
+    // backwards from the last digit
+    char digits[24];
+    char * p = digits + sizeof(digits);
+    uint64_t n = (uint64_t) std::nearbyint(std::fabs(x) * powers[format.precision]);
+    for(uint32_t i = 0; i < format.precision; ++i, n /= 10) *--p = (char) ('0' + n % 10);
+    if(format.precision) *--p = '.';
+    do *--p = (char) ('0' + n % 10); while(n /= 10);
+    if(std::signbit(x)) *--p = '-';
+
+    uint32_t nDigits = (uint32_t) (digits + sizeof(digits) - p);
+    uint32_t unitSize = *unit ? 1 + (uint32_t) strlen(unit) : 0;
+    uint32_t length = nDigits + unitSize;
+    if(!size) return length;
+
+    uint32_t copy = std::min(nDigits, size - 1);
+    memcpy(out, p, copy);
+    if(unitSize && copy < size - 1)
+    {
+        out[copy++] = ' ';
+        uint32_t rest = std::min(unitSize - 1, size - 1 - copy);
+        memcpy(out + copy, unit, rest);
+        copy += rest;
+    }
+    out[copy] = 0;
+    return length;
+}
+
+// Reads a string of size bytes (not necessarily NUL terminated); false if it
+// isn't a number, optionally followed by the unit.
+static inline bool opiParseValue(
+    const OpiParamFormat & format, const char * data, uint32_t size, float & value)
+{
+    char text[64];
+    if(size >= sizeof(text) || !format.scale) return false;
+    memcpy(text, data, size);
+    text[size] = 0;
+
+    char * end = 0;
+    double x = strtod(text, &end);
+    if(end == text) return false;
+
+    while(*end == ' ') ++end;
+    const char * unit = format.unit ? format.unit : "";
+    size_t unitSize = strlen(unit);
+    if(*end && unitSize && !strncmp(end, unit, unitSize)) end += unitSize;
+    while(*end == ' ') ++end;
+    if(*end) return false;
+
+    value = (float) (x / format.scale);
+    return true;
+}
+
+// opiPlugValuesToStrings with format, returns the number of strings written
+static inline uint32_t opiFormatValues(const OpiParamFormat & format, OpiParamStrings * strings)
+{
+    uint32_t at = strings->offsets[0];
+    for(uint32_t i = 0; i < strings->count; ++i)
+    {
+        uint32_t room = at < strings->dataSize ? strings->dataSize - at : 0;
+        uint32_t n = opiFormatValue(format, strings->values[i], strings->data + at, room);
+        if(n >= room) return i;
+
+        at += n + 1;
+        strings->offsets[i + 1] = at;
+    }
+    return strings->count;
+}
+
+// opiPlugStringsToValues with format
+static inline void opiParseValues(const OpiParamFormat & format, OpiParamStrings * strings)
+{
+    for(uint32_t i = 0; i < strings->count; ++i)
+    {
+        uint32_t begin = strings->offsets[i], end = strings->offsets[i + 1];
+        if(end > begin) opiParseValue(format, strings->data + begin,
+            end - begin - 1, strings->values[i]);
+    }
+}
@@ -0,0 +1,376 @@
+/*
+/// # Community Plugin Format Worker Pool
+///
+/// ## About
+/// Fixed pool of realtime worker threads with work-stealing deques, used by
+/// the reference host to run independent plugin instances in parallel.
+///
+/// ## Details
+/// - Work is submitted as a batch: a callback plus a count of items
+/// - Items are pushed to the deque of the thread that creates them and other
+///   threads steal from the opposite end (Chase-Lev)
+/// - Running items may spawn more items of the same batch (eg. successors in
+///   a graph) and batches may be nested (an item may run a batch and join it)
+/// - The thread calling run() works on the batch too and returns only once
+///   every item has finished
+/// - Nothing is allocated once the pool is started
+///
+/// ## Usage
+/// run() from outside the pool must only ever be called from one thread at a
+/// time (typically the host's audio thread), since that thread owns deque 0.
+/// Workers spin for a while when out of work and then go to sleep; waking
+/// them takes a lock, but during continuous processing they never get there.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+# include <immintrin.h>
+# define OPI_POOL_PAUSE() _mm_pause()
+#else
+# define OPI_POOL_PAUSE() std::this_thread::yield()
+#endif
+
+// best effort, fails silently without the required privileges
+static inline void opiSetThreadRealtime()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+/*
+ * ==============================================================
+ *
+ *                          DEQUE
+ *
+ * ===============================================================
+ */
+
+// Chase-Lev work-stealing deque with a fixed capacity. The owner pushes and
+// pops at the bottom, any other thread steals from the top.
+struct OpiWorkDeque
+{
+    std::unique_ptr<std::atomic<uint64_t>[]>    items;
+    int64_t     mask = 0;
+
+    alignas(64) std::atomic<int64_t>    top { 0 };
+    alignas(64) std::atomic<int64_t>    bottom { 0 };
+
+    void init(uint32_t capacity)
+    {
+        uint32_t size = 1;
+        while(size < capacity) size <<= 1;
+        items.reset(new std::atomic<uint64_t>[size]);
+        for(uint32_t i = 0; i < size; ++i) items[i].store(0, std::memory_order_relaxed);
+        mask = size - 1;
+    }
+
+    // owner only: returns false if full
+    bool push(uint64_t item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if(b - t > mask) return false;
+        items[b & mask].store(item, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only
+    bool pop(uint64_t & item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if(t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = items[b & mask].load(std::memory_order_acquire);
+        if(t == b)
+        {
+            // last item: race against the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread
+    bool steal(uint64_t & item)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) return false;
+
+        item = items[t & mask].load(std::memory_order_acquire);
+        return top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          POOL
+ *
+ * ===============================================================
+ */
+
+struct OpiWorkerPool;
+struct OpiWorkerBatch;
+
+// passed to the batch callback, mainly so it can spawn more items
+struct OpiWorkerContext
+{
+    OpiWorkerPool *     pool;
+    OpiWorkerBatch *    batch;
+    uint32_t            worker;     // 0 = the thread that called run()
+
+    inline void spawn(uint32_t item);
+};
+
+struct OpiWorkerBatch
+{
+    void    (*run)(void * ctx, uint32_t item, OpiWorkerContext & wc);
+    void *  ctx;
+
+    // items that still have to finish, including ones not spawned yet
+    std::atomic<uint32_t>   remaining { 0 };
+    uint32_t                slot = 0;
+};
+
+struct OpiWorkerPool
+{
+    // deque entries are (batch slot << 32) | item
+    static const uint32_t   maxBatches = 64;
+
+    std::vector<std::thread>            threads;
+    std::unique_ptr<OpiWorkDeque[]>     deques;     // [0] belongs to run() callers
+    uint32_t                            nDeques = 0;
+
+    std::atomic<OpiWorkerBatch*>    batches[maxBatches];
+
+    std::atomic<bool>       quit { false };
+    std::atomic<uint32_t>   signal { 0 };       // bumped when new work appears
+    std::atomic<uint32_t>   sleepers { 0 };
+    std::mutex              sleepLock;
+    std::condition_variable sleepCond;
+
+    OpiWorkerPool() { for(auto & b : batches) b.store(0, std::memory_order_relaxed); }
+    ~OpiWorkerPool() { stop(); }
+
+    static int & currentWorker()
+    {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    // nThreads workers in addition to the thread calling run(); capacity is
+    // the maximum number of items queued per thread at any time
+    void start(uint32_t nThreads, uint32_t capacity = 4096)
+    {
+        stop();
+        quit.store(false);
+        nDeques = nThreads + 1;
+        deques.reset(new OpiWorkDeque[nDeques]);
+        for(uint32_t i = 0; i < nDeques; ++i) deques[i].init(capacity);
+
+        for(uint32_t i = 1; i <= nThreads; ++i)
+            threads.emplace_back([this, i]() { workerMain(i); });
+    }
+
+    void stop()
+    {
+        if(threads.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            quit.store(true);
+        }
+        sleepCond.notify_all();
+        for(std::thread & t : threads) t.join();
+        threads.clear();
+    }
+
+    uint32_t numThreads() const { return nDeques ? nDeques : 1; }
+
+    // Runs nItems items of which the roots are queued right away and the rest
+    // must be spawned by running items. Returns when all of them are done.
+    // If roots is 0, then items 0 to nRoots-1 are queued.
+    void run(void (*fn)(void *, uint32_t, OpiWorkerContext &), void * ctx,
+        uint32_t nItems, const uint32_t * roots, uint32_t nRoots)
+    {
+        OpiWorkerBatch batch;
+        batch.run = fn;
+        batch.ctx = ctx;
+        batch.remaining.store(nItems, std::memory_order_relaxed);
+
+        uint32_t worker = (uint32_t) currentWorker();
+        OpiWorkerContext wc = { this, &batch, worker };
+
+        // without workers (or slots) just run everything on this thread
+        if(!acquireSlot(batch))
+        {
+            runInline(batch, wc, roots, nRoots);
+            return;
+        }
+
+        for(uint32_t i = 0; i < nRoots; ++i) wc.spawn(roots ? roots[i] : i);
+        wake();
+
+        // work on anything (not just this batch) until this batch is done;
+        // yield eventually, in case whoever holds the last item needs our core
+        uint64_t entry;
+        uint32_t idle = 0;
+        while(batch.remaining.load(std::memory_order_acquire))
+        {
+            if(findWork(worker, entry)) { execute(worker, entry); idle = 0; }
+            else if(++idle < 256) OPI_POOL_PAUSE();
+            else std::this_thread::yield();
+        }
+
+        batches[batch.slot].store(0, std::memory_order_release);
+    }
+
+    // queue an item of a batch on the given worker's deque
+    void spawn(uint32_t worker, OpiWorkerBatch & batch, uint32_t item)
+    {
+        uint64_t entry = ((uint64_t) batch.slot << 32) | item;
+        if(!nDeques || !deques[worker].push(entry)) execute(worker, entry);
+    }
+
+private:
+    bool acquireSlot(OpiWorkerBatch & batch)
+    {
+        if(threads.empty()) return false;
+        for(uint32_t i = 0; i < maxBatches; ++i)
+        {
+            OpiWorkerBatch * expected = 0;
+            if(batches[i].compare_exchange_strong(expected, &batch,
+                std::memory_order_acq_rel))
+            {
+                batch.slot = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // fallback: a plain stack on this thread instead of the deques
+    void runInline(OpiWorkerBatch & batch, OpiWorkerContext & wc,
+        const uint32_t * roots, uint32_t nRoots)
+    {
+        OpiWorkerContext inline_ = wc;
+        inline_.pool = 0;
+        for(uint32_t i = 0; i < nRoots; ++i) batch.run(batch.ctx, roots ? roots[i] : i, inline_);
+    }
+
+    bool findWork(uint32_t worker, uint64_t & entry)
+    {
+        if(deques[worker].pop(entry)) return true;
+        for(uint32_t i = 1; i < nDeques; ++i)
+        {
+            uint32_t victim = (worker + i) % nDeques;
+            if(deques[victim].steal(entry)) return true;
+        }
+        return false;
+    }
+
+    void execute(uint32_t worker, uint64_t entry)
+    {
+        OpiWorkerBatch * batch =
+            batches[entry >> 32].load(std::memory_order_acquire);
+        OpiWorkerContext wc = { this, batch, worker };
+        batch->run(batch->ctx, (uint32_t) entry, wc);
+
+        // must be the last access: the batch may be gone right after this
+        batch->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void wake()
+    {
+        signal.fetch_add(1, std::memory_order_release);
+        if(sleepers.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            sleepCond.notify_all();
+        }
+    }
+
+    void workerMain(uint32_t worker)
+    {
+        opiSetThreadRealtime();
+        currentWorker() = (int) worker;
+
+        typedef std::chrono::steady_clock clock;
+        const clock::duration spinTime = std::chrono::milliseconds(5);
+
+        uint64_t entry;
+        clock::time_point idleSince = clock::now();
+        uint32_t idle = 0;
+
+        while(!quit.load(std::memory_order_acquire))
+        {
+            uint32_t seen = signal.load(std::memory_order_acquire);
+
+            if(findWork(worker, entry))
+            {
+                execute(worker, entry);
+                idle = 0;
+                continue;
+            }
+
+            if(!idle++) idleSince = clock::now();
+            if(idle < 1024) { OPI_POOL_PAUSE(); continue; }
+            if((idle & 63) || clock::now() - idleSince < spinTime)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock);
+            sleepers.fetch_add(1, std::memory_order_acq_rel);
+            sleepCond.wait(lock, [&]()
+            {
+                return quit.load() || signal.load() != seen;
+            });
+            sleepers.fetch_sub(1, std::memory_order_acq_rel);
+            idle = 0;
+        }
+    }
+};
+
+inline void OpiWorkerContext::spawn(uint32_t item)
+{
+    // inline fallback: no pool, so just recurse
+    if(!pool) { batch->run(batch->ctx, item, *this); return; }
+    pool->spawn(worker, *batch, item);
+}
@@ -0,0 +1,388 @@
+/*
+/// # Community Plugin Format Profiling
+///
+/// ## About
+/// Reference host side of opiHostGetProfiler: per-instance timing of every
+/// opiPlugProcess call plus the zones the plugin marks itself, collected into
+/// a trace that can be exported for chrome://tracing (or Perfetto) and
+/// summarised as per-instance DSP load percentiles.
+///
+/// ## Details
+/// - Timestamps come from the TSC on x86 (steady_clock elsewhere) and are
+///   converted to microseconds against steady_clock when exporting
+/// - Each instance has its own OpiProfileTrack with a lock-free ring; records
+///   are pushed by whichever thread runs the instance and drained by one
+///   non-realtime thread, so recording never allocates or locks
+/// - A full ring drops records (and counts them) rather than blocking
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiProfileSession profile(48000);
+///    inst.profile = profile.add("track 1 eq");  // before opiPlugConfig
+///    ... process ...
+///    profile.drain();                           // periodically, not [RT]
+///    ...
+///    profile.writeChromeTrace("session.json");
+///    profile.summary(stdout);
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// Drain at least once before destroying the instances, since the records
+/// only point at the zone names until then.
+*/
+
+#pragma once
+
+#include "Community.h"
+#include "CommunityParams.h"
+#include "CommunityPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+# define OPI_PROFILE_TSC 1
+# ifdef _MSC_VER
+#  include <intrin.h>
+# else
+#  include <x86intrin.h>
+# endif
+#endif
+
+static inline uint64_t opiProfileTicks()
+{
+#ifdef OPI_PROFILE_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*
+ * ==============================================================
+ *
+ *                          TRACK
+ *
+ * ===============================================================
+ */
+
+struct OpiProfileRecord
+{
+    uint64_t        begin;      // ticks
+    uint64_t        end;        // ticks
+    const char *    name;
+    uint32_t        frames;     // nFrames for process records, 0 for zones
+    uint16_t        thread;     // worker index, 0 = the thread driving the pool
+    uint16_t        depth;      // 0 = process, 1.. = plugin zones
+};
+
+// The profiler handed to one instance, plus the ring its records go into.
+struct OpiProfileTrack : public OpiProfiler
+{
+    static const uint32_t   maxDepth = 16;
+
+    std::string                     name;
+    OpiSpscRing<OpiProfileRecord>   ring;
+    std::atomic<uint32_t>           dropped { 0 };
+    const std::atomic<bool> *       recording = 0;
+
+    // [RT] open zones; deeper ones are counted but not recorded
+    uint64_t        zoneBegin[maxDepth];
+    const char *    zoneName[maxDepth];
+    uint32_t        depth = 0;
+
+    OpiProfileTrack()
+    {
+        profilerSize = sizeof(OpiProfiler);
+        begin = &beginZone;
+        end = &endZone;
+    }
+
+    bool isRecording() const
+    {
+        return recording && recording->load(std::memory_order_relaxed);
+    }
+
+    // [RT]
+    void record(const char * what, uint64_t t0, uint64_t t1,
+        uint32_t frames, uint32_t level)
+    {
+        OpiProfileRecord r = { t0, t1, what, frames,
+            (uint16_t) OpiWorkerPool::currentWorker(), (uint16_t) level };
+        if(!ring.push(r)) dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void beginZone(OpiProfiler * p, const char * what)
+    {
+        OpiProfileTrack * track = (OpiProfileTrack*) p;
+        uint32_t d = track->depth++;
+        if(d >= maxDepth) return;
+        track->zoneName[d] = what;
+        track->zoneBegin[d] = opiProfileTicks();
+    }
+
+    static void endZone(OpiProfiler * p)
+    {
+        OpiProfileTrack * track = (OpiProfileTrack*) p;
+        if(!track->depth) return;
+        uint32_t d = --track->depth;
+        if(d >= maxDepth || !track->isRecording()) return;
+        track->record(track->zoneName[d], track->zoneBegin[d],
+            opiProfileTicks(), 0, d + 1);
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          SESSION
+ *
+ * ===============================================================
+ */
+
+// All the tracks of a host, and what has been drained from them so far.
+struct OpiProfileSession
+{
+    struct Entry
+    {
+        uint64_t    begin, end;     // ticks
+        uint32_t    track;
+        uint32_t    name;           // index into names
+        uint32_t    frames;
+        uint16_t    thread;
+        uint16_t    depth;
+    };
+
+    std::vector<std::unique_ptr<OpiProfileTrack>>   tracks;
+    std::vector<Entry>          entries;
+    std::vector<std::string>    names;
+    std::map<std::string, uint32_t> nameIndex;
+
+    // by address, for the drain in progress only: a zone name is only
+    // guaranteed to live until then (its library may be unloaded after),
+    // and another one could turn up at the same address
+    std::map<const char*, uint32_t> drainNames;
+
+    std::atomic<bool>   recording { true };
+    float               samplerate;
+
+    // for converting ticks to time
+    uint64_t                                startTicks;
+    std::chrono::steady_clock::time_point   startTime;
+
+    OpiProfileSession(float rate = 48000) : samplerate(rate)
+    {
+        startTicks = opiProfileTicks();
+        startTime = std::chrono::steady_clock::now();
+    }
+
+    // new track with room for capacity records between drains
+    OpiProfileTrack * add(const char * trackName, uint32_t capacity = 1024)
+    {
+        tracks.emplace_back(new OpiProfileTrack);
+        OpiProfileTrack * track = tracks.back().get();
+        track->name = trackName;
+        track->ring.init(capacity);
+        track->recording = &recording;
+        return track;
+    }
+
+    // move everything recorded so far out of the rings; from one thread only
+    void drain()
+    {
+        OpiProfileRecord r;
+        for(uint32_t t = 0; t < tracks.size(); ++t)
+        {
+            while(tracks[t]->ring.pop(r))
+            {
+                Entry e = { r.begin, r.end, t, intern(r.name),
+                    r.frames, r.thread, r.depth };
+                entries.push_back(e);
+            }
+        }
+        drainNames.clear();
+    }
+
+    void clear() { entries.clear(); }
+
+    uint32_t numDropped() const
+    {
+        uint32_t n = 0;
+        for(auto & t : tracks) n += t->dropped.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // measured against steady_clock since construction, so this waits until
+    // enough time has passed for a decent estimate
+    double ticksPerUs()
+    {
+#ifdef OPI_PROFILE_TSC
+        typedef std::chrono::steady_clock clock;
+        while(clock::now() - startTime < std::chrono::milliseconds(20))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        uint64_t ticks = opiProfileTicks();
+        double us = std::chrono::duration<double, std::micro>(
+            clock::now() - startTime).count();
+        return (ticks - startTicks) / us;
+#else
+        return 1e3;
+#endif
+    }
+
+    // Chrome trace event format: one complete ("X") event per record on the
+    // row of the thread that ran it, with the instance as category.
+    bool writeChromeTrace(const char * path)
+    {
+        FILE * f = fopen(path, "w");
+        if(!f) return false;
+
+        double scale = 1 / ticksPerUs();
+        uint64_t origin = ~uint64_t(0);
+        uint32_t nThreads = 0;
+        for(const Entry & e : entries)
+        {
+            origin = std::min(origin, e.begin);
+            nThreads = std::max(nThreads, (uint32_t) e.thread + 1);
+        }
+
+        fprintf(f, "{\"traceEvents\":[\n");
+        for(uint32_t t = 0; t < nThreads; ++t)
+        {
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                "\"args\":{\"name\":\"worker %u\"}},\n", t, t);
+        }
+        for(size_t i = 0; i < entries.size(); ++i)
+        {
+            const Entry & e = entries[i];
+            fprintf(f, "{\"name\":");
+            writeString(f, names[e.name]);
+            fprintf(f, ",\"cat\":");
+            writeString(f, tracks[e.track]->name);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u",
+                (e.begin - origin) * scale, (e.end - e.begin) * scale, e.thread);
+            if(!e.depth) fprintf(f, ",\"args\":{\"frames\":%u}", e.frames);
+            fprintf(f, "}%s\n", i + 1 < entries.size() ? "," : "");
+        }
+        fprintf(f, "]}\n");
+        return fclose(f) == 0;
+    }
+
+    // Per-instance opiPlugProcess times and DSP load (time spent over the
+    // duration of the block), worst instances first, then the plugin zones.
+    // The load of a single instance past 100% means it alone blew the deadline.
+    void summary(FILE * f, uint32_t maxRows = 10)
+    {
+        double scale = 1 / ticksPerUs();
+
+        struct Row
+        {
+            std::string         name;
+            std::vector<double> us;
+            std::vector<double> load;
+            uint32_t            over = 0;
+        };
+        std::vector<Row> rows(tracks.size());
+        std::map<std::string, Row> zones;
+
+        for(uint32_t t = 0; t < tracks.size(); ++t) rows[t].name = tracks[t]->name;
+        for(const Entry & e : entries)
+        {
+            double us = (e.end - e.begin) * scale;
+            if(e.depth)
+            {
+                Row & z = zones[names[e.name]];
+                z.name = names[e.name];
+                z.us.push_back(us);
+                continue;
+            }
+            Row & r = rows[e.track];
+            double load = e.frames ? us * 1e-6 * samplerate / e.frames : 0;
+            r.us.push_back(us);
+            r.load.push_back(load);
+            r.over += load > 1;
+        }
+
+        for(Row & r : rows)
+        {
+            std::sort(r.us.begin(), r.us.end());
+            std::sort(r.load.begin(), r.load.end());
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const Row & a, const Row & b)
+        {
+            return percentile(a.load, 1) > percentile(b.load, 1);
+        });
+
+        fprintf(f, "%-20s %8s %9s %9s %9s %8s %8s %6s\n", "instance", "calls",
+            "p50(us)", "p99(us)", "max(us)", "p99 load", "max load", "over");
+        for(uint32_t i = 0; i < rows.size() && i < maxRows; ++i)
+        {
+            Row & r = rows[i];
+            if(r.us.empty()) continue;
+            fprintf(f, "%-20s %8u %9.2f %9.2f %9.2f %7.2f%% %7.2f%% %6u\n",
+                r.name.c_str(), (uint32_t) r.us.size(),
+                percentile(r.us, .5), percentile(r.us, .99), percentile(r.us, 1),
+                percentile(r.load, .99) * 100, percentile(r.load, 1) * 100, r.over);
+        }
+
+        if(!zones.empty())
+        {
+            fprintf(f, "%-20s %8s %9s %9s %9s\n", "zone", "count",
+                "p50(us)", "p99(us)", "max(us)");
+        }
+        for(auto & kv : zones)
+        {
+            Row & z = kv.second;
+            std::sort(z.us.begin(), z.us.end());
+            fprintf(f, "%-20s %8u %9.2f %9.2f %9.2f\n",
+                z.name.c_str(), (uint32_t) z.us.size(),
+                percentile(z.us, .5), percentile(z.us, .99), percentile(z.us, 1));
+        }
+
+        uint32_t dropped = numDropped();
+        if(dropped) fprintf(f, "%u records dropped, drain more often\n", dropped);
+    }
+
+private:
+    uint32_t intern(const char * name)
+    {
+        auto cached = drainNames.find(name);
+        if(cached != drainNames.end()) return cached->second;
+
+        std::string text = name ? name : "";
+        auto it = nameIndex.find(text);
+        uint32_t i = it != nameIndex.end() ? it->second : (uint32_t) names.size();
+        if(it == nameIndex.end())
+        {
+            names.push_back(text);
+            nameIndex[text] = i;
+        }
+        drainNames[name] = i;
+        return i;
+    }
+
+    // v must be sorted
+    static double percentile(const std::vector<double> & v, double p)
+    {
+        if(v.empty()) return 0;
+        return v[(size_t) (p * (v.size() - 1) + .5)];
+    }
+
+    static void writeString(FILE * f, const std::string & s)
+    {
+        fputc('"', f);
+        for(unsigned char ch : s)
+        {
+            if(ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+            else if(ch < 0x20) fprintf(f, "\\u%04x", ch);
+            else fputc(ch, f);
+        }
+        fputc('"', f);
+    }
+};
@@ -0,0 +1,686 @@
+/*
+/// # Community Plugin Format Resampling
+///
+/// ## About
+/// Polyphase FIR sample rate conversion, for plugins and hosts alike:
+/// - OpiResampler: any rational ratio (eg. 44100 to 48000) on several channels
+/// - OpiOversampler: 2x, 4x or 8x around a plugin's nonlinear stages
+/// - OpiResampleWrapper: runs a plugin that only takes some samplerates at
+///   any other, as a proxy OpiPlugin the host drives like the plugin itself
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    // in a plugin, around a waveshaper
+///    OpiOversampler os;
+///    os.init(4, nChannels, maxFrames);                   // in opiPlugConfig
+///    float * const * hi = os.up(inputs, nFrames);        // 4 * nFrames each
+///    ... shape hi[c][0 .. 4 * nFrames) ...
+///    os.down(outputs, nFrames);
+///
+///    // in a host, when opiPlugConfig turns the samplerate down
+///    inst.adopt(OpiResampleWrapper::create(lib.entrypoint, 48000,
+///        &OpiHostInstance::hostDispatcher, &inst));
+///    inst.configure(blockSize, 44100, 2, 2);
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// ## Details
+/// - The filters are Kaiser windowed sincs designed by init(): nTaps per
+///   phase (rounded up to 16, and scaled up when decimating) set the width
+///   of the transition band, attenuation its depth
+/// - OpiResampler puts the stopband at the lower of the two Nyquist
+///   frequencies, so nothing aliases; OpiOversampler centres the transition
+///   there instead, which keeps more of the top octave for the same taps
+/// - Every output sample is one dot product (the dot kernel of CommunityDsp.h)
+///   of a phase's taps with the input history, so both sides vectorise
+///   whatever the ratio
+/// - The ratio is reduced to up / down and may have at most 2048 phases (up),
+///   which covers all the common rates
+/// - Nothing allocates after init()
+///
+/// ### OpiResampleWrapper
+/// - Configures the plugin at its own rate and converts the audio both ways,
+///   so every outer block turns into an inner one of a few frames more or less
+/// - Input event deltas (and smoothFrames) are moved to where their frame
+///   comes out of the input filter, carried over into the next block if
+///   that's past the inner block; output events are mapped back the same way
+/// - Latency is the plugin's plus both filters, in outer frames (rounded);
+///   the host is asked to query it again (opiHostSetLatency) after every
+///   opiPlugConfig
+/// - Takes one input and one output bus at most, planar and without
+///   opiConfigPackedEvents, and hides opiPlugGetFuncs, batching and parameter
+///   buffers; events of unknown type are dropped
+*/
+
+#pragma once
+
+#include "Community.h"
+#include "CommunityDsp.h"
+#include "CommunityEvents.h"
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+/*
+ * ==============================================================
+ *
+ *                          RESAMPLER
+ *
+ * ===============================================================
+ */
+
+// Converts nChannels channels from one rate to another, in blocks of up to
+// maxIn input frames.
+struct OpiResampler
+{
+    static const uint32_t   maxPhases = 2048;
+
+    // set before init(): the kernels to filter with (eg. to compare the
+    // variants) and where the transition band is centred, as a fraction of
+    // the lower Nyquist frequency (0 = such that the stopband starts there)
+    const OpiDspKernels *   kernels = &opiDsp();
+    double                  cutoff = 0;
+
+    uint32_t    up = 1;         // output frames per down input frames
+    uint32_t    down = 1;
+    uint32_t    nTaps = 0;      // per phase, a multiple of 16
+    uint32_t    nChannels = 0;
+    uint32_t    maxIn = 0;
+
+    std::vector<float>  coefs;      // up phases of nTaps, each reversed
+    std::vector<float>  history;    // per channel: nTaps - 1 old, maxIn new
+
+    // where the next output falls: input frame offset (from the start of the
+    // next block) and phase (in 1/up input frames)
+    uint32_t    offset = 0;
+    uint32_t    phase = 0;
+
+    // rates in Hz, or any two numbers with the same ratio
+    bool init(uint32_t inRate, uint32_t outRate, uint32_t channels, uint32_t maxFrames,
+        uint32_t taps = 64, double attenuation = 100)
+    {
+        if(!inRate || !outRate) return false;
+
+        uint32_t a = inRate, b = outRate;
+        while(b) { uint32_t t = a % b; a = b; b = t; }
+        up = outRate / a;
+        down = inRate / a;
+        if(up > maxPhases) return false;
+
+        // decimating narrows the band, so the filter gets longer to match
+        uint64_t perPhase = ((uint64_t) taps * std::max(up, down) + up - 1) / up;
+        nTaps = (uint32_t) ((perPhase + 15) & ~(uint64_t) 15);
+        nChannels = channels;
+        maxIn = maxFrames;
+
+        design(attenuation);
+        history.assign((size_t) nChannels * historyStride(), 0.f);
+        reset();
+        return true;
+    }
+
+    uint32_t historyStride() const { return nTaps - 1 + maxIn; }
+
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), 0.f);
+        offset = 0;
+        phase = 0;
+    }
+
+    // Kaiser windowed sinc at up times the input rate, split into phases
+    void design(double attenuation)
+    {
+        const double pi = 3.14159265358979323846;
+
+        uint32_t n = up * nTaps;
+        double beta = attenuation > 50 ? .1102 * (attenuation - 8.7)
+            : attenuation > 21 ? .5842 * pow(attenuation - 21, .4)
+                + .07886 * (attenuation - 21) : 0;
+
+        // cutoff and transition in cycles per sample at the filter's rate
+        double nyquist = .5 / std::max(up, down);
+        double transition = (attenuation - 7.95) / (14.36 * (n - 1));
+        double fc = cutoff > 0 ? cutoff * nyquist : nyquist - transition * .5;
+
+        std::vector<double> h(n);
+        double center = (n - 1) * .5, sum = 0;
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            double x = i - center;
+            double sinc = x ? sin(2 * pi * fc * x) / (pi * x) : 2 * fc;
+            double r = 2 * x / (n - 1);
+            sum += h[i] = sinc * besselI0(beta * sqrt(std::max(0., 1 - r * r)));
+        }
+
+        // unity gain at DC, which takes up times the sum over all phases
+        coefs.resize(n);
+        for(uint32_t p = 0; p < up; ++p)
+        for(uint32_t j = 0; j < nTaps; ++j)
+            coefs[p * nTaps + (nTaps - 1 - j)] = (float) (h[p + j * up] * up / sum);
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1, term = 1;
+        for(int k = 1; k < 64 && term > 1e-12 * sum; ++k)
+        {
+            term *= (x * .5 / k) * (x * .5 / k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // the most output frames that nIn input frames can give
+    uint32_t maxOut(uint32_t nIn) const
+    {
+        return (uint32_t) (((uint64_t) nIn * up + down - 1) / down) + 1;
+    }
+
+    // group delay of the filter, in output frames
+    double latency() const { return (up * nTaps - 1) * .5 / down; }
+
+    // Takes nIn (at most maxIn) frames per channel from in (0 = silence) and
+    // writes the outputs they complete to out, returns how many that was
+    // (at most maxOut(nIn)); the count is the same for every channel.
+    uint32_t process(const float * const * in, uint32_t nIn, float * const * out)
+    {
+        uint32_t step = down / up, stepPhase = down % up;
+        uint32_t stride = historyStride();
+
+        uint32_t n = offset, ph = phase, nOut = 0;
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            float * h = history.data() + (size_t) c * stride;
+            if(in && in[c]) memcpy(h + nTaps - 1, in[c], nIn * sizeof(float));
+            else memset(h + nTaps - 1, 0, nIn * sizeof(float));
+
+            float * y = out[c];
+            n = offset;
+            ph = phase;
+            for(nOut = 0; n < nIn; ++nOut)
+            {
+                y[nOut] = kernels->dot(coefs.data() + (size_t) ph * nTaps, h + n, nTaps);
+                n += step;
+                ph += stepPhase;
+                if(ph >= up) { ph -= up; ++n; }
+            }
+
+            memmove(h, h + nIn, (nTaps - 1) * sizeof(float));
+        }
+
+        // without channels, still keep time
+        if(!nChannels)
+        {
+            for(; n < nIn; ++nOut)
+            {
+                n += step;
+                ph += stepPhase;
+                if(ph >= up) { ph -= up; ++n; }
+            }
+        }
+
+        offset = n - nIn;
+        phase = ph;
+        return nOut;
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          OVERSAMPLER
+ *
+ * ===============================================================
+ */
+
+// Runs a block at factor times the rate: up() to the high rate into the
+// oversampler's own buffers, the plugin processes those in place, down()
+// back to the original rate.
+struct OpiOversampler
+{
+    uint32_t        factor = 1;
+    uint32_t        nChannels = 0;
+    OpiResampler    upsampler, downsampler;
+
+    std::vector<float>      buffer;     // factor * maxFrames per channel
+    std::vector<float*>     channels;
+
+    // factor 1 just copies
+    bool init(uint32_t factor_, uint32_t nChannels_, uint32_t maxFrames,
+        uint32_t taps = 32, double attenuation = 100)
+    {
+        factor = std::max<uint32_t>(factor_, 1);
+        nChannels = nChannels_;
+
+        upsampler.cutoff = downsampler.cutoff = 1;
+        if(!upsampler.init(1, factor, nChannels, maxFrames, taps, attenuation)
+            || !downsampler.init(factor, 1, nChannels, factor * maxFrames, taps, attenuation))
+            return false;
+
+        size_t stride = (size_t) factor * maxFrames;
+        buffer.assign(nChannels * stride, 0.f);
+        channels.resize(nChannels);
+        for(uint32_t c = 0; c < nChannels; ++c) channels[c] = buffer.data() + c * stride;
+        return true;
+    }
+
+    void reset()
+    {
+        upsampler.reset();
+        downsampler.reset();
+    }
+
+    // nFrames from in (0 = silence) to factor * nFrames in the channels returned
+    float * const * up(const float * const * in, uint32_t nFrames)
+    {
+        if(factor == 1)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                if(in && in[c]) opiDspCopy(channels[c], in[c], nFrames);
+                else opiDspClear(channels[c], nFrames);
+            }
+        }
+        else upsampler.process(in, nFrames, channels.data());
+        return channels.data();
+    }
+
+    // the factor * nFrames in the channels back down to nFrames in out
+    void down(float * const * out, uint32_t nFrames)
+    {
+        if(factor == 1)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c) opiDspCopy(out[c], channels[c], nFrames);
+        }
+        else downsampler.process(channels.data(), factor * nFrames, out);
+    }
+
+    // frames at the original rate, rounded
+    uint32_t latency() const
+    {
+        if(factor == 1) return 0;
+        return (uint32_t) lround(upsampler.latency() / factor + downsampler.latency());
+    }
+};
+
+/*
+ * ==============================================================
+ *
+ *                          WRAPPER
+ *
+ * ===============================================================
+ */
+
+// A plugin that runs another one at a fixed samplerate. It answers
+// dispatchToPlugin for the host and passes the plugin's own dispatchToHost
+// calls on as its own, so the host sees just one plugin.
+struct OpiResampleWrapper : public OpiPlugin
+{
+    static const uint32_t   maxEvents = 1024;   // per block, including carried
+
+    union EventCopy
+    {
+        OpiEvent            event;
+        OpiEventMidi        midi;
+        OpiEventAutomation  automation;
+    };
+
+    OpiPlugin * inner = 0;
+    uint32_t    innerRate = 0;
+    uint32_t    nTaps = 0;
+
+    // set up by opiPlugConfig
+    bool        configured = false;
+    uint32_t    up = 1, down = 1;   // inner / outer rate, reduced
+    uint32_t    nIn = 0, nOut = 0;  // channels
+    uint32_t    latencyFrames = 0;  // in outer frames, plugin included
+
+    OpiResampler    inResampler, outResampler;
+
+    std::vector<float>      innerIn, innerOut;  // inner blocks
+    std::vector<float*>     innerInPtrs, innerOutPtrs;
+    std::vector<char>       innerInBus, innerOutBus;    // OpiBusChannels
+
+    // outer output frames made but not handed out yet
+    std::vector<float>      fifo;
+    std::vector<float*>     fifoPtrs;
+    uint32_t                fifoStride = 0;
+    uint32_t                fifoFrames = 0;
+
+    // frames so far on each side, for placing events
+    uint64_t    outerFrames = 0;
+    uint64_t    innerFrames = 0;
+
+    std::vector<EventCopy>  pending, current, outCopies;
+    std::vector<OpiEvent*>  eventList, outList;
+
+    static OpiPlugin * create(OpiEntrypoint entrypoint, uint32_t innerRate,
+        OpiCallback hostCallback, void * hostPtr, uint32_t nTaps = 64)
+    {
+        OpiResampleWrapper * w = new OpiResampleWrapper(hostCallback, hostPtr);
+        w->innerRate = innerRate;
+        w->nTaps = nTaps;
+        w->inner = entrypoint(&innerDispatcher, w);
+        if(!w->inner)
+        {
+            delete w;
+            return 0;
+        }
+        return w;
+    }
+
+    OpiResampleWrapper(OpiCallback hostCallback, void * ptr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = ptr;
+    }
+
+    ~OpiResampleWrapper()
+    {
+        if(inner) inner->dispatchToPlugin(inner, opiPlugDestroy, 0, 0);
+    }
+
+    intptr_t dispatchInner(int32_t op, int32_t idx = 0, void * data = 0)
+    {
+        return inner->dispatchToPlugin(inner, op, idx, data);
+    }
+
+    // the plugin talks to the host through us
+    static intptr_t innerDispatcher(OpiPlugin * plug, int32_t op, int32_t idx, void * data)
+    {
+        OpiResampleWrapper * w = (OpiResampleWrapper*) plug->ptrHost;
+        return w->dispatchToHost(w, op, idx, data);
+    }
+
+    bool bypass() const { return up == down; }
+
+    static OpiBusChannels * busFor(std::vector<char> & storage, uint32_t channels)
+    {
+        storage.assign(opiBusChannelsSize(channels), 0);
+        return (OpiBusChannels*) storage.data();
+    }
+
+    int configure(OpiConfig * config)
+    {
+        configured = false;
+
+        bool hasFlags = config->configSize > offsetof(OpiConfig, flags);
+        uint32_t flags = hasFlags ? config->flags : 0;
+        if(flags & ~(opiConfigInPlace | opiConfigOffline)) return 0;
+
+        intptr_t nInputs = dispatchInner(opiPlugNumInputs);
+        intptr_t nOutputs = dispatchInner(opiPlugNumOutputs);
+        if(nInputs > 1 || nOutputs > 1) return 0;
+        nIn = nInputs ? config->inBusChannels[0].nChannels : 0;
+        nOut = nOutputs ? config->outBusChannels[0].nChannels : 0;
+
+        uint32_t outerRate = (uint32_t) lround(config->samplerate);
+        uint32_t maxOuter = config->blocksize;
+        if(!outerRate || !maxOuter
+            || !inResampler.init(outerRate, innerRate, nIn, maxOuter, nTaps)) return 0;
+        up = inResampler.up;
+        down = inResampler.down;
+
+        OpiConfig innerConfig = *config;
+        innerConfig.samplerate = (float) innerRate;
+        innerConfig.blocksize = bypass() ? maxOuter : inResampler.maxOut(maxOuter);
+        if(!dispatchInner(opiPlugConfig, 0, &innerConfig)) return 0;
+
+        uint32_t maxInner = innerConfig.blocksize;
+        if(!bypass() && maxInner < inResampler.maxOut(maxOuter))
+        {
+            // the largest outer block that still fits
+            maxOuter = maxInner > 1 ? (uint32_t) ((uint64_t) (maxInner - 1) * down / up) : 0;
+            if(!hasFlags || !maxOuter) return 0;
+            inResampler.init(outerRate, innerRate, nIn, maxOuter, nTaps);
+        }
+        else if(bypass()) maxOuter = maxInner;
+        config->blocksize = maxOuter;
+
+        if(config->configSize > offsetof(OpiConfig, arenaSize))
+            config->arenaSize = innerConfig.arenaSize;
+
+        if(!outResampler.init(innerRate, outerRate, nOut, maxInner, nTaps)) return 0;
+
+        innerIn.assign((size_t) nIn * maxInner, 0.f);
+        innerOut.assign((size_t) nOut * maxInner, 0.f);
+        innerInPtrs.resize(nIn);
+        innerOutPtrs.resize(nOut);
+        for(uint32_t c = 0; c < nIn; ++c) innerInPtrs[c] = innerIn.data() + (size_t) c * maxInner;
+        for(uint32_t c = 0; c < nOut; ++c) innerOutPtrs[c] = innerOut.data() + (size_t) c * maxInner;
+        busFor(innerInBus, nIn);
+        busFor(innerOutBus, nOut);
+
+        fifoStride = maxOuter + outResampler.maxOut(maxInner);
+        fifo.assign((size_t) nOut * fifoStride, 0.f);
+        fifoPtrs.resize(nOut);
+
+        pending.reserve(maxEvents);
+        current.reserve(maxEvents);
+        outCopies.reserve(maxEvents);
+        eventList.reserve(maxEvents);
+        outList.reserve(maxEvents);
+
+        configured = true;
+        latencyFrames = computeLatency();
+        dispatchToHost(this, opiHostSetLatency, 0, 0);
+        return 1;
+    }
+
+    // delay of both filters together, in outer frames
+    double filterDelay() const
+    {
+        if(!configured || bypass()) return 0;
+        return ((up * inResampler.nTaps - 1) * .5 + (down * outResampler.nTaps - 1) * .5) / up;
+    }
+
+    uint32_t computeLatency()
+    {
+        double frames = (double) dispatchInner(opiPlugGetLatency);
+        if(!configured || bypass()) return (uint32_t) frames;
+        return (uint32_t) lround(filterDelay() + frames * down / up);
+    }
+
+    void reset()
+    {
+        inResampler.reset();
+        outResampler.reset();
+        fifoFrames = 0;
+        outerFrames = innerFrames = 0;
+        pending.clear();
+    }
+
+    // inner frame (absolute) where outer frame x comes out of the input filter
+    uint64_t innerFrameFor(uint64_t x) const
+    {
+        double delay = (up * inResampler.nTaps - 1) * .5;
+        return (uint64_t) llround(((double) x * up + delay) / down);
+    }
+
+    // outer frame (absolute) that went into inner frame k, possibly before 0
+    int64_t outerFrameFor(uint64_t k) const
+    {
+        double delay = (up * inResampler.nTaps - 1) * .5;
+        return llround(((double) k * down - delay) / up);
+    }
+
+    static bool copyEvent(const OpiEvent * ev, EventCopy & copy)
+    {
+        if(ev->type != opiEventMidi && ev->type != opiEventAutomation) return false;
+        memcpy(&copy, ev, opiEventSize(ev));
+        return true;
+    }
+
+    void process(OpiProcessInfo * info)
+    {
+        if(bypass())
+        {
+            dispatchInner(opiPlugProcess, 0, info);
+            return;
+        }
+
+        uint32_t nFrames = info->nFrames;
+        const float * const * in = nIn ? info->inputs[0].channels : 0;
+        uint32_t nInner = inResampler.process(in, nFrames, innerInPtrs.data());
+
+        // events carried over from earlier blocks come first, they are older
+        current.clear();
+        size_t nCarried = 0;
+        for(EventCopy & ev : pending)
+        {
+            if(ev.event.delta < nInner) current.push_back(ev);
+            else
+            {
+                ev.event.delta -= nInner;
+                pending[nCarried++] = ev;
+            }
+        }
+        pending.resize(nCarried);
+
+        for(uint32_t e = 0; e < info->nInEvents; ++e)
+        {
+            EventCopy ev;
+            if(!copyEvent(info->inEvents[e], ev)) continue;
+
+            uint64_t k = innerFrameFor(outerFrames + ev.event.delta);
+            k = std::max(k, innerFrames) - innerFrames;
+            if(ev.event.type == opiEventAutomation)
+                ev.automation.smoothFrames = (uint32_t) std::min<uint64_t>(
+                    (uint64_t) ev.automation.smoothFrames * up / down, 0xffffffffu);
+
+            if(k < nInner)
+            {
+                ev.event.delta = (uint32_t) k;
+                if(current.size() < maxEvents) current.push_back(ev);
+            }
+            else
+            {
+                ev.event.delta = (uint32_t) (k - nInner);
+                if(pending.size() < maxEvents) pending.push_back(ev);
+            }
+        }
+
+        eventList.clear();
+        for(EventCopy & ev : current) eventList.push_back(&ev.event);
+
+        uint32_t nMade = 0;
+        outList.clear();
+        outCopies.clear();
+        if(nInner)
+        {
+            OpiBusChannels * inBus = (OpiBusChannels*) innerInBus.data();
+            OpiBusChannels * outBus = (OpiBusChannels*) innerOutBus.data();
+            for(uint32_t c = 0; c < nIn; ++c) inBus->channels[c] = innerInPtrs[c];
+            for(uint32_t c = 0; c < nOut; ++c) outBus->channels[c] = innerOutPtrs[c];
+            inBus->silenceMask = 0;
+            outBus->silenceMask = 0;
+
+            OpiTimeInfo timeInfo;
+            OpiProcessInfo innerInfo;
+            memset(&innerInfo, 0, sizeof(innerInfo));
+            innerInfo.processInfoSize = sizeof(OpiProcessInfo);
+            innerInfo.nFrames = nInner;
+            if(info->timeInfo)
+            {
+                timeInfo = *info->timeInfo;
+                timeInfo.samplePos = timeInfo.samplePos * up / down;
+                innerInfo.timeInfo = &timeInfo;
+            }
+            innerInfo.inputs = nIn ? inBus : 0;
+            innerInfo.outputs = nOut ? outBus : 0;
+            innerInfo.inEvents = eventList.data();
+            innerInfo.nInEvents = (uint32_t) eventList.size();
+
+            dispatchInner(opiPlugProcess, 0, &innerInfo);
+
+            for(uint32_t e = 0; innerInfo.outEvents && e < innerInfo.nOutEvents; ++e)
+            {
+                EventCopy ev;
+                if(outCopies.size() == maxEvents
+                    || !copyEvent(innerInfo.outEvents[e], ev)) continue;
+
+                int64_t x = outerFrameFor(innerFrames + ev.event.delta) - (int64_t) outerFrames;
+                ev.event.delta = (uint32_t) std::min<int64_t>(
+                    std::max<int64_t>(x, 0), nFrames ? nFrames - 1 : 0);
+                outCopies.push_back(ev);
+            }
+
+            for(uint32_t c = 0; c < nOut; ++c)
+                fifoPtrs[c] = fifo.data() + (size_t) c * fifoStride + fifoFrames;
+            nMade = outResampler.process(innerOutPtrs.data(), nInner, fifoPtrs.data());
+        }
+        for(EventCopy & ev : outCopies) outList.push_back(&ev.event);
+        info->outEvents = outList.empty() ? 0 : outList.data();
+        info->nOutEvents = (uint32_t) outList.size();
+
+        // the output filter always has at least as many frames ready as went
+        // in, but just in case, anything missing is silence
+        fifoFrames += nMade;
+        uint32_t nTake = std::min(fifoFrames, nFrames);
+        for(uint32_t c = 0; c < nOut; ++c)
+        {
+            float * f = fifo.data() + (size_t) c * fifoStride;
+            float * out = info->outputs[0].channels[c];
+            memcpy(out, f, nTake * sizeof(float));
+            if(nTake < nFrames) memset(out + nTake, 0, (nFrames - nTake) * sizeof(float));
+            memmove(f, f + nTake, (fifoFrames - nTake) * sizeof(float));
+        }
+        fifoFrames -= nTake;
+        if(nOut) info->outputs[0].silenceMask = 0;
+
+        outerFrames += nFrames;
+        innerFrames += nInner;
+    }
+
+    static intptr_t pluginDispatcher(OpiPlugin * ptr, int32_t op, int32_t idx, void * data)
+    {
+        OpiResampleWrapper * w = (OpiResampleWrapper*) ptr;
+
+        if(!op)
+        {
+            w->process((OpiProcessInfo*) data);
+            return 1;
+        }
+
+        switch(op)
+        {
+        case opiPlugDestroy: delete w; return 1;
+
+        case opiPlugConfig: return w->configure((OpiConfig*) data);
+
+        case opiPlugEnable:
+        case opiPlugReset:
+            w->reset();
+            return w->dispatchInner(op, idx, data);
+
+        case opiPlugGetLatency:
+            w->latencyFrames = w->computeLatency();
+            return w->latencyFrames;
+
+        case opiPlugGetTailFrames:
+            {
+                uint32_t * frames = (uint32_t*) data;
+                if(!w->dispatchInner(op, idx, frames)) return 0;
+                if(*frames != opiTailInfinite && w->configured && !w->bypass())
+                    *frames = (uint32_t) ((uint64_t) *frames * w->down / w->up
+                        + (uint64_t) ceil(w->filterDelay()));
+                return 1;
+            }
+
+        // flushing has no audio, so the deltas don't matter
+        case opiPlugFlushEvents: return w->dispatchInner(op, idx, data);
+
+        // these would bypass the conversion
+        case opiPlugGetFuncs: return 0;
+        case opiPlugMaxBatch: return 0;
+        case opiPlugProcessBatch: return 0;
+        case opiPlugAcceptsParamBuffer: return 0;
+
+        default: return w->dispatchInner(op, idx, data);
+        }
+    }
+};
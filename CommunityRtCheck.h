@@ -0,0 +1,188 @@
+/*
+/// # Community Plugin Format Realtime Checker
+///
+/// ## About
+/// Catches plugins doing things in opiPlugProcess (and the calls that stand
+/// in for it, like opiPlugProcessBatch) that can block the audio thread:
+/// allocating or freeing memory, taking locks, waiting and making system
+/// calls. OpiRtCheck.cpp builds into a library that is preloaded into the host
+/// and interposes those functions; the host marks the realtime calls with
+/// OpiRtCheck and gets every violation back with a stack trace.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    g++ -O2 -shared -fPIC OpiRtCheck.cpp -o OpiRtCheck.so -ldl
+///    LD_PRELOAD=./OpiRtCheck.so ./opi_bench --suite rtcheck plugin.so
+///
+///    // in the host (link it with -rdynamic for names in its own frames)
+///    OpiRtCheck check;
+///    if(!check.load()) ... not preloaded ...
+///    check.enter("process");
+///    inst.process(&info);
+///    check.leave();
+///    ...
+///    check.report(stdout);
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// ## Details
+/// - Only the thread between enter() and leave() is checked, so whatever
+///   runs on other threads (eg. a plugin's own workers) goes unnoticed
+/// - The interposed calls still go through; a violation is only recorded,
+///   without allocating or locking, into a fixed table (beyond which they
+///   are only counted)
+/// - Only calls that go through the dynamic linker are seen: anything a
+///   plugin links statically, or system calls libc makes internally (eg. the
+///   write behind printf) are missed
+/// - Needs glibc (for forwarding the allocator); elsewhere load() fails
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+# include <dlfcn.h>
+# include <cxxabi.h>
+#endif
+
+struct OpiRtViolation
+{
+    static const uint32_t   maxFrames = 32;
+
+    const char *    kind;       // the interposed function, eg. "malloc"
+    const char *    what;       // as passed to opiRtCheckEnter
+    uint32_t        nFrames;
+    void *          frames[maxFrames];  // innermost first
+};
+
+// Exported by OpiRtCheck.so. Checks nest, so a realtime call made from
+// within another one is fine. Violations may only be read while no thread
+// is between enter and leave.
+extern "C"
+{
+    typedef void        (*OpiRtCheckEnterFunc)(const char * what);
+    typedef void        (*OpiRtCheckLeaveFunc)(void);
+    typedef uint32_t    (*OpiRtCheckCountFunc)(void);
+    typedef int         (*OpiRtCheckGetFunc)(uint32_t i, OpiRtViolation * out);
+    typedef void        (*OpiRtCheckClearFunc)(void);
+}
+
+// Host side: finds the preloaded checker and reports what it caught.
+struct OpiRtCheck
+{
+    OpiRtCheckEnterFunc     enterFunc = 0;
+    OpiRtCheckLeaveFunc     leaveFunc = 0;
+    OpiRtCheckCountFunc     countFunc = 0;
+    OpiRtCheckGetFunc       getFunc = 0;
+    OpiRtCheckClearFunc     clearFunc = 0;
+
+    // false if OpiRtCheck.so isn't preloaded, enter() and leave() do nothing then
+    bool load()
+    {
+#ifndef _WIN32
+        enterFunc = (OpiRtCheckEnterFunc) dlsym(RTLD_DEFAULT, "opiRtCheckEnter");
+        leaveFunc = (OpiRtCheckLeaveFunc) dlsym(RTLD_DEFAULT, "opiRtCheckLeave");
+        countFunc = (OpiRtCheckCountFunc) dlsym(RTLD_DEFAULT, "opiRtCheckCount");
+        getFunc = (OpiRtCheckGetFunc) dlsym(RTLD_DEFAULT, "opiRtCheckGet");
+        clearFunc = (OpiRtCheckClearFunc) dlsym(RTLD_DEFAULT, "opiRtCheckClear");
+#endif
+        if(enterFunc && leaveFunc && countFunc && getFunc && clearFunc) return true;
+        enterFunc = 0;
+        leaveFunc = 0;
+        return false;
+    }
+
+    // [RT] around each realtime call, on the thread making it
+    void enter(const char * what) { if(enterFunc) enterFunc(what); }
+    void leave() { if(leaveFunc) leaveFunc(); }
+
+    // violations so far, including those that didn't fit in the table
+    uint32_t count() const { return countFunc ? countFunc() : 0; }
+
+    // recorded violations of one kind, eg. "malloc"
+    uint32_t count(const char * kind) const
+    {
+        uint32_t n = 0;
+        OpiRtViolation v;
+        for(uint32_t i = 0; getFunc && getFunc(i, &v); ++i)
+            if(v.kind && !strcmp(v.kind, kind)) ++n;
+        return n;
+    }
+
+    void clear() { if(clearFunc) clearFunc(); }
+
+    // Prints the violations grouped by identical stacks, most frequent first,
+    // with up to maxStacks stacks of maxDepth frames. Returns count().
+    uint32_t report(FILE * f, uint32_t maxStacks = 8, uint32_t maxDepth = 12)
+    {
+        uint32_t total = count();
+        if(!total) return 0;
+
+        typedef std::tuple<std::string, std::string, std::vector<void*>> Key;
+        std::map<Key, uint32_t> stacks;
+
+        OpiRtViolation v;
+        for(uint32_t i = 0; getFunc && getFunc(i, &v); ++i)
+        {
+            Key key(v.kind ? v.kind : "?", v.what ? v.what : "?",
+                std::vector<void*>(v.frames, v.frames + v.nFrames));
+            ++stacks[key];
+        }
+
+        std::vector<std::pair<uint32_t, const Key*>> order;
+        for(auto & kv : stacks) order.push_back(std::make_pair(kv.second, &kv.first));
+        std::stable_sort(order.begin(), order.end(),
+            [](const std::pair<uint32_t, const Key*> & a,
+                const std::pair<uint32_t, const Key*> & b) { return a.first > b.first; });
+
+        fprintf(f, "%u violations, %u distinct stacks\n", total, (uint32_t) order.size());
+        for(uint32_t s = 0; s < order.size() && s < maxStacks; ++s)
+        {
+            const Key & key = *order[s].second;
+            const std::vector<void*> & frames = std::get<2>(key);
+            fprintf(f, "%6ux %s in %s\n", order[s].first,
+                std::get<0>(key).c_str(), std::get<1>(key).c_str());
+            for(uint32_t i = 0; i < frames.size() && i < maxDepth; ++i)
+                fprintf(f, "        #%-2u %s\n", i, symbolize(frames[i]).c_str());
+        }
+        if(order.size() > maxStacks)
+            fprintf(f, "        ... %u more stacks\n", (uint32_t) order.size() - maxStacks);
+        return total;
+    }
+
+    // "module(function+0xoffset)" as far as the dynamic symbols tell
+    static std::string symbolize(void * addr)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%p", addr);
+#ifndef _WIN32
+        Dl_info info;
+        if(!dladdr(addr, &info) || !info.dli_fname) return buf;
+
+        std::string module = info.dli_fname;
+        size_t slash = module.find_last_of('/');
+        if(slash != std::string::npos) module = module.substr(slash + 1);
+        if(!info.dli_sname) return module + "(" + buf + ")";
+
+        int status = 0;
+        char * demangled = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+        std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+
+        snprintf(buf, sizeof(buf), "+0x%lx",
+            (unsigned long) ((const char*) addr - (const char*) info.dli_saddr));
+        return module + "(" + name + buf + ")";
+#else
+        return buf;
+#endif
+    }
+};
@@ -0,0 +1,388 @@
+/*
+/// # Community Plugin Format Plugin Scanning
+///
+/// ## About
+/// Reference host support for building a plugin list: OpiPluginInfo is what
+/// the host keeps per plugin binary, opiScanPlugin fills it in from
+/// OpiPluginDescriptor (or from a temporary instance for plugins without one)
+/// and OpiScanCache remembers the results across runs, so binaries that
+/// haven't changed are not even loaded.
+///
+/// ## Details
+/// A cached entry is used as long as the size and modification time of the
+/// file match. If only the time differs (eg. the file was touched or copied
+/// over with the same contents) the file is hashed, and the entry is still
+/// used if the hash matches. Binaries that fail to load are cached as well,
+/// so a broken plugin doesn't slow down every startup.
+///
+/// Cache file layout (native byte order):
+/// - header: OpiScanCache::Header
+/// - per plugin: OpiScanCache::Record, the path, then per parameter the
+///   default value (float), the name size (uint32_t) and the name
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiScanCache cache;
+///    cache.load("plugins.opic");    // a missing or broken file is just empty
+///    for(... every plugin binary ...)
+///    {
+///        const OpiPluginInfo & info = cache.scan(path);
+///        if(info.loaded) ... add to the plugin list ...
+///    }
+///    cache.save("plugins.opic");
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#pragma once
+
+#include "CommunityHost.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+#include <sys/stat.h>
+
+/*
+ * ==============================================================
+ *
+ *                          FILES
+ *
+ * ===============================================================
+ */
+
+// modification time in nanoseconds and size in bytes, false if missing
+static inline bool opiFileStat(const char * path, uint64_t & mtime, uint64_t & size)
+{
+#ifdef _WIN32
+    struct __stat64 st;
+    if(_stat64(path, &st)) return false;
+    mtime = (uint64_t) st.st_mtime * 1000000000ull;
+#else
+    struct stat st;
+    if(stat(path, &st)) return false;
+# ifdef __APPLE__
+    mtime = (uint64_t) st.st_mtimespec.tv_sec * 1000000000ull + st.st_mtimespec.tv_nsec;
+# else
+    mtime = (uint64_t) st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+# endif
+#endif
+    size = (uint64_t) st.st_size;
+    return true;
+}
+
+// Hash of the contents for spotting changes (not cryptographic), 8 bytes at
+// a time so that hashing stays cheap next to loading. 0 if unreadable.
+static inline uint64_t opiFileHash(const char * path)
+{
+    FILE * f = fopen(path, "rb");
+    if(!f) return 0;
+
+    uint64_t hash = 14695981039346656037ull;
+    uint64_t words[8192];
+    size_t n;
+    while((n = fread(words, 1, sizeof(words), f)) > 0)
+    {
+        // zero the tail of a partial word so the result is deterministic
+        if(n & 7) memset((char*) words + n, 0, 8 - (n & 7));
+        for(size_t i = 0; i < (n + 7) / 8; ++i)
+        {
+            hash = (hash ^ words[i]) * 1099511628211ull;
+            hash ^= hash >> 29;
+        }
+        hash = (hash ^ n) * 1099511628211ull;
+    }
+    fclose(f);
+    return hash ? hash : 1;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          SCAN
+ *
+ * ===============================================================
+ */
+
+// What the host knows about a plugin binary without an instance.
+struct OpiPluginInfo
+{
+    std::string path;
+
+    // the file this was scanned from
+    uint64_t    mtime = 0;          // nanoseconds
+    uint64_t    size = 0;
+    uint64_t    hash = 0;           // 0 = unknown
+
+    bool        loaded = false;     // false if the binary failed to load
+    bool        fromDescriptor = false; // false if it took an instance
+
+    uint32_t    nInputs = 0;
+    uint32_t    nOutputs = 0;
+    uint32_t    maxChannels = 0;
+    uint32_t    inEventMask = 0;
+    uint32_t    outEventMask = 0;
+
+    std::vector<std::string>    paramNames;
+    std::vector<float>          paramDefaults;
+};
+
+// Loads the binary and fills in info from OpiPluginDescriptor, or if the
+// plugin doesn't have one, from a temporary instance. Only touches what the
+// plugin reports; the file identity is up to the caller.
+static inline bool opiScanPlugin(const char * path, OpiPluginInfo & info,
+    bool useDescriptor = true)
+{
+    info.path = path;
+    info.loaded = false;
+    info.fromDescriptor = false;
+    info.paramNames.clear();
+    info.paramDefaults.clear();
+
+    OpiHostLibrary lib;
+    if(!lib.open(path)) return false;
+
+    const OpiDescriptor * d = useDescriptor && lib.descriptor ? lib.descriptor() : 0;
+    if(d && d->descriptorSize >= offsetof(OpiDescriptor, params) + sizeof(d->params))
+    {
+        info.nInputs = d->nInputs;
+        info.nOutputs = d->nOutputs;
+        info.maxChannels = d->maxChannels;
+        info.inEventMask = d->inEventMask;
+        info.outEventMask = d->outEventMask;
+
+        info.paramNames.resize(d->nParams);
+        info.paramDefaults.resize(d->nParams);
+        for(uint32_t i = 0; i < d->nParams; ++i)
+        {
+            info.paramNames[i] = d->params[i].name ? d->params[i].name : "";
+            info.paramDefaults[i] = d->params[i].defaultValue;
+        }
+        info.loaded = true;
+        info.fromDescriptor = true;
+        return true;
+    }
+
+    OpiHostInstance inst;
+    if(!inst.create(lib.entrypoint)) return false;
+
+    info.nInputs = (uint32_t) inst.dispatch(opiPlugNumInputs);
+    info.nOutputs = (uint32_t) inst.dispatch(opiPlugNumOutputs);
+    info.maxChannels = (uint32_t) inst.dispatch(opiPlugMaxChannels);
+    info.inEventMask = (uint32_t) inst.dispatch(opiPlugInEventMask);
+    info.outEventMask = (uint32_t) inst.dispatch(opiPlugOutEventMask);
+
+    uint32_t nParams = (uint32_t) inst.dispatch(opiPlugNumParam);
+    info.paramNames.resize(nParams);
+    info.paramDefaults.resize(nParams);
+    for(uint32_t i = 0; i < nParams; ++i)
+    {
+        OpiString name = { 0, 0 };
+        if(inst.dispatch(opiPlugGetParamName, i, &name) && name.data)
+        {
+            // some plugins count the terminating zero
+            uint32_t size = name.size;
+            while(size && !name.data[size - 1]) --size;
+            info.paramNames[i].assign(name.data, size);
+        }
+        float value = 0;
+        inst.dispatch(opiPlugGetParam, i, &value);
+        info.paramDefaults[i] = value;
+    }
+    info.loaded = true;
+    return true;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          CACHE
+ *
+ * ===============================================================
+ */
+
+struct OpiScanCache
+{
+    static const uint32_t   version = 1;
+
+    struct Header
+    {
+        char        magic[8];   // "OPISCAN\0"
+        uint32_t    version;
+        uint32_t    nPlugins;
+    };
+
+    struct Record
+    {
+        uint64_t    mtime;
+        uint64_t    size;
+        uint64_t    hash;
+        uint32_t    flags;      // flagLoaded | flagDescriptor
+        uint32_t    nInputs;
+        uint32_t    nOutputs;
+        uint32_t    maxChannels;
+        uint32_t    inEventMask;
+        uint32_t    outEventMask;
+        uint32_t    nParams;
+        uint32_t    pathSize;
+    };
+
+    static const uint32_t   flagLoaded = 1<<0;
+    static const uint32_t   flagDescriptor = 1<<1;
+
+    std::map<std::string, OpiPluginInfo>    plugins;
+
+    // how the scan() calls so far were answered
+    uint32_t    nCached = 0;    // size and time matched
+    uint32_t    nHashed = 0;    // time changed, contents didn't
+    uint32_t    nScanned = 0;   // the binary was loaded
+
+    // The info for the binary at path, from the cache if it's unchanged.
+    // The reference stays valid until the entry is scanned again or the
+    // cache is loaded or cleared.
+    const OpiPluginInfo & scan(const char * path)
+    {
+        uint64_t mtime = 0, size = 0, hash = 0;
+        bool exists = opiFileStat(path, mtime, size);
+
+        OpiPluginInfo & info = plugins[path];
+        if(exists && info.path == path && info.size == size)
+        {
+            if(info.mtime == mtime) { ++nCached; return info; }
+
+            hash = opiFileHash(path);
+            if(info.hash && hash == info.hash)
+            {
+                info.mtime = mtime;
+                ++nHashed;
+                return info;
+            }
+        }
+
+        ++nScanned;
+        opiScanPlugin(path, info);
+        info.mtime = mtime;
+        info.size = size;
+        info.hash = !exists ? 0 : hash ? hash : opiFileHash(path);
+        return info;
+    }
+
+    void clear()
+    {
+        plugins.clear();
+        nCached = nHashed = nScanned = 0;
+    }
+
+    // Replaces the contents with the file; if it's missing or broken the
+    // cache ends up empty and false is returned.
+    bool load(const char * file)
+    {
+        clear();
+
+        FILE * f = fopen(file, "rb");
+        if(!f) return false;
+
+        Header header;
+        bool ok = fread(&header, sizeof(header), 1, f) == 1
+            && !memcmp(header.magic, "OPISCAN", 8) && header.version == version;
+
+        for(uint32_t p = 0; ok && p < header.nPlugins; ++p)
+        {
+            Record r;
+            ok = fread(&r, sizeof(r), 1, f) == 1
+                && r.pathSize && r.pathSize < (1u << 16) && r.nParams < (1u << 24);
+            if(!ok) break;
+
+            std::string path(r.pathSize, 0);
+            ok = fread(&path[0], 1, r.pathSize, f) == r.pathSize;
+
+            OpiPluginInfo & info = plugins[path];
+            info.path = path;
+            info.mtime = r.mtime;
+            info.size = r.size;
+            info.hash = r.hash;
+            info.loaded = (r.flags & flagLoaded) != 0;
+            info.fromDescriptor = (r.flags & flagDescriptor) != 0;
+            info.nInputs = r.nInputs;
+            info.nOutputs = r.nOutputs;
+            info.maxChannels = r.maxChannels;
+            info.inEventMask = r.inEventMask;
+            info.outEventMask = r.outEventMask;
+            info.paramNames.resize(r.nParams);
+            info.paramDefaults.resize(r.nParams);
+
+            for(uint32_t i = 0; ok && i < r.nParams; ++i)
+            {
+                uint32_t nameSize = 0;
+                ok = fread(&info.paramDefaults[i], sizeof(float), 1, f) == 1
+                    && fread(&nameSize, sizeof(nameSize), 1, f) == 1
+                    && nameSize < (1u << 16);
+                if(!ok || !nameSize) continue;
+
+                info.paramNames[i].resize(nameSize);
+                ok = fread(&info.paramNames[i][0], 1, nameSize, f) == nameSize;
+            }
+        }
+        fclose(f);
+
+        if(!ok) plugins.clear();
+        return ok;
+    }
+
+    // Writes a new file next to the old one and then replaces it, so a
+    // failed save leaves the previous cache intact.
+    bool save(const char * file) const
+    {
+        std::string tmp = std::string(file) + ".tmp";
+        FILE * f = fopen(tmp.c_str(), "wb");
+        if(!f) return false;
+
+        Header header;
+        memcpy(header.magic, "OPISCAN", 8);
+        header.version = version;
+        header.nPlugins = (uint32_t) plugins.size();
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+        for(auto & kv : plugins)
+        {
+            const OpiPluginInfo & info = kv.second;
+
+            Record r;
+            memset(&r, 0, sizeof(r));
+            r.mtime = info.mtime;
+            r.size = info.size;
+            r.hash = info.hash;
+            r.flags = (info.loaded ? flagLoaded : 0)
+                | (info.fromDescriptor ? flagDescriptor : 0);
+            r.nInputs = info.nInputs;
+            r.nOutputs = info.nOutputs;
+            r.maxChannels = info.maxChannels;
+            r.inEventMask = info.inEventMask;
+            r.outEventMask = info.outEventMask;
+            r.nParams = (uint32_t) info.paramNames.size();
+            r.pathSize = (uint32_t) kv.first.size();
+
+            ok = ok && fwrite(&r, sizeof(r), 1, f) == 1
+                && fwrite(kv.first.data(), 1, r.pathSize, f) == r.pathSize;
+
+            for(uint32_t i = 0; ok && i < r.nParams; ++i)
+            {
+                uint32_t nameSize = (uint32_t) info.paramNames[i].size();
+                ok = fwrite(&info.paramDefaults[i], sizeof(float), 1, f) == 1
+                    && fwrite(&nameSize, sizeof(nameSize), 1, f) == 1
+                    && fwrite(info.paramNames[i].data(), 1, nameSize, f) == nameSize;
+            }
+        }
+        if(fclose(f)) ok = false;
+
+#ifdef _WIN32
+        if(ok) remove(file);    // rename doesn't replace on Windows
+#endif
+        if(ok) ok = rename(tmp.c_str(), file) == 0;
+        if(!ok) remove(tmp.c_str());
+        return ok;
+    }
+};
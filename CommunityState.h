@@ -0,0 +1,438 @@
+/*
+/// # Community Plugin Format State Files
+///
+/// ## About
+/// Reference host storage for sectioned plugin state (opiPlugSaveSections and
+/// opiPlugLoadSections): one file per plugin instance, streamed out section
+/// by section, saved incrementally by appending to it and loaded by memory
+/// mapping it, so the plugin only pages in what it actually touches.
+///
+/// ## Details
+/// File layout (native byte order):
+/// - header: OpiStateFile::Header, padded to a page
+/// - section data, every section starting on a page boundary
+/// - section table: one OpiStateFile::Entry per section, padded in front so
+///   that the footer ends on a page boundary
+/// - footer: OpiStateFile::Footer, as the last bytes of the file
+///
+/// A dirty-only save appends the sections the plugin rewrites plus a new table
+/// and footer to the existing file, with kept sections pointing back at their
+/// old data; loading goes by the last footer. If that is missing or broken (a
+/// save that never finished), load() takes the latest consistent footer at an
+/// earlier page boundary instead, which is the last complete save. Once at
+/// least half of the file is dead data the next save is a full one, which is
+/// written to a new file that then replaces the old one (so existing mappings
+/// stay intact).
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    OpiStateFile state;                      // must outlive the instance
+///    state.save(inst, "track1.opis");         // full save
+///    ... user changes things ...
+///    state.save(inst, "track1.opis", true);   // dirty sections only
+///    ...
+///    state.load(inst, "track1.opis");
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// Memory mapping is only implemented for POSIX, elsewhere map() returns 0
+/// and plugins read() the sections instead.
+*/
+
+#pragma once
+
+#include "CommunityHost.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+struct OpiStateFile
+{
+    static const uint64_t   pageSize = 4096;
+    static const uint32_t   version = 1;
+
+    struct Header
+    {
+        char        magic[8];   // "OPISTATE"
+        uint32_t    version;
+        uint32_t    pageSize;
+    };
+
+    struct Entry
+    {
+        uint32_t    id;
+        uint32_t    reserved;
+        uint64_t    offset;     // from the start of the file
+        uint64_t    size;
+    };
+
+    struct Footer
+    {
+        uint64_t    tableOffset;
+        uint32_t    nSections;
+        uint32_t    version;
+        char        magic[8];   // "OPISTEND"
+    };
+
+    std::string         path;       // file that table refers to
+    std::vector<Entry>  table;      // sections of the last save or load
+    uint64_t            fileSize = 0;
+    bool                valid = false;  // table usable for dirty-only saves
+
+    bool                allowMap = true;
+
+    // mapping handed to the plugin by the last load
+    void *      mapBase = 0;
+    uint64_t    mapSize = 0;
+
+    OpiStateFile() {}
+    OpiStateFile(const OpiStateFile &) = delete;
+    OpiStateFile & operator=(const OpiStateFile &) = delete;
+
+    ~OpiStateFile() { unmap(); }
+
+    // Asks the plugin for its state and writes it to path. With dirtyOnly the
+    // plugin may keep sections from the previous save or load, if that was
+    // of the same file. Returns false if the plugin doesn't support sections
+    // or anything fails; a full save then leaves the previous file as it was
+    // and a dirty-only one cuts the file back to its old size. Should the
+    // process die during a dirty-only save, load() still finds the previous
+    // one.
+    bool save(OpiHostInstance & inst, const char * file, bool dirtyOnly = false)
+    {
+        uint64_t live = pageSize;
+        for(const Entry & e : table) live += pageAlign(e.size);
+
+        dirtyOnly = dirtyOnly && valid && path == file && 2 * live > fileSize;
+
+        std::string tmp = std::string(file) + ".tmp";
+        FILE * f = fopen(dirtyOnly ? file : tmp.c_str(), dirtyOnly ? "r+b" : "wb");
+        if(!f) { valid = false; return false; }
+
+        SaveContext ctx;
+        ctx.state = this;
+        ctx.f = f;
+        ctx.ok = true;
+
+        memset(&ctx.writer, 0, sizeof(ctx.writer));
+        ctx.writer.writerSize = sizeof(OpiSectionWriter);
+        ctx.writer.flags = dirtyOnly ? opiSaveDirtyOnly : 0;
+        ctx.writer.ctx = &ctx;
+        ctx.writer.begin = &writerBegin;
+        ctx.writer.write = &writerWrite;
+        ctx.writer.keep = &writerKeep;
+
+        if(dirtyOnly)
+        {
+            ctx.pos = fileSize;
+            ctx.ok = seek(f, fileSize);
+        }
+        else
+        {
+            Header header;
+            memcpy(header.magic, "OPISTATE", 8);
+            header.version = version;
+            header.pageSize = (uint32_t) pageSize;
+            ctx.pos = 0;
+            ctx.ok = ctx.put(&header, sizeof(header)) && ctx.pad(pageSize);
+        }
+
+        bool ok = ctx.ok && inst.dispatch(opiPlugSaveSections, 0, &ctx.writer) && ctx.ok;
+
+        Footer footer;
+        footer.nSections = (uint32_t) ctx.entries.size();
+        footer.version = version;
+        memcpy(footer.magic, "OPISTEND", 8);
+
+        uint64_t tableSize = ctx.entries.size() * sizeof(Entry);
+        ok = ok && ctx.pad(pageSize, tableSize + sizeof(Footer));
+        footer.tableOffset = ctx.pos;
+        ok = ok && ctx.put(ctx.entries.data(), tableSize)
+            && ctx.put(&footer, sizeof(footer)) && !fflush(f);
+
+        if(!ok && dirtyOnly) truncate(f, fileSize);
+        if(fclose(f)) ok = false;
+
+        if(!ok)
+        {
+            if(!dirtyOnly) remove(tmp.c_str());
+            valid = false;
+            return false;
+        }
+
+        if(!dirtyOnly && !replace(tmp.c_str(), file))
+        {
+            remove(tmp.c_str());
+            valid = false;
+            return false;
+        }
+
+        path = file;
+        table.swap(ctx.entries);
+        fileSize = ctx.pos;
+        valid = true;
+        return true;
+    }
+
+    // Loads the state from path into the plugin. Returns false if the file is
+    // broken or the plugin doesn't support sections (or fails to load).
+    bool load(OpiHostInstance & inst, const char * file)
+    {
+        FILE * f = fopen(file, "rb");
+        if(!f) return false;
+
+        LoadContext ctx;
+        ctx.f = f;
+        ctx.base = 0;
+
+        // the last footer, or failing that the latest one at a page boundary
+        uint64_t size = 0;
+        bool ok = seekEnd(f, size) && readTable(f, size, ctx.entries);
+        for(uint64_t end = size & ~(pageSize - 1); !ok && end >= 2 * pageSize; end -= pageSize)
+            ok = end != size && readTable(f, end, ctx.entries);
+        if(!ok) { fclose(f); return false; }
+
+        void * base = allowMap ? map(file, size) : 0;
+        ctx.base = (const char*) base;
+
+        memset(&ctx.reader, 0, sizeof(ctx.reader));
+        ctx.reader.readerSize = sizeof(OpiSectionReader);
+        ctx.reader.nSections = (uint32_t) ctx.entries.size();
+        ctx.reader.ctx = &ctx;
+        ctx.reader.info = &readerInfo;
+        ctx.reader.read = &readerRead;
+        ctx.reader.map = &readerMap;
+
+        ok = inst.dispatch(opiPlugLoadSections, 0, &ctx.reader) != 0;
+        fclose(f);
+
+        // the plugin has let go of the previous mapping by now
+        unmap();
+        mapBase = base;
+        mapSize = base ? size : 0;
+
+        path = file;
+        table.swap(ctx.entries);
+        fileSize = size;
+        valid = ok;
+        return ok;
+    }
+
+private:
+    static uint64_t pageAlign(uint64_t n) { return (n + pageSize - 1) & ~(pageSize - 1); }
+
+    struct SaveContext
+    {
+        OpiSectionWriter    writer;
+        OpiStateFile *      state;
+        FILE *              f;
+        uint64_t            pos;
+        std::vector<Entry>  entries;
+        bool                ok;
+        bool                inSection = false;
+
+        bool put(const void * data, uint64_t size)
+        {
+            if(size && fwrite(data, 1, (size_t) size, f) != size) ok = false;
+            if(ok) pos += size;
+            return ok;
+        }
+
+        // zeros until pos + tail is a multiple of align
+        bool pad(uint64_t align, uint64_t tail = 0)
+        {
+            static const char zeros[64] = {};
+            while(ok && (pos + tail) % align)
+            {
+                uint64_t n = align - (pos + tail) % align;
+                put(zeros, n < sizeof(zeros) ? n : sizeof(zeros));
+            }
+            return ok;
+        }
+
+        bool exists(uint32_t id) const
+        {
+            for(const Entry & e : entries) if(e.id == id) return true;
+            return false;
+        }
+    };
+
+    struct LoadContext
+    {
+        OpiSectionReader    reader;
+        FILE *              f;
+        const char *        base;
+        std::vector<Entry>  entries;
+    };
+
+    static int32_t writerBegin(OpiSectionWriter * w, uint32_t id)
+    {
+        SaveContext & ctx = *((SaveContext*) w->ctx);
+        if(!ctx.ok || ctx.exists(id) || !ctx.pad(pageSize)) return ctx.ok = false;
+
+        Entry e = { id, 0, ctx.pos, 0 };
+        ctx.entries.push_back(e);
+        ctx.inSection = true;
+        return 1;
+    }
+
+    static int32_t writerWrite(OpiSectionWriter * w, const void * data, uint64_t size)
+    {
+        SaveContext & ctx = *((SaveContext*) w->ctx);
+        if(!ctx.ok || !ctx.inSection || !ctx.put(data, size)) return ctx.ok = false;
+        ctx.entries.back().size += size;
+        return 1;
+    }
+
+    static int32_t writerKeep(OpiSectionWriter * w, uint32_t id)
+    {
+        SaveContext & ctx = *((SaveContext*) w->ctx);
+        ctx.inSection = false;
+        if(!ctx.ok || !(w->flags & opiSaveDirtyOnly) || ctx.exists(id)) return ctx.ok = false;
+
+        for(const Entry & e : ctx.state->table)
+        {
+            if(e.id != id) continue;
+            ctx.entries.push_back(e);
+            return 1;
+        }
+        return ctx.ok = false;
+    }
+
+    static int32_t readerInfo(OpiSectionReader * r, uint32_t index,
+        uint32_t * id, uint64_t * size)
+    {
+        LoadContext & ctx = *((LoadContext*) r->ctx);
+        if(index >= ctx.entries.size()) return 0;
+        if(id) *id = ctx.entries[index].id;
+        if(size) *size = ctx.entries[index].size;
+        return 1;
+    }
+
+    static uint64_t readerRead(OpiSectionReader * r, uint32_t index,
+        uint64_t offset, void * data, uint64_t size)
+    {
+        LoadContext & ctx = *((LoadContext*) r->ctx);
+        if(index >= ctx.entries.size()) return 0;
+
+        const Entry & e = ctx.entries[index];
+        if(offset >= e.size) return 0;
+        if(size > e.size - offset) size = e.size - offset;
+
+        if(ctx.base)
+        {
+            memcpy(data, ctx.base + e.offset + offset, (size_t) size);
+            return size;
+        }
+        if(!seek(ctx.f, e.offset + offset)) return 0;
+        return fread(data, 1, (size_t) size, ctx.f);
+    }
+
+    static const void * readerMap(OpiSectionReader * r, uint32_t index)
+    {
+        LoadContext & ctx = *((LoadContext*) r->ctx);
+        if(!ctx.base || index >= ctx.entries.size()) return 0;
+        return ctx.base + ctx.entries[index].offset;
+    }
+
+    // reads the table of a footer ending at end, if there is a consistent one
+    static bool readTable(FILE * f, uint64_t end, std::vector<Entry> & entries)
+    {
+        Footer footer;
+        bool ok = end >= pageSize + sizeof(Footer)
+            && seek(f, end - sizeof(Footer))
+            && fread(&footer, sizeof(footer), 1, f) == 1
+            && !memcmp(footer.magic, "OPISTEND", 8) && footer.version == version
+            && footer.tableOffset <= end - sizeof(Footer)
+            && (end - sizeof(Footer) - footer.tableOffset) / sizeof(Entry) == footer.nSections
+            && (end - sizeof(Footer) - footer.tableOffset) % sizeof(Entry) == 0;
+
+        if(ok)
+        {
+            entries.resize(footer.nSections);
+            ok = seek(f, footer.tableOffset) && (!footer.nSections
+                || fread(entries.data(), sizeof(Entry), footer.nSections, f)
+                    == footer.nSections);
+        }
+        for(uint32_t i = 0; ok && i < entries.size(); ++i)
+        {
+            const Entry & e = entries[i];
+            ok = e.offset >= pageSize && e.offset % pageSize == 0
+                && e.offset <= footer.tableOffset && e.size <= footer.tableOffset - e.offset;
+        }
+        return ok;
+    }
+
+    static bool seek(FILE * f, uint64_t pos)
+    {
+#ifdef _WIN32
+        return !_fseeki64(f, (int64_t) pos, SEEK_SET);
+#else
+        return !fseeko(f, (off_t) pos, SEEK_SET);
+#endif
+    }
+
+    static bool seekEnd(FILE * f, uint64_t & size)
+    {
+#ifdef _WIN32
+        if(_fseeki64(f, 0, SEEK_END)) return false;
+        size = (uint64_t) _ftelli64(f);
+#else
+        if(fseeko(f, 0, SEEK_END)) return false;
+        size = (uint64_t) ftello(f);
+#endif
+        return true;
+    }
+
+    static void truncate(FILE * f, uint64_t size)
+    {
+        fflush(f);
+#ifdef _WIN32
+        _chsize_s(_fileno(f), (int64_t) size);
+#else
+        if(ftruncate(fileno(f), (off_t) size)) {}
+#endif
+    }
+
+    static bool replace(const char * from, const char * to)
+    {
+#ifdef _WIN32
+        return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return !rename(from, to);
+#endif
+    }
+
+    void * map(const char * file, uint64_t size)
+    {
+#ifdef _WIN32
+        (void) file; (void) size;
+        return 0;
+#else
+        int fd = open(file, O_RDONLY);
+        if(fd < 0) return 0;
+        void * base = mmap(0, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        return base == MAP_FAILED ? 0 : base;
+#endif
+    }
+
+    void unmap()
+    {
+#ifndef _WIN32
+        if(mapBase) munmap(mapBase, (size_t) mapSize);
+#endif
+        mapBase = 0;
+        mapSize = 0;
+    }
+};
@@ -0,0 +1,244 @@
+
+#include "Community.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <cstddef>
+
+// Long linear-phase lowpass FIR, brute force. This is deliberately heavy so
+// it can show how a plugin splits its work with opiHostRunTasks: each block
+// is cut into (channel, segment) tasks that the host may run on its workers.
+struct OpiFir : public OpiPlugin
+{
+    static const uint32_t   nTaps = 1024;
+    static const uint32_t   maxChannels = 8;
+    static const uint32_t   minSegment = 32;    // frames, don't split finer
+    static const uint32_t   maxBlock = 4096;    // frames, largest block we take
+
+    uint32_t    nChannels = 0;
+    uint32_t    maxFrames = 0;
+    uint32_t    nSegments = 1;
+
+    OpiProfiler *   profiler = 0;   // from the host, if it has one
+
+    std::vector<float>  kernel;     // reversed, so it lines up with history
+
+    // nTaps-1 old + maxFrames new per channel, in the host's arena if it has
+    // one and in historyStorage otherwise
+    float *             history[maxChannels] = {};
+    std::vector<float>  historyStorage;
+
+    // per block state read by the tasks
+    OpiProcessInfo *    procInfo = 0;
+    uint32_t            segmentFrames = 0;
+
+    OpiFir(OpiCallback hostCallback, void * ptr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = ptr;
+    }
+
+    void design(float samplerate)
+    {
+        // windowed sinc at 1kHz with a Blackman window, unity gain at DC
+        const double pi = 3.14159265358979323846;
+        double fc = 1000. / samplerate, sum = 0;
+        std::vector<double> h(nTaps);
+        for(uint32_t i = 0; i < nTaps; ++i)
+        {
+            double x = i - (nTaps - 1) * .5;
+            double sinc = x ? sin(2 * pi * fc * x) / (pi * x) : 2 * fc;
+            double w = .42 - .5 * cos(2 * pi * i / (nTaps - 1))
+                + .08 * cos(4 * pi * i / (nTaps - 1));
+            sum += h[i] = sinc * w;
+        }
+
+        kernel.resize(nTaps);
+        for(uint32_t i = 0; i < nTaps; ++i)
+            kernel[nTaps - 1 - i] = (float) (h[i] / sum);
+    }
+
+    // floats per channel of history, rounded to whole cache lines
+    uint32_t historyStride() const { return (nTaps - 1 + maxFrames + 15) & ~15u; }
+
+    // on enable and reset, which is also when the host empties its arena
+    void reset()
+    {
+        size_t size = (size_t) nChannels * historyStride();
+        OpiArena * arena = (OpiArena*) dispatchToHost(this, opiHostGetArena, 0, 0);
+        float * block = arena ? (float*) arena->alloc(arena, size * sizeof(float), 64) : 0;
+        if(!block)
+        {
+            historyStorage.resize(size);
+            block = historyStorage.data();
+        }
+        memset(block, 0, size * sizeof(float));
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+            history[c] = block + (size_t) c * historyStride();
+    }
+
+    void runTask(uint32_t task)
+    {
+        uint32_t c = task % nChannels;
+        uint32_t begin = (task / nChannels) * segmentFrames;
+        uint32_t end = std::min(begin + segmentFrames, procInfo->nFrames);
+
+        const float * x = history[c];
+        const float * h = kernel.data();
+        float * out = procInfo->outputs[0].channels[c];
+
+        for(uint32_t n = begin; n < end; ++n)
+        {
+            float acc = 0;
+            for(uint32_t k = 0; k < nTaps; ++k) acc += h[k] * x[n + k];
+            out[n] = acc;
+        }
+    }
+
+    static void taskCallback(void * ctx, uint32_t task)
+    {
+        ((OpiFir*) ctx)->runTask(task);
+    }
+
+    void zoneBegin(const char * name) { if(profiler) profiler->begin(profiler, name); }
+    void zoneEnd() { if(profiler) profiler->end(profiler); }
+
+    void process(OpiProcessInfo * info)
+    {
+        // anything past the event pointers only if processInfoSize covers it
+        // (opiHasEventBuffers, opiFindParamBuffer)
+        assert(info->processInfoSize >= offsetof(OpiProcessInfo, inEventBuffer));
+
+        uint32_t nFrames = info->nFrames;
+        uint64_t silenceMask = info->inputs[0].silenceMask;
+
+        // take the input first, so the outputs may alias it
+        zoneBegin("input");
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            float * dst = history[c] + nTaps - 1;
+            if(silenceMask & (uint64_t(1) << c)) memset(dst, 0, nFrames * sizeof(float));
+            else memcpy(dst, info->inputs[0].channels[c], nFrames * sizeof(float));
+        }
+        zoneEnd();
+
+        procInfo = info;
+        segmentFrames = (nFrames + nSegments - 1) / nSegments;
+        if(segmentFrames < minSegment) segmentFrames = minSegment;
+
+        OpiTaskList tasks;
+        tasks.taskListSize = sizeof(OpiTaskList);
+        tasks.nTasks = nChannels * ((nFrames + segmentFrames - 1) / segmentFrames);
+        tasks.run = &taskCallback;
+        tasks.ctx = this;
+
+        // hosts without workers leave it to us
+        zoneBegin("convolve");
+        if(!dispatchToHost(this, opiHostRunTasks, 0, &tasks))
+        {
+            for(uint32_t i = 0; i < tasks.nTasks; ++i) runTask(i);
+        }
+        zoneEnd();
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            float * h = history[c];
+            memmove(h, h + nFrames, (nTaps - 1) * sizeof(float));
+        }
+        info->outputs[0].silenceMask = 0;
+    }
+
+    int configure(OpiConfig * config)
+    {
+        // alias-safe, since process copies the input before writing anything
+        bool hasFlags = config->configSize > offsetof(OpiConfig, flags);
+        uint32_t flags = hasFlags ? config->flags : 0;
+        if(flags & ~(opiConfigInPlace | opiConfigOffline)) return 0;
+
+        uint32_t n = config->inBusChannels[0].nChannels;
+        if(n != config->outBusChannels[0].nChannels || n > maxChannels) return 0;
+
+        // hosts that know about flags also accept a lower block size
+        if(config->blocksize > maxBlock)
+        {
+            if(!hasFlags) return 0;
+            config->blocksize = maxBlock;
+        }
+
+        nChannels = n;
+        maxFrames = config->blocksize;
+        design(config->samplerate);
+
+        // the history is set up by reset(), from the arena if we get one
+        historyStorage.clear();
+        if(config->configSize > offsetof(OpiConfig, arenaSize))
+            config->arenaSize = (uint64_t) n * historyStride() * sizeof(float);
+
+        profiler = (OpiProfiler*) dispatchToHost(this, opiHostGetProfiler, 0, 0);
+
+        // enough tasks to keep every worker busy, even with few channels
+        intptr_t nWorkers = dispatchToHost(this, opiHostNumWorkers, 0, 0);
+        nSegments = 1;
+        if(n && nWorkers > (intptr_t) n) nSegments = ((uint32_t) nWorkers + n - 1) / n;
+        return 1;
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t idx, void*data)
+    {
+        OpiFir * plug = (OpiFir*) ptr;
+
+        if(!op)
+        {
+            plug->process((OpiProcessInfo*) data);
+            return 1;
+        }
+
+        switch(op)
+        {
+        case opiPlugDestroy: delete plug; return 1;
+
+        case opiPlugNumInputs: return 1;
+        case opiPlugNumOutputs: return 1;
+        case opiPlugMaxChannels: return maxChannels;
+
+        case opiPlugInEventMask: return 0;
+        case opiPlugOutEventMask: return 0;
+
+        case opiPlugGetLatency: return (nTaps - 1) / 2;
+        case opiPlugGetTailFrames: *((uint32_t*)data) = nTaps - 1; return 1;
+
+        case opiPlugConfig: return plug->configure((OpiConfig*) data);
+        case opiPlugReset: plug->reset(); return 1;
+
+        case opiPlugEnable: plug->reset(); return 1;
+        case opiPlugDisable: return 1;
+
+        case opiPlugNumParam: return 0;
+
+        default: return 0;
+        }
+    }
+};
+
+DLLEXPORT OpiPlugin * OpiPluginEntrypoint(OpiCallback hostCallback, void * hostPtr)
+{
+    return new OpiFir(hostCallback, hostPtr);
+}
+
+DLLEXPORT const OpiDescriptor * OpiPluginDescriptor()
+{
+    static const OpiDescriptor descriptor =
+    {
+        sizeof(OpiDescriptor),
+        1, 1, OpiFir::maxChannels,
+        0, 0,
+        0, 0
+    };
+    return &descriptor;
+}
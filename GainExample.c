@@ -1,74 +1,327 @@
 
-#include "plugin-opi.h"
+#include "Community.h"
+#include "CommunityDsp.h"
+#include "CommunityEvents.h"
+#include "CommunityParams.h"
 
 #include <vector>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <cstddef>
 
 struct OpiGain : public OpiPlugin
 {
-    std::vector<char> stringBuffer;
+    std::vector<char> stringBuffer;     // for hosts without opiHostGetScratch
 
-    int nChannels = 0;
-    float gain = 1;
+    static const uint32_t maxChannels = 1024;
+
+    uint32_t nChannels = 0;
+    uint32_t silenceChannels = 0;   // channels with silence bits (see configure)
+    uint32_t interleave = 1;        // channels per group, 1 = planar
+
+    // a gain ramp as one gain per frame, for interleaved groups
+    std::vector<float> rampGains;
+
+    // one instance's audio from a batch, for lanes that need processLane()
+    std::vector<float> laneSamples;
+    std::vector<char> laneBus;
+
+    OpiParamStore params;       // gain as seen by opiPlugGetParam/SetParam
+    OpiEventScheduler events;   // gain as seen by process
+    OpiParamNotifier notifier;  // automated gain for the host, sent on opiPlugIdle
 
     OpiGain(OpiCallback hostCallback, void * ptr)
     {
         dispatchToHost = hostCallback;
         dispatchToPlugin = &pluginDispatcher;
         ptrHost = ptr;
+
+        float gain = 1;
+        params.init(1, &gain);
+        events.init(1, &gain);
+        notifier.init(64);
     }
 
     void process(OpiProcessInfo * procInfo)
     {
-        assert(procInfo->processInfoSize == sizeof(OpiProcessInfo));
+        // anything past the event pointers only if processInfoSize covers it
+        // (opiHasEventBuffers, opiFindParamBuffer)
+        assert(procInfo->processInfoSize >= offsetof(OpiProcessInfo, inEventBuffer));
         
-        int nFrames = procInfo->nFrames;
+        // pick up any value set with opiPlugSetParam since the last block
+        params.consume([&](uint32_t idx, float value)
+        {
+            events.setParam(idx, value);
+        });
+        float target = events.ramps[0].target;
 
-        uint64_t silenceMask = procInfo->inputs[0].silenceMask;
-        uint64_t skipMask = silenceMask & procInfo->outputs[0].silenceMask;
+        OpiBusChannels * inBus = procInfo->inputs;
+        OpiBusChannels * outBus = procInfo->outputs;
+        uint32_t w = interleave;
 
-        for(int c = 0; c < nChannels; ++c)
+        // with a buffer the gain is just another input signal
+        const OpiParamBuffer * gainBuffer = opiFindParamBuffer(procInfo, 0);
+
+        events.process(procInfo, [&](uint32_t offset, uint32_t nFrames)
         {
-            if((1<<c) & skipMask) continue;
-            if((1<<c) & silenceMask)
+            const OpiParamRamp & g = events.ramps[0];
+
+            // interleaved groups take a ramp as one gain per frame, which
+            // gives exactly the same gains as opiDspScaleRamp
+            const float * frameGains = gainBuffer ? gainBuffer->values + offset : 0;
+            if(w > 1 && !frameGains && g.active())
             {
-                for(int i = 0; i < nFrames; ++i)
-                {
-                    procInfo->outputs[0].channels[c][i] = 0;
-                }
+                opiDspRamp(rampGains.data(), g.value, g.at(nFrames), nFrames);
+                frameGains = rampGains.data();
             }
-            else
+
+            // a group at a time (planar is groups of one), skipped or cleared
+            // only if every channel in it is silent
+            for(uint32_t c = 0; c < nChannels; c += w)
             {
-                for(int i = 0; i < nFrames; ++i)
-                {
-                    procInfo->outputs[0].channels[c][i]
-                        = gain * procInfo->inputs[0].channels[c][i];
-                }
+                uint32_t n = std::min(w, nChannels - c);
+                bool silent = opiAllSilent(inBus, silenceChannels, c, n);
+                if(silent && opiAllSilent(outBus, silenceChannels, c, n)) continue;
+
+                float * out = outBus->channels[c] + offset * w;
+                float * in = inBus->channels[c] + offset * w;
+                uint32_t size = nFrames * w;
+
+                if(silent) opiDspClear(out, size);
+                else if(w > 1 && frameGains) opiDspScaleFrames(out, in, frameGains, w, size);
+                else if(gainBuffer) opiDspMultiply(out, in, frameGains, size);
+                else if(g.active()) opiDspScaleRamp(out, in, g.value, g.at(nFrames), size);
+                else opiDspScale(out, in, g.value, size);
             }
+        });
+
+        // silent in, silent out; only now, since the check above skips
+        // groups already flagged silent on both sides
+        for(uint32_t c = 0; c < nChannels; c += w)
+        {
+            uint32_t n = std::min(w, nChannels - c);
+            bool silent = opiAllSilent(inBus, silenceChannels, c, n);
+            for(uint32_t k = c; k < c + n; ++k) opiSetSilent(outBus, silenceChannels, k, silent);
         }
+
+        if(gainBuffer && procInfo->nFrames)
+            events.setParam(0, gainBuffer->values[procInfo->nFrames - 1]);
+
+        publish(target);
     }
 
-    int configure(OpiConfig * config)
+    // makes the gain after a block visible to opiPlugGetParam and, if events
+    // moved it away from target (the value before them), queues it for the
+    // host as well
+    void publish(float target)
+    {
+        float value = events.ramps[0].target;
+        params.publish(0, value);
+        if(value != target) notifier.push(0, value);
+    }
+
+    // Processes a batch of instances (see opiPlugProcessBatch) on whichever
+    // one the host called. Lanes without events or ramps are scaled across
+    // instances in one pass; any others are then redone on their own, with
+    // exactly the same arithmetic as process. Those are gathered before the
+    // pass, since with opiConfigInPlace it overwrites their input.
+    static const uint32_t maxBatch = 64;
+
+    static void processBatch(OpiBatchInfo * batch)
     {
-        if(config->inBusChannels[0].nChannels
-        == config->inBusChannels[1].nChannels)
+        uint32_t nLanes = batch->nInstances;
+        uint32_t nFrames = batch->nFrames;
+        uint32_t nChannels = ((OpiGain*) batch->plugins[0])->nChannels;
+        uint32_t silenceChannels = ((OpiGain*) batch->plugins[0])->silenceChannels;
+
+        float gains[maxBatch];
+        bool fast[maxBatch];
+        for(uint32_t k = 0; k < nLanes; ++k)
         {
-            nChannels = config->inBusChannels[0].nChannels;
-            return 1;
+            OpiGain * plug = (OpiGain*) batch->plugins[k];
+            OpiProcessInfo * info = batch->procInfos[k];
+
+            plug->params.consume([&](uint32_t idx, float value)
+            {
+                plug->events.setParam(idx, value);
+            });
+
+            bool hasEvents = info->nInEvents
+                || (opiHasEventBuffers(info) && info->inEventBuffer.count)
+                || opiFindParamBuffer(info, 0);
+            fast[k] = !hasEvents && !plug->events.ramps[0].active();
+            gains[k] = plug->events.ramps[0].value;
+            if(!fast[k]) plug->gatherLane(batch, k);
         }
-        else
+
+        for(uint32_t c = 0; c < nChannels; ++c)
         {
+            bool silent = opiIsSilent(batch->inputs, silenceChannels, c);
+            if(silent && opiIsSilent(batch->outputs, silenceChannels, c)) continue;
+
+            float * out = batch->outputs[0].channels[c];
+            float * in = batch->inputs[0].channels[c];
+
+            if(silent) opiDspClear(out, nFrames * nLanes);
+            else opiDspScaleLanes(out, in, gains, nLanes, nFrames * nLanes);
+            opiSetSilent(batch->outputs, silenceChannels, c, silent);
+        }
+
+        for(uint32_t k = 0; k < nLanes; ++k)
+        {
+            OpiGain * plug = (OpiGain*) batch->plugins[k];
+            if(fast[k]) plug->params.publish(0, plug->events.ramps[0].target);
+            else plug->processLane(batch, k);
+        }
+    }
+
+    // copies one lane of a batch's input into laneBus
+    void gatherLane(OpiBatchInfo * batch, uint32_t k)
+    {
+        uint32_t nLanes = batch->nInstances;
+        uint32_t nFrames = batch->nFrames;
+        OpiBusChannels * bus = (OpiBusChannels*) laneBus.data();
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            const float * src = batch->inputs[0].channels[c] + k;
+            for(uint32_t i = 0; i < nFrames; ++i) bus->channels[c][i] = src[i * nLanes];
+        }
+        for(uint32_t w = 0; w < opiSilenceWords(silenceChannels); ++w)
+        {
+            *opiSilenceWord(bus, silenceChannels, w) =
+                *opiSilenceWord(batch->inputs, silenceChannels, w);
+        }
+    }
+
+    // runs a lane gathered by gatherLane through process(), in place in
+    // laneBus, and scatters it into the batch's output
+    void processLane(OpiBatchInfo * batch, uint32_t k)
+    {
+        uint32_t nLanes = batch->nInstances;
+        uint32_t nFrames = batch->nFrames;
+        OpiBusChannels * bus = (OpiBusChannels*) laneBus.data();
+
+        OpiProcessInfo info = *batch->procInfos[k];
+        info.inputs = bus;
+        info.outputs = bus;
+        process(&info);
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            float * dst = batch->outputs[0].channels[c] + k;
+            for(uint32_t i = 0; i < nFrames; ++i) dst[i * nLanes] = bus->channels[c][i];
+        }
+    }
+
+    // same as process, but time doesn't move (so ramps only start)
+    void flushEvents(OpiProcessInfo * procInfo)
+    {
+        params.consume([&](uint32_t idx, float value)
+        {
+            events.setParam(idx, value);
+        });
+        float target = events.ramps[0].target;
+        events.process(procInfo, [](uint32_t, uint32_t) {});
+        publish(target);
+    }
+
+    int configure(OpiConfig * config)
+    {
+        // process is alias-safe (the kernels allow dst == src), the
+        // scheduler reads either event transport, offline is no different
+        // and the channel loop takes any silence bits and group size
+        uint32_t flags = config->configSize > offsetof(OpiConfig, flags)
+            ? config->flags : 0;
+        if(flags & ~(opiConfigInPlace | opiConfigPackedEvents | opiConfigOffline
+            | opiConfigWideSilence | opiConfigInterleaved))
             return 0;
+
+        OpiBusConfig & in = config->inBusChannels[0];
+        OpiBusConfig & out = config->outBusChannels[0];
+        if(in.nChannels != out.nChannels || in.nChannels > maxChannels) return 0;
+
+        nChannels = in.nChannels;
+        silenceChannels = (flags & opiConfigWideSilence) ? nChannels : std::min(nChannels, 64u);
+
+        // the same groups on both sides (for in-place), or planar
+        interleave = 1;
+        if((flags & opiConfigInterleaved)
+            && config->busConfigSize > offsetof(OpiBusConfig, interleave))
+        {
+            if(in.interleave == out.interleave && in.interleave > 1) interleave = in.interleave;
+            else in.interleave = out.interleave = 1;
+        }
+        rampGains.assign(config->blocksize, 0.f);
+
+        laneSamples.assign(nChannels * config->blocksize, 0.f);
+        laneBus.assign(opiBusChannelsSize(nChannels), 0);
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            ((OpiBusChannels*) laneBus.data())->channels[c] =
+                laneSamples.data() + c * config->blocksize;
         }
+        return 1;
     }
 
-    void setStringBuffer(const char * data, int size = -1)
+    bool getParam(uint32_t idx, float * value)
     {
-        if(size == -1) size = strlen(data);
-        
-        stringBuffer.resize(size + 1);
-        memcpy(stringBuffer.data(), data, size);
-        stringBuffer[size] = 0;
+        switch(idx)
+        {
+        case 0: *value = params.get(0); return true;
+        default: return false;
+        }
+    }
+
+    bool setParam(uint32_t idx, float value)
+    {
+        switch(idx)
+        {
+        case 0:
+            if(value < 0) value = 0;
+            if(value > 1) value = 1;
+            params.set(0, value);
+            return true;
+        default: return false;
+        }
+    }
+
+    bool getParams(OpiParamRange * range)
+    {
+        if(range->first > 1 || range->count > 1 - range->first) return false;
+        for(uint32_t i = 0; i < range->count; ++i)
+            getParam(range->first + i, &range->values[i]);
+        return true;
+    }
+
+    bool setParams(OpiParamRange * range)
+    {
+        if(range->first > 1 || range->count > 1 - range->first) return false;
+        for(uint32_t i = 0; i < range->count; ++i)
+            setParam(range->first + i, range->values[i]);
+        return true;
+    }
+
+    // room for a string result, in the host's scratch memory if it has some
+    char * stringSpace(uint32_t size)
+    {
+        OpiString scratch = { 0, size };
+        if(dispatchToHost(this, opiHostGetScratch, 0, &scratch) && scratch.data)
+            return scratch.data;
+
+        stringBuffer.resize(size);
+        return stringBuffer.data();
+    }
+
+    // NUL terminated copy in stringSpace(), size is set without the NUL
+    char * copyString(const char * data, uint32_t & size)
+    {
+        size = strlen(data);
+        char * str = stringSpace(size + 1);
+        memcpy(str, data, size + 1);
+        return str;
     }
 
     static intptr_t pluginDispatcher(
@@ -88,19 +341,22 @@ struct OpiGain : public OpiPlugin
 
         case opiPlugNumInputs: return 1;    // one input
         case opiPlugNumOutputs: return 1;   // one output
-        case opiPlugMaxChannels: return 2;  // up to 2 channels
+        case opiPlugMaxChannels: return maxChannels;
 
-        case opiPlugInEventMask: return 0;  // don't want events
+        case opiPlugInEventMask: return opiEventWantAutomation;
         case opiPlugOutEventMask: return 0; // don't emit events
 
         case opiPlugGetLatency: return 0;   // no latency
+        case opiPlugGetTailFrames: *((uint32_t*)data) = 0; return 1;
 
         case opiPlugConfig: return plug->configure((OpiConfig*) data);
-        case opiPlugReset: return 1;    // no-op
+        case opiPlugReset: plug->events.reset(); return 1;
 
-        case opiPlugEnable: return 1;   // no-op
+        case opiPlugEnable: plug->events.reset(); return 1;
         case opiPlugDisable: return 1;  // no-op
 
+        case opiPlugIdle: plug->notifier.flush(plug); return 1;
+
         case opiPlugOpenEdit: return 0;     // don't have editor
         case opiPlugCloseEdit: return 0;    // don't have editor
 
@@ -109,72 +365,116 @@ struct OpiGain : public OpiPlugin
             
         case opiPlugNumParam: return 1; // one parameter
         
-        case opiPlugGetParam:
-            switch(idx)
-            {
-            case 0: *((float*)data) = plug->gain; return 1;
-            default: return 0;
-            }
-            
-        case opiPlugSetParam:
-            switch(idx)
-            {
-            case 0:
-                plug->gain = *((float*)data);
-                if(plug->gain < 0) plug->gain = 0;
-                if(plug->gain > 1) plug->gain = 1;
-                return 1;
-            default: return 0;
-            }
+        case opiPlugGetParam: return plug->getParam(idx, (float*)data);
+        case opiPlugSetParam: return plug->setParam(idx, *((float*)data));
 
-        case opiPlugGetParamName:
-            switch(idx)
-            {
-            case 0: plug->setStringBuffer("Gain"); break;
-            default: return 0;
-            }
-            ((OpiString*)data)->data = plug->stringBuffer.data();
-            ((OpiString*)data)->size = plug->stringBuffer.size();
-            return 1;
+        case opiPlugGetParams: return plug->getParams((OpiParamRange*) data);
+        case opiPlugSetParams: return plug->setParams((OpiParamRange*) data);
 
-        case opiPlugValueToString:
+        case opiPlugGetParamChanges:
+            return plug->params.changes((OpiParamChanges*) data);
+
+        case opiPlugFlushEvents: plug->flushEvents((OpiProcessInfo*) data); return 1;
+        case opiPlugGetFuncs: return (intptr_t) &funcs;
+
+        case opiPlugMaxBatch: return plug->interleave > 1 ? 0 : maxBatch;
+        case opiPlugProcessBatch: processBatch((OpiBatchInfo*) data); return 1;
+
+        case opiPlugAcceptsParamBuffer: return idx == 0;
+
+        case opiPlugGetParamName:
             {
+                OpiString * str = (OpiString*) data;
                 switch(idx)
                 {
-                case 0:
-                    // this is very naive
-                    plug->stringBuffer.resize(32); // alloc "enough" space
-                    plug->stringBuffer.resize(
-                        sprintf(plug->stringBuffer.data(),
-                            "%.2f", ((OpiParamString*)data)->value));
-                    break;
+                case 0: str->data = plug->copyString("Gain", str->size); break;
                 default: return 0;
                 }
-                ((OpiParamString*)data)->data = plug->stringBuffer.data();
-                ((OpiParamString*)data)->size = plug->stringBuffer.size();
+                return 1;
+            }
+
+        // the gain is a plain number, so the strings come from gainFormat
+        case opiPlugValueToString:
+            {
+                OpiParamString * str = (OpiParamString*) data;
+                if(idx != 0) return 0;
+
+                char text[32];
+                opiFormatValue(gainFormat, str->value, text, sizeof(text));
+                str->data = plug->copyString(text, str->size);
                 return 1;
             }
         case opiPlugStringToValue:
-            switch(idx)
             {
-            case 0:
-                plug->setStringBuffer(
-                    ((OpiString*)data)->data,
-                    ((OpiString*)data)->size);
-                // this is even more naive, but .. whatever
-                sscanf(plug->stringBuffer.data(),
-                    "%f", &(((OpiParamString*)data)->value));
-                break;
-            default: return 0;
+                OpiParamString * str = (OpiParamString*) data;
+                if(idx != 0) return 0;
+                opiParseValue(gainFormat, str->data, str->size, str->value);
+                return 1;
             }
+        case opiPlugValuesToStrings:
+            if(idx != 0) return 0;
+            return opiFormatValues(gainFormat, (OpiParamStrings*) data);
+        case opiPlugStringsToValues:
+            if(idx != 0) return 0;
+            opiParseValues(gainFormat, (OpiParamStrings*) data);
             return 1;
+        case opiPlugGetParamFormat: return idx == 0 ? (intptr_t) &gainFormat : 0;
 
         default: return 0;
         }
     }
+
+    // direct entry points, see OpiPluginFuncs
+    static const OpiPluginFuncs funcs;
+
+    static const OpiParamFormat gainFormat;
+
+    static void funcProcess(OpiPlugin * plug, OpiProcessInfo * procInfo)
+    { ((OpiGain*) plug)->process(procInfo); }
+    static void funcFlushEvents(OpiPlugin * plug, OpiProcessInfo * procInfo)
+    { ((OpiGain*) plug)->flushEvents(procInfo); }
+    static int32_t funcGetParam(OpiPlugin * plug, uint32_t idx, float * value)
+    { return ((OpiGain*) plug)->getParam(idx, value); }
+    static int32_t funcSetParam(OpiPlugin * plug, uint32_t idx, float value)
+    { return ((OpiGain*) plug)->setParam(idx, value); }
+    static int32_t funcGetParams(OpiPlugin * plug, OpiParamRange * range)
+    { return ((OpiGain*) plug)->getParams(range); }
+    static int32_t funcSetParams(OpiPlugin * plug, OpiParamRange * range)
+    { return ((OpiGain*) plug)->setParams(range); }
+    static void funcProcessBatch(OpiPlugin *, OpiBatchInfo * batch)
+    { processBatch(batch); }
 };
 
+const OpiPluginFuncs OpiGain::funcs =
+{
+    sizeof(OpiPluginFuncs),
+    &OpiGain::funcProcess,
+    &OpiGain::funcFlushEvents,
+    &OpiGain::funcGetParam,
+    &OpiGain::funcSetParam,
+    &OpiGain::funcGetParams,
+    &OpiGain::funcSetParams,
+    &OpiGain::funcProcessBatch,
+};
+
+// linear gain with two decimals, eg. "0.50"
+const OpiParamFormat OpiGain::gainFormat = { sizeof(OpiParamFormat), 1, 2, 0 };
+
 DLLEXPORT OpiPlugin * OpiPluginEntrypoint(OpiCallback hostCallback, void * hostPtr)
 {
     return new OpiGain(hostCallback, hostPtr);
 }
+
+// what the dispatcher reports, for scanning without an instance
+DLLEXPORT const OpiDescriptor * OpiPluginDescriptor()
+{
+    static const OpiParamDescriptor params[] = { { "Gain", 1 } };
+    static const OpiDescriptor descriptor =
+    {
+        sizeof(OpiDescriptor),
+        1, 1, OpiGain::maxChannels,
+        opiEventWantAutomation, 0,
+        1, params
+    };
+    return &descriptor;
+}
@@ -0,0 +1,4810 @@
+/*
+/// # opi_bench
+///
+/// ## About
+/// Reference host and benchmark harness. Loads plugins through
+/// OpiPluginEntrypoint and times opiPlugProcess over a matrix of block sizes,
+/// channel counts, silenceMask patterns and event densities.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    g++ -O2 -shared -fPIC -x c++ GainExample.c -o GainExample.so
+///    g++ -O2 OpiBench.cpp -o opi_bench -ldl -lpthread
+///    ./opi_bench [--suite name] [--frames n] [--golden file] [--threads n]
+///        [--trace file] plugin.so ...
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// For each row the following is reported:
+/// - ns/smp: average time per channel sample (ie. per frame per channel)
+/// - p50/p99/max: per-block process time in microseconds
+/// - checksum: FNV-1a of all output samples, inputs and events are generated
+///   from a fixed seed so this should only change if the output does
+///
+/// With --golden the checksums are compared against the given file, or
+/// written into it if it doesn't exist yet. Mismatches set the exit code.
+*/
+
+#include "CommunityHost.h"
+#include "CommunityDsp.h"
+#include "CommunityEvents.h"
+#include "CommunityParams.h"
+#include "CommunityGraph.h"
+#include "CommunityState.h"
+#include "CommunityProfile.h"
+#include "CommunityScan.h"
+#include "CommunityRtCheck.h"
+#include "CommunityBridge.h"
+#include "CommunityResample.h"
+
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <ctime>
+
+#ifdef _WIN32
+# include <direct.h>
+# include <sys/utime.h>
+#else
+# include <unistd.h>
+# include <utime.h>
+#endif
+
+/*
+ * ==============================================================
+ *
+ *                          HELPER
+ *
+ * ===============================================================
+ */
+
+static inline uint64_t benchNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// xorshift, so the generated input is identical on every platform
+struct BenchRandom
+{
+    uint32_t state = 0x12345678;
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    float uniform() { return (next() >> 8) * (1.f / 16777216.f); }
+    float bipolar() { return 2 * uniform() - 1; }
+};
+
+struct BenchChecksum
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    void add(const void * data, size_t size)
+    {
+        const uint8_t * bytes = (const uint8_t*) data;
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+};
+
+// per-block timings of one benchmark row
+struct BenchTimes
+{
+    std::vector<uint64_t>   blockNs;
+
+    uint64_t total() const
+    {
+        uint64_t sum = 0;
+        for(uint64_t t : blockNs) sum += t;
+        return sum;
+    }
+
+    // sorts in place, so only call this once all the blocks are in
+    double percentileUs(double p)
+    {
+        if(blockNs.empty()) return 0;
+        std::sort(blockNs.begin(), blockNs.end());
+        size_t i = (size_t) (p * (blockNs.size() - 1) + .5);
+        return blockNs[i] * 1e-3;
+    }
+};
+
+struct BenchArgs
+{
+    std::vector<const char *>   plugins;
+
+    uint32_t    totalFrames = 1<<18;    // frames to process per row
+    uint32_t    maxThreads = 0;         // 0 = hardware concurrency
+    const char *golden = 0;             // golden checksum file
+    const char *trace = 0;              // chrome trace output (profile suite)
+    bool        all = false;            // running every suite, not just one
+
+    std::map<std::string, uint64_t> goldenIn;
+    std::map<std::string, uint64_t> goldenOut;
+    int         mismatches = 0;
+
+    void loadGolden()
+    {
+        if(!golden) return;
+        FILE * f = fopen(golden, "r");
+        if(!f) return;
+        char key[256];
+        unsigned long long value;
+        while(fscanf(f, "%255s %llx", key, &value) == 2) goldenIn[key] = value;
+        fclose(f);
+    }
+
+    // returns a short status string for the report
+    const char * checkGolden(const std::string & key, uint64_t value)
+    {
+        if(!golden) return "";
+        goldenOut[key] = value;
+        if(goldenIn.empty()) return "";
+        auto it = goldenIn.find(key);
+        if(it == goldenIn.end()) return " (new)";
+        if(it->second == value) return " ok";
+        ++mismatches;
+        return " MISMATCH";
+    }
+
+    void saveGolden()
+    {
+        if(!golden || !goldenIn.empty()) return;
+        FILE * f = fopen(golden, "w");
+        if(!f) { fprintf(stderr, "cannot write %s\n", golden); return; }
+        for(auto & kv : goldenOut)
+            fprintf(f, "%s %016llx\n", kv.first.c_str(), (unsigned long long) kv.second);
+        fclose(f);
+    }
+};
+
+// configure an instance for a single input and output bus, and enable it
+static bool benchConfigure(OpiHostInstance & inst,
+    uint32_t blockSize, uint32_t nChannels, uint32_t flags = 0)
+{
+    if(!inst.configure(blockSize, 48000, nChannels, nChannels, flags)) return false;
+    inst.dispatch(opiPlugEnable);
+    return true;
+}
+
+static std::string benchPluginName(const char * path)
+{
+    std::string name = path;
+    size_t slash = name.find_last_of("/\\");
+    if(slash != std::string::npos) name = name.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if(dot != std::string::npos) name = name.substr(0, dot);
+    return name;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          PROCESS
+ *
+ * ===============================================================
+ */
+
+enum BenchSilence
+{
+    benchSilenceNone,   // all inputs carry signal
+    benchSilenceHalf,   // odd input channels are silent
+    benchSilenceAll,    // all inputs are silent
+    benchSilenceSkip,   // all inputs silent and outputs already cleared by host
+
+    benchSilenceCount
+};
+
+static const char * benchSilenceNames[benchSilenceCount] =
+    { "none", "half", "all", "skip" };
+
+// everything needed to run opiPlugProcess on one instance at one configuration
+struct BenchProcessRow
+{
+    uint32_t    blockSize;
+    uint32_t    nChannels;
+    uint32_t    silence;
+    uint32_t    eventsPerBlock;
+};
+
+struct BenchProcessState
+{
+    OpiHostBus  input, output;
+
+    std::vector<OpiEventMidi>       midi;
+    std::vector<OpiEventAutomation> automation;
+    std::vector<OpiEvent*>          events;
+
+    OpiTimeInfo     timeInfo;
+    OpiProcessInfo  procInfo;
+
+    BenchRandom     random;
+
+    void setup(const BenchProcessRow & row)
+    {
+        input.allocate(row.nChannels, row.blockSize);
+        output.allocate(row.nChannels, row.blockSize);
+
+        midi.assign(row.eventsPerBlock, OpiEventMidi());
+        automation.assign(row.eventsPerBlock, OpiEventAutomation());
+        events.assign(row.eventsPerBlock, (OpiEvent*) 0);
+
+        memset(&timeInfo, 0, sizeof(timeInfo));
+        timeInfo.infoSize = sizeof(OpiTimeInfo);
+        timeInfo.flags = opiTimeTransportPlaying
+            | opiTimeSamplePosValid | opiTimeTempoValid;
+        timeInfo.tempo = 120;
+
+        memset(&procInfo, 0, sizeof(procInfo));
+        procInfo.processInfoSize = sizeof(OpiProcessInfo);
+        procInfo.nFrames = row.blockSize;
+        procInfo.timeInfo = &timeInfo;
+        procInfo.inputs = input.bus();
+        procInfo.outputs = output.bus();
+        procInfo.inEvents = events.data();
+
+        random = BenchRandom();
+    }
+
+    // fill inputs and events for the next block, outside of the timed region
+    void prepare(const BenchProcessRow & row, uint32_t eventMask, uint32_t nParams)
+    {
+        uint64_t silent = 0;
+        for(uint32_t c = 0; c < row.nChannels; ++c)
+        {
+            bool isSilent = row.silence == benchSilenceAll
+                || row.silence == benchSilenceSkip
+                || (row.silence == benchSilenceHalf && (c & 1));
+
+            if(isSilent)
+            {
+                silent |= uint64_t(1) << c;
+                input.clear(c, row.blockSize);
+            }
+            else
+            {
+                float * in = input.channel(c);
+                for(uint32_t i = 0; i < row.blockSize; ++i)
+                    in[i] = random.bipolar();
+            }
+        }
+        input.bus()->silenceMask = silent;
+
+        if(row.silence == benchSilenceSkip)
+        {
+            for(uint32_t c = 0; c < row.nChannels; ++c) output.clear(c, row.blockSize);
+            output.bus()->silenceMask = silent;
+        }
+        else
+        {
+            output.bus()->silenceMask = 0;
+        }
+
+        // events are evenly spaced, alternating between the wanted types
+        for(uint32_t e = 0; e < row.eventsPerBlock; ++e)
+        {
+            uint32_t delta = (uint32_t) (((uint64_t) e * row.blockSize) / row.eventsPerBlock);
+            bool useMidi = !(eventMask & opiEventWantAutomation)
+                || ((eventMask & opiEventWantMidi) && (e & 1));
+
+            if(useMidi)
+            {
+                OpiEventMidi & ev = midi[e];
+                ev.type = opiEventMidi;
+                ev.delta = delta;
+                ev.data[0] = (e & 2) ? 0x80 : 0x90;
+                ev.data[1] = 36 + (random.next() % 48);
+                ev.data[2] = 1 + (random.next() % 127);
+                ev.data[3] = 0;
+                events[e] = (OpiEvent*) &ev;
+            }
+            else
+            {
+                OpiEventAutomation & ev = automation[e];
+                ev.type = opiEventAutomation;
+                ev.delta = delta;
+                ev.paramIndex = nParams ? e % nParams : 0;
+                ev.targetValue = random.uniform();
+                ev.smoothFrames = row.blockSize / row.eventsPerBlock;
+                events[e] = (OpiEvent*) &ev;
+            }
+        }
+        procInfo.nInEvents = row.eventsPerBlock;
+        procInfo.outEvents = 0;
+        procInfo.nOutEvents = 0;
+    }
+};
+
+// returns false if the plugin rejected the configuration
+static bool benchProcessRow(OpiHostLibrary & lib, const std::string & name,
+    const BenchProcessRow & row, BenchArgs & args)
+{
+    OpiHostInstance inst;
+    if(!inst.create(lib.entrypoint)) return false;
+
+    uint32_t eventMask = (uint32_t) inst.dispatch(opiPlugInEventMask);
+    uint32_t nParams = (uint32_t) inst.dispatch(opiPlugNumParam);
+
+    if(!benchConfigure(inst, row.blockSize, row.nChannels)) return false;
+
+    BenchProcessState state;
+    state.setup(row);
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / row.blockSize, 16);
+    uint32_t nWarmup = std::max<uint32_t>(nBlocks / 16, 4);
+
+    BenchTimes times;
+    times.blockNs.reserve(nBlocks);
+
+    BenchChecksum checksum;
+
+    for(uint32_t b = 0; b < nWarmup + nBlocks; ++b)
+    {
+        state.prepare(row, eventMask, nParams);
+        state.timeInfo.samplePos = (uint64_t) b * row.blockSize;
+
+        uint64_t t0 = benchNow();
+        inst.dispatch(opiPlugProcess, 0, &state.procInfo);
+        uint64_t t1 = benchNow();
+
+        if(b < nWarmup) continue;
+        times.blockNs.push_back(t1 - t0);
+
+        for(uint32_t c = 0; c < row.nChannels; ++c)
+            checksum.add(state.output.channel(c), row.blockSize * sizeof(float));
+    }
+
+    inst.dispatch(opiPlugDisable);
+
+    double nsPerSample = times.total()
+        / ((double) nBlocks * row.blockSize * std::max<uint32_t>(row.nChannels, 1));
+
+    char key[256];
+    snprintf(key, sizeof(key), "%s:b%u:c%u:%s:e%u", name.c_str(),
+        row.blockSize, row.nChannels, benchSilenceNames[row.silence],
+        row.eventsPerBlock);
+
+    const char * status = args.checkGolden(key, checksum.hash);
+
+    double p50 = times.percentileUs(.5);
+    double p99 = times.percentileUs(.99);
+    double pmax = times.percentileUs(1);
+
+    printf("%-16s %6u %3u %-5s %5u %9.3f %9.2f %9.2f %9.2f  %016llx%s\n",
+        name.c_str(), row.blockSize, row.nChannels,
+        benchSilenceNames[row.silence], row.eventsPerBlock,
+        nsPerSample, p50, p99, pmax, (unsigned long long) checksum.hash, status);
+
+    return true;
+}
+
+static int benchProcess(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "process: no plugins given\n");
+        return 1;
+    }
+
+    static const uint32_t blockSizes[] = { 16, 64, 256, 1024, 4096 };
+
+    printf("%-16s %6s %3s %-5s %5s %9s %9s %9s %9s  %s\n",
+        "plugin", "block", "ch", "sil", "ev", "ns/smp",
+        "p50(us)", "p99(us)", "max(us)", "checksum");
+
+    for(const char * path : args.plugins)
+    {
+        OpiHostLibrary lib;
+        if(!lib.open(path))
+        {
+            fprintf(stderr, "%s: cannot load plugin\n", path);
+            return 1;
+        }
+        std::string name = benchPluginName(path);
+
+        // query capabilities from a throwaway instance
+        uint32_t maxChannels, eventMask;
+        {
+            OpiHostInstance probe;
+            if(!probe.create(lib.entrypoint))
+            {
+                fprintf(stderr, "%s: entrypoint returned no plugin\n", path);
+                return 1;
+            }
+            maxChannels = (uint32_t) probe.dispatch(opiPlugMaxChannels);
+            eventMask = (uint32_t) probe.dispatch(opiPlugInEventMask);
+        }
+        if(maxChannels > 64) maxChannels = 64;
+
+        std::vector<uint32_t> channelCounts;
+        channelCounts.push_back(1);
+        if(maxChannels >= 2) channelCounts.push_back(2);
+        if(maxChannels > 2) channelCounts.push_back(maxChannels);
+
+        for(uint32_t blockSize : blockSizes)
+        {
+            std::vector<uint32_t> densities;
+            densities.push_back(0);
+            if(eventMask)
+            {
+                densities.push_back(1);
+                if(blockSize > 16) densities.push_back(16);
+                if(blockSize > 64) densities.push_back(blockSize / 4);
+            }
+
+            for(uint32_t nChannels : channelCounts)
+            for(uint32_t silence = 0; silence < benchSilenceCount; ++silence)
+            for(uint32_t density : densities)
+            {
+                BenchProcessRow row = { blockSize, nChannels, silence, density };
+                if(!benchProcessRow(lib, name, row, args))
+                {
+                    printf("%-16s %6u %3u %-5s %5u  (config rejected)\n",
+                        name.c_str(), blockSize, nChannels,
+                        benchSilenceNames[silence], density);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          DSP KERNELS
+ *
+ * ===============================================================
+ */
+
+enum BenchKernel
+{
+    benchKernelClear,
+    benchKernelCopy,
+    benchKernelScale,
+    benchKernelScaleRamp,
+    benchKernelMix,
+    benchKernelPeak,
+    benchKernelScaleLanes,
+    benchKernelRamp,
+    benchKernelScaleFrames,
+    benchKernelDot,
+
+    benchKernelCount
+};
+
+static const char * benchKernelNames[benchKernelCount] =
+    { "clear", "copy", "scale", "scaleRamp", "mix", "peak", "scaleLanes", "ramp",
+      "scaleFrames", "dot" };
+
+// gains for scaleLanes, 16 lanes so every size divides evenly
+static const float benchLaneGains[16] =
+    { .1f, .2f, .3f, .4f, .5f, .6f, .7f, .8f, .9f, 1, 1.1f, 1.2f, 1.3f, 1.4f, 1.5f, 1.6f };
+
+// runs one kernel once over n samples, returns the result of peak and dot
+static inline float benchKernelRun(const OpiDspKernels & k,
+    int kernel, float * dst, const float * src, uint32_t n)
+{
+    switch(kernel)
+    {
+    case benchKernelClear: k.clear(dst, n); break;
+    case benchKernelCopy: k.copy(dst, src, n); break;
+    case benchKernelScale: k.scale(dst, src, .5f, n); break;
+    case benchKernelScaleRamp: k.scaleRamp(dst, src, .25f, .75f, n); break;
+    case benchKernelMix: k.mix(dst, src, .5f, n); break;
+    case benchKernelPeak: return k.peak(src, n);
+    case benchKernelScaleLanes: k.scaleLanes(dst, src, benchLaneGains, 16, n); break;
+    case benchKernelRamp: k.ramp(dst, .25f, .75f, n); break;
+    case benchKernelScaleFrames: k.scaleFrames(dst, src, src, 16, n); break;
+    case benchKernelDot: return k.dot(src, src, n);
+    }
+    return 0;
+}
+
+// Times every kernel in every variant the CPU supports against the scalar
+// one; err is the largest difference from the scalar output.
+static int benchDsp(BenchArgs & args)
+{
+    static const uint32_t sizes[] = { 16, 64, 256, 1024, 4096 };
+
+    printf("%-10s %6s %-8s %9s %8s %10s\n",
+        "kernel", "n", "isa", "ns/smp", "speedup", "err");
+
+    std::vector<float> src(4096 + 1), dst(4096 + 1), ref(4096 + 1);
+    BenchRandom random;
+    for(float & x : src) x = random.bipolar();
+
+    for(int kernel = 0; kernel < benchKernelCount; ++kernel)
+    for(uint32_t n : sizes)
+    {
+        double scalarNs = 0;
+
+        // offset by one so the unaligned paths get exercised too
+        const float * in = src.data() + 1;
+        float * out = dst.data() + 1;
+
+        std::fill(ref.begin(), ref.end(), .125f);
+        float refPeak = benchKernelRun(opiDspKernelsScalar, kernel, ref.data() + 1, in, n);
+
+        for(int isa = 0; isa < opiDspIsaCount; ++isa)
+        {
+            const OpiDspKernels * k = opiDspKernelsFor(isa);
+            if(!k) continue;
+
+            std::fill(dst.begin(), dst.end(), .125f);
+            float peak = benchKernelRun(*k, kernel, out, in, n);
+
+            double err = fabs(peak - refPeak);
+            if(kernel != benchKernelMix)    // mix accumulates, check it once only
+            for(uint32_t i = 0; i < n; ++i)
+                err = std::max(err, (double) fabs(out[i] - ref[i + 1]));
+
+            uint32_t reps = std::max<uint32_t>(args.totalFrames / n, 64);
+            volatile float sink = 0;
+
+            uint64_t t0 = benchNow();
+            for(uint32_t r = 0; r < reps; ++r)
+                sink = sink + benchKernelRun(*k, kernel, out, in, n);
+            uint64_t t1 = benchNow();
+
+            double ns = (t1 - t0) / ((double) reps * n);
+            if(isa == opiDspIsaScalar) scalarNs = ns;
+
+            printf("%-10s %6u %-8s %9.4f %7.2fx %10.3g\n",
+                benchKernelNames[kernel], n, k->name, ns,
+                scalarNs / ns, err);
+        }
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          EVENT SCHEDULING
+ *
+ * ===============================================================
+ */
+
+// Cost of sample-accurate automation through OpiEventScheduler, rendering a
+// stereo gain like GainExample does. The "quantized" rows apply only the last
+// event of each block, which is what a plugin ignoring deltas would do.
+static int benchEvents(BenchArgs & args)
+{
+    static const uint32_t blockSize = 256;
+    static const uint32_t nChannels = 2;
+    static const uint32_t densities[] = { 0, 1, 4, 16, 64, 256 };
+    static const uint32_t smoothing[] = { 0, 32, 1024 };
+
+    printf("%-10s %6s %6s %9s %9s\n", "mode", "ev/blk", "smooth", "spans/blk", "ns/smp");
+
+    OpiHostBus input, output;
+    input.allocate(nChannels, blockSize);
+    output.allocate(nChannels, blockSize);
+
+    BenchRandom random;
+    for(uint32_t c = 0; c < nChannels; ++c)
+    for(uint32_t i = 0; i < blockSize; ++i) input.channel(c)[i] = random.bipolar();
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+
+    for(int quantized = 1; quantized >= 0; --quantized)
+    for(uint32_t density : densities)
+    for(uint32_t smooth : smoothing)
+    {
+        if(quantized && smooth) continue;
+        if(!density && smooth) continue;
+
+        // pregenerate a few blocks worth of events, reused cyclically
+        static const uint32_t nPatterns = 16;
+        std::vector<OpiEventAutomation> storage(nPatterns * std::max<uint32_t>(density, 1));
+        std::vector<OpiEvent*> pointers(storage.size());
+        for(size_t e = 0; e < storage.size(); ++e)
+        {
+            OpiEventAutomation & ev = storage[e];
+            ev.type = opiEventAutomation;
+            ev.delta = density ? (uint32_t) ((e % density) * blockSize / density) : 0;
+            ev.paramIndex = 0;
+            ev.targetValue = random.uniform();
+            ev.smoothFrames = smooth;
+            pointers[e] = (OpiEvent*) &ev;
+        }
+
+        OpiEventScheduler sched;
+        float initial = 1;
+        sched.init(1, &initial);
+
+        OpiProcessInfo info;
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = sizeof(OpiProcessInfo);
+        info.nFrames = blockSize;
+        info.inputs = input.bus();
+        info.outputs = output.bus();
+        info.nInEvents = density;
+
+        uint64_t spans = 0;
+        float gain = 1;
+
+        uint64_t t0 = benchNow();
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            info.inEvents = pointers.data() + (b % nPatterns) * density;
+
+            if(quantized)
+            {
+                if(density) gain = ((OpiEventAutomation*) info.inEvents[density - 1])->targetValue;
+                for(uint32_t c = 0; c < nChannels; ++c)
+                    opiDspScale(output.channel(c), input.channel(c), gain, blockSize);
+                ++spans;
+                continue;
+            }
+
+            sched.process(&info, [&](uint32_t offset, uint32_t n)
+            {
+                const OpiParamRamp & g = sched.ramps[0];
+                for(uint32_t c = 0; c < nChannels; ++c)
+                {
+                    float * out = output.channel(c) + offset;
+                    const float * in = input.channel(c) + offset;
+                    if(g.active()) opiDspScaleRamp(out, in, g.value, g.at(n), n);
+                    else opiDspScale(out, in, g.value, n);
+                }
+                ++spans;
+            });
+        }
+        uint64_t t1 = benchNow();
+
+        printf("%-10s %6u %6u %9.2f %9.4f\n",
+            quantized ? "quantized" : "scheduled", density, smooth,
+            spans / (double) nBlocks,
+            (t1 - t0) / ((double) nBlocks * blockSize * nChannels));
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          EVENT TRANSPORT
+ *
+ * ===============================================================
+ */
+
+enum BenchLayout
+{
+    benchLayoutPtrSeq,      // pointer array into one contiguous event array
+    benchLayoutPtrScatter,  // pointer array into events spread over the heap
+    benchLayoutPacked,      // opiConfigPackedEvents
+
+    benchLayoutCount
+};
+
+static const char * benchLayoutNames[benchLayoutCount] =
+    { "ptr-seq", "ptr-scat", "packed" };
+
+// Stand-in for a MIDI effect: transposes note events by an octave and sends
+// everything else through unchanged. Pointer mode outputs come from storage
+// owned by the "plugin", as they would without an arena.
+struct BenchMidiThru
+{
+    std::vector<OpiEventMidi>   outStorage;
+    std::vector<OpiEvent*>      outList;
+
+    void process(OpiProcessInfo * info, bool packed)
+    {
+        uint32_t nOut = 0;
+        for(OpiEventReader events(info); const OpiEvent * ev = events.peek(); events.next())
+        {
+            if(ev->type != opiEventMidi) continue;
+
+            OpiEventMidi midi = *((const OpiEventMidi*) ev);
+            if((midi.data[0] & 0xe0) == 0x80) midi.data[1] = (midi.data[1] + 12) & 0x7f;
+
+            if(packed) opiEventAppend(&info->outEventBuffer, (OpiEvent*) &midi, sizeof(midi));
+            else if(nOut < outStorage.size())
+            {
+                outStorage[nOut] = midi;
+                outList[nOut] = (OpiEvent*) &outStorage[nOut];
+                ++nOut;
+            }
+        }
+        if(!packed)
+        {
+            info->outEvents = outList.data();
+            info->nOutEvents = nOut;
+        }
+    }
+};
+
+// MIDI-dense blocks through the two event transports. Per event, reports the
+// host filling the input, the plugin walking it and writing the output, and
+// the host reading the output back. The checksum covers the output events
+// and must be the same for every layout.
+static int benchMidi(BenchArgs & args)
+{
+    static const uint32_t blockSize = 256;
+    static const uint32_t densities[] = { 64, 256, 1024, 4096, 16384 };
+    static const uint32_t scatterSlots = 1<<20;     // 16MB of event slots
+
+    printf("%6s %-9s %9s %9s %9s %9s  %s\n",
+        "ev/blk", "layout", "fill", "process", "drain", "ns/ev", "checksum");
+
+    // slots for the scatter layout, visited in a shuffled order
+    std::vector<OpiEventMidi> heap(scatterSlots);
+    std::vector<uint32_t> order(scatterSlots);
+    {
+        BenchRandom random;
+        for(uint32_t i = 0; i < scatterSlots; ++i) order[i] = i;
+        for(uint32_t i = scatterSlots - 1; i > 0; --i)
+            std::swap(order[i], order[random.next() % (i + 1)]);
+    }
+
+    for(uint32_t density : densities)
+    for(int layout = 0; layout < benchLayoutCount; ++layout)
+    {
+        bool packed = layout == benchLayoutPacked;
+
+        BenchMidiThru plug;
+        plug.outStorage.resize(density);
+        plug.outList.resize(density);
+
+        std::vector<OpiEventMidi> seq(density);
+        std::vector<OpiEvent*> inList(density);
+
+        OpiEventArena inArena, outArena;
+        inArena.allocate(density * 16);
+        outArena.allocate(density * 16);
+
+        OpiProcessInfo info;
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = sizeof(OpiProcessInfo);
+        info.nFrames = blockSize;
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        uint64_t fillNs = 0, processNs = 0, drainNs = 0;
+        uint32_t scatterPos = 0;
+
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            uint64_t t0 = benchNow();
+
+            inArena.clear();
+            outArena.clear();
+            for(uint32_t e = 0; e < density; ++e)
+            {
+                OpiEventMidi midi;
+                midi.type = opiEventMidi;
+                midi.delta = (uint32_t) ((uint64_t) e * blockSize / density);
+                uint32_t r = random.next();
+                midi.data[0] = (r & 1) ? 0x90 : 0x80;
+                midi.data[1] = (r >> 8) & 0x7f;
+                midi.data[2] = (r >> 16) & 0x7f;
+                midi.data[3] = 0;
+
+                switch(layout)
+                {
+                case benchLayoutPtrSeq:
+                    seq[e] = midi;
+                    inList[e] = (OpiEvent*) &seq[e];
+                    break;
+                case benchLayoutPtrScatter:
+                    {
+                        OpiEventMidi * slot = &heap[order[scatterPos++ % scatterSlots]];
+                        *slot = midi;
+                        inList[e] = (OpiEvent*) slot;
+                    }
+                    break;
+                default:
+                    inArena.add((OpiEvent*) &midi);
+                }
+            }
+
+            if(packed)
+            {
+                info.inEventBuffer = inArena.buffer;
+                info.outEventBuffer = outArena.buffer;
+            }
+            else
+            {
+                info.inEvents = inList.data();
+                info.nInEvents = density;
+            }
+
+            uint64_t t1 = benchNow();
+            plug.process(&info, packed);
+            uint64_t t2 = benchNow();
+
+            if(packed)
+            {
+                const char * data = (const char*) info.outEventBuffer.data;
+                for(uint32_t pos = 0; pos < info.outEventBuffer.size;)
+                {
+                    uint32_t recordSize = *((const uint32_t*) (data + pos));
+                    checksum.add(((const OpiEventMidi*) (data + pos + 4))->data, 4);
+                    pos += recordSize;
+                }
+            }
+            else
+            {
+                for(uint32_t e = 0; e < info.nOutEvents; ++e)
+                    checksum.add(((const OpiEventMidi*) info.outEvents[e])->data, 4);
+            }
+            uint64_t t3 = benchNow();
+
+            fillNs += t1 - t0;
+            processNs += t2 - t1;
+            drainNs += t3 - t2;
+        }
+
+        double n = (double) nBlocks * density;
+        printf("%6u %-9s %9.2f %9.2f %9.2f %9.2f  %016llx\n",
+            density, benchLayoutNames[layout],
+            fillNs / n, processNs / n, drainNs / n,
+            (fillNs + processNs + drainNs) / n,
+            (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          STATE
+ *
+ * ===============================================================
+ */
+
+// Stand-in for a sampler with a large state: a number of zones of sample data,
+// each saved as its own section. Zones loaded from a mapping are used in
+// place and only copied once they are modified.
+struct BenchStatePlugin : public OpiPlugin
+{
+    struct Zone
+    {
+        std::vector<char>   owned;
+        const char *        data = 0;
+        uint64_t            size = 0;
+        bool                dirty = true;
+    };
+
+    std::vector<Zone>   zones;
+    std::vector<char>   chunk;  // opiPlugSaveChunk buffer
+
+    BenchStatePlugin(uint32_t nZones, uint64_t zoneSize)
+    {
+        dispatchToHost = 0;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = 0;
+
+        BenchRandom random;
+        zones.resize(nZones);
+        for(Zone & z : zones)
+        {
+            z.owned.resize(zoneSize);
+            uint32_t * words = (uint32_t*) z.owned.data();
+            for(uint64_t i = 0; i < zoneSize / 4; ++i) words[i] = random.next();
+            z.data = z.owned.data();
+            z.size = zoneSize;
+        }
+    }
+
+    void modify(uint32_t idx, uint32_t value)
+    {
+        Zone & z = zones[idx];
+        if(z.data != z.owned.data())
+        {
+            z.owned.assign(z.data, z.data + z.size);
+            z.data = z.owned.data();
+        }
+        memcpy(z.owned.data(), &value, sizeof(value));
+        z.dirty = true;
+    }
+
+    // reads every byte, so mapped zones are all paged in
+    uint64_t hash() const
+    {
+        BenchChecksum checksum;
+        for(const Zone & z : zones) checksum.add(z.data, (size_t) z.size);
+        return checksum.hash;
+    }
+
+    intptr_t saveChunk(OpiChunk * c)
+    {
+        uint64_t total = sizeof(uint32_t);
+        for(const Zone & z : zones) total += sizeof(uint64_t) + z.size;
+        if(total > 0xffffffffu) return 0;
+
+        chunk.resize((size_t) total);
+        char * p = chunk.data();
+        uint32_t n = (uint32_t) zones.size();
+        memcpy(p, &n, sizeof(n)); p += sizeof(n);
+        for(const Zone & z : zones)
+        {
+            memcpy(p, &z.size, sizeof(z.size)); p += sizeof(z.size);
+            memcpy(p, z.data, (size_t) z.size); p += z.size;
+        }
+        c->data = chunk.data();
+        c->size = (uint32_t) total;
+        return 1;
+    }
+
+    intptr_t loadChunk(OpiChunk * c)
+    {
+        const char * p = (const char*) c->data, * end = p + c->size;
+        uint32_t n;
+        if(end - p < (ptrdiff_t) sizeof(n)) return 0;
+        memcpy(&n, p, sizeof(n)); p += sizeof(n);
+
+        zones.clear();
+        zones.resize(n);
+        for(Zone & z : zones)
+        {
+            if(end - p < (ptrdiff_t) sizeof(z.size)) return 0;
+            memcpy(&z.size, p, sizeof(z.size)); p += sizeof(z.size);
+            if((uint64_t) (end - p) < z.size) return 0;
+            z.owned.assign(p, p + z.size); p += z.size;
+            z.data = z.owned.data();
+            z.dirty = true;
+        }
+        return 1;
+    }
+
+    intptr_t saveSections(OpiSectionWriter * w)
+    {
+        bool dirtyOnly = (w->flags & opiSaveDirtyOnly) != 0;
+        for(uint32_t i = 0; i < zones.size(); ++i)
+        {
+            Zone & z = zones[i];
+            bool ok = (dirtyOnly && !z.dirty) ? w->keep(w, i)
+                : w->begin(w, i) && w->write(w, z.data, z.size);
+            if(!ok) return 0;
+        }
+        for(Zone & z : zones) z.dirty = false;
+        return 1;
+    }
+
+    intptr_t loadSections(OpiSectionReader * r)
+    {
+        zones.clear();
+        zones.resize(r->nSections);
+        for(uint32_t i = 0; i < r->nSections; ++i)
+        {
+            Zone & z = zones[i];
+            uint32_t id;
+            if(!r->info(r, i, &id, &z.size) || id != i) return 0;
+
+            z.dirty = false;
+            z.data = (const char*) r->map(r, i);
+            if(z.data) continue;
+
+            z.owned.resize((size_t) z.size);
+            if(r->read(r, i, 0, z.owned.data(), z.size) != z.size) return 0;
+            z.data = z.owned.data();
+        }
+        return 1;
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t, void * data)
+    {
+        BenchStatePlugin * plug = (BenchStatePlugin*) ptr;
+        switch(op)
+        {
+        case opiPlugDestroy: delete plug; return 1;
+        case opiPlugSaveChunk: return plug->saveChunk((OpiChunk*) data);
+        case opiPlugLoadChunk: return plug->loadChunk((OpiChunk*) data);
+        case opiPlugSaveSections: return plug->saveSections((OpiSectionWriter*) data);
+        case opiPlugLoadSections: return plug->loadSections((OpiSectionReader*) data);
+        default: return 0;
+        }
+    }
+};
+
+// peak resident memory, resettable on Linux only (otherwise returns 0)
+static void benchResetPeakRss()
+{
+#ifdef __linux__
+    FILE * f = fopen("/proc/self/clear_refs", "w");
+    if(f) { fputs("5", f); fclose(f); }
+#endif
+}
+
+static double benchPeakRssMB(const char * field = "VmHWM:")
+{
+#ifdef __linux__
+    FILE * f = fopen("/proc/self/status", "r");
+    if(!f) return 0;
+    char line[256];
+    double kb = 0;
+    while(fgets(line, sizeof(line), f))
+        if(!strncmp(line, field, strlen(field))) kb = atof(line + strlen(field));
+    fclose(f);
+    return kb / 1024;
+#else
+    (void) field;
+    return 0;
+#endif
+}
+
+// Saving and loading a large state (16 zones of 16MB) as one OpiChunk written
+// to a file, against OpiStateFile sections: full, dirty-only after touching
+// a single zone, and loading through a mapping or by reading. Peak is the
+// resident memory high-water mark during the operation minus what was
+// resident before it. State hashes must match between the two paths. Last, a
+// dirty save with its footer torn off must load as the save before it.
+static int benchState(BenchArgs &)
+{
+    static const uint32_t nZones = 16;
+    static const uint64_t zoneSize = 16 << 20;
+    const char * chunkPath = "opi_bench_state.chunk";
+    const char * statePath = "opi_bench_state.opis";
+
+    printf("%u zones x %lluMB\n", nZones, (unsigned long long) (zoneSize >> 20));
+    printf("%-18s %10s %10s  %s\n", "operation", "ms", "peak(MB)", "state");
+
+    OpiHostInstance source;
+    source.plug = new BenchStatePlugin(nZones, zoneSize);
+    BenchStatePlugin * plug = (BenchStatePlugin*) source.plug;
+
+    OpiStateFile stateFile;
+    uint64_t hashSaved = plug->hash();
+    uint64_t hashModified = 0;
+
+    double rssBefore = 0;
+    uint64_t t0 = 0;
+    auto begin = [&]()
+    {
+        rssBefore = benchPeakRssMB("VmRSS:");
+        benchResetPeakRss();
+        t0 = benchNow();
+    };
+    auto end = [&](const char * name, bool ok, uint64_t hash)
+    {
+        double ms = (benchNow() - t0) * 1e-6;
+        double peak = benchPeakRssMB() - rssBefore;
+        if(!ok) printf("%-18s  (failed)\n", name);
+        else printf("%-18s %10.1f %10.1f  %016llx\n", name, ms, peak > 0 ? peak : 0,
+            (unsigned long long) hash);
+    };
+
+    // single buffer: the plugin copies everything into its chunk, the host
+    // writes it out (and the reverse for loading)
+    {
+        begin();
+        OpiChunk chunk = { 0, 0 };
+        bool ok = source.dispatch(opiPlugSaveChunk, 0, &chunk) != 0;
+        FILE * f = ok ? fopen(chunkPath, "wb") : 0;
+        ok = f && fwrite(chunk.data, 1, chunk.size, f) == chunk.size;
+        if(f && fclose(f)) ok = false;
+        std::vector<char>().swap(plug->chunk);
+        end("chunk save", ok, hashSaved);
+    }
+
+    {
+        begin();
+        OpiHostInstance inst;
+        inst.plug = new BenchStatePlugin(0, 0);
+
+        std::vector<char> buffer;
+        FILE * f = fopen(chunkPath, "rb");
+        bool ok = f != 0;
+        if(ok)
+        {
+            fseek(f, 0, SEEK_END);
+            buffer.resize(ftell(f));
+            fseek(f, 0, SEEK_SET);
+            ok = fread(buffer.data(), 1, buffer.size(), f) == buffer.size();
+            fclose(f);
+        }
+        OpiChunk chunk = { buffer.data(), (uint32_t) buffer.size() };
+        ok = ok && inst.dispatch(opiPlugLoadChunk, 0, &chunk);
+        std::vector<char>().swap(buffer);
+        end("chunk load", ok, ((BenchStatePlugin*) inst.plug)->hash());
+    }
+
+    // sections: streamed straight out of the zones
+    {
+        begin();
+        bool ok = stateFile.save(source, statePath);
+        end("sections save", ok, hashSaved);
+    }
+
+    {
+        plug->modify(nZones / 2, 0x12345678);
+        hashModified = plug->hash();
+
+        begin();
+        bool ok = stateFile.save(source, statePath, true);
+        end("sections save dirty", ok, hashModified);
+    }
+
+    for(int mapped = 1; mapped >= 0; --mapped)
+    {
+        begin();
+        OpiHostInstance inst;
+        inst.plug = new BenchStatePlugin(0, 0);
+
+        OpiStateFile loadFile;
+        loadFile.allowMap = mapped != 0;
+        bool ok = loadFile.load(inst, statePath);
+        const char * name = mapped ? "sections load map" : "sections load read";
+        double ms = (benchNow() - t0) * 1e-6;
+        double peak = benchPeakRssMB() - rssBefore;
+
+        // hashing pages in everything, so report it separately for the mapping
+        uint64_t hash = ((BenchStatePlugin*) inst.plug)->hash();
+        if(!ok) printf("%-18s  (failed)\n", name);
+        else printf("%-18s %10.1f %10.1f  %016llx\n", name, ms, peak > 0 ? peak : 0,
+            (unsigned long long) hash);
+    }
+
+    // another dirty save, but as if the process died before its footer was
+    // written: loading must fall back to the one before
+    int failed = 0;
+    {
+        plug->modify(nZones / 4, 0x9abcdef0);
+        bool ok = stateFile.save(source, statePath, true);
+        FILE * f = ok ? fopen(statePath, "r+b") : 0;
+        ok = f && !fseek(f, -8, SEEK_END) && fwrite("OPISTORN", 1, 8, f) == 8;
+        if(f && fclose(f)) ok = false;
+
+        begin();
+        OpiHostInstance inst;
+        inst.plug = new BenchStatePlugin(0, 0);
+        OpiStateFile loadFile;
+        ok = ok && loadFile.load(inst, statePath);
+        uint64_t hash = ((BenchStatePlugin*) inst.plug)->hash();
+        end("sections load torn", ok, hash);
+        if(!ok || hash != hashModified) failed = 1;
+    }
+
+    printf("expected: saved %016llx, modified %016llx (torn falls back to modified)\n",
+        (unsigned long long) hashSaved, (unsigned long long) hashModified);
+
+    remove(chunkPath);
+    remove(statePath);
+    return failed;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          PARAMETER EXCHANGE
+ *
+ * ===============================================================
+ */
+
+struct BenchNotifyCounter
+{
+    std::atomic<uint64_t>   count { 0 };
+
+    static intptr_t hostDispatcher(
+        struct OpiPlugin * plug, int32_t op, int32_t, void *)
+    {
+        BenchNotifyCounter * counter = (BenchNotifyCounter*) plug->ptrHost;
+        if(op != opiHostParamValue) return 0;
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+        return 1;
+    }
+};
+
+// Stress test for CommunityParams.h: writer threads hammer set()/get() while
+// an [RT] thread consumes and publishes per block and a [UI] thread flushes
+// notifications and follows changes(). Afterwards both the [RT] and the [UI]
+// view must match the store exactly and every notification must be either
+// delivered or counted as dropped. Then the first plugin given, if any, with
+// its own notifications delivered by OpiHostInstance::idle().
+// Build with -fsanitize=thread to check for data races.
+static int benchParams(BenchArgs & args)
+{
+    static const uint32_t nParams = 256;
+    static const uint32_t nWriters = 2;
+
+    OpiParamStore store;
+    std::vector<float> defaults(nParams, .5f);
+    store.init(nParams, defaults.data());
+
+    OpiParamNotifier notifier;
+    notifier.init(256);
+
+    BenchNotifyCounter counter;
+    OpiPlugin plug;
+    plug.dispatchToHost = &BenchNotifyCounter::hostDispatcher;
+    plug.dispatchToPlugin = 0;
+    plug.ptrHost = &counter;
+
+    std::vector<float> rtValues(defaults);
+    std::atomic<uint32_t> writersDone { 0 };
+    uint64_t blocks = 0, pushed = 0;
+
+    uint32_t setsPerWriter = args.totalFrames;
+
+    uint64_t t0 = benchNow();
+
+    std::vector<std::thread> writers;
+    for(uint32_t w = 0; w < nWriters; ++w)
+    {
+        writers.emplace_back([&, w]()
+        {
+            BenchRandom random;
+            random.state += w;
+            volatile float sink = 0;
+            for(uint32_t i = 0; i < setsPerWriter; ++i)
+            {
+                uint32_t idx = random.next() % nParams;
+                store.set(idx, random.uniform());
+                sink = sink + store.get(random.next() % nParams);
+
+                // let the other threads in, even on a single core
+                if(!(i & 1023)) std::this_thread::yield();
+            }
+            writersDone.fetch_add(1);
+        });
+    }
+
+    std::thread rt([&]()
+    {
+        for(;;)
+        {
+            bool last = writersDone.load() == nWriters;
+            store.consume([&](uint32_t idx, float value) { rtValues[idx] = value; });
+
+            // pretend automation moved one parameter and tell the host
+            uint32_t idx = blocks % nParams;
+            float value = (blocks & 0xff) * (1.f / 256);
+            rtValues[idx] = value;
+            store.publish(idx, value);
+            notifier.push(idx, value);
+            ++pushed;
+            ++blocks;
+
+            if(last) break;
+            std::this_thread::yield();
+        }
+    });
+
+    // the [UI] side only ever reads what changes() reports
+    std::vector<float> uiValues(nParams);
+    std::vector<uint64_t> changedBits((nParams + 63) / 64);
+    OpiParamChanges changes = { 0, 0, nParams, changedBits.data() };
+    auto followChanges = [&]()
+    {
+        store.changes(&changes);
+        for(uint32_t w = 0; w < changedBits.size(); ++w)
+        for(uint64_t bits = changedBits[w]; bits; bits &= bits - 1)
+        {
+            uint32_t idx = w * 64 + opiCountTrailingZeros(bits);
+            uiValues[idx] = store.get(idx);
+        }
+    };
+
+    std::atomic<bool> rtDone { false };
+    std::thread ui([&]()
+    {
+        while(!rtDone.load())
+        {
+            notifier.flush(&plug);
+            followChanges();
+            std::this_thread::yield();
+        }
+        notifier.flush(&plug);
+    });
+
+    for(std::thread & t : writers) t.join();
+    rt.join();
+    rtDone.store(true);
+    ui.join();
+
+    uint64_t t1 = benchNow();
+
+    // anything set after the final block is picked up by the next one
+    store.consume([&](uint32_t idx, float value) { rtValues[idx] = value; });
+
+    uint32_t mismatches = 0, uiMismatches = 0;
+    for(uint32_t i = 0; i < nParams; ++i) if(rtValues[i] != store.get(i)) ++mismatches;
+
+    followChanges();
+    for(uint32_t i = 0; i < nParams; ++i) if(uiValues[i] != store.get(i)) ++uiMismatches;
+
+    uint64_t delivered = counter.count.load();
+    uint64_t dropped = notifier.dropped.load();
+
+    printf("%-24s %12llu\n", "sets", (unsigned long long) setsPerWriter * nWriters);
+    printf("%-24s %12.1f\n", "ns/set (wall)", (t1 - t0) / ((double) setsPerWriter * nWriters));
+    printf("%-24s %12llu\n", "blocks", (unsigned long long) blocks);
+    printf("%-24s %12llu\n", "notifications delivered", (unsigned long long) delivered);
+    printf("%-24s %12llu\n", "notifications dropped", (unsigned long long) dropped);
+    printf("%-24s %12u\n", "final value mismatches", mismatches);
+    printf("%-24s %12u\n", "missed changes (UI)", uiMismatches);
+
+    if(mismatches || uiMismatches || delivered + dropped != pushed)
+    {
+        fprintf(stderr, "params: stress test FAILED\n");
+        return 1;
+    }
+    if(args.plugins.empty()) return 0;
+
+    // The first plugin, automated on the audio thread while a UI thread calls
+    // OpiHostInstance::idle(): whatever it reports with opiHostParamValue (if
+    // anything) arrives through there.
+    OpiHostLibrary lib;
+    OpiHostInstance inst;
+    static const uint32_t blockSize = 256;
+    if(!lib.open(args.plugins[0]) || !inst.create(lib.entrypoint)
+        || !benchConfigure(inst, blockSize, 2))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    OpiHostBus in, out;
+    in.allocate(2, blockSize);
+    out.allocate(2, blockSize);
+
+    OpiEventAutomation automation = { opiEventAutomation, 0, 0, 0, 0 };
+    OpiEvent * events[1] = { (OpiEvent*) &automation };
+
+    OpiProcessInfo info;
+    memset(&info, 0, sizeof(info));
+    info.processInfoSize = sizeof(OpiProcessInfo);
+    info.nFrames = blockSize;
+    info.inputs = in.bus();
+    info.outputs = out.bus();
+    info.inEvents = events;
+
+    std::atomic<bool> processing { true };
+    std::thread idler([&]()
+    {
+        while(processing.load())
+        {
+            inst.idle();
+            std::this_thread::yield();
+        }
+    });
+
+    // a new value every fourth block
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 64), automated = 0;
+    for(uint32_t b = 0; b < nBlocks; ++b)
+    {
+        info.nInEvents = !(b & 3);
+        automated += info.nInEvents;
+        automation.delta = b % blockSize;
+        automation.targetValue = (b >> 2 & 1) ? .25f : .75f;
+        inst.process(&info);
+        std::this_thread::yield();
+    }
+    processing.store(false);
+    idler.join();
+    inst.idle();
+
+    printf("\n%s, %u blocks\n", benchPluginName(args.plugins[0]).c_str(), nBlocks);
+    printf("%-24s %12u\n", "automation events", automated);
+    printf("%-24s %12u\n", "notifications on idle", inst.paramValues.load());
+    return 0;
+}
+
+// Stand-in for a plugin with a huge number of parameters, implementing both
+// the per-index and the bulk parameter ops on top of OpiParamStore.
+struct BenchParamPlugin : public OpiPlugin
+{
+    OpiParamStore   params;
+
+    explicit BenchParamPlugin(uint32_t nParams)
+    {
+        dispatchToHost = 0;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = 0;
+        params.init(nParams);
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t idx, void * data)
+    {
+        BenchParamPlugin * plug = (BenchParamPlugin*) ptr;
+        OpiParamStore & params = plug->params;
+
+        switch(op)
+        {
+        case opiPlugDestroy: delete plug; return 1;
+        case opiPlugNumParam: return params.nParams;
+
+        case opiPlugGetParam:
+            if((uint32_t) idx >= params.nParams) return 0;
+            *((float*)data) = params.get(idx);
+            return 1;
+        case opiPlugSetParam:
+            if((uint32_t) idx >= params.nParams) return 0;
+            params.set(idx, *((float*)data));
+            return 1;
+
+        case opiPlugGetParams:
+        case opiPlugSetParams:
+            {
+                OpiParamRange * range = (OpiParamRange*) data;
+                if(range->first > params.nParams
+                || range->count > params.nParams - range->first) return 0;
+                if(op == opiPlugGetParams) params.get(range->first, range->count, range->values);
+                else params.set(range->first, range->count, range->values);
+                return 1;
+            }
+
+        case opiPlugGetParamChanges:
+            return params.changes((OpiParamChanges*) data);
+
+        default: return 0;
+        }
+    }
+};
+
+// Host-side parameter sync with 10k parameters: reading and writing all of
+// them (snapshot, preset recall) one call per parameter against one bulk call,
+// and finding the few that changed between syncs by polling every parameter
+// against opiPlugGetParamChanges. Both paths must find the same changes.
+static int benchBulk(BenchArgs &)
+{
+    static const uint32_t nParams = 10000;
+    static const uint32_t nRounds = 1000;
+    static const uint32_t changesPerRound = 16;
+
+    OpiHostInstance inst;
+    inst.plug = new BenchParamPlugin(nParams);
+    BenchParamPlugin * plug = (BenchParamPlugin*) inst.plug;
+
+    std::vector<float> values(nParams), cache(nParams);
+    BenchRandom random;
+
+    printf("%u parameters, %u changed between syncs\n", nParams, changesPerRound);
+    printf("%-8s %-8s %12s %10s\n", "sync", "path", "us/sync", "found");
+
+    for(int bulk = 0; bulk < 2; ++bulk)
+    {
+        uint64_t t0 = benchNow();
+        for(uint32_t r = 0; r < nRounds; ++r)
+        {
+            if(bulk)
+            {
+                OpiParamRange range = { 0, nParams, values.data() };
+                inst.dispatch(opiPlugGetParams, 0, &range);
+            }
+            else for(uint32_t i = 0; i < nParams; ++i)
+                inst.dispatch(opiPlugGetParam, i, &values[i]);
+        }
+        printf("%-8s %-8s %12.2f %10s\n", "get", bulk ? "bulk" : "single",
+            (benchNow() - t0) * 1e-3 / nRounds, "-");
+    }
+
+    for(int bulk = 0; bulk < 2; ++bulk)
+    {
+        for(float & v : values) v = random.uniform();
+
+        uint64_t t0 = benchNow();
+        for(uint32_t r = 0; r < nRounds; ++r)
+        {
+            if(bulk)
+            {
+                OpiParamRange range = { 0, nParams, values.data() };
+                inst.dispatch(opiPlugSetParams, 0, &range);
+            }
+            else for(uint32_t i = 0; i < nParams; ++i)
+                inst.dispatch(opiPlugSetParam, i, &values[i]);
+        }
+        printf("%-8s %-8s %12.2f %10s\n", "set", bulk ? "bulk" : "single",
+            (benchNow() - t0) * 1e-3 / nRounds, "-");
+    }
+
+    std::vector<uint64_t> bits((nParams + 63) / 64);
+    for(int query = 0; query < 2; ++query)
+    {
+        // start both from a synced cache and the same sequence of changes
+        OpiParamChanges changes = { 0, 0, nParams, bits.data() };
+        if(query) inst.dispatch(opiPlugGetParamChanges, 0, &changes);
+        for(uint32_t i = 0; i < nParams; ++i) cache[i] = plug->params.get(i);
+
+        BenchRandom changeRandom;
+        uint64_t found = 0, ns = 0;
+
+        for(uint32_t r = 0; r < nRounds; ++r)
+        {
+            // the plugin (or another host thread) moves some parameters
+            for(uint32_t k = 0; k < changesPerRound; ++k)
+            {
+                uint32_t idx = changeRandom.next() % nParams;
+                plug->params.set(idx, cache[idx] + 1);
+            }
+
+            uint64_t t0 = benchNow();
+            if(query)
+            {
+                inst.dispatch(opiPlugGetParamChanges, 0, &changes);
+                for(uint32_t w = 0; w < bits.size(); ++w)
+                for(uint64_t b = bits[w]; b; b &= b - 1)
+                {
+                    uint32_t idx = w * 64 + opiCountTrailingZeros(b);
+                    float value;
+                    inst.dispatch(opiPlugGetParam, idx, &value);
+                    if(value != cache[idx]) { cache[idx] = value; ++found; }
+                }
+            }
+            else for(uint32_t i = 0; i < nParams; ++i)
+            {
+                float value;
+                inst.dispatch(opiPlugGetParam, i, &value);
+                if(value != cache[i]) { cache[i] = value; ++found; }
+            }
+            ns += benchNow() - t0;
+        }
+        printf("%-8s %-8s %12.2f %10llu\n", "changes", query ? "query" : "poll",
+            ns * 1e-3 / nRounds, (unsigned long long) found);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          IN-PLACE CHAINS
+ *
+ * ===============================================================
+ */
+
+// Runs a serial chain of instances of the first plugin, either with a
+// separate output buffer per plugin or in-place through a single buffer
+// (opiConfigInPlace). Both modes must produce the same checksum.
+static int benchChain(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "chain: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSizes[] = { 16, 32, 64, 256 };
+    static const uint32_t chainLengths[] = { 1, 8, 32, 128 };
+
+    printf("%6s %6s %-8s %10s %9s %9s  %s\n",
+        "block", "chain", "mode", "buffers", "ns/smp", "p99(us)", "checksum");
+
+    for(uint32_t blockSize : blockSizes)
+    for(uint32_t length : chainLengths)
+    for(int inPlace = 0; inPlace < 2; ++inPlace)
+    {
+        std::vector<std::unique_ptr<OpiHostInstance>> chain;
+        bool ok = true;
+        for(uint32_t i = 0; i < length && ok; ++i)
+        {
+            chain.emplace_back(new OpiHostInstance);
+            ok = chain.back()->create(lib.entrypoint)
+                && benchConfigure(*chain.back(), blockSize, nChannels,
+                    inPlace ? opiConfigInPlace : 0);
+        }
+        if(!ok)
+        {
+            printf("%6u %6u %-8s  (config rejected)\n",
+                blockSize, length, inPlace ? "inplace" : "separate");
+            continue;
+        }
+
+        // separate: buses[i] -> plugin i -> buses[i+1]
+        // in-place: buses[0] -> every plugin -> buses[0], through one alias
+        std::vector<OpiHostBus> buses(inPlace ? 2 : length + 1);
+        buses[0].allocate(nChannels, blockSize);
+        if(inPlace) buses[1].alias(buses[0]);
+        else for(uint32_t i = 1; i <= length; ++i) buses[i].allocate(nChannels, blockSize);
+
+        OpiProcessInfo info;
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = sizeof(OpiProcessInfo);
+        info.nFrames = blockSize;
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            for(uint32_t i = 0; i < blockSize; ++i) buses[0].channel(c)[i] = random.bipolar();
+
+            uint64_t t0 = benchNow();
+            for(uint32_t i = 0; i < length; ++i)
+            {
+                info.inputs = buses[inPlace ? 0 : i].bus();
+                info.outputs = buses[inPlace ? 1 : i + 1].bus();
+                chain[i]->dispatch(opiPlugProcess, 0, &info);
+            }
+            times.blockNs.push_back(benchNow() - t0);
+
+            OpiHostBus & last = buses[inPlace ? 0 : length];
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(last.channel(c), blockSize * sizeof(float));
+        }
+
+        double ns = times.total() / ((double) nBlocks * blockSize * nChannels * length);
+        uint32_t nBuffers = (inPlace ? 1 : length + 1) * nChannels;
+
+        printf("%6u %6u %-8s %10u %9.4f %9.2f  %016llx\n",
+            blockSize, length, inPlace ? "inplace" : "separate",
+            nBuffers, ns, times.percentileUs(.99),
+            (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          PARALLEL GRAPH
+ *
+ * ===============================================================
+ */
+
+// Parallel tracks, each a serial chain of instances of one plugin, summed
+// into a master node; sources are the first node of each track.
+struct BenchSession
+{
+    std::vector<std::unique_ptr<OpiHostInstance>>   instances;
+    OpiGraph                graph;
+    std::vector<uint32_t>   sources;
+    uint32_t                master = 0;
+
+    bool build(OpiHostLibrary & lib, uint32_t nTracks, uint32_t chainLength,
+        uint32_t nChannels)
+    {
+        bool ok = true;
+        auto add = [&]() -> uint32_t
+        {
+            instances.emplace_back(new OpiHostInstance);
+            if(!instances.back()->create(lib.entrypoint)) ok = false;
+            return graph.addNode(instances.back().get(), nChannels);
+        };
+
+        master = add();
+        for(uint32_t t = 0; t < nTracks; ++t)
+        {
+            uint32_t prev = add();
+            sources.push_back(prev);
+            for(uint32_t k = 1; k < chainLength; ++k)
+            {
+                uint32_t node = add();
+                graph.connect(prev, node);
+                prev = node;
+            }
+            graph.connect(prev, master);
+        }
+        return ok;
+    }
+};
+
+// Scaling of OpiGraph on 1..maxThreads threads: a session of parallel tracks,
+// each a serial chain of instances of the first plugin, summed into a master
+// node. The master checksum must not depend on the thread count.
+static int benchGraph(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "graph: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSize = 128;
+    static const uint32_t nTracks = 64;
+    static const uint32_t chainLength = 4;
+
+    BenchSession session;
+    OpiGraph & graph = session.graph;
+
+    if(!session.build(lib, nTracks, chainLength, nChannels)
+    || !graph.compile(blockSize, 48000))
+    {
+        fprintf(stderr, "graph: compile failed\n");
+        return 1;
+    }
+    uint32_t master = session.master;
+    const std::vector<uint32_t> & sources = session.sources;
+
+    printf("%u nodes (%u tracks x %u + master), block %u\n",
+        (uint32_t) graph.nodes.size(), nTracks, chainLength, blockSize);
+    printf("%7s %11s %9s %9s %8s  %s\n",
+        "threads", "us/block", "p99(us)", "max(us)", "speedup", "checksum");
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+    double baseline = 0;
+
+    // the workers run at realtime priority, so should the thread driving them
+    // (like a host's audio thread would), or oversubscribed cores starve it
+    opiSetThreadRealtime();
+
+    for(uint32_t nThreads = 1; nThreads <= args.maxThreads; ++nThreads)
+    {
+        OpiWorkerPool pool;
+        pool.start(nThreads - 1);
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t src : sources)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * in = graph.input(src).channel(c);
+                for(uint32_t i = 0; i < blockSize; ++i) in[i] = random.bipolar();
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+            graph.idle();   // as a host's UI thread would, untimed
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(graph.output(master).channel(c), blockSize * sizeof(float));
+        }
+
+        double us = times.total() * 1e-3 / nBlocks;
+        if(nThreads == 1) baseline = us;
+
+        printf("%7u %11.2f %9.2f %9.2f %7.2fx  %016llx\n",
+            nThreads, us, times.percentileUs(.99), times.percentileUs(1),
+            baseline / us, (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          GRAPH SLEEP
+ *
+ * ===============================================================
+ */
+
+// A mostly idle session: same layout as the graph suite, but at any time only
+// one in eight tracks gets input (which track changes every 32 blocks), the
+// rest are fed silence. Run with and without putting idle nodes to sleep on
+// the thread count given by --threads; the checksums must match.
+static int benchSleep(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "sleep: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSize = 128;
+    static const uint32_t nTracks = 64;
+    static const uint32_t chainLength = 4;
+
+    printf("%s, %u tracks x %u + master, block %u, %u threads\n",
+        benchPluginName(args.plugins[0]).c_str(),
+        nTracks, chainLength, blockSize, args.maxThreads);
+    printf("%-6s %11s %9s %11s %11s  %s\n",
+        "sleep", "us/block", "p99(us)", "calls/blk", "asleep/blk", "checksum");
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+
+    opiSetThreadRealtime();
+
+    for(int allowSleep = 0; allowSleep < 2; ++allowSleep)
+    {
+        BenchSession session;
+        OpiGraph & graph = session.graph;
+        std::vector<uint32_t> & sources = session.sources;
+
+        bool ok = session.build(lib, nTracks, chainLength, nChannels);
+        graph.allowSleep = allowSleep != 0;
+        if(!ok || !graph.compile(blockSize, 48000))
+        {
+            fprintf(stderr, "sleep: compile failed\n");
+            return 1;
+        }
+
+        OpiWorkerPool pool;
+        pool.start(args.maxThreads - 1);
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+        uint64_t asleep = 0;
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t t = 0; t < nTracks; ++t)
+            {
+                OpiHostBus & in = graph.input(sources[t]);
+                bool active = (b / 32 + t) % 8 == 0;
+                for(uint32_t c = 0; c < nChannels; ++c)
+                {
+                    float * buf = in.channel(c);
+                    for(uint32_t i = 0; i < blockSize; ++i)
+                        buf[i] = active ? random.bipolar() : 0.f;
+                }
+                in.bus()->silenceMask = active ? 0 : (uint64_t(1) << nChannels) - 1;
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+            graph.idle();   // as a host's UI thread would, untimed
+            asleep += graph.numSleeping();
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(graph.output(session.master).channel(c),
+                    blockSize * sizeof(float));
+        }
+
+        uint64_t calls = 0;
+        for(auto & n : graph.nodes) calls += n->processCalls;
+
+        printf("%-6s %11.2f %9.2f %11.1f %11.1f  %016llx\n",
+            allowSleep ? "on" : "off",
+            times.total() * 1e-3 / nBlocks, times.percentileUs(.99),
+            (double) calls / nBlocks, (double) asleep / nBlocks,
+            (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          OFFLINE BOUNCE
+ *
+ * ===============================================================
+ */
+
+// Renders --frames frames of a session (16 tracks x 4 + master) as fast as
+// possible, once configured for live playback with small blocks and once with
+// opiConfigOffline and a large requested block size (which plugins may lower),
+// on the thread count given by --threads. Reports the realtime factor at
+// 48kHz; the checksum must not depend on the block size. Note that past a
+// point larger blocks get slower again for cheap plugins, once the buffers
+// of the whole graph no longer fit in cache.
+static int benchBounce(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "bounce: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t nTracks = 16;
+    static const uint32_t chainLength = 4;
+    static const float samplerate = 48000;
+
+    struct Mode { const char * name; uint32_t blockSize, flags; };
+    static const Mode modes[] =
+    {
+        { "live", 128, 0 },
+        { "offline", 1024, opiConfigOffline },
+        { "offline", 4096, opiConfigOffline },
+        { "offline", 16384, opiConfigOffline },
+    };
+
+    printf("%s, %u tracks x %u + master, %.1fs of audio, %u threads\n",
+        benchPluginName(args.plugins[0]).c_str(), nTracks, chainLength,
+        args.totalFrames / samplerate, args.maxThreads);
+    printf("%-8s %7s %7s %10s %9s  %s\n",
+        "mode", "asked", "block", "wall(ms)", "realtime", "checksum");
+
+    opiSetThreadRealtime();
+
+    for(const Mode & mode : modes)
+    {
+        BenchSession session;
+        OpiGraph & graph = session.graph;
+        if(!session.build(lib, nTracks, chainLength, nChannels)
+        || !graph.compile(mode.blockSize, samplerate, mode.flags))
+        {
+            fprintf(stderr, "bounce: compile failed\n");
+            return 1;
+        }
+
+        OpiWorkerPool pool;
+        pool.start(args.maxThreads - 1);
+        for(auto & inst : session.instances) inst->pool = &pool;
+
+        // one generator per source channel, so the input doesn't depend on
+        // how the frames are split into blocks
+        std::vector<BenchRandom> random(nTracks * nChannels);
+        for(uint32_t i = 0; i < random.size(); ++i) random[i].state += i * 0x9e3779b9u;
+
+        // per channel as well, then combined at the end
+        BenchChecksum channelChecksums[nChannels];
+        uint64_t ns = 0;
+
+        for(uint32_t pos = 0; pos < args.totalFrames; pos += graph.maxFrames)
+        {
+            uint32_t frames = std::min(graph.maxFrames, args.totalFrames - pos);
+
+            for(uint32_t t = 0; t < nTracks; ++t)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * in = graph.input(session.sources[t]).channel(c);
+                for(uint32_t i = 0; i < frames; ++i) in[i] = random[t * nChannels + c].bipolar();
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, frames);
+            ns += benchNow() - t0;
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                channelChecksums[c].add(graph.output(session.master).channel(c),
+                    frames * sizeof(float));
+        }
+
+        BenchChecksum checksum;
+        for(BenchChecksum & cc : channelChecksums) checksum.add(&cc.hash, sizeof(cc.hash));
+
+        double seconds = args.totalFrames / samplerate;
+        printf("%-8s %7u %7u %10.2f %8.1fx  %016llx\n",
+            mode.name, mode.blockSize, graph.maxFrames, ns * 1e-6,
+            seconds / (ns * 1e-9), (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          HOST TASKS
+ *
+ * ===============================================================
+ */
+
+// Plugin-internal parallelism through opiHostRunTasks: the first plugin is
+// processed on its own, first without a pool (the host refuses the op and
+// the plugin runs its tasks itself) and then with pools of 1..maxThreads.
+// Only plugins that actually use the op (eg. FirExample) will scale.
+static int benchTasks(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "tasks: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t blockSize = 256;
+
+    uint32_t nChannels = 8;
+    {
+        OpiHostInstance probe;
+        if(!probe.create(lib.entrypoint)) return 1;
+        intptr_t maxChannels = probe.dispatch(opiPlugMaxChannels);
+        if(maxChannels > 0 && (uint32_t) maxChannels < nChannels)
+            nChannels = (uint32_t) maxChannels;
+    }
+
+    printf("%s, %u channels, block %u\n",
+        benchPluginName(args.plugins[0]).c_str(), nChannels, blockSize);
+    printf("%7s %11s %9s %9s %8s  %s\n",
+        "threads", "us/block", "p99(us)", "max(us)", "speedup", "checksum");
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+    double baseline = 0;
+
+    opiSetThreadRealtime();
+
+    // nThreads = 0: no pool at all
+    for(uint32_t nThreads = 0; nThreads <= args.maxThreads; ++nThreads)
+    {
+        OpiWorkerPool pool;
+        if(nThreads) pool.start(nThreads - 1);
+
+        OpiHostInstance inst;
+        inst.pool = nThreads ? &pool : 0;
+        if(!inst.create(lib.entrypoint)
+        || !benchConfigure(inst, blockSize, nChannels))
+        {
+            fprintf(stderr, "tasks: config rejected\n");
+            return 1;
+        }
+
+        OpiHostBus in, out;
+        in.allocate(nChannels, blockSize);
+        out.allocate(nChannels, blockSize);
+
+        OpiProcessInfo info;
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = sizeof(OpiProcessInfo);
+        info.nFrames = blockSize;
+        info.inputs = in.bus();
+        info.outputs = out.bus();
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            for(uint32_t i = 0; i < blockSize; ++i) in.channel(c)[i] = random.bipolar();
+
+            uint64_t t0 = benchNow();
+            inst.dispatch(opiPlugProcess, 0, &info);
+            times.blockNs.push_back(benchNow() - t0);
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(out.channel(c), blockSize * sizeof(float));
+        }
+        inst.destroy();
+
+        double us = times.total() * 1e-3 / nBlocks;
+        if(!nThreads) baseline = us;
+
+        char label[16];
+        if(nThreads) snprintf(label, sizeof(label), "%u", nThreads);
+        else snprintf(label, sizeof(label), "none");
+
+        printf("%7s %11.2f %9.2f %9.2f %7.2fx  %016llx\n",
+            label, us, times.percentileUs(.99), times.percentileUs(1),
+            baseline / us, (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          CALL OVERHEAD
+ *
+ * ===============================================================
+ */
+
+// Per-call cost of the hot operations through dispatchToPlugin against the
+// OpiPluginFuncs table, for the first plugin: process at 16 frames per block
+// (2 channels) and single parameter get/set.
+static int benchCalls(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "calls: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    OpiHostInstance inst;
+    if(!lib.open(args.plugins[0]) || !inst.create(lib.entrypoint))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t blockSize = 16;
+    static const uint32_t nChannels = 2;
+    if(!benchConfigure(inst, blockSize, nChannels))
+    {
+        fprintf(stderr, "calls: config rejected\n");
+        return 1;
+    }
+
+    OpiHostBus in, out;
+    in.allocate(nChannels, blockSize);
+    out.allocate(nChannels, blockSize);
+    BenchRandom random;
+    for(uint32_t c = 0; c < nChannels; ++c)
+    for(uint32_t i = 0; i < blockSize; ++i) in.channel(c)[i] = random.bipolar();
+
+    OpiProcessInfo info;
+    memset(&info, 0, sizeof(info));
+    info.processInfoSize = sizeof(OpiProcessInfo);
+    info.nFrames = blockSize;
+    info.inputs = in.bus();
+    info.outputs = out.bus();
+
+    bool hasParam = inst.dispatch(opiPlugNumParam) > 0;
+    uint32_t nCalls = std::max<uint32_t>(args.totalFrames, 1 << 16);
+
+    printf("%s, block %u, %u calls each\n",
+        benchPluginName(args.plugins[0]).c_str(), blockSize, nCalls);
+    printf("%-10s %-10s %9s\n", "op", "path", "ns/call");
+
+    // runs f nCalls times, best of a few runs to keep the noise down
+    auto time = [&](const char * op, const char * path, bool available, auto && f)
+    {
+        if(!available) { printf("%-10s %-10s %9s\n", op, path, "n/a"); return; }
+
+        double best = 1e30;
+        for(int run = 0; run < 5; ++run)
+        {
+            uint64_t t0 = benchNow();
+            for(uint32_t i = 0; i < nCalls; ++i) f(i);
+            best = std::min(best, (benchNow() - t0) / (double) nCalls);
+        }
+        printf("%-10s %-10s %9.2f\n", op, path, best);
+    };
+
+    OpiPlugin * plug = inst.plug;
+    const OpiPluginFuncs & funcs = inst.funcs;
+    volatile float sink = 0;
+
+    time("process", "dispatch", true, [&](uint32_t)
+        { plug->dispatchToPlugin(plug, opiPlugProcess, 0, &info); });
+    time("process", "funcs", funcs.process != 0, [&](uint32_t)
+        { funcs.process(plug, &info); });
+
+    time("getParam", "dispatch", hasParam, [&](uint32_t)
+        { float v; plug->dispatchToPlugin(plug, opiPlugGetParam, 0, &v); sink = v; });
+    time("getParam", "funcs", hasParam && funcs.getParam, [&](uint32_t)
+        { float v; funcs.getParam(plug, 0, &v); sink = v; });
+
+    time("setParam", "dispatch", hasParam, [&](uint32_t i)
+        { float v = (i & 255) * (1.f / 256); plug->dispatchToPlugin(plug, opiPlugSetParam, 0, &v); });
+    time("setParam", "funcs", hasParam && funcs.setParam, [&](uint32_t i)
+        { funcs.setParam(plug, 0, (i & 255) * (1.f / 256)); });
+
+    (void) sink;
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          BATCHED INSTANCES
+ *
+ * ===============================================================
+ */
+
+// 64 instances of the first plugin (2 channels, each with its own gain), one
+// call per instance against opiPlugProcessBatch with the host keeping the
+// audio in the batch layout, without events and with an automation ramp on
+// every eighth instance each block, with separate output buffers and then in
+// place (opiConfigInPlace). Then the same through OpiGraph (64 tracks x 4 + master) with
+// batching off and on, where the graph also pays for the gather and scatter.
+// Checksums must match within each block size.
+static int benchBatch(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "batch: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t nInstances = 64;
+    static const uint32_t blockSizes[] = { 16, 64, 256 };
+    static const uint32_t batchSizes[] = { 1, 8, 16, 64 };
+
+    printf("%s, %u instances\n", benchPluginName(args.plugins[0]).c_str(), nInstances);
+    printf("%6s %-5s %-5s %6s %11s %9s %9s  %s\n",
+        "block", "ramps", "place", "batch", "us/block", "ns/smp", "p99(us)", "checksum");
+
+    for(uint32_t blockSize : blockSizes)
+    for(int ramped = 0; ramped < 2; ++ramped)
+    for(int inPlace = 0; inPlace < 2; ++inPlace)
+    for(uint32_t batchSize : batchSizes)
+    {
+        const char * place = inPlace ? "in" : "out";
+
+        std::vector<std::unique_ptr<OpiHostInstance>> insts;
+        uint32_t limit = 0;
+        bool ok = true;
+        for(uint32_t k = 0; k < nInstances && ok; ++k)
+        {
+            insts.emplace_back(new OpiHostInstance);
+            ok = insts.back()->create(lib.entrypoint)
+                && benchConfigure(*insts.back(), blockSize, nChannels,
+                    inPlace ? opiConfigInPlace : 0);
+            if(ok) insts.back()->setParam(0, .25f + .5f * k / nInstances);
+            if(ok && !k) limit = (uint32_t) insts.back()->dispatch(opiPlugMaxBatch);
+        }
+        if(!ok && inPlace)
+        {
+            printf("%6u %-5s %-5s %6u  (not supported)\n",
+                blockSize, ramped ? "1/8" : "none", place, batchSize);
+            continue;
+        }
+        if(!ok)
+        {
+            fprintf(stderr, "batch: config rejected\n");
+            return 1;
+        }
+        if(batchSize > 1 && batchSize > limit)
+        {
+            printf("%6u %-5s %-5s %6u  (not supported)\n",
+                blockSize, ramped ? "1/8" : "none", place, batchSize);
+            continue;
+        }
+
+        // planar buffers per instance, and the batch layout of the same
+        uint32_t nBatches = nInstances / batchSize;
+        std::vector<OpiHostBus> in(nInstances), out(nInstances);
+        std::vector<OpiHostBus> batchIn(nBatches), batchOut(nBatches);
+        for(uint32_t k = 0; k < nInstances; ++k)
+        {
+            in[k].allocate(nChannels, blockSize);
+            out[k].allocate(nChannels, blockSize);
+        }
+        for(uint32_t b = 0; b < nBatches; ++b)
+        {
+            batchIn[b].allocate(nChannels, blockSize * batchSize);
+            batchOut[b].allocate(nChannels, blockSize * batchSize);
+        }
+
+        std::vector<OpiEventAutomation> ramps(nInstances);
+        std::vector<OpiEvent*> rampPtrs(nInstances);
+        std::vector<OpiProcessInfo> infos(nInstances);
+        std::vector<OpiProcessInfo*> infoPtrs(nInstances);
+        std::vector<OpiPlugin*> plugins(nInstances);
+        for(uint32_t k = 0; k < nInstances; ++k)
+        {
+            OpiProcessInfo & info = infos[k];
+            memset(&info, 0, sizeof(info));
+            info.processInfoSize = sizeof(OpiProcessInfo);
+            info.nFrames = blockSize;
+            info.inputs = in[k].bus();
+            info.outputs = inPlace ? in[k].bus() : out[k].bus();
+            info.inEvents = &rampPtrs[k];
+            infoPtrs[k] = &info;
+            plugins[k] = insts[k]->plug;
+            rampPtrs[k] = (OpiEvent*) &ramps[k];
+        }
+
+        std::vector<OpiBatchInfo> batches(nBatches);
+        for(uint32_t b = 0; b < nBatches; ++b)
+        {
+            OpiBatchInfo & batch = batches[b];
+            memset(&batch, 0, sizeof(batch));
+            batch.batchInfoSize = sizeof(OpiBatchInfo);
+            batch.nInstances = batchSize;
+            batch.nFrames = blockSize;
+            batch.plugins = &plugins[b * batchSize];
+            batch.procInfos = &infoPtrs[b * batchSize];
+            batch.inputs = batchIn[b].bus();
+            batch.outputs = inPlace ? batchIn[b].bus() : batchOut[b].bus();
+        }
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t blk = 0; blk < nBlocks; ++blk)
+        {
+            for(uint32_t k = 0; k < nInstances; ++k)
+            {
+                for(uint32_t c = 0; c < nChannels; ++c)
+                for(uint32_t i = 0; i < blockSize; ++i) in[k].channel(c)[i] = random.bipolar();
+
+                OpiEventAutomation & ev = ramps[k];
+                ev.type = opiEventAutomation;
+                ev.delta = blockSize / 4;
+                ev.paramIndex = 0;
+                ev.targetValue = random.uniform();
+                ev.smoothFrames = blockSize / 2;
+                infos[k].nInEvents = ramped && !(k & 7) ? 1 : 0;
+            }
+
+            // the host would keep the audio in this layout, so not timed
+            if(batchSize > 1)
+            for(uint32_t k = 0; k < nInstances; ++k)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * dst = batchIn[k / batchSize].channel(c) + k % batchSize;
+                for(uint32_t i = 0; i < blockSize; ++i)
+                    dst[i * batchSize] = in[k].channel(c)[i];
+            }
+
+            uint64_t t0 = benchNow();
+            if(batchSize > 1)
+            {
+                for(uint32_t b = 0; b < nBatches; ++b)
+                    insts[b * batchSize]->processBatch(&batches[b]);
+            }
+            else
+            {
+                for(uint32_t k = 0; k < nInstances; ++k) insts[k]->process(&infos[k]);
+            }
+            times.blockNs.push_back(benchNow() - t0);
+
+            for(uint32_t k = 0; k < nInstances; ++k)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * dst = (inPlace ? in[k] : out[k]).channel(c);
+                if(batchSize > 1)
+                {
+                    const float * src = (inPlace ? batchIn : batchOut)[k / batchSize].channel(c)
+                        + k % batchSize;
+                    for(uint32_t i = 0; i < blockSize; ++i) dst[i] = src[i * batchSize];
+                }
+                checksum.add(dst, blockSize * sizeof(float));
+            }
+        }
+
+        double us = times.total() * 1e-3 / nBlocks;
+        printf("%6u %-5s %-5s %6u %11.2f %9.4f %9.2f  %016llx\n",
+            blockSize, ramped ? "1/8" : "none", place, batchSize, us,
+            us * 1e3 / (blockSize * nChannels * nInstances), times.percentileUs(.99),
+            (unsigned long long) checksum.hash);
+    }
+
+    static const uint32_t nTracks = 64;
+    static const uint32_t chainLength = 4;
+
+    printf("\ngraph, %u tracks x %u + master, %u threads\n",
+        nTracks, chainLength, args.maxThreads);
+    printf("%6s %6s %11s %9s %9s  %s\n",
+        "block", "batch", "us/block", "batches", "p99(us)", "checksum");
+
+    opiSetThreadRealtime();
+
+    for(uint32_t blockSize : blockSizes)
+    for(uint32_t batchSize : batchSizes)
+    {
+        if(batchSize == 8) continue;
+
+        BenchSession session;
+        OpiGraph & graph = session.graph;
+        graph.maxBatch = batchSize;
+        if(!session.build(lib, nTracks, chainLength, nChannels)
+        || !graph.compile(blockSize, 48000))
+        {
+            fprintf(stderr, "batch: compile failed\n");
+            return 1;
+        }
+
+        OpiWorkerPool pool;
+        pool.start(args.maxThreads - 1);
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t blk = 0; blk < nBlocks; ++blk)
+        {
+            for(uint32_t src : session.sources)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * buf = graph.input(src).channel(c);
+                for(uint32_t i = 0; i < blockSize; ++i) buf[i] = random.bipolar();
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(graph.output(session.master).channel(c),
+                    blockSize * sizeof(float));
+        }
+
+        printf("%6u %6u %11.2f %9u %9.2f  %016llx\n", blockSize, batchSize,
+            times.total() * 1e-3 / nBlocks, (uint32_t) graph.batches.size(),
+            times.percentileUs(.99), (unsigned long long) checksum.hash);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          PROFILING
+ *
+ * ===============================================================
+ */
+
+// A 501 node session (125 tracks x 4 + master) of the first plugin, run on
+// the thread count given by --threads once without and once with every
+// instance profiled, to show the cost of recording. If a second plugin is
+// given, one instance of it goes in the middle of the first track (eg.
+// FirExample, to have an obvious hot spot). Then prints the worst instances
+// and zones, and writes a Chrome trace with --trace.
+static int benchProfile(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "profile: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib, hotLib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+    if(args.plugins.size() > 1 && !hotLib.open(args.plugins[1]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[1]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSize = 128;
+    static const uint32_t nTracks = 125;
+    static const uint32_t chainLength = 4;
+    static const float samplerate = 48000;
+
+    printf("%s, %u tracks x %u + master, block %u, %u threads\n",
+        benchPluginName(args.plugins[0]).c_str(),
+        nTracks, chainLength, blockSize, args.maxThreads);
+    printf("%-8s %11s %9s %9s %10s  %s\n",
+        "profile", "us/block", "p99(us)", "max(us)", "records", "checksum");
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+
+    opiSetThreadRealtime();
+
+    OpiProfileSession profile(samplerate);
+
+    for(int profiled = 0; profiled < 2; ++profiled)
+    {
+        BenchSession session;
+        OpiGraph & graph = session.graph;
+        bool ok = session.build(lib, nTracks, chainLength, nChannels);
+
+        // instances are master, then each track in order
+        if(ok && hotLib.handle)
+            ok = session.instances[1 + chainLength / 2]->create(hotLib.entrypoint);
+
+        if(profiled)
+        {
+            char name[64];
+            for(uint32_t i = 0; i < session.instances.size(); ++i)
+            {
+                if(!i) snprintf(name, sizeof(name), "master");
+                else snprintf(name, sizeof(name), "track%u.%u",
+                    (i - 1) / chainLength, (i - 1) % chainLength);
+                session.instances[i]->profile = profile.add(name);
+            }
+        }
+
+        if(!ok || !graph.compile(blockSize, samplerate))
+        {
+            fprintf(stderr, "profile: compile failed\n");
+            return 1;
+        }
+
+        OpiWorkerPool pool;
+        pool.start(args.maxThreads - 1);
+        for(auto & inst : session.instances) inst->pool = &pool;
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t src : session.sources)
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                float * in = graph.input(src).channel(c);
+                for(uint32_t i = 0; i < blockSize; ++i) in[i] = random.bipolar();
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+
+            // like a host's UI thread would, but outside the timed region
+            if(profiled) profile.drain();
+            graph.idle();
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(graph.output(session.master).channel(c),
+                    blockSize * sizeof(float));
+        }
+
+        printf("%-8s %11.2f %9.2f %9.2f %10u  %016llx\n",
+            profiled ? "on" : "off",
+            times.total() * 1e-3 / nBlocks, times.percentileUs(.99),
+            times.percentileUs(1), (uint32_t) profile.entries.size(),
+            (unsigned long long) checksum.hash);
+    }
+
+    printf("\n");
+    profile.summary(stdout, 8);
+
+    if(args.trace)
+    {
+        if(!profile.writeChromeTrace(args.trace))
+        {
+            fprintf(stderr, "cannot write %s\n", args.trace);
+            return 1;
+        }
+        printf("trace written to %s\n", args.trace);
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          MODULATION
+ *
+ * ===============================================================
+ */
+
+// The first plugin's gain (parameter 0) following a piecewise linear curve
+// with 1, 16 or 128 breakpoints per block: once sent as OpiEventAutomation
+// (a ramp to each breakpoint) and once rendered by the host into an
+// OpiParamBuffer with OpiParamCurve, which is included in the timing.
+// Checksums must match within each density.
+static int benchModulation(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "modulation: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t blockSize = 256;
+    static const uint32_t nChannels = 2;
+    static const uint32_t densities[] = { 1, 16, 128 };
+    static const uint32_t nPatterns = 16;
+
+    OpiHostBus in, out;
+    in.allocate(nChannels, blockSize);
+    out.allocate(nChannels, blockSize);
+    BenchRandom random;
+    for(uint32_t c = 0; c < nChannels; ++c)
+    for(uint32_t i = 0; i < blockSize; ++i) in.channel(c)[i] = random.bipolar();
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 64);
+
+    printf("%s, block %u, %u blocks each\n",
+        benchPluginName(args.plugins[0]).c_str(), blockSize, nBlocks);
+    printf("%-8s %6s %9s %9s %9s  %s\n",
+        "mode", "pts/blk", "ns/smp", "p50(us)", "p99(us)", "checksum");
+
+    for(uint32_t density : densities)
+    {
+        // a few blocks worth of breakpoints, each ramping to the next
+        std::vector<OpiEventAutomation> points(nPatterns * density);
+        std::vector<OpiEvent*> pointers(points.size());
+        for(size_t e = 0; e < points.size(); ++e)
+        {
+            OpiEventAutomation & ev = points[e];
+            ev.type = opiEventAutomation;
+            ev.delta = (uint32_t) ((e % density) * blockSize / density);
+            ev.paramIndex = 0;
+            ev.targetValue = random.uniform();
+            ev.smoothFrames = blockSize / density;
+            pointers[e] = (OpiEvent*) &ev;
+        }
+
+        for(int buffered = 0; buffered < 2; ++buffered)
+        {
+            OpiHostInstance inst;
+            if(!inst.create(lib.entrypoint) || !benchConfigure(inst, blockSize, nChannels))
+            {
+                fprintf(stderr, "modulation: cannot create instance\n");
+                return 1;
+            }
+            if(buffered && !inst.dispatch(opiPlugAcceptsParamBuffer, 0))
+            {
+                printf("%-8s %6u %9s\n", "buffer", density, "n/a");
+                continue;
+            }
+
+            OpiParamCurve curve;
+            curve.init(blockSize, 1);
+            OpiParamBuffer buffer = curve.buffer(0);
+
+            OpiProcessInfo info;
+            memset(&info, 0, sizeof(info));
+            info.processInfoSize = sizeof(OpiProcessInfo);
+            info.nFrames = blockSize;
+            info.inputs = in.bus();
+            info.outputs = out.bus();
+
+            BenchTimes times;
+            BenchChecksum checksum;
+            for(uint32_t b = 0; b < nBlocks; ++b)
+            {
+                uint32_t first = (b % nPatterns) * density;
+
+                uint64_t t0 = benchNow();
+                if(buffered)
+                {
+                    curve.render(points.data() + first, density, blockSize);
+                    info.paramBuffers = &buffer;
+                    info.nParamBuffers = 1;
+                }
+                else
+                {
+                    info.inEvents = pointers.data() + first;
+                    info.nInEvents = density;
+                }
+                inst.process(&info);
+                times.blockNs.push_back(benchNow() - t0);
+
+                for(uint32_t c = 0; c < nChannels; ++c)
+                    checksum.add(out.channel(c), blockSize * sizeof(float));
+            }
+
+            printf("%-8s %6u %9.4f %9.2f %9.2f  %016llx\n",
+                buffered ? "buffer" : "events", density,
+                times.total() / ((double) nBlocks * blockSize * nChannels),
+                times.percentileUs(.5), times.percentileUs(.99),
+                (unsigned long long) checksum.hash);
+        }
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          SCAN
+ *
+ * ===============================================================
+ */
+
+static bool benchCopyFile(const char * from, const char * to)
+{
+    FILE * in = fopen(from, "rb");
+    if(!in) return false;
+    FILE * out = fopen(to, "wb");
+    if(!out) { fclose(in); return false; }
+
+    char buf[1 << 16];
+    size_t n;
+    bool ok = true;
+    while(ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) ok = fwrite(buf, 1, n, out) == n;
+    fclose(in);
+    if(fclose(out)) ok = false;
+    return ok;
+}
+
+// A library of 2000 plugin binaries (copies of the given plugins, since the
+// loader would share the same file) scanned by instantiating every plugin,
+// by OpiPluginDescriptor, and through OpiScanCache: empty, warm, after every
+// file was touched and after 1% of them changed. The files are in the page
+// cache throughout, so this is the cost of the scan itself, not of the disk.
+static int benchScan(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "scan: no plugins given\n");
+        return 1;
+    }
+
+    static const uint32_t nFiles = 2000;
+    const char * dir = "opi_bench_scan";
+    const char * cachePath = "opi_bench_scan.opic";
+
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+
+    std::vector<std::string> paths(nFiles);
+    for(uint32_t i = 0; i < nFiles; ++i)
+    {
+        const char * plugin = args.plugins[i % args.plugins.size()];
+        const char * ext = strrchr(plugin, '.');
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "/%05u-", i);
+        paths[i] = dir + (prefix + benchPluginName(plugin)) + (ext ? ext : "");
+        if(!benchCopyFile(plugin, paths[i].c_str()))
+        {
+            fprintf(stderr, "scan: cannot copy %s\n", plugin);
+            return 1;
+        }
+    }
+
+    printf("%u plugin binaries\n", nFiles);
+    printf("%-12s %10s %10s %7s %7s %7s %7s\n",
+        "mode", "ms", "us/plugin", "loaded", "cached", "hashed", "scanned");
+
+    auto report = [&](const char * mode, uint64_t t0, uint32_t loaded,
+        const OpiScanCache * cache)
+    {
+        double ms = (benchNow() - t0) * 1e-6;
+        printf("%-12s %10.2f %10.2f %7u", mode, ms, ms * 1e3 / nFiles, loaded);
+        if(cache) printf(" %7u %7u %7u", cache->nCached, cache->nHashed, cache->nScanned);
+        printf("\n");
+    };
+
+    // the old way, and the descriptor, which must agree with it
+    std::vector<OpiPluginInfo> byInstance(nFiles), byDescriptor(nFiles);
+    for(int descriptor = 0; descriptor < 2; ++descriptor)
+    {
+        std::vector<OpiPluginInfo> & infos = descriptor ? byDescriptor : byInstance;
+        uint32_t loaded = 0;
+        uint64_t t0 = benchNow();
+        for(uint32_t i = 0; i < nFiles; ++i)
+            loaded += opiScanPlugin(paths[i].c_str(), infos[i], descriptor != 0);
+        report(descriptor ? "descriptor" : "instance", t0, loaded, 0);
+    }
+
+    uint32_t differ = 0;
+    for(uint32_t i = 0; i < nFiles; ++i)
+    {
+        const OpiPluginInfo & a = byInstance[i], & b = byDescriptor[i];
+        differ += a.loaded != b.loaded || a.nInputs != b.nInputs
+            || a.nOutputs != b.nOutputs || a.maxChannels != b.maxChannels
+            || a.inEventMask != b.inEventMask || a.outEventMask != b.outEventMask
+            || a.paramNames != b.paramNames || a.paramDefaults != b.paramDefaults;
+    }
+
+    // runs a scan of the whole library through a cache loaded from the file
+    auto cached = [&](const char * mode, bool fromFile)
+    {
+        OpiScanCache cache;
+        uint32_t loaded = 0;
+        uint64_t t0 = benchNow();
+        if(fromFile) cache.load(cachePath);
+        for(uint32_t i = 0; i < nFiles; ++i) loaded += cache.scan(paths[i].c_str()).loaded;
+        cache.save(cachePath);
+        report(mode, t0, loaded, &cache);
+    };
+
+    remove(cachePath);
+    cached("cold cache", false);
+    cached("warm cache", true);
+
+    // same contents, new time
+    for(uint32_t i = 0; i < nFiles; ++i)
+    {
+        struct utimbuf times;
+        times.actime = times.modtime = time(0) - 3600;
+        utime(paths[i].c_str(), &times);
+    }
+    cached("touched", true);
+
+    // a new build of every 100th plugin (trailing bytes are ignored by the loader)
+    for(uint32_t i = 0; i < nFiles; i += 100)
+    {
+        FILE * f = fopen(paths[i].c_str(), "ab");
+        if(f) { fputc(0, f); fclose(f); }
+    }
+    cached("1% changed", true);
+    cached("warm cache", true);
+
+    printf("descriptor vs instance: %s\n", differ ? "MISMATCH" : "same");
+
+    for(const std::string & path : paths) remove(path.c_str());
+    remove(cachePath);
+#ifdef _WIN32
+    _rmdir(dir);
+#else
+    rmdir(dir);
+#endif
+    return differ ? 1 : 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          LATENCY COMPENSATION
+ *
+ * ===============================================================
+ */
+
+// Pure delay by a settable number of frames, reported as its latency. With
+// copyOnly it only claims the latency and passes the audio straight through,
+// to stand in for plugins whose processing is beside the point.
+struct BenchDelayPlugin : public OpiPlugin
+{
+    static const uint32_t   maxDelay = 1 << 14;
+
+    uint32_t    delay = 0;
+    bool        copyOnly = false;
+
+    uint32_t    nChannels = 0;
+    uint32_t    length = 0;
+    uint32_t    pos = 0;
+    std::vector<float>  ring;
+
+    BenchDelayPlugin(OpiCallback hostCallback, void * hostPtr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = hostPtr;
+    }
+
+    static OpiPlugin * entrypoint(OpiCallback hostCallback, void * hostPtr)
+    {
+        return new BenchDelayPlugin(hostCallback, hostPtr);
+    }
+
+    // not [RT] in a real plugin, but the bench only calls it between blocks
+    void setDelay(uint32_t frames)
+    {
+        delay = std::min(frames, maxDelay);
+        dispatchToHost(this, opiHostSetLatency, 0, 0);
+    }
+
+    void process(OpiProcessInfo * info)
+    {
+        OpiBusChannels * in = info->inputs, * out = info->outputs;
+        for(uint32_t c = 0; c < nChannels; ++c)
+        {
+            bool silent = c < 64 && (in->silenceMask & (uint64_t(1) << c));
+            if(copyOnly)
+            {
+                if(silent) opiDspClear(out->channels[c], info->nFrames);
+                else opiDspCopy(out->channels[c], in->channels[c], info->nFrames);
+                continue;
+            }
+
+            float * r = ring.data() + (size_t) c * length;
+            for(uint32_t i = 0, w = pos; i < info->nFrames; ++i, w = w + 1 == length ? 0 : w + 1)
+            {
+                r[w] = silent ? 0.f : in->channels[c][i];
+                out->channels[c][i] = r[w >= delay ? w - delay : w + length - delay];
+            }
+        }
+        out->silenceMask = 0;
+        if(!copyOnly) pos = (pos + info->nFrames) % length;
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t, void * data)
+    {
+        BenchDelayPlugin * plug = (BenchDelayPlugin*) ptr;
+
+        switch(op)
+        {
+        case opiPlugProcess: plug->process((OpiProcessInfo*) data); return 1;
+        case opiPlugDestroy: delete plug; return 1;
+
+        case opiPlugNumInputs: return 1;
+        case opiPlugNumOutputs: return 1;
+        case opiPlugMaxChannels: return 64;
+
+        case opiPlugGetLatency: return plug->delay;
+        case opiPlugGetTailFrames: *((uint32_t*)data) = plug->delay; return 1;
+
+        case opiPlugConfig:
+            {
+                OpiConfig * config = (OpiConfig*) data;
+                plug->nChannels = config->inBusChannels[0].nChannels;
+                if(plug->nChannels != config->outBusChannels[0].nChannels) return 0;
+                plug->length = maxDelay + config->blocksize;
+                plug->ring.assign((size_t) plug->length * plug->nChannels, 0.f);
+                plug->pos = 0;
+                return 1;
+            }
+        case opiPlugEnable: return 1;
+        case opiPlugDisable: return 1;
+
+        default: return 0;
+        }
+    }
+};
+
+// Correctness first: a source split three ways (through a delay, through a
+// longer delay and directly) and summed again must come out as three times
+// the source delayed by the longer path, exactly, with stretches of silence
+// so that silent delay lines and sleeping nodes get exercised too. Midway the
+// longer delay changes (through opiHostSetLatency and updateLatency) and the
+// output must settle on the new latency.
+//
+// Then the cost: tracks of the first plugin followed by a latency-only node
+// of a random latency up to the given spread, summed into a master, so every
+// track but the slowest gets a delay line on the master input. Delay MB is
+// what those lines move per block (written and read) with every track
+// playing; rows with only some tracks playing show what skipping silent
+// lines saves.
+static bool benchLatencyCheck(uint32_t blockSize, uint32_t nBlocks)
+{
+    static const uint32_t nChannels = 2;
+    OpiHostInstance src, a, b, mix;
+    src.create(&BenchDelayPlugin::entrypoint);
+    a.create(&BenchDelayPlugin::entrypoint);
+    b.create(&BenchDelayPlugin::entrypoint);
+    mix.create(&BenchDelayPlugin::entrypoint);
+    ((BenchDelayPlugin*) a.plug)->setDelay(100);
+    ((BenchDelayPlugin*) b.plug)->setDelay(700);
+
+    OpiGraph graph;
+    uint32_t nSrc = graph.addNode(&src, nChannels);
+    uint32_t nA = graph.addNode(&a, nChannels);
+    uint32_t nB = graph.addNode(&b, nChannels);
+    uint32_t nMix = graph.addNode(&mix, nChannels);
+    graph.connect(nSrc, nA);
+    graph.connect(nSrc, nB);
+    graph.connect(nSrc, nMix);
+    graph.connect(nA, nMix);
+    graph.connect(nB, nMix);
+    if(!graph.compile(blockSize, 48000)) return false;
+
+    OpiWorkerPool pool;
+    BenchRandom random;
+    std::vector<float> history[nChannels];
+    uint32_t latency = 700, changedAt = ~0u, errors = 0, checked = 0;
+    bool reported = graph.maxLatency() == latency;
+
+    for(uint32_t blk = 0; blk < nBlocks; ++blk)
+    {
+        // bursts of 24 blocks of signal and 40 of silence
+        bool silent = blk % 64 >= 24;
+        OpiHostBus & in = graph.input(nSrc);
+        in.bus()->silenceMask = silent ? 3 : 0;
+        for(uint32_t c = 0; c < nChannels; ++c)
+        for(uint32_t i = 0; i < blockSize; ++i)
+        {
+            float x = silent ? 0.f : random.bipolar();
+            in.channel(c)[i] = x;
+            history[c].push_back(x);
+        }
+
+        if(blk == nBlocks / 2)
+        {
+            ((BenchDelayPlugin*) b.plug)->setDelay(1500);
+            reported = reported && graph.updateLatency() && graph.maxLatency() == 1500;
+            latency = 1500;
+            changedAt = blk;
+        }
+
+        graph.process(pool, blockSize);
+        graph.idle();
+
+        // skip the glitch while the new delays fill up
+        if(blk >= changedAt && blk < changedAt + 2 + 2 * latency / blockSize) continue;
+
+        uint64_t mask = graph.output(nMix).bus()->silenceMask;
+        for(uint32_t c = 0; c < nChannels; ++c)
+        for(uint32_t i = 0; i < blockSize; ++i)
+        {
+            size_t t = (size_t) blk * blockSize + i;
+            float x = t >= latency ? history[c][t - latency] : 0.f;
+            float expected = x + x + x;
+            float got = (mask & (uint64_t(1) << c)) ? 0.f : graph.output(nMix).channel(c)[i];
+            errors += got != expected;
+            ++checked;
+        }
+    }
+
+    printf("check: block %u, %u samples, %u wrong, latency %s\n",
+        blockSize, checked, errors, reported ? "reported" : "NOT REPORTED");
+    return !errors && reported;
+}
+
+static int benchLatency(BenchArgs & args)
+{
+    bool ok = true;
+    for(uint32_t blockSize : { 32u, 64u, 500u })
+        ok = benchLatencyCheck(blockSize, std::max<uint32_t>(40000 / blockSize, 256)) && ok;
+
+    if(args.plugins.empty()) return ok ? 0 : 1;
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSize = 128;
+    static const uint32_t nTracks = 256;
+    static const uint32_t spreads[] = { 0, 512, 8192 };
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 256);
+    printf("%u tracks x (%s + latency) + master, block %u\n",
+        nTracks, benchPluginName(args.plugins[0]).c_str(), blockSize);
+    printf("%-4s %6s %7s %6s %10s %9s %9s %10s  %s\n", "pdc", "spread", "active",
+        "lines", "us/block", "p99(us)", "delay MB", "GB/s", "checksum");
+
+    OpiWorkerPool pool;
+
+    for(uint32_t spread : spreads)
+    for(uint32_t activeEvery : { 1u, 8u })
+    for(int compensate = 0; compensate < 2; ++compensate)
+    {
+        if(!spread && compensate) continue;
+
+        std::vector<std::unique_ptr<OpiHostInstance>> instances;
+        OpiGraph graph;
+        auto add = [&](OpiEntrypoint entry) -> uint32_t
+        {
+            instances.emplace_back(new OpiHostInstance);
+            instances.back()->create(entry);
+            return graph.addNode(instances.back().get(), nChannels);
+        };
+
+        BenchRandom random;
+        uint32_t master = add(lib.entrypoint);
+        std::vector<uint32_t> sources;
+        for(uint32_t t = 0; t < nTracks; ++t)
+        {
+            uint32_t first = add(lib.entrypoint);
+            uint32_t late = add(&BenchDelayPlugin::entrypoint);
+            BenchDelayPlugin * plug = (BenchDelayPlugin*) instances.back()->plug;
+            plug->copyOnly = true;
+            plug->setDelay(spread ? random.next() % (spread + 1) : 0);
+            graph.connect(first, late);
+            graph.connect(late, master);
+            sources.push_back(first);
+        }
+        graph.compensateLatency = compensate != 0;
+        if(!graph.compile(blockSize, 48000))
+        {
+            fprintf(stderr, "latency: compile failed\n");
+            return 1;
+        }
+
+        uint32_t nLines = 0;
+        for(uint32_t t = 0; t < nTracks; ++t)
+            nLines += compensate && graph.latencies[sources[t] + 1] < graph.maxLatency();
+
+        BenchTimes times;
+        BenchChecksum checksum;
+        for(uint32_t blk = 0; blk < nBlocks; ++blk)
+        {
+            // with activeEvery > 1 only some tracks play, changing every 64 blocks
+            for(uint32_t t = 0; t < nTracks; ++t)
+            {
+                OpiHostBus & in = graph.input(sources[t]);
+                bool active = (t + blk / 64) % activeEvery == 0;
+                in.bus()->silenceMask = active ? 0 : 3;
+                for(uint32_t c = 0; c < nChannels; ++c)
+                for(uint32_t i = 0; i < blockSize; ++i)
+                    in.channel(c)[i] = active ? random.bipolar() : 0.f;
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(graph.output(master).channel(c), blockSize * sizeof(float));
+        }
+
+        // every line writes and reads a block per channel
+        double mb = nLines * 2.0 * nChannels * blockSize * sizeof(float) / (1 << 20);
+        double us = times.total() * 1e-3 / nBlocks;
+        printf("%-4s %6u %5u/%u %6u %10.2f %9.2f %9.2f ",
+            compensate ? "on" : "off", spread, 1u, activeEvery, nLines, us,
+            times.percentileUs(.99), mb);
+        if(nLines && activeEvery == 1) printf("%10.2f", mb * (1 << 20) / (us * 1e3));
+        else printf("%10s", "-");
+        printf("  %016llx\n", (unsigned long long) checksum.hash);
+    }
+    return ok ? 0 : 1;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          REALTIME SAFETY
+ *
+ * ===============================================================
+ */
+
+// Breaks the rules on purpose every 16th block: takes a mutex, grows a vector
+// and sleeps. The suite runs it first, to show the checker catches all that.
+struct BenchRtViolator : public OpiPlugin
+{
+    std::mutex          lock;
+    std::vector<float>  history;
+    uint32_t            nBlocks = 0;
+    uint32_t            nChannels = 0;
+
+    BenchRtViolator(OpiCallback hostCallback, void * hostPtr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = hostPtr;
+    }
+
+    static OpiPlugin * entrypoint(OpiCallback hostCallback, void * hostPtr)
+    {
+        return new BenchRtViolator(hostCallback, hostPtr);
+    }
+
+    void process(OpiProcessInfo * info)
+    {
+        if(!(nBlocks++ & 15))
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            history.push_back(info->nFrames ? info->inputs->channels[0][0] : 0.f);
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+        for(uint32_t c = 0; c < nChannels && info->nFrames; ++c)
+            opiDspCopy(info->outputs->channels[c], info->inputs->channels[c], info->nFrames);
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t, void * data)
+    {
+        BenchRtViolator * plug = (BenchRtViolator*) ptr;
+
+        switch(op)
+        {
+        case opiPlugProcess: plug->process((OpiProcessInfo*) data); return 1;
+        case opiPlugFlushEvents: plug->process((OpiProcessInfo*) data); return 1;
+        case opiPlugDestroy: delete plug; return 1;
+
+        case opiPlugNumInputs: return 1;
+        case opiPlugNumOutputs: return 1;
+        case opiPlugMaxChannels: return 64;
+
+        case opiPlugConfig:
+            plug->nChannels = ((OpiConfig*) data)->inBusChannels[0].nChannels;
+            return 1;
+        case opiPlugEnable: return 1;
+        case opiPlugDisable: return 1;
+
+        default: return 0;
+        }
+    }
+};
+
+// Runs process (and flushEvents, when there are events) over a few block
+// sizes and event densities with the inputs cycling through signal, half
+// silent and silent, then processBatch if the plugin batches. Prints worst
+// case block times per row; returns the number of violations.
+static uint32_t benchRtCheckPlugin(OpiRtCheck & check,
+    OpiEntrypoint entrypoint, const std::string & name, BenchArgs & args)
+{
+    static const uint32_t nChannels = 2;
+    static const uint32_t blockSizes[] = { 32, 256, 1024 };
+    static const uint32_t eventCounts[] = { 0, 16 };
+    static const uint32_t nBatch = 8;
+
+    check.clear();
+
+    for(uint32_t blockSize : blockSizes)
+    for(uint32_t nEvents : eventCounts)
+    {
+        OpiHostInstance inst;
+        if(!inst.create(entrypoint)) return 1;
+        uint32_t eventMask = (uint32_t) inst.dispatch(opiPlugInEventMask);
+        uint32_t nParams = (uint32_t) inst.dispatch(opiPlugNumParam);
+        if(!benchConfigure(inst, blockSize, nChannels))
+        {
+            printf("%-16s %-12s %6u %5u  (config rejected)\n",
+                name.c_str(), "process", blockSize, nEvents);
+            continue;
+        }
+
+        BenchProcessRow row = { blockSize, nChannels, benchSilenceNone, nEvents };
+        BenchProcessState state;
+        state.setup(row);
+
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 64);
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        uint32_t before = check.count();
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            row.silence = b % 3;
+            state.prepare(row, eventMask, nParams);
+            state.timeInfo.samplePos = (uint64_t) b * blockSize;
+
+            uint64_t t0 = benchNow();
+            check.enter("process");
+            inst.process(&state.procInfo);
+            check.leave();
+            times.blockNs.push_back(benchNow() - t0);
+        }
+        uint32_t nProcess = check.count() - before;
+
+        printf("%-16s %-12s %6u %5u %9.2f %9.2f %9.2f %6u\n",
+            name.c_str(), "process", blockSize, nEvents, times.percentileUs(.5),
+            times.percentileUs(.99), times.percentileUs(1), nProcess);
+
+        if(nEvents)
+        {
+            OpiProcessInfo flush = state.procInfo;
+            flush.nFrames = 0;
+            flush.inputs = 0;
+            flush.outputs = 0;
+
+            times.blockNs.clear();
+            before = check.count();
+            for(uint32_t b = 0; b < 64; ++b)
+            {
+                state.prepare(row, eventMask, nParams);
+
+                uint64_t t0 = benchNow();
+                check.enter("flushEvents");
+                if(inst.funcs.flushEvents) inst.funcs.flushEvents(inst.plug, &flush);
+                else inst.dispatch(opiPlugFlushEvents, 0, &flush);
+                check.leave();
+                times.blockNs.push_back(benchNow() - t0);
+            }
+            printf("%-16s %-12s %6u %5u %9.2f %9.2f %9.2f %6u\n",
+                name.c_str(), "flushEvents", 0u, nEvents, times.percentileUs(.5),
+                times.percentileUs(.99), times.percentileUs(1), check.count() - before);
+        }
+        inst.dispatch(opiPlugDisable);
+    }
+
+    // lanes as in the batch suite, plain noise in and no events
+    for(uint32_t blockSize : blockSizes)
+    {
+        std::vector<std::unique_ptr<OpiHostInstance>> insts;
+        std::vector<OpiPlugin*> plugins;
+        bool ok = true;
+        for(uint32_t k = 0; k < nBatch && ok; ++k)
+        {
+            insts.emplace_back(new OpiHostInstance);
+            ok = insts.back()->create(entrypoint)
+                && benchConfigure(*insts.back(), blockSize, nChannels)
+                && insts.back()->dispatch(opiPlugMaxBatch) >= (intptr_t) nBatch;
+            plugins.push_back(insts.back()->plug);
+        }
+        if(!ok) break;
+
+        OpiHostBus batchIn, batchOut;
+        batchIn.allocate(nChannels, blockSize * nBatch);
+        batchOut.allocate(nChannels, blockSize * nBatch);
+
+        std::vector<OpiProcessInfo> infos(nBatch);
+        std::vector<OpiProcessInfo*> infoPtrs(nBatch);
+        for(uint32_t k = 0; k < nBatch; ++k)
+        {
+            memset(&infos[k], 0, sizeof(OpiProcessInfo));
+            infos[k].processInfoSize = sizeof(OpiProcessInfo);
+            infos[k].nFrames = blockSize;
+            infoPtrs[k] = &infos[k];
+        }
+
+        OpiBatchInfo batch;
+        memset(&batch, 0, sizeof(batch));
+        batch.batchInfoSize = sizeof(OpiBatchInfo);
+        batch.nInstances = nBatch;
+        batch.nFrames = blockSize;
+        batch.plugins = plugins.data();
+        batch.procInfos = infoPtrs.data();
+        batch.inputs = batchIn.bus();
+        batch.outputs = batchOut.bus();
+
+        BenchRandom random;
+        uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 64);
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        uint32_t before = check.count();
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            for(uint32_t i = 0; i < blockSize * nBatch; ++i)
+                batchIn.channel(c)[i] = random.bipolar();
+
+            uint64_t t0 = benchNow();
+            check.enter("processBatch");
+            insts[0]->processBatch(&batch);
+            check.leave();
+            times.blockNs.push_back(benchNow() - t0);
+        }
+        printf("%-16s %-12s %6u %5u %9.2f %9.2f %9.2f %6u\n",
+            name.c_str(), "processBatch", blockSize, 0u, times.percentileUs(.5),
+            times.percentileUs(.99), times.percentileUs(1), check.count() - before);
+    }
+
+    return check.report(stdout);
+}
+
+// Needs OpiRtCheck.so preloaded (see CommunityRtCheck.h), and is skipped
+// without it unless asked for by name. The violator goes first and must be
+// caught taking its mutex, allocating and sleeping; then each plugin given
+// must come out clean. Block times are in microseconds, with the checker's
+// (small) overhead included.
+static int benchRtCheck(BenchArgs & args)
+{
+    OpiRtCheck check;
+    if(!check.load())
+    {
+        fprintf(stderr, "rtcheck: OpiRtCheck.so is not preloaded, run as\n"
+            "  LD_PRELOAD=./OpiRtCheck.so opi_bench --suite rtcheck plugin ...\n");
+        return args.all ? 0 : 1;
+    }
+
+    printf("%-16s %-12s %6s %5s %9s %9s %9s %6s\n",
+        "plugin", "op", "block", "evts", "p50(us)", "p99(us)", "max(us)", "viol");
+
+    int result = 0;
+
+    benchRtCheckPlugin(check, &BenchRtViolator::entrypoint, "(violator)", args);
+    static const char * expected[] = { "pthread_mutex_lock", "malloc", "nanosleep" };
+    for(const char * kind : expected)
+    {
+        if(check.count(kind)) continue;
+        fprintf(stderr, "rtcheck: self-test did not catch %s\n", kind);
+        result = 1;
+    }
+    if(!result) printf("self-test ok\n\n");
+
+    for(const char * path : args.plugins)
+    {
+        OpiHostLibrary lib;
+        if(!lib.open(path))
+        {
+            fprintf(stderr, "%s: cannot load plugin\n", path);
+            result = 1;
+            continue;
+        }
+
+        std::string name = benchPluginName(path);
+        if(benchRtCheckPlugin(check, lib.entrypoint, name, args)) result = 1;
+        else printf("%s: no violations\n", name.c_str());
+        printf("\n");
+    }
+    return result;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          ARENA
+ *
+ * ===============================================================
+ */
+
+// Starts a few grains every block, each with a buffer it fills, and keeps
+// them until opiPlugReset. The buffers come from the host's arena if there is
+// one and from malloc otherwise (going back to free on reset), like a plugin
+// without an arena would have to.
+struct BenchGrainPlugin : public OpiPlugin
+{
+    static const uint32_t   grainBytes = 4096;
+    static const uint32_t   grainsPerBlock = 8;
+    static const uint32_t   maxGrains = 1024;
+
+    OpiArena *  arena = 0;
+    void *      grains[maxGrains];
+    uint32_t    nGrains = 0;
+    uint32_t    nChannels = 0;
+
+    BenchGrainPlugin(OpiCallback hostCallback, void * hostPtr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = hostPtr;
+    }
+
+    ~BenchGrainPlugin() { reset(); }
+
+    static OpiPlugin * entrypoint(OpiCallback hostCallback, void * hostPtr)
+    {
+        return new BenchGrainPlugin(hostCallback, hostPtr);
+    }
+
+    void reset()
+    {
+        if(!arena) for(uint32_t i = 0; i < nGrains; ++i) free(grains[i]);
+        nGrains = 0;
+        arena = (OpiArena*) dispatchToHost(this, opiHostGetArena, 0, 0);
+    }
+
+    void process(OpiProcessInfo * info)
+    {
+        for(uint32_t i = 0; i < grainsPerBlock && nGrains < maxGrains; ++i)
+        {
+            void * grain = arena ? arena->alloc(arena, grainBytes, 64) : malloc(grainBytes);
+            if(!grain) break;
+            memset(grain, nGrains & 0xff, grainBytes);
+            grains[nGrains++] = grain;
+        }
+        for(uint32_t c = 0; c < nChannels; ++c)
+            opiDspCopy(info->outputs->channels[c], info->inputs->channels[c], info->nFrames);
+        info->outputs->silenceMask = 0;
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t, void * data)
+    {
+        BenchGrainPlugin * plug = (BenchGrainPlugin*) ptr;
+
+        switch(op)
+        {
+        case opiPlugProcess: plug->process((OpiProcessInfo*) data); return 1;
+        case opiPlugDestroy: delete plug; return 1;
+
+        case opiPlugNumInputs: return 1;
+        case opiPlugNumOutputs: return 1;
+        case opiPlugMaxChannels: return 64;
+
+        case opiPlugConfig:
+            {
+                OpiConfig * config = (OpiConfig*) data;
+                plug->nChannels = config->inBusChannels[0].nChannels;
+                config->arenaSize = (uint64_t) maxGrains * grainBytes;
+                return 1;
+            }
+        case opiPlugReset: plug->reset(); return 1;
+        case opiPlugEnable: plug->reset(); return 1;
+        case opiPlugDisable: return 1;
+
+        default: return 0;
+        }
+    }
+};
+
+// First a chain of instances of the first plugin, with the host's arena off
+// and on: setup is create, configure and enable for all of them (which is
+// where the arena is mapped and faulted in), arena is what got mapped in
+// total. Checksums must match.
+//
+// Then a plugin that allocates as it goes (BenchGrainPlugin) with malloc
+// against the arena, reset every 128 blocks outside the timing.
+static int benchArena(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "arena: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 2;
+    static const uint32_t nInstances = 64;
+    static const uint32_t blockSize = 64;
+
+    printf("%s x %u, block %u\n", benchPluginName(args.plugins[0]).c_str(),
+        nInstances, blockSize);
+    printf("%-6s %10s %10s %5s %11s %9s %9s  %s\n",
+        "arena", "setup(ms)", "arena(MB)", "huge", "us/block", "p99(us)", "max(us)", "checksum");
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize / 16, 16);
+    uint64_t hashes[2] = { 0, 0 };
+
+    for(int useArena = 0; useArena < 2; ++useArena)
+    {
+        std::vector<std::unique_ptr<OpiHostInstance>> insts;
+        std::vector<OpiHostBus> buses(nInstances + 1);
+
+        uint64_t t0 = benchNow();
+        for(uint32_t k = 0; k < nInstances; ++k)
+        {
+            insts.emplace_back(new OpiHostInstance);
+            insts.back()->useArena = useArena != 0;
+            if(!insts.back()->create(lib.entrypoint)
+                || !benchConfigure(*insts.back(), blockSize, nChannels))
+            {
+                fprintf(stderr, "arena: config rejected\n");
+                return 1;
+            }
+        }
+        double setupMs = (benchNow() - t0) * 1e-6;
+
+        uint64_t mapped = 0;
+        uint32_t nHuge = 0;
+        for(auto & inst : insts)
+        {
+            mapped += inst->arena.mapped;
+            nHuge += inst->arena.hugePages;
+        }
+
+        for(auto & bus : buses) bus.allocate(nChannels, blockSize);
+        std::vector<OpiProcessInfo> infos(nInstances);
+        for(uint32_t k = 0; k < nInstances; ++k)
+        {
+            memset(&infos[k], 0, sizeof(OpiProcessInfo));
+            infos[k].processInfoSize = sizeof(OpiProcessInfo);
+            infos[k].nFrames = blockSize;
+            infos[k].inputs = buses[k].bus();
+            infos[k].outputs = buses[k + 1].bus();
+        }
+
+        BenchRandom random;
+        BenchChecksum checksum;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            for(uint32_t i = 0; i < blockSize; ++i)
+                buses[0].channel(c)[i] = random.bipolar();
+
+            uint64_t t1 = benchNow();
+            for(uint32_t k = 0; k < nInstances; ++k) insts[k]->process(&infos[k]);
+            times.blockNs.push_back(benchNow() - t1);
+
+            for(uint32_t c = 0; c < nChannels; ++c)
+                checksum.add(buses[nInstances].channel(c), blockSize * sizeof(float));
+        }
+        hashes[useArena] = checksum.hash;
+
+        printf("%-6s %10.2f %10.2f %5u %11.2f %9.2f %9.2f  %016llx\n",
+            useArena ? "on" : "off", setupMs, mapped / (1024. * 1024.), nHuge,
+            times.total() * 1e-3 / nBlocks, times.percentileUs(.99),
+            times.percentileUs(1), (unsigned long long) checksum.hash);
+    }
+
+    printf("\ngrains of %u bytes, %u per block, reset every 128 blocks\n",
+        BenchGrainPlugin::grainBytes, BenchGrainPlugin::grainsPerBlock);
+    printf("%-6s %11s %9s %9s %9s\n", "arena", "ns/grain", "p50(us)", "p99(us)", "max(us)");
+
+    for(int useArena = 0; useArena < 2; ++useArena)
+    {
+        OpiHostInstance inst;
+        inst.useArena = useArena != 0;
+        if(!inst.create(&BenchGrainPlugin::entrypoint)
+            || !benchConfigure(inst, blockSize, nChannels)) return 1;
+
+        BenchProcessRow row = { blockSize, nChannels, benchSilenceNone, 0 };
+        BenchProcessState state;
+        state.setup(row);
+
+        uint32_t nGrainBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 256);
+        BenchTimes times;
+        times.blockNs.reserve(nGrainBlocks);
+
+        for(uint32_t b = 0; b < nGrainBlocks; ++b)
+        {
+            if(b && !(b % 128)) inst.dispatch(opiPlugReset);
+            state.prepare(row, 0, 0);
+
+            uint64_t t0 = benchNow();
+            inst.process(&state.procInfo);
+            times.blockNs.push_back(benchNow() - t0);
+        }
+        inst.dispatch(opiPlugDisable);
+
+        printf("%-6s %11.1f %9.2f %9.2f %9.2f\n", useArena ? "on" : "off",
+            times.total() / ((double) nGrainBlocks * BenchGrainPlugin::grainsPerBlock),
+            times.percentileUs(.5), times.percentileUs(.99), times.percentileUs(1));
+    }
+
+    if(hashes[0] != hashes[1])
+    {
+        fprintf(stderr, "arena: output differs with the arena\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          PROCESS BRIDGE
+ *
+ * ===============================================================
+ */
+
+#ifdef OPI_BRIDGE_SUPPORTED
+
+// Passes audio through and kills its own process in the 8th block, which is
+// all the host can tell of a plugin crashing behind the bridge.
+struct BenchCrashPlugin : public OpiPlugin
+{
+    static const uint32_t   crashBlock = 8;
+
+    uint32_t    nChannels = 0;
+    uint32_t    nBlocks = 0;
+
+    BenchCrashPlugin(OpiCallback hostCallback, void * hostPtr)
+    {
+        dispatchToHost = hostCallback;
+        dispatchToPlugin = &pluginDispatcher;
+        ptrHost = hostPtr;
+    }
+
+    static OpiPlugin * entrypoint(OpiCallback hostCallback, void * hostPtr)
+    {
+        return new BenchCrashPlugin(hostCallback, hostPtr);
+    }
+
+    static intptr_t pluginDispatcher(
+        struct OpiPlugin * ptr, int32_t op, int32_t, void * data)
+    {
+        BenchCrashPlugin * plug = (BenchCrashPlugin*) ptr;
+
+        switch(op)
+        {
+        case opiPlugProcess:
+            {
+                if(++plug->nBlocks == crashBlock) kill(getpid(), SIGKILL);
+                OpiProcessInfo * info = (OpiProcessInfo*) data;
+                for(uint32_t c = 0; c < plug->nChannels; ++c)
+                    opiDspCopy(info->outputs->channels[c], info->inputs->channels[c], info->nFrames);
+                info->outputs->silenceMask = info->inputs->silenceMask;
+                return 1;
+            }
+        case opiPlugDestroy: delete plug; return 1;
+
+        case opiPlugNumInputs: return 1;
+        case opiPlugNumOutputs: return 1;
+        case opiPlugMaxChannels: return 2;
+
+        case opiPlugConfig:
+            plug->nChannels = ((OpiConfig*) data)->inBusChannels[0].nChannels;
+            return 1;
+        case opiPlugEnable: return 1;
+        case opiPlugDisable: return 1;
+
+        default: return 0;
+        }
+    }
+};
+
+enum BenchBridgeMode
+{
+    benchBridgeLocal,   // in-process, for reference
+    benchBridgeShared,  // audio kept in the bridge's region
+    benchBridgeCopy,    // audio in host buffers, copied across
+    benchBridgeSpin,    // shared, both sides spinning through the blocks
+
+    benchBridgeModeCount
+};
+
+static const char * benchBridgeModeNames[benchBridgeModeCount] =
+    { "local", "shared", "copy", "spin" };
+
+struct BenchBridgeResult
+{
+    BenchTimes  times;
+    uint64_t    hash = 0;
+    double      syscallsPerBlock = 0;
+};
+
+// returns false if the plugin couldn't be started or configured
+static bool benchBridgeRow(OpiHostLibrary & lib, const char * path, uint32_t mode,
+    uint32_t blockSize, BenchArgs & args, BenchBridgeResult & result)
+{
+    static const uint32_t nChannels = 2;
+
+    OpiBridgeHost bridge;
+    if(mode == benchBridgeSpin)
+    {
+        bridge.callSpin = 1 << 20;
+        bridge.idleSpin = 1 << 24;
+    }
+
+    OpiHostInstance inst;
+    if(mode == benchBridgeLocal)
+    {
+        if(!inst.create(lib.entrypoint)) return false;
+    }
+    else if(!bridge.start(path)
+        || !inst.adopt(bridge.instantiate(&OpiHostInstance::hostDispatcher, &inst))) return false;
+
+    uint32_t eventMask = (uint32_t) inst.dispatch(opiPlugInEventMask);
+    uint32_t nParams = (uint32_t) inst.dispatch(opiPlugNumParam);
+    if(!benchConfigure(inst, blockSize, nChannels)) return false;
+
+    BenchProcessRow row = { blockSize, nChannels, benchSilenceNone, 4 };
+    BenchProcessState state;
+    state.setup(row);
+
+    bool shared = mode == benchBridgeShared || mode == benchBridgeSpin;
+    if(shared)
+    {
+        state.procInfo.inputs = bridge.inputBus();
+        state.procInfo.outputs = bridge.outputBus();
+    }
+
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 64);
+    uint32_t nWarmup = std::max<uint32_t>(nBlocks / 16, 4);
+    result.times.blockNs.reserve(nBlocks);
+
+    BenchChecksum checksum;
+    uint32_t syscalls = 0;
+
+    for(uint32_t b = 0; b < nWarmup + nBlocks; ++b)
+    {
+        state.prepare(row, eventMask, nParams);
+        state.timeInfo.samplePos = (uint64_t) b * blockSize;
+        if(shared)
+        {
+            // as if whatever feeds the plugin had rendered straight into it
+            for(uint32_t c = 0; c < nChannels; ++c)
+                memcpy(bridge.inputBus()->channels[c], state.input.channel(c),
+                    blockSize * sizeof(float));
+            bridge.inputBus()->silenceMask = state.input.bus()->silenceMask;
+            bridge.outputBus()->silenceMask = 0;
+        }
+
+        uint32_t s0 = bridge.numSyscalls();
+        uint64_t t0 = benchNow();
+        inst.dispatch(opiPlugProcess, 0, &state.procInfo);
+        uint64_t t1 = benchNow();
+
+        if(b < nWarmup) continue;
+        result.times.blockNs.push_back(t1 - t0);
+        syscalls += bridge.numSyscalls() - s0;
+
+        for(uint32_t c = 0; c < nChannels; ++c)
+            checksum.add(state.procInfo.outputs->channels[c], blockSize * sizeof(float));
+    }
+    inst.dispatch(opiPlugDisable);
+
+    result.hash = checksum.hash;
+    result.syscallsPerBlock = syscalls / (double) nBlocks;
+    return true;
+}
+
+// The [UI] side through the bridge must answer like the plugin in-process:
+// names, value/string conversion and setting parameters. Returns mismatches.
+static uint32_t benchBridgeUi(OpiHostLibrary & lib, const char * path, uint32_t & nChecked)
+{
+    OpiHostInstance local, remote;
+    OpiBridgeHost bridge;
+    if(!local.create(lib.entrypoint) || !bridge.start(path)
+        || !remote.adopt(bridge.instantiate(&OpiHostInstance::hostDispatcher, &remote)))
+        return 1;
+
+    uint32_t mismatches = 0;
+    auto check = [&](bool same) { ++nChecked; if(!same) ++mismatches; };
+
+    uint32_t nParams = (uint32_t) local.dispatch(opiPlugNumParam);
+    check(nParams == (uint32_t) remote.dispatch(opiPlugNumParam));
+    check(local.dispatch(opiPlugInEventMask) == remote.dispatch(opiPlugInEventMask));
+    check(local.dispatch(opiPlugGetLatency) == remote.dispatch(opiPlugGetLatency));
+
+    for(uint32_t p = 0; p < nParams; ++p)
+    {
+        OpiString a = { 0, 0 }, b = { 0, 0 };
+        intptr_t ra = local.dispatch(opiPlugGetParamName, p, &a);
+        std::string name = ra ? std::string(a.data, a.size) : std::string();
+        intptr_t rb = remote.dispatch(opiPlugGetParamName, p, &b);
+        check(ra == rb && name == (rb ? std::string(b.data, b.size) : std::string()));
+
+        float value = .25f + .5f * p / std::max(nParams, 1u);
+        check(local.dispatch(opiPlugSetParam, p, &value) == remote.dispatch(opiPlugSetParam, p, &value));
+
+        float va = -1, vb = -2;
+        local.dispatch(opiPlugGetParam, p, &va);
+        remote.dispatch(opiPlugGetParam, p, &vb);
+        check(va == vb);
+
+        OpiParamString sa = { 0, 0, value }, sb = { 0, 0, value };
+        ra = local.dispatch(opiPlugValueToString, p, &sa);
+        std::string text = ra ? std::string(sa.data, sa.size) : std::string();
+        rb = remote.dispatch(opiPlugValueToString, p, &sb);
+        check(ra == rb && text == (rb ? std::string(sb.data, sb.size) : std::string()));
+
+        if(text.empty()) continue;
+        std::vector<char> chars(text.begin(), text.end());
+        OpiParamString ta = { chars.data(), (uint32_t) chars.size(), 0 };
+        OpiParamString tb = { chars.data(), (uint32_t) chars.size(), 0 };
+        ra = local.dispatch(opiPlugStringToValue, p, &ta);
+        rb = remote.dispatch(opiPlugStringToValue, p, &tb);
+        check(ra == rb && ta.value == tb.value);
+    }
+    return mismatches;
+}
+
+// The first plugin in-process against running in a process of its own
+// (OpiBridgeHost, by forking opi_bench) at 32, 64 and 128 frames with four
+// events per block. "shared" keeps the host's audio in the bridge's region,
+// "copy" passes host buffers; "spin" is shared with both sides spinning
+// through the blocks instead of sleeping (only with more than one core).
+// Added is the p50 over in-process, sys/blk the futex calls per block, and the
+// checksums must match in-process.
+//
+// Then the [UI] ops must agree, and a plugin killing its process must only
+// take that process down: the host notices and gets silence from then on.
+static int benchBridge(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "bridge: no plugins given\n");
+        return 1;
+    }
+
+    const char * path = args.plugins[0];
+    OpiHostLibrary lib;
+    if(!lib.open(path))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", path);
+        return 1;
+    }
+
+    static const uint32_t blockSizes[] = { 32, 64, 128 };
+    bool multiCore = std::thread::hardware_concurrency() > 1;
+    int failed = 0;
+
+    printf("%s, 2 channels, 4 events per block\n", benchPluginName(path).c_str());
+    printf("%-7s %6s %9s %9s %9s %10s %8s  %s\n", "mode", "block",
+        "p50(us)", "p99(us)", "max(us)", "added(us)", "sys/blk", "checksum");
+
+    for(uint32_t blockSize : blockSizes)
+    {
+        double localP50 = 0;
+        uint64_t localHash = 0;
+
+        for(uint32_t mode = 0; mode < benchBridgeModeCount; ++mode)
+        {
+            if(mode == benchBridgeSpin && !multiCore)
+            {
+                printf("%-7s %6u  (skipped, single core)\n", benchBridgeModeNames[mode], blockSize);
+                continue;
+            }
+
+            BenchBridgeResult result;
+            if(!benchBridgeRow(lib, path, mode, blockSize, args, result))
+            {
+                fprintf(stderr, "bridge: %s rejected at block %u\n",
+                    benchBridgeModeNames[mode], blockSize);
+                return 1;
+            }
+
+            double p50 = result.times.percentileUs(.5);
+            if(mode == benchBridgeLocal)
+            {
+                localP50 = p50;
+                localHash = result.hash;
+            }
+            bool same = result.hash == localHash;
+            if(!same) failed = 1;
+
+            printf("%-7s %6u %9.2f %9.2f %9.2f %10.2f %8.2f  %016llx%s\n",
+                benchBridgeModeNames[mode], blockSize, p50,
+                result.times.percentileUs(.99), result.times.percentileUs(1),
+                p50 - localP50, result.syscallsPerBlock,
+                (unsigned long long) result.hash, same ? "" : " MISMATCH");
+        }
+    }
+
+    uint32_t nChecked = 0;
+    uint32_t mismatches = benchBridgeUi(lib, path, nChecked);
+    printf("\nui ops: %u checked, %u mismatches\n", nChecked, mismatches);
+    if(mismatches) failed = 1;
+
+    // a plugin that crashes in the 8th block
+    {
+        OpiBridgeHost bridge;
+        OpiHostInstance inst;
+        if(!bridge.start(&BenchCrashPlugin::entrypoint)
+            || !inst.adopt(bridge.instantiate(&OpiHostInstance::hostDispatcher, &inst))
+            || !benchConfigure(inst, 64, 2))
+        {
+            fprintf(stderr, "bridge: crash plugin didn't start\n");
+            return 1;
+        }
+
+        BenchProcessRow row = { 64, 2, benchSilenceNone, 0 };
+        BenchProcessState state;
+        state.setup(row);
+
+        uint32_t diedIn = 0, silentAfter = 0;
+        double noticeMs = 0;
+        for(uint32_t b = 1; b <= 2 * BenchCrashPlugin::crashBlock; ++b)
+        {
+            state.prepare(row, 0, 0);
+            uint64_t t0 = benchNow();
+            inst.dispatch(opiPlugProcess, 0, &state.procInfo);
+            uint64_t t1 = benchNow();
+
+            if(!diedIn && !bridge.alive())
+            {
+                diedIn = b;
+                noticeMs = (t1 - t0) * 1e-6;
+            }
+            if(diedIn && state.output.bus()->silenceMask == 3
+                && !state.output.channel(0)[0] && !state.output.channel(1)[row.blockSize - 1])
+                ++silentAfter;
+        }
+        inst.destroy();
+
+        printf("crash: stub died in block %u (of %u), noticed after %.1f ms, %u silent blocks\n",
+            diedIn, 2 * BenchCrashPlugin::crashBlock, noticeMs, silentAfter);
+        if(diedIn != BenchCrashPlugin::crashBlock
+            || silentAfter != BenchCrashPlugin::crashBlock + 1) failed = 1;
+    }
+    return failed;
+}
+
+#else
+
+static int benchBridge(BenchArgs &)
+{
+    printf("not supported on this platform\n");
+    return 0;
+}
+
+#endif // OPI_BRIDGE_SUPPORTED
+
+/*
+ * ==============================================================
+ *
+ *                          WIDE BUSES
+ *
+ * ===============================================================
+ */
+
+struct BenchWideLayout
+{
+    const char *    name;
+    uint32_t        interleave;
+    uint32_t        flags;
+};
+
+static const BenchWideLayout benchWideLayouts[] =
+{
+    { "planar64",   1,  0 },    // silenceMask only
+    { "planar",     1,  opiConfigWideSilence },
+    { "group4",     4,  opiConfigWideSilence | opiConfigInterleaved },
+    { "group8",     8,  opiConfigWideSilence | opiConfigInterleaved },
+    { "group16",    16, opiConfigWideSilence | opiConfigInterleaved },
+};
+
+// A 256-channel bus through the first plugin, with four automation events per
+// block: planar with only silenceMask ("planar64", so channels from 64 up are
+// never silent), planar with opiConfigWideSilence, and interleaved in groups
+// of 4, 8 and 16. "active" is the number of channels carrying signal; the
+// rest are silent with their outputs already cleared, like a lower order
+// scene on a higher order ambisonics bus. Checksums must match across layouts.
+// Then the bus through a chain of the plugin in OpiGraph.
+static int benchWide(BenchArgs & args)
+{
+    if(args.plugins.empty())
+    {
+        fprintf(stderr, "wide: no plugins given\n");
+        return 1;
+    }
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    static const uint32_t nChannels = 256;
+    static const uint32_t nEvents = 4;
+    static const uint32_t blockSizes[] = { 64, 256 };
+    static const uint32_t actives[] = { nChannels, 64 };
+
+    printf("%s, %u channels, %u events per block\n",
+        benchPluginName(args.plugins[0]).c_str(), nChannels, nEvents);
+    printf("%-9s %6s %6s %9s %9s %9s %9s  %s\n", "layout", "block", "active",
+        "ns/smp", "p50(us)", "p99(us)", "max(us)", "checksum");
+
+    int failed = 0;
+    for(uint32_t blockSize : blockSizes)
+    for(uint32_t nActive : actives)
+    {
+        uint64_t firstHash = 0;
+        bool haveFirst = false;
+
+        for(const BenchWideLayout & layout : benchWideLayouts)
+        {
+            OpiHostInstance inst;
+            if(!inst.create(lib.entrypoint)) return 1;
+            uint32_t nParams = (uint32_t) inst.dispatch(opiPlugNumParam);
+
+            inst.inInterleave = inst.outInterleave = layout.interleave;
+            if(!benchConfigure(inst, blockSize, nChannels, layout.flags)
+                || inst.inInterleave != layout.interleave)
+            {
+                printf("%-9s %6u %6u  (config rejected)\n", layout.name, blockSize, nActive);
+                continue;
+            }
+
+            OpiHostBus in, out;
+            in.allocate(nChannels, blockSize, inst.inInterleave);
+            out.allocate(nChannels, blockSize, inst.outInterleave);
+
+            std::vector<OpiEventAutomation> automation(nEvents);
+            std::vector<OpiEvent*> events(nEvents);
+
+            OpiProcessInfo info;
+            memset(&info, 0, sizeof(info));
+            info.processInfoSize = sizeof(OpiProcessInfo);
+            info.nFrames = blockSize;
+            info.inputs = in.bus();
+            info.outputs = out.bus();
+            info.inEvents = events.data();
+            info.nInEvents = nEvents;
+
+            uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+            uint32_t nWarmup = std::max<uint32_t>(nBlocks / 16, 4);
+
+            BenchRandom random;
+            BenchChecksum checksum;
+            BenchTimes times;
+            times.blockNs.reserve(nBlocks);
+            std::vector<float> planar(blockSize);
+
+            for(uint32_t b = 0; b < nWarmup + nBlocks; ++b)
+            {
+                for(uint32_t c = 0; c < nActive; ++c)
+                for(uint32_t i = 0; i < blockSize; ++i)
+                    in.sample(c, i) = random.bipolar();
+
+                in.setAllSilent(false);
+                out.setAllSilent(false);
+                for(uint32_t c = nActive; c < nChannels; ++c)
+                {
+                    in.setSilent(c, true);
+                    out.setSilent(c, true);
+                }
+
+                for(uint32_t e = 0; e < nEvents; ++e)
+                {
+                    OpiEventAutomation & ev = automation[e];
+                    ev.type = opiEventAutomation;
+                    ev.delta = e * blockSize / nEvents;
+                    ev.paramIndex = nParams ? e % nParams : 0;
+                    ev.targetValue = random.uniform();
+                    ev.smoothFrames = blockSize / nEvents;
+                    events[e] = (OpiEvent*) &ev;
+                }
+
+                uint64_t t0 = benchNow();
+                inst.dispatch(opiPlugProcess, 0, &info);
+                uint64_t t1 = benchNow();
+
+                if(b < nWarmup) continue;
+                times.blockNs.push_back(t1 - t0);
+
+                // channel by channel, so that every layout sums the same
+                for(uint32_t c = 0; c < nChannels; ++c)
+                {
+                    for(uint32_t i = 0; i < blockSize; ++i) planar[i] = out.sample(c, i);
+                    checksum.add(planar.data(), blockSize * sizeof(float));
+                }
+            }
+            inst.dispatch(opiPlugDisable);
+
+            if(!haveFirst) firstHash = checksum.hash;
+            haveFirst = true;
+            bool same = checksum.hash == firstHash;
+            if(!same) failed = 1;
+
+            printf("%-9s %6u %6u %9.3f %9.2f %9.2f %9.2f  %016llx%s\n",
+                layout.name, blockSize, nActive,
+                times.total() / ((double) nBlocks * blockSize * nChannels),
+                times.percentileUs(.5), times.percentileUs(.99), times.percentileUs(1),
+                (unsigned long long) checksum.hash, same ? "" : " MISMATCH");
+        }
+    }
+
+    // The same bus through a chain of the plugin in OpiGraph, which offers
+    // opiConfigWideSilence: with fewer channels active the rest must come out
+    // flagged silent, and with none the whole chain must fall asleep (if the
+    // plugin took the flag and reports a tail).
+    static const uint32_t chainLength = 4;
+    static const uint32_t blockSize = 256;
+    static const uint32_t graphActives[] = { nChannels, 64, 0 };
+
+    std::vector<std::unique_ptr<OpiHostInstance>> insts;
+    OpiGraph graph;
+    for(uint32_t k = 0; k < chainLength; ++k)
+    {
+        insts.emplace_back(new OpiHostInstance);
+        if(!insts.back()->create(lib.entrypoint)) return 1;
+        graph.addNode(insts.back().get(), nChannels);
+        if(k) graph.connect(k - 1, k);
+    }
+    if(!graph.compile(blockSize, 48000))
+    {
+        printf("\ngraph, chain of %u  (config rejected)\n", chainLength);
+        return failed;
+    }
+    bool wide = (graph.nodes[0]->flags & opiConfigWideSilence) != 0;
+
+    printf("\ngraph, chain of %u, block %u, wide silence %s\n",
+        chainLength, blockSize, wide ? "on" : "off");
+    printf("%6s %11s %8s %8s\n", "active", "us/block", "asleep", "silent");
+
+    OpiWorkerPool pool;
+    uint32_t nBlocks = std::max<uint32_t>(args.totalFrames / blockSize, 16);
+    for(uint32_t nActive : graphActives)
+    {
+        BenchRandom random;
+        BenchTimes times;
+        times.blockNs.reserve(nBlocks);
+
+        OpiHostBus & in = graph.input(0);
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < nChannels; ++c)
+            {
+                for(uint32_t i = 0; i < blockSize; ++i)
+                    in.channel(c)[i] = c < nActive ? random.bipolar() : 0.f;
+                in.setSilent(c, c >= nActive);
+            }
+
+            uint64_t t0 = benchNow();
+            graph.process(pool, blockSize);
+            times.blockNs.push_back(benchNow() - t0);
+            graph.idle();
+        }
+
+        OpiHostBus & out = graph.output(chainLength - 1);
+        uint32_t silent = 0;
+        for(uint32_t c = 0; c < nChannels; ++c) silent += out.silent(c);
+
+        // with wide silence every inactive channel must be flagged
+        bool ok = !wide || silent == nChannels - nActive;
+        if(!ok) failed = 1;
+
+        printf("%6u %11.2f %8u %8u%s\n", nActive, times.total() * 1e-3 / nBlocks,
+            graph.numSleeping(), silent, ok ? "" : " FAIL");
+    }
+    return failed;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          STRINGS
+ *
+ * ===============================================================
+ */
+
+// Strings for 10k values of every plugin's first parameter, as for drawing an
+// automation lane: one opiPlugValueToString per value copied out by the host
+// ("single"), opiPlugValuesToStrings ("bulk"), the host formatting them itself
+// from opiPlugGetParamFormat ("format") and OpiHostInstance::valuesToStrings
+// ("host", whichever of those it picks), then the same back to values. The
+// strings (and values) must match across the rows of a plugin.
+static int benchStrings(BenchArgs & args)
+{
+    static const uint32_t nValues = 10000;
+    static const uint32_t nRuns = 16;
+
+    printf("%-20s %-12s %10s %9s  %s\n", "plugin", "mode", "us/10k", "ns/value", "checksum");
+
+    int failed = 0;
+    for(const char * path : args.plugins)
+    {
+        std::string name = benchPluginName(path);
+
+        OpiHostLibrary lib;
+        OpiHostInstance inst;
+        if(!lib.open(path) || !inst.create(lib.entrypoint))
+        {
+            fprintf(stderr, "%s: cannot load plugin\n", path);
+            failed = 1;
+            continue;
+        }
+        if(!inst.dispatch(opiPlugNumParam))
+        {
+            printf("%-20s (no parameters)\n", name.c_str());
+            continue;
+        }
+
+        std::vector<float> values(nValues);
+        BenchRandom random;
+        for(float & v : values) v = random.uniform();
+
+        const OpiParamFormat * format = (const OpiParamFormat*) inst.dispatch(opiPlugGetParamFormat);
+
+        OpiHostStrings strings;
+        std::vector<float> parsed(nValues);
+        uint64_t firstHash = 0, firstParsed = 0;
+        bool haveFirst = false, haveParsed = false;
+
+        // time fn() nRuns times, print the median and check what it left
+        auto row = [&](const char * mode, bool toValues, const std::function<bool()> & fn)
+        {
+            BenchTimes times;
+            bool ok = true;
+            for(uint32_t r = 0; r < nRuns && ok; ++r)
+            {
+                uint64_t t0 = benchNow();
+                ok = fn();
+                times.blockNs.push_back(benchNow() - t0);
+            }
+            if(!ok)
+            {
+                printf("%-20s %-12s  (not supported)\n", name.c_str(), mode);
+                return;
+            }
+
+            BenchChecksum checksum;
+            if(toValues) checksum.add(parsed.data(), nValues * sizeof(float));
+            else checksum.add(strings.data.data(), strings.offsets[nValues]);
+
+            uint64_t & first = toValues ? firstParsed : firstHash;
+            bool & have = toValues ? haveParsed : haveFirst;
+            if(!have) first = checksum.hash;
+            have = true;
+            bool same = checksum.hash == first;
+            if(!same) failed = 1;
+
+            double us = times.percentileUs(.5);
+            printf("%-20s %-12s %10.1f %9.1f  %016llx%s\n", name.c_str(), mode,
+                us, us * 1e3 / nValues, (unsigned long long) checksum.hash, same ? "" : " MISMATCH");
+        };
+
+        // what hosts do without bulk conversion: copy each result out
+        row("single", false, [&]()
+        {
+            strings.data.clear();
+            strings.offsets.assign(1, 0);
+            for(uint32_t i = 0; i < nValues; ++i)
+            {
+                OpiParamString str = { 0, 0, values[i] };
+                if(!inst.dispatch(opiPlugValueToString, 0, &str)) return false;
+                strings.data.insert(strings.data.end(), str.data, str.data + str.size);
+                strings.data.push_back(0);
+                strings.offsets.push_back((uint32_t) strings.data.size());
+            }
+            return true;
+        });
+
+        auto packed = [&](OpiParamStrings & ps)
+        {
+            ps.paramStringsSize = sizeof(OpiParamStrings);
+            ps.count = nValues;
+            ps.data = strings.data.data();
+            ps.dataSize = (uint32_t) strings.data.size();
+            ps.offsets = strings.offsets.data();
+        };
+
+        row("bulk", false, [&]()
+        {
+            strings.data.resize(32 * nValues);
+            strings.offsets.assign(nValues + 1, 0);
+            OpiParamStrings ps;
+            packed(ps);
+            ps.values = values.data();
+            return inst.dispatch(opiPlugValuesToStrings, 0, &ps) == nValues;
+        });
+
+        row("format", false, [&]()
+        {
+            if(!format) return false;
+            strings.data.resize(32 * nValues);
+            strings.offsets.assign(nValues + 1, 0);
+            OpiParamStrings ps;
+            packed(ps);
+            ps.values = values.data();
+            return opiFormatValues(*format, &ps) == nValues;
+        });
+
+        row("host", false, [&]()
+        {
+            inst.valuesToStrings(0, values.data(), nValues, strings);
+            return true;
+        });
+
+        // strings is left as "host" made it, parse those back
+        row("single parse", true, [&]()
+        {
+            for(uint32_t i = 0; i < nValues; ++i)
+            {
+                OpiParamString str = { (char*) strings.get(i), strings.size(i), 0 };
+                if(!inst.dispatch(opiPlugStringToValue, 0, &str)) return false;
+                parsed[i] = str.value;
+            }
+            return true;
+        });
+
+        row("bulk parse", true, [&]()
+        {
+            OpiParamStrings ps;
+            packed(ps);
+            ps.values = parsed.data();
+            return inst.dispatch(opiPlugStringsToValues, 0, &ps) != 0;
+        });
+
+        row("format parse", true, [&]()
+        {
+            if(!format) return false;
+            OpiParamStrings ps;
+            packed(ps);
+            ps.values = parsed.data();
+            opiParseValues(*format, &ps);
+            return true;
+        });
+    }
+    return failed;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          RESAMPLING
+ *
+ * ===============================================================
+ */
+
+// Below this the residual is float rounding of the input, not the resampler.
+static const double benchResidualFloorDb = -140;
+
+// What is left of y once the best fitting sinusoid of w radians per frame is
+// taken out, relative to all of y (ie. THD+N), in dB but no lower than
+// benchResidualFloorDb; gainDb gets its level relative to amplitude.
+static double benchResidualDb(const float * y, uint32_t n, double w,
+    double amplitude = 1, double * gainDb = 0)
+{
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0, yy = 0;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        double s = sin(w * i), c = cos(w * i);
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        ys += y[i] * s;
+        yc += y[i] * c;
+        yy += (double) y[i] * y[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    if(gainDb) *gainDb = 20 * log10(sqrt(a * a + b * b) / amplitude + 1e-30);
+
+    // sample by sample: yy minus the fitted energy cancels down to rounding
+    double residual = 0;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        double r = y[i] - (a * sin(w * i) + b * cos(w * i));
+        residual += r * r;
+    }
+    if(residual <= 0 || yy <= 0) return benchResidualFloorDb;
+    return std::max(10 * log10(residual / yy), benchResidualFloorDb);
+}
+
+// a benchResidualDb result for printing, "<-140" at the floor
+static std::string benchResidualText(double db)
+{
+    char text[16];
+    if(db <= benchResidualFloorDb) snprintf(text, sizeof(text), "<%.0f", benchResidualFloorDb);
+    else snprintf(text, sizeof(text), "%.1f", db);
+    return text;
+}
+
+// x through a mono resampler in blocks, whatever comes out
+static std::vector<float> benchResampleAll(OpiResampler & r, const std::vector<float> & x,
+    uint32_t blockSize)
+{
+    std::vector<float> y, block(r.maxOut(blockSize));
+    for(uint32_t i = 0; i < x.size(); i += blockSize)
+    {
+        const float * in = x.data() + i;
+        float * out = block.data();
+        uint32_t n = r.process(&in, std::min<uint32_t>(blockSize, (uint32_t) x.size() - i), &out);
+        y.insert(y.end(), block.begin(), block.begin() + n);
+    }
+    return y;
+}
+
+static std::vector<float> benchSine(uint32_t n, double hz, double rate, double amplitude = 1)
+{
+    const double pi = 3.14159265358979323846;
+    std::vector<float> x(n);
+    for(uint32_t i = 0; i < n; ++i) x[i] = (float) (amplitude * sin(2 * pi * hz * i / rate));
+    return x;
+}
+
+// Polyphase conversion at common ratios: time per output frame with every
+// kernel variant, then quality (level and THD+N of tones that should pass,
+// rejection of those that must not alias), tanh distortion oversampled 1x to
+// 8x, and the first plugin run at 48 kHz in a 44.1 kHz host through
+// OpiResampleWrapper.
+static int benchResample(BenchArgs & args)
+{
+    const double pi = 3.14159265358979323846;
+    static const uint32_t blockSize = 256;
+    static const uint32_t ratios[][2] =
+        { { 44100, 48000 }, { 48000, 44100 }, { 48000, 96000 }, { 96000, 48000 } };
+
+    int failed = 0;
+
+    printf("throughput, 2 channels, %u-frame blocks\n", blockSize);
+    printf("%-14s %-8s %9s\n", "ratio", "isa", "ns/frame");
+    for(auto & ratio : ratios)
+    for(int isa = 0; isa < opiDspIsaCount; ++isa)
+    {
+        const OpiDspKernels * k = opiDspKernelsFor(isa);
+        if(!k) continue;
+
+        OpiResampler r;
+        r.kernels = k;
+        r.init(ratio[0], ratio[1], 2, blockSize);
+
+        std::vector<float> x = benchSine(blockSize, 1000, ratio[0]);
+        std::vector<float> y(2 * r.maxOut(blockSize));
+        const float * in[2] = { x.data(), x.data() };
+        float * out[2] = { y.data(), y.data() + r.maxOut(blockSize) };
+
+        uint64_t nOut = 0;
+        uint64_t t0 = benchNow();
+        for(uint32_t done = 0; done < args.totalFrames; done += blockSize)
+            nOut += r.process(in, blockSize, out);
+        uint64_t t1 = benchNow();
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u->%u", ratio[0], ratio[1]);
+        printf("%-14s %-8s %9.2f\n", name, k->name, (t1 - t0) / (2. * nOut));
+    }
+
+    printf("\nquality, 64-tap filters\n");
+    printf("%-14s %9s %9s %10s\n", "ratio", "tone(Hz)", "gain(dB)", "thd+n(dB)");
+    for(auto & ratio : ratios)
+    {
+        // 15997 rather than 16000: no short period in common with the rates
+        static const double tones[] = { 1000, 10000, 15997 };
+        for(double hz : tones)
+        {
+            OpiResampler r;
+            r.init(ratio[0], ratio[1], 1, blockSize);
+            std::vector<float> y = benchResampleAll(r, benchSine(32768, hz, ratio[0], .5), blockSize);
+
+            // skip the filter's start
+            uint32_t skip = (uint32_t) r.latency() * 4;
+            double gain, thd = benchResidualDb(y.data() + skip, (uint32_t) y.size() - skip,
+                2 * pi * hz / ratio[1], .5, &gain);
+            if(thd > -80 || fabs(gain) > .1) failed = 1;
+
+            char name[32];
+            snprintf(name, sizeof(name), "%u->%u", ratio[0], ratio[1]);
+            printf("%-14s %9.0f %9.3f %10s%s\n", name, hz, gain, benchResidualText(thd).c_str(),
+                thd > -80 || fabs(gain) > .1 ? " FAIL" : "");
+        }
+    }
+
+    // tones above the output's Nyquist frequency, which must not fold back
+    printf("\n%-14s %9s %14s\n", "ratio", "tone(Hz)", "rejection(dB)");
+    {
+        static const uint32_t aliasCases[][3] = { { 48000, 44100, 23000 }, { 96000, 48000, 30000 } };
+        for(auto & c : aliasCases)
+        {
+            OpiResampler r;
+            r.init(c[0], c[1], 1, blockSize);
+            std::vector<float> y = benchResampleAll(r, benchSine(32768, c[2], c[0], .5), blockSize);
+
+            uint32_t skip = (uint32_t) r.latency() * 4;
+            double energy = 0;
+            for(uint32_t i = skip; i < y.size(); ++i) energy += (double) y[i] * y[i];
+            double db = 10 * log10(energy / (y.size() - skip) / (.5 * .5 * .5) + 1e-30);
+            if(db > -90) failed = 1;
+
+            char name[32];
+            snprintf(name, sizeof(name), "%u->%u", c[0], c[1]);
+            printf("%-14s %9u %14.1f%s\n", name, c[2], -db, db > -90 ? " FAIL" : "");
+        }
+    }
+
+    // 4690 Hz is exactly 469 cycles per 4800 frames, so every harmonic is in
+    // a bin of its own and anything between them is aliasing
+    printf("\noversampling, tanh(4x) of 4690 Hz at 48 kHz, 2 channels\n");
+    printf("%-7s %8s %10s %9s\n", "factor", "latency", "alias(dB)", "ns/frame");
+    {
+        static const uint32_t window = 4800, bin = 469;
+        static const uint32_t factors[] = { 1, 2, 4, 8 };
+        std::vector<float> x = benchSine(16 * window, 4690, 48000);
+
+        for(uint32_t factor : factors)
+        {
+            OpiOversampler os;
+            os.init(factor, 2, blockSize);
+
+            std::vector<float> y(x.size()), y2(blockSize);
+            uint64_t t0 = benchNow();
+            for(uint32_t i = 0; i < x.size(); i += blockSize)
+            {
+                const float * in[2] = { x.data() + i, x.data() + i };
+                float * const * hi = os.up(in, blockSize);
+                for(uint32_t c = 0; c < 2; ++c)
+                for(uint32_t j = 0; j < factor * blockSize; ++j)
+                    hi[c][j] = tanhf(4 * hi[c][j]);
+                float * out[2] = { y.data() + i, y2.data() };
+                os.down(out, blockSize);
+            }
+            uint64_t t1 = benchNow();
+
+            const float * w = y.data() + y.size() - window;
+            double total = 0, harmonics = 0, dc = 0;
+            for(uint32_t i = 0; i < window; ++i)
+            {
+                total += (double) w[i] * w[i];
+                dc += w[i];
+            }
+            harmonics += dc * dc / window;
+            for(uint32_t h = bin; h < window / 2; h += bin)
+            {
+                double s = 0, c = 0;
+                for(uint32_t i = 0; i < window; ++i)
+                {
+                    s += w[i] * sin(2 * pi * h * i / window);
+                    c += w[i] * cos(2 * pi * h * i / window);
+                }
+                harmonics += 2 * (s * s + c * c) / window;
+            }
+            double alias = 10 * log10(std::max(total - harmonics, 1e-30) / total);
+
+            printf("%-7u %8u %10.1f %9.2f\n", factor, os.latency(), alias,
+                (t1 - t0) / (2. * x.size()));
+        }
+    }
+
+    if(args.plugins.empty()) return failed;
+
+    OpiHostLibrary lib;
+    if(!lib.open(args.plugins[0]))
+    {
+        fprintf(stderr, "%s: cannot load plugin\n", args.plugins[0]);
+        return 1;
+    }
+
+    printf("\n%s at 48000 Hz in a 44100 Hz host, %u-frame blocks\n",
+        benchPluginName(args.plugins[0]).c_str(), blockSize);
+
+    // native at 44.1 kHz, then wrapped; impulse and event timing are
+    // relative to input time plus reported latency
+    double usNative = 0;
+    int64_t nativePeakOff = 0, nativeDropOff = 0;
+    for(int wrapped = 0; wrapped < 2; ++wrapped)
+    {
+        OpiHostInstance inst;
+        if(wrapped)
+        {
+            if(!inst.adopt(OpiResampleWrapper::create(lib.entrypoint, 48000,
+                &OpiHostInstance::hostDispatcher, &inst))) return 1;
+        }
+        else if(!inst.create(lib.entrypoint)) return 1;
+
+        if(!inst.configure(blockSize, 44100, 2, 2))
+        {
+            printf("%-8s (config rejected)\n", wrapped ? "wrapped" : "native");
+            return 1;
+        }
+        inst.refreshLatency();
+        inst.dispatch(opiPlugEnable);
+
+        OpiHostBus in, out;
+        in.allocate(2, blockSize);
+        out.allocate(2, blockSize);
+
+        OpiEventAutomation mute = { opiEventAutomation, 37, 0, 0, 0 };
+        OpiEvent * events[1] = { (OpiEvent*) &mute };
+
+        OpiProcessInfo info;
+        memset(&info, 0, sizeof(info));
+        info.processInfoSize = sizeof(OpiProcessInfo);
+        info.nFrames = blockSize;
+        info.inputs = in.bus();
+        info.outputs = out.bus();
+
+        // an impulse at frame 100 and where its peak comes out
+        uint32_t nBlocks = 8, peakAt = 0;
+        float peak = 0;
+        std::vector<float> y;
+        for(uint32_t b = 0; b < nBlocks; ++b)
+        {
+            for(uint32_t c = 0; c < 2; ++c)
+            for(uint32_t i = 0; i < blockSize; ++i)
+                in.channel(c)[i] = b == 0 && i == 100 ? 1.f : 0.f;
+            inst.process(&info);
+            for(uint32_t i = 0; i < blockSize; ++i)
+                if(fabsf(out.channel(0)[i]) > peak)
+                {
+                    peak = fabsf(out.channel(0)[i]);
+                    peakAt = b * blockSize + i;
+                }
+        }
+
+        // a 1 kHz tone there and back
+        inst.dispatch(opiPlugReset);
+        std::vector<float> x = benchSine(32 * blockSize, 1000, 44100, .5);
+        for(uint32_t b = 0; b < 32; ++b)
+        {
+            for(uint32_t c = 0; c < 2; ++c)
+                memcpy(in.channel(c), x.data() + b * blockSize, blockSize * sizeof(float));
+            inst.process(&info);
+            y.insert(y.end(), out.channel(0), out.channel(0) + blockSize);
+        }
+        double gain, thd = benchResidualDb(y.data() + 8 * blockSize, 24 * blockSize,
+            2 * pi * 1000 / 44100, .5, &gain);
+
+        // a constant, muted in block 4 at frame 37: where it drops out (if
+        // the first parameter is a level at all)
+        inst.dispatch(opiPlugReset);
+        int64_t dropAt = -1;
+        bool high = false;
+        for(uint32_t b = 0; b < 12; ++b)
+        {
+            for(uint32_t c = 0; c < 2; ++c)
+            for(uint32_t i = 0; i < blockSize; ++i) in.channel(c)[i] = .5f;
+            info.inEvents = b == 4 ? events : 0;
+            info.nInEvents = b == 4 ? 1 : 0;
+            inst.process(&info);
+            for(uint32_t i = 0; i < blockSize && dropAt < 0 && b >= 4; ++i)
+            {
+                if(fabsf(out.channel(0)[i]) >= .25f) high = true;
+                else if(high) dropAt = b * blockSize + i;
+            }
+        }
+        info.inEvents = 0;
+        info.nInEvents = 0;
+        float unity = 1;
+        inst.dispatch(opiPlugSetParam, 0, &unity);
+
+        // the cost of a block
+        BenchRandom random;
+        for(uint32_t c = 0; c < 2; ++c)
+        for(uint32_t i = 0; i < blockSize; ++i) in.channel(c)[i] = random.bipolar();
+        uint32_t reps = std::max<uint32_t>(args.totalFrames / blockSize, 64);
+        uint64_t t0 = benchNow();
+        for(uint32_t r = 0; r < reps; ++r) inst.process(&info);
+        double us = (benchNow() - t0) * 1e-3 / reps;
+        if(!wrapped) usNative = us;
+        inst.dispatch(opiPlugDisable);
+
+        // wrapped, both should move by exactly the latency added
+        int64_t peakOff = (int64_t) peakAt - 100 - (int64_t) inst.latency;
+        int64_t dropOff = dropAt < 0 ? 0 : dropAt - (4 * blockSize + 37) - (int64_t) inst.latency;
+        if(!wrapped)
+        {
+            nativePeakOff = peakOff;
+            nativeDropOff = dropOff;
+        }
+        bool ok = std::abs(peakOff - nativePeakOff) <= 1
+            && std::abs(dropOff - nativeDropOff) <= 1 && thd < -80;
+        if(!ok) failed = 1;
+
+        char event[24] = "-";
+        if(dropAt >= 0) snprintf(event, sizeof(event), "%+lld", (long long) dropOff);
+        printf("%-8s latency %3u, impulse %+lld, event %s, thd+n %s dB, %.2f us/block (%+.2f)%s\n",
+            wrapped ? "wrapped" : "native", inst.latency, (long long) peakOff,
+            event, benchResidualText(thd).c_str(), us, us - usNative, ok ? "" : " FAIL");
+    }
+    return failed;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          MAIN
+ *
+ * ===============================================================
+ */
+
+struct BenchSuite
+{
+    const char *    name;
+    const char *    help;
+    int (*run)(BenchArgs &);
+};
+
+static const BenchSuite benchSuites[] =
+{
+    { "process",    "opiPlugProcess matrix for each plugin", benchProcess },
+    { "dsp",        "CommunityDsp.h kernels against the scalar loops", benchDsp },
+    { "events",     "sample-accurate automation, dense vs sparse", benchEvents },
+    { "midi",       "packed event buffers vs pointer arrays", benchMidi },
+    { "state",      "large plugin state, single chunk vs sections", benchState },
+    { "params",     "lock-free parameter exchange stress test", benchParams },
+    { "bulk",       "10k parameter sync, single vs bulk ops", benchBulk },
+    { "chain",      "serial chains, separate vs in-place buffers", benchChain },
+    { "graph",      "parallel graph scaling over 1..n threads", benchGraph },
+    { "sleep",      "idle session with and without sleeping nodes", benchSleep },
+    { "bounce",     "offline render with large blocks vs live", benchBounce },
+    { "tasks",      "opiHostRunTasks scaling over 1..n threads", benchTasks },
+    { "calls",      "per-call overhead, dispatcher vs function table", benchCalls },
+    { "batch",      "64 instances, one call each vs batched", benchBatch },
+    { "profile",    "500-node session profiled per instance", benchProfile },
+    { "modulation", "audio-rate parameter buffers vs automation events", benchModulation },
+    { "scan",       "2000-plugin library scan, instance vs descriptor vs cache", benchScan },
+    { "latency",    "delay compensation: correctness and cost on 256 tracks", benchLatency },
+    { "rtcheck",    "allocations and locks in realtime calls (OpiRtCheck.so)", benchRtCheck },
+    { "arena",      "host arena vs plugin heap: setup, processing, allocation", benchArena },
+    { "bridge",     "out-of-process plugin: added latency at 32..128 frames", benchBridge },
+    { "wide",       "256-channel bus: planar vs interleaved groups, wide silence", benchWide },
+    { "strings",    "10k parameter values to strings and back: single vs bulk vs format", benchStrings },
+    { "resample",   "polyphase resampling and oversampling: speed, quality, wrapped plugin", benchResample },
+};
+
+static void benchUsage()
+{
+    printf("usage: opi_bench [--suite name|all] [--frames n] [--golden file]"
+        " [--threads n] [--trace file] plugin ...\n\n");
+    printf("suites:\n");
+    for(const BenchSuite & s : benchSuites) printf("  %-12s %s\n", s.name, s.help);
+}
+
+int main(int argc, char ** argv)
+{
+    BenchArgs args;
+    const char * suite = "process";
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--suite" && i + 1 < argc) suite = argv[++i];
+        else if(arg == "--frames" && i + 1 < argc) args.totalFrames = atoi(argv[++i]);
+        else if(arg == "--golden" && i + 1 < argc) args.golden = argv[++i];
+        else if(arg == "--threads" && i + 1 < argc) args.maxThreads = atoi(argv[++i]);
+        else if(arg == "--trace" && i + 1 < argc) args.trace = argv[++i];
+        else if(arg == "--help" || arg == "-h") { benchUsage(); return 0; }
+        else if(arg[0] == '-') { benchUsage(); return 1; }
+        else args.plugins.push_back(argv[i]);
+    }
+    if(!args.totalFrames) args.totalFrames = 1;
+    if(!args.maxThreads) args.maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    args.loadGolden();
+    args.all = !strcmp(suite, "all");
+
+    int result = 0;
+    bool found = false;
+    for(const BenchSuite & s : benchSuites)
+    {
+        if(strcmp(suite, "all") && strcmp(suite, s.name)) continue;
+        found = true;
+        printf("== %s\n", s.name);
+        if(s.run(args)) result = 1;
+    }
+    if(!found) { benchUsage(); return 1; }
+
+    args.saveGolden();
+    if(args.mismatches)
+    {
+        fprintf(stderr, "%d golden checksum mismatches\n", args.mismatches);
+        result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,38 @@
+/*
+/// # opi_bridge
+///
+/// ## About
+/// Stub process for OpiBridgeHost (see CommunityBridge.h): loads one plugin
+/// and serves it through the shared memory region the host passed down. Hosts
+/// that don't want a copy of themselves forked for every plugin run this.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    g++ -O2 OpiBridgeStub.cpp -o opi_bridge -ldl -lpthread
+///
+///    // in the host, which starts it as "opi_bridge <fd> <plugin>"
+///    bridge.start("plugin.so", "./opi_bridge");
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+
+#include "CommunityBridge.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char ** argv)
+{
+#ifdef OPI_BRIDGE_SUPPORTED
+    if(argc != 3)
+    {
+        fprintf(stderr, "usage: opi_bridge fd plugin\n");
+        return 2;
+    }
+    return OpiBridgeStub::run(atoi(argv[1]), argv[2], 0);
+#else
+    (void) argc;
+    (void) argv;
+    fprintf(stderr, "opi_bridge: not supported on this platform\n");
+    return 2;
+#endif
+}
@@ -0,0 +1,302 @@
+/*
+/// # OpiRtCheck
+///
+/// ## About
+/// Preload library behind CommunityRtCheck.h: interposes the allocator,
+/// blocking pthread calls and the common system calls, and records every
+/// call made by a thread while it is inside a realtime call of the host.
+///
+/// ## Usage
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~none
+///    g++ -O2 -shared -fPIC OpiRtCheck.cpp -o OpiRtCheck.so -ldl
+///    LD_PRELOAD=./OpiRtCheck.so ./opi_bench --suite rtcheck plugin.so
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+/// ## Details
+/// The allocator is forwarded to glibc's __libc_* entry points (asking the
+/// dynamic linker for the next malloc could itself allocate), everything
+/// else to the next definition found by dlsym(RTLD_NEXT). The thread state
+/// uses initial-exec TLS so that touching it never allocates either.
+///
+/// Locks that can't block (trylock) and atomics are fine and not reported.
+*/
+
+#include "CommunityRtCheck.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C"
+{
+    void *  __libc_malloc(size_t size);
+    void *  __libc_calloc(size_t n, size_t size);
+    void *  __libc_realloc(void * ptr, size_t size);
+    void    __libc_free(void * ptr);
+    void *  __libc_memalign(size_t alignment, size_t size);
+}
+
+#define OPI_RT_TLS  __thread __attribute__((tls_model("initial-exec")))
+
+static const uint32_t               opiRtMaxViolations = 4096;
+static OpiRtViolation               opiRtViolations[opiRtMaxViolations];
+static std::atomic<uint32_t>        opiRtNumViolations { 0 };
+
+static OPI_RT_TLS uint32_t          opiRtDepth = 0;
+static OPI_RT_TLS const char *      opiRtWhat = 0;
+static OPI_RT_TLS bool              opiRtBusy = false;
+
+// the unwinder is loaded on first use (which allocates), so get that done
+__attribute__((constructor)) static void opiRtInit()
+{
+    void * frames[4];
+    backtrace(frames, 4);
+}
+
+// records a call to kind if this thread is in a realtime call, leaving out
+// this function and the hook from the stack
+static void opiRtRecord(const char * kind)
+{
+    if(!opiRtDepth || opiRtBusy) return;
+    opiRtBusy = true;
+
+    uint32_t i = opiRtNumViolations.fetch_add(1, std::memory_order_relaxed);
+    if(i < opiRtMaxViolations)
+    {
+        OpiRtViolation & v = opiRtViolations[i];
+        void * frames[OpiRtViolation::maxFrames + 2];
+        int n = backtrace(frames, OpiRtViolation::maxFrames + 2);
+        n = n > 2 ? n - 2 : 0;
+
+        v.kind = kind;
+        v.what = opiRtWhat;
+        v.nFrames = (uint32_t) n;
+        memcpy(v.frames, frames + 2, n * sizeof(void*));
+    }
+    opiRtBusy = false;
+}
+
+// next definition of a function (for versioned ones, of that version)
+template <class F>
+static F opiRtNext(const char * name, const char * version = 0)
+{
+    void * f = version ? dlvsym(RTLD_NEXT, name, version) : 0;
+    return (F) (f ? f : dlsym(RTLD_NEXT, name));
+}
+
+/*
+ * ==============================================================
+ *
+ *                          CONTROL
+ *
+ * ===============================================================
+ */
+
+extern "C"
+{
+
+__attribute__((visibility("default")))
+void opiRtCheckEnter(const char * what)
+{
+    if(!opiRtDepth++) opiRtWhat = what;
+}
+
+__attribute__((visibility("default")))
+void opiRtCheckLeave(void)
+{
+    if(opiRtDepth) --opiRtDepth;
+}
+
+__attribute__((visibility("default")))
+uint32_t opiRtCheckCount(void)
+{
+    return opiRtNumViolations.load(std::memory_order_relaxed);
+}
+
+__attribute__((visibility("default")))
+int opiRtCheckGet(uint32_t i, OpiRtViolation * out)
+{
+    uint32_t n = opiRtNumViolations.load(std::memory_order_acquire);
+    if(i >= n || i >= opiRtMaxViolations) return 0;
+    *out = opiRtViolations[i];
+    return 1;
+}
+
+__attribute__((visibility("default")))
+void opiRtCheckClear(void)
+{
+    opiRtNumViolations.store(0, std::memory_order_release);
+}
+
+/*
+ * ==============================================================
+ *
+ *                          ALLOCATOR
+ *
+ * ===============================================================
+ */
+
+void * malloc(size_t size)
+{
+    opiRtRecord("malloc");
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t n, size_t size)
+{
+    opiRtRecord("calloc");
+    return __libc_calloc(n, size);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+    opiRtRecord("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void * ptr)
+{
+    if(ptr) opiRtRecord("free");
+    __libc_free(ptr);
+}
+
+void * memalign(size_t alignment, size_t size)
+{
+    opiRtRecord("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size)
+{
+    opiRtRecord("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** out, size_t alignment, size_t size)
+{
+    opiRtRecord("posix_memalign");
+    if(!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void*))
+        return EINVAL;
+    void * ptr = __libc_memalign(alignment, size);
+    if(!ptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+/*
+ * ==============================================================
+ *
+ *                          LOCKS AND WAITS
+ *
+ * ===============================================================
+ */
+
+#define OPI_RT_HOOK(ret, name, params, args) \
+    ret name params \
+    { \
+        static ret (*next) params = opiRtNext<ret (*) params>(#name); \
+        opiRtRecord(#name); \
+        return next args; \
+    }
+
+// the condition variables have an old version too, make sure to get the new
+#define OPI_RT_HOOK_VERSION(ret, name, version, params, args) \
+    ret name params \
+    { \
+        static ret (*next) params = opiRtNext<ret (*) params>(#name, version); \
+        opiRtRecord(#name); \
+        return next args; \
+    }
+
+OPI_RT_HOOK(int, pthread_mutex_lock, (pthread_mutex_t * m), (m))
+OPI_RT_HOOK(int, pthread_mutex_timedlock,
+    (pthread_mutex_t * m, const struct timespec * t), (m, t))
+OPI_RT_HOOK(int, pthread_rwlock_rdlock, (pthread_rwlock_t * l), (l))
+OPI_RT_HOOK(int, pthread_rwlock_wrlock, (pthread_rwlock_t * l), (l))
+OPI_RT_HOOK_VERSION(int, pthread_cond_wait, "GLIBC_2.3.2",
+    (pthread_cond_t * c, pthread_mutex_t * m), (c, m))
+OPI_RT_HOOK_VERSION(int, pthread_cond_timedwait, "GLIBC_2.3.2",
+    (pthread_cond_t * c, pthread_mutex_t * m, const struct timespec * t), (c, m, t))
+OPI_RT_HOOK(int, pthread_join, (pthread_t t, void ** result), (t, result))
+OPI_RT_HOOK(int, pthread_create, (pthread_t * t, const pthread_attr_t * a,
+    void * (*f)(void *), void * arg), (t, a, f, arg))
+OPI_RT_HOOK(int, sem_wait, (sem_t * s), (s))
+OPI_RT_HOOK(int, sem_timedwait, (sem_t * s, const struct timespec * t), (s, t))
+
+OPI_RT_HOOK(int, nanosleep, (const struct timespec * t, struct timespec * left), (t, left))
+OPI_RT_HOOK(int, clock_nanosleep, (clockid_t clock, int flags,
+    const struct timespec * t, struct timespec * left), (clock, flags, t, left))
+OPI_RT_HOOK(int, usleep, (useconds_t us), (us))
+OPI_RT_HOOK(unsigned, sleep, (unsigned s), (s))
+OPI_RT_HOOK(int, sched_yield, (void), ())
+
+/*
+ * ==============================================================
+ *
+ *                          SYSTEM CALLS
+ *
+ * ===============================================================
+ */
+
+OPI_RT_HOOK(ssize_t, read, (int fd, void * buf, size_t n), (fd, buf, n))
+OPI_RT_HOOK(ssize_t, write, (int fd, const void * buf, size_t n), (fd, buf, n))
+OPI_RT_HOOK(int, close, (int fd), (fd))
+OPI_RT_HOOK(FILE *, fopen, (const char * path, const char * mode), (path, mode))
+OPI_RT_HOOK(int, fclose, (FILE * f), (f))
+OPI_RT_HOOK(int, fflush, (FILE * f), (f))
+OPI_RT_HOOK(void *, mmap, (void * addr, size_t n, int prot, int flags, int fd, off_t off),
+    (addr, n, prot, flags, fd, off))
+OPI_RT_HOOK(int, munmap, (void * addr, size_t n), (addr, n))
+
+// the mode is only there with O_CREAT or O_TMPFILE
+int open(const char * path, int flags, ...)
+{
+    static int (*next)(const char *, int, ...) =
+        opiRtNext<int (*)(const char *, int, ...)>("open");
+    opiRtRecord("open");
+
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return next(path, flags, mode);
+}
+
+int openat(int dir, const char * path, int flags, ...)
+{
+    static int (*next)(int, const char *, int, ...) =
+        opiRtNext<int (*)(int, const char *, int, ...)>("openat");
+    opiRtRecord("openat");
+
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return next(dir, path, flags, mode);
+}
+
+// raw system calls (eg. futex from std::atomic::wait); like libc itself this
+// passes on six arguments whatever the call takes
+long syscall(long number, ...)
+{
+    static long (*next)(long, ...) = opiRtNext<long (*)(long, ...)>("syscall");
+    opiRtRecord("syscall");
+
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for(int i = 0; i < 6; ++i) a[i] = va_arg(args, long);
+    va_end(args);
+    return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+} // extern "C"